@@ -27,9 +27,17 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES :=                      \
     Foilplanet_OMX_Basecomponent.cc     \
     Foilplanet_OMX_Baseport.cc          \
+    Foilplanet_OMX_Tunnel.cc            \
     osal_android.cc                     \
+    osal_arena.cc                       \
     osal_event.cc                       \
-    osal_rga.cc
+    osal_queue.cc                       \
+    osal_reorder.cc                     \
+    osal_repack.cc                      \
+    osal_rga.cc                         \
+    osal_task.cc                        \
+    osal_thread.cc                      \
+    osal_vpupool.cc
 
 LOCAL_MODULE := libfpomx_common
 LOCAL_MODULE_TAGS := optional
@@ -52,8 +60,10 @@ include $(BUILD_STATIC_LIBRARY)
 #
 include $(CLEAR_VARS)
 
+# the vpumem cache lives here so every component library shares one
 LOCAL_SRC_FILES := \
-    Foilplanet_OMX_Resourcemanager.cc
+    Foilplanet_OMX_Resourcemanager.cc   \
+    osal_vpumem.cc
 
 LOCAL_PRELINK_MODULE := false
 LOCAL_MODULE := libfpomx_rm
@@ -65,7 +75,7 @@ LOCAL_CFLAGS :=
 LOCAL_CPP_EXTENSION := .cc
 
 LOCAL_STATIC_LIBRARIES := mpp-wrapper
-LOCAL_SHARED_LIBRARIES := libmpp libcutils libutils liblog
+LOCAL_SHARED_LIBRARIES := libmpp libvpu libcutils libutils liblog
 
 LOCAL_C_INCLUDES :=                     \
     $(FOILPLANET_OMX_INC)/foilplanet    \
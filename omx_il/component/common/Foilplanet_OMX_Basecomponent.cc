@@ -18,14 +18,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
 
 #include "Foilplanet_OMX_Baseport.h"
 #include "Foilplanet_OMX_Basecomponent.h"
 #include "Foilplanet_OMX_Resourcemanager.h"
+#include "Foilplanet_OMX_Tunnel.h"
 
 #include "OMX_Macros.h"
 
+#include "osal_arena.h"
 #include "osal_event.h"
+#include "osal_queue.h"
+#include "osal_task.h"
 #include "osal/mpp_log.h"
 #include "osal/mpp_thread.h"
 #include "osal/mpp_mem.h"
@@ -96,7 +101,7 @@ OMX_ERRORTYPE FP_OMX_GetComponentVersion(
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -146,7 +151,7 @@ OMX_ERRORTYPE FP_OMX_GetState (
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    *pState = pFpComponent->currentState;
+    *pState = FP_OMX_LOAD(pFpComponent->currentState);
     ret = OMX_ErrorNone;
 
 EXIT:
@@ -155,28 +160,50 @@ EXIT:
     return ret;
 }
 
+#define FP_OMX_STATE_NUM    (OMX_StateWaitForResources + 1)
+
+/* component state transitions, [current][dest] */
+static const OMX_BOOL gStateTransition[FP_OMX_STATE_NUM][FP_OMX_STATE_NUM] = {
+    /*                      Invalid    Loaded      Idle        Executing   Pause       WaitForRes */
+    /* Invalid    */    {   OMX_FALSE, OMX_FALSE,  OMX_FALSE,  OMX_FALSE,  OMX_FALSE,  OMX_FALSE },
+    /* Loaded     */    {   OMX_TRUE,  OMX_FALSE,  OMX_TRUE,   OMX_FALSE,  OMX_FALSE,  OMX_TRUE  },
+    /* Idle       */    {   OMX_TRUE,  OMX_TRUE,   OMX_FALSE,  OMX_TRUE,   OMX_TRUE,   OMX_FALSE },
+    /* Executing  */    {   OMX_TRUE,  OMX_FALSE,  OMX_TRUE,   OMX_FALSE,  OMX_TRUE,   OMX_FALSE },
+    /* Pause      */    {   OMX_TRUE,  OMX_FALSE,  OMX_TRUE,   OMX_TRUE,   OMX_FALSE,  OMX_FALSE },
+    /* WaitForRes */    {   OMX_TRUE,  OMX_TRUE,   OMX_TRUE,   OMX_FALSE,  OMX_FALSE,  OMX_FALSE },
+};
+
+static OMX_ERRORTYPE FP_OMX_CheckStateTransition(OMX_STATETYPE currentState, OMX_STATETYPE destState)
+{
+    if (currentState == destState)
+        return OMX_ErrorSameState;
+    if (currentState == OMX_StateInvalid)
+        return OMX_ErrorInvalidState;
+    if ((OMX_U32)currentState >= FP_OMX_STATE_NUM || (OMX_U32)destState >= FP_OMX_STATE_NUM)
+        return OMX_ErrorIncorrectStateTransition;
+    if (gStateTransition[currentState][destState] == OMX_FALSE)
+        return OMX_ErrorIncorrectStateTransition;
+
+    return OMX_ErrorNone;
+}
+
 OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 messageParam)
 {
     OMX_ERRORTYPE             ret = OMX_ErrorNone;
     FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     FP_OMX_MESSAGE   *message;
     OMX_STATETYPE             destState = (OMX_STATETYPE)messageParam;
-    OMX_STATETYPE             currentState = pFpComponent->currentState;
+    OMX_STATETYPE             currentState = FP_OMX_LOAD(pFpComponent->currentState);
     FP_OMX_BASEPORT  *pFoilplanetPort = NULL;
     OMX_S32                   countValue = 0;
-    unsigned int              i = 0, j = 0;
-    int                       k = 0;
+    unsigned int              i = 0;
     int                       timeOutCnt = 200;
 
     FunctionIn();
 
-    /* check parameters */
-    if (currentState == destState) {
-        ret = OMX_ErrorSameState;
-        goto EXIT;
-    }
-    if (currentState == OMX_StateInvalid) {
-        ret = OMX_ErrorInvalidState;
+    /* the switch below only carries out transitions the table allows */
+    ret = FP_OMX_CheckStateTransition(currentState, destState);
+    if (ret != OMX_ErrorNone) {
         goto EXIT;
     }
 
@@ -204,7 +231,7 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
         case OMX_StateExecuting:
         case OMX_StatePause:
         case OMX_StateLoaded:
-            pFpComponent->currentState = OMX_StateInvalid;
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StateInvalid);
             ret = pFpComponent->fp_BufferProcessTerminate(pOMXComponent);
 
             for (i = 0; i < ALL_PORT_NUM; i++) {
@@ -237,8 +264,8 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
                 }
             }
             for (i = 0; i < ALL_PORT_NUM; i++) {
-                OSAL_SemaphoreTerminate(pFpComponent->pFoilplanetPort[i].bufferSemID);
-                pFpComponent->pFoilplanetPort[i].bufferSemID = NULL;
+                OSAL_SignalTerminate(pFpComponent->pFoilplanetPort[i].hCodecReadyEvent);
+                pFpComponent->pFoilplanetPort[i].hCodecReadyEvent = NULL;
             }
             if (pFpComponent->fp_codec_componentTerminate != NULL)
                 pFpComponent->fp_codec_componentTerminate(pOMXComponent);
@@ -284,8 +311,8 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
                 }
             }
             for (i = 0; i < ALL_PORT_NUM; i++) {
-                OSAL_SemaphoreTerminate(pFpComponent->pFoilplanetPort[i].bufferSemID);
-                pFpComponent->pFoilplanetPort[i].bufferSemID = NULL;
+                OSAL_SignalTerminate(pFpComponent->pFoilplanetPort[i].hCodecReadyEvent);
+                pFpComponent->pFoilplanetPort[i].hCodecReadyEvent = NULL;
             }
 
             pFpComponent->fp_codec_componentTerminate(pOMXComponent);
@@ -293,8 +320,8 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
             for (i = 0; i < (pFpComponent->portParam.nPorts); i++) {
                 pFoilplanetPort = (pFpComponent->pFoilplanetPort + i);
                 if (CHECK_PORT_TUNNELED(pFoilplanetPort) && CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort)) {
-                    while (!GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE))) {
-                        mpp_free((FP_OMX_MESSAGE*)message);
+                    while ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) != NULL) {
+                        FP_OMX_PortMessageFree(pFoilplanetPort, message);
                     }
                     ret = pFpComponent->fp_FreeTunnelBuffer(pFoilplanetPort, i);
                     if (OMX_ErrorNone != ret) {
@@ -307,11 +334,11 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
                     }
                 }
             }
-            pFpComponent->currentState = OMX_StateLoaded;
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StateLoaded);
             break;
         case OMX_StateWaitForResources:
             ret = FP_OMX_Out_WaitForResource(pOMXComponent);
-            pFpComponent->currentState = OMX_StateLoaded;
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StateLoaded);
             break;
         case OMX_StateExecuting:
         case OMX_StatePause:
@@ -372,7 +399,7 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
                 }
             }
             for (i = 0; i < ALL_PORT_NUM; i++) {
-                ret = OSAL_SemaphoreCreate(&pFpComponent->pFoilplanetPort[i].bufferSemID);
+                ret = OSAL_SignalCreate(&pFpComponent->pFoilplanetPort[i].hCodecReadyEvent);
                 if (ret != OMX_ErrorNone) {
                     ret = OMX_ErrorInsufficientResources;
                     mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
@@ -456,8 +483,8 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
                     pFpComponent->pFoilplanetPort[i].secureBufferMutex = NULL;
                 }
                 for (i = 0; i < ALL_PORT_NUM; i++) {
-                    OSAL_SemaphoreTerminate(pFpComponent->pFoilplanetPort[i].bufferSemID);
-                    pFpComponent->pFoilplanetPort[i].bufferSemID = NULL;
+                    OSAL_SignalTerminate(pFpComponent->pFoilplanetPort[i].hCodecReadyEvent);
+                    pFpComponent->pFoilplanetPort[i].hCodecReadyEvent = NULL;
                 }
 
                 ret = OMX_ErrorInsufficientResources;
@@ -465,7 +492,7 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
             }
 
             mpp_log(" OMX_StateIdle");
-            pFpComponent->currentState = OMX_StateIdle;
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StateIdle);
             break;
         case OMX_StateExecuting:
         case OMX_StatePause:
@@ -473,10 +500,10 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
                 pFpComponent->nRkFlags |= RK_VPU_NEED_FLUSH_ON_SEEK;
             }
             FP_OMX_BufferFlushProcess(pOMXComponent, ALL_PORT_INDEX, OMX_FALSE);
-            pFpComponent->currentState = OMX_StateIdle;
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StateIdle);
             break;
         case OMX_StateWaitForResources:
-            pFpComponent->currentState = OMX_StateIdle;
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StateIdle);
             break;
         default:
             ret = OMX_ErrorIncorrectStateTransition;
@@ -489,17 +516,8 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
             ret = OMX_ErrorIncorrectStateTransition;
             break;
         case OMX_StateIdle:
-            for (i = 0; i < pFpComponent->portParam.nPorts; i++) {
-                pFoilplanetPort = &pFpComponent->pFoilplanetPort[i];
-                if (CHECK_PORT_TUNNELED(pFoilplanetPort) && CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort) && CHECK_PORT_ENABLED(pFoilplanetPort)) {
-                    for (j = 0; j < pFoilplanetPort->tunnelBufferNum; j++) {
-                        OSAL_SemaphorePost(pFpComponent->pFoilplanetPort[i].bufferSemID);
-                    }
-                }
-            }
-
-            pFpComponent->transientState = FP_OMX_TransStateMax;
-            pFpComponent->currentState = OMX_StateExecuting;
+            FP_OMX_STORE(pFpComponent->transientState, FP_OMX_TransStateMax);
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StateExecuting);
             if (pFpComponent->bMultiThreadProcess == OMX_FALSE) {
                 OSAL_SignalSet(pFpComponent->pauseEvent);
             } else {
@@ -507,22 +525,16 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
                     OSAL_SignalSet(pFpComponent->pFoilplanetPort[i].pauseEvent);
                 }
             }
-            break;
-        case OMX_StatePause:
+
+            /* the supplied tunnel buffers start moving once we execute */
             for (i = 0; i < pFpComponent->portParam.nPorts; i++) {
                 pFoilplanetPort = &pFpComponent->pFoilplanetPort[i];
-                if (CHECK_PORT_TUNNELED(pFoilplanetPort) && CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort) && CHECK_PORT_ENABLED(pFoilplanetPort)) {
-                    OMX_S32 semaValue = 0, cnt = 0;
-                    OSAL_Get_SemaphoreCount(pFpComponent->pFoilplanetPort[i].bufferSemID, &semaValue);
-                    OMX_S32 n = GET_MPPLIST(pFoilplanetPort->bufferQ)->list_size();
-                    cnt = n - semaValue;
-                    for (k = 0; k < cnt; k++) {
-                        OSAL_SemaphorePost(pFpComponent->pFoilplanetPort[i].bufferSemID);
-                    }
-                }
+                if (CHECK_PORT_ENABLED(pFoilplanetPort))
+                    FP_OMX_TunnelResume(pOMXComponent, i);
             }
-
-            pFpComponent->currentState = OMX_StateExecuting;
+            break;
+        case OMX_StatePause:
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StateExecuting);
             if (pFpComponent->bMultiThreadProcess == OMX_FALSE) {
                 OSAL_SignalSet(pFpComponent->pauseEvent);
             } else {
@@ -545,10 +557,10 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
             ret = OMX_ErrorIncorrectStateTransition;
             break;
         case OMX_StateIdle:
-            pFpComponent->currentState = OMX_StatePause;
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StatePause);
             break;
         case OMX_StateExecuting:
-            pFpComponent->currentState = OMX_StatePause;
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StatePause);
             break;
         case OMX_StateWaitForResources:
             ret = OMX_ErrorIncorrectStateTransition;
@@ -562,7 +574,7 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
         switch (currentState) {
         case OMX_StateLoaded:
             ret = FP_OMX_In_WaitForResource(pOMXComponent);
-            pFpComponent->currentState = OMX_StateWaitForResources;
+            FP_OMX_STORE(pFpComponent->currentState, OMX_StateWaitForResources);
             break;
         case OMX_StateIdle:
         case OMX_StateExecuting:
@@ -582,17 +594,12 @@ OMX_ERRORTYPE FP_OMX_ComponentStateSet(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32
 EXIT:
     if (ret == OMX_ErrorNone) {
         if (pFpComponent->pCallbacks != NULL) {
-            pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                         pFpComponent->callbackData,
-                                                         OMX_EventCmdComplete, OMX_CommandStateSet,
-                                                         destState, NULL);
+            FP_OMX_PostEvent(pOMXComponent, OMX_EventCmdComplete, OMX_CommandStateSet, destState, NULL);
         }
     } else {
         mpp_err("ERROR");
         if (pFpComponent->pCallbacks != NULL) {
-            pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                         pFpComponent->callbackData,
-                                                         OMX_EventError, ret, 0, NULL);
+            FP_OMX_PostEvent(pOMXComponent, OMX_EventError, ret, 0, NULL);
         }
     }
     FunctionOut();
@@ -600,68 +607,210 @@ EXIT:
     return ret;
 }
 
-static OMX_ERRORTYPE _OMX_MessageHandlerThread(OMX_PTR threadData)
+static OMX_U64 FP_OMX_CallbackTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (OMX_U64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* drains the callback queue, the dispatcher is rescheduled by the next post */
+static void _OMX_CallbackDispatchTask(OMX_PTR pTaskData)
+{
+    OMX_COMPONENTTYPE    *pOMXComponent = (OMX_COMPONENTTYPE *)pTaskData;
+    FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    OMX_CALLBACKTYPE     *pCallbacks = NULL;
+    FP_OMX_CALLBACK      *callback = NULL;
+    FP_OMX_CALLBACK      *done = NULL;
+    OMX_U64               latency = 0;
+
+    for (;;) {
+        MUTEX_LOCK(pFpComponent->callbackMutex);
+        if (done != NULL) {
+            done->next = pFpComponent->callbackFree;
+            pFpComponent->callbackFree = done;
+        }
+        callback = pFpComponent->callbackHead;
+        if (callback == NULL) {
+            pFpComponent->bCallbackScheduled = OMX_FALSE;
+            MUTEX_UNLOCK(pFpComponent->callbackMutex);
+            break;
+        }
+        pFpComponent->callbackHead = callback->next;
+        if (pFpComponent->callbackHead == NULL)
+            pFpComponent->callbackTail = NULL;
+
+        latency = FP_OMX_CallbackTime() - callback->nQueueTime;
+        pFpComponent->nCallbackCount++;
+        pFpComponent->nCallbackLatencySum += latency;
+        if (latency > pFpComponent->nCallbackLatencyMax)
+            pFpComponent->nCallbackLatencyMax = latency;
+        pCallbacks = pFpComponent->pCallbacks;
+        MUTEX_UNLOCK(pFpComponent->callbackMutex);
+
+        if (pCallbacks != NULL) {
+            switch (callback->type) {
+            case FP_OMX_CALLBACK_EVENT:
+                pCallbacks->EventHandler(pOMXComponent, pFpComponent->callbackData,
+                                         callback->eEvent, callback->nData1,
+                                         callback->nData2, callback->pEventData);
+                break;
+            case FP_OMX_CALLBACK_EMPTY_BUFFER_DONE:
+                pCallbacks->EmptyBufferDone(pOMXComponent, pFpComponent->callbackData, callback->bufferHeader);
+                break;
+            case FP_OMX_CALLBACK_FILL_BUFFER_DONE:
+                pCallbacks->FillBufferDone(pOMXComponent, pFpComponent->callbackData, callback->bufferHeader);
+                break;
+            default:
+                break;
+            }
+        }
+        done = callback;
+    }
+}
+
+static OMX_ERRORTYPE FP_OMX_CallbackQueue(OMX_COMPONENTTYPE *pOMXComponent, FP_OMX_CALLBACK *pCallback)
+{
+    OMX_ERRORTYPE         ret = OMX_ErrorNone;
+    FP_OMX_BASECOMPONENT *pFpComponent = NULL;
+    FP_OMX_CALLBACK      *callback = NULL;
+
+    if (pOMXComponent == NULL || pOMXComponent->pComponentPrivate == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+    pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+
+    MUTEX_LOCK(pFpComponent->callbackMutex);
+    callback = pFpComponent->callbackFree;
+    if (callback != NULL) {
+        pFpComponent->callbackFree = callback->next;
+    } else {
+        /* never freed on its own, recycled through callbackFree until the arena goes */
+        callback = (FP_OMX_CALLBACK *)OSAL_ArenaAlloc(pFpComponent->hSessionArena, sizeof(FP_OMX_CALLBACK));
+        if (callback == NULL) {
+            MUTEX_UNLOCK(pFpComponent->callbackMutex);
+            mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+            ret = OMX_ErrorInsufficientResources;
+            goto EXIT;
+        }
+    }
+
+    *callback = *pCallback;
+    callback->nQueueTime = FP_OMX_CallbackTime();
+    callback->next = NULL;
+    if (pFpComponent->callbackTail != NULL)
+        pFpComponent->callbackTail->next = callback;
+    else
+        pFpComponent->callbackHead = callback;
+    pFpComponent->callbackTail = callback;
+
+    if (pFpComponent->bCallbackScheduled == OMX_FALSE) {
+        ret = OSAL_SerialQueueSubmit(pFpComponent->hCallbackDispatcher, _OMX_CallbackDispatchTask, pOMXComponent);
+        if (ret == OMX_ErrorNone)
+            pFpComponent->bCallbackScheduled = OMX_TRUE;
+        else
+            mpp_err("schedule callback dispatcher failed, ret 0x%x", ret);
+    }
+    MUTEX_UNLOCK(pFpComponent->callbackMutex);
+
+EXIT:
+    return ret;
+}
+
+OMX_ERRORTYPE FP_OMX_PostEvent(
+    OMX_COMPONENTTYPE *pOMXComponent,
+    OMX_EVENTTYPE      eEvent,
+    OMX_U32            nData1,
+    OMX_U32            nData2,
+    OMX_PTR            pEventData)
+{
+    FP_OMX_CALLBACK callback;
+
+    memset(&callback, 0, sizeof(FP_OMX_CALLBACK));
+    callback.type       = FP_OMX_CALLBACK_EVENT;
+    callback.eEvent     = eEvent;
+    callback.nData1     = nData1;
+    callback.nData2     = nData2;
+    callback.pEventData = pEventData;
+
+    return FP_OMX_CallbackQueue(pOMXComponent, &callback);
+}
+
+OMX_ERRORTYPE FP_OMX_PostEmptyBufferDone(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader)
+{
+    FP_OMX_CALLBACK callback;
+
+    memset(&callback, 0, sizeof(FP_OMX_CALLBACK));
+    callback.type         = FP_OMX_CALLBACK_EMPTY_BUFFER_DONE;
+    callback.bufferHeader = bufferHeader;
+
+    return FP_OMX_CallbackQueue(pOMXComponent, &callback);
+}
+
+OMX_ERRORTYPE FP_OMX_PostFillBufferDone(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader)
+{
+    FP_OMX_CALLBACK callback;
+
+    memset(&callback, 0, sizeof(FP_OMX_CALLBACK));
+    callback.type         = FP_OMX_CALLBACK_FILL_BUFFER_DONE;
+    callback.bufferHeader = bufferHeader;
+
+    return FP_OMX_CallbackQueue(pOMXComponent, &callback);
+}
+
+/* one task per queued command, run in order on the shared worker pool */
+static void _OMX_MessageHandlerTask(OMX_PTR pTaskData)
 {
-    OMX_ERRORTYPE             ret = OMX_ErrorNone;
     OMX_COMPONENTTYPE        *pOMXComponent = NULL;
     FP_OMX_BASECOMPONENT *pFpComponent = NULL;
-    FP_OMX_MESSAGE       *message = NULL;
-    OMX_U32                   messageType = 0, portIndex = 0;
+    FP_OMX_MESSAGE        message;
+    OMX_U32                   portIndex = 0;
 
     FunctionIn();
 
-    if (threadData == NULL) {
-        ret = OMX_ErrorBadParameter;
+    if (pTaskData == NULL) {
         goto EXIT;
     }
 
-    pOMXComponent = (OMX_COMPONENTTYPE *)threadData;
-    ret = FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE));
-    if (ret != OMX_ErrorNone) {
+    pOMXComponent = (OMX_COMPONENTTYPE *)pTaskData;
+    if (FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE)) != OMX_ErrorNone) {
         goto EXIT;
     }
 
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    while (pFpComponent->bExitMessageHandlerThread == OMX_FALSE) {
-        GET_MPPLIST(pFpComponent->messageQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE));
-        if (message != NULL) {
-            messageType = message->messageType;
-            switch (messageType) {
-            case OMX_CommandStateSet:
-                ret = FP_OMX_ComponentStateSet(pOMXComponent, message->messageParam);
-                break;
-            case OMX_CommandFlush:
-                ret = FP_OMX_BufferFlushProcess(pOMXComponent, message->messageParam, OMX_TRUE);
-                break;
-            case OMX_CommandPortDisable:
-                ret = FP_OMX_PortDisableProcess(pOMXComponent, message->messageParam);
-                break;
-            case OMX_CommandPortEnable:
-                ret = FP_OMX_PortEnableProcess(pOMXComponent, message->messageParam);
-                break;
-            case OMX_CommandMarkBuffer:
-                portIndex = message->messageParam;
-                pFpComponent->pFoilplanetPort[portIndex].markType.hMarkTargetComponent = ((OMX_MARKTYPE *)message->pCmdData)->hMarkTargetComponent;
-                pFpComponent->pFoilplanetPort[portIndex].markType.pMarkData            = ((OMX_MARKTYPE *)message->pCmdData)->pMarkData;
-                break;
-            case (OMX_COMMANDTYPE)FP_OMX_CommandComponentDeInit:
-                pFpComponent->bExitMessageHandlerThread = OMX_TRUE;
-                break;
-            default:
-                break;
-            }
-            mpp_free(message);
-            message = NULL;
-        }
+    if (GET_MPPLIST(pFpComponent->messageQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE)) != 0) {
+        mpp_err("command task without a queued message");
+        goto EXIT;
     }
 
-    pthread_exit(NULL);
+    switch (message.messageType) {
+    case OMX_CommandStateSet:
+        FP_OMX_ComponentStateSet(pOMXComponent, message.messageParam);
+        break;
+    case OMX_CommandFlush:
+        FP_OMX_BufferFlushProcess(pOMXComponent, message.messageParam, OMX_TRUE);
+        break;
+    case OMX_CommandPortDisable:
+        FP_OMX_PortDisableProcess(pOMXComponent, message.messageParam);
+        break;
+    case OMX_CommandPortEnable:
+        FP_OMX_PortEnableProcess(pOMXComponent, message.messageParam);
+        break;
+    case OMX_CommandMarkBuffer:
+        portIndex = message.messageParam;
+        pFpComponent->pFoilplanetPort[portIndex].markType.hMarkTargetComponent = ((OMX_MARKTYPE *)message.pCmdData)->hMarkTargetComponent;
+        pFpComponent->pFoilplanetPort[portIndex].markType.pMarkData            = ((OMX_MARKTYPE *)message.pCmdData)->pMarkData;
+        break;
+    default:
+        break;
+    }
 
 EXIT:
     FunctionOut();
-
-    return ret;
 }
 
 static OMX_ERRORTYPE Foilplanet_StateSet(FP_OMX_BASECOMPONENT *pFpComponent, OMX_U32 nParam)
@@ -669,43 +818,43 @@ static OMX_ERRORTYPE Foilplanet_StateSet(FP_OMX_BASECOMPONENT *pFpComponent, OMX
     OMX_U32 destState = nParam;
     OMX_U32 i = 0;
 
-    if ((destState == OMX_StateIdle) && (pFpComponent->currentState == OMX_StateLoaded)) {
-        pFpComponent->transientState = FP_OMX_TransStateLoadedToIdle;
+    if ((destState == OMX_StateIdle) && (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateLoaded)) {
+        FP_OMX_STORE(pFpComponent->transientState, FP_OMX_TransStateLoadedToIdle);
         for (i = 0; i < pFpComponent->portParam.nPorts; i++) {
-            pFpComponent->pFoilplanetPort[i].portState = OMX_StateIdle;
+            FP_OMX_STORE(pFpComponent->pFoilplanetPort[i].portState, OMX_StateIdle);
         }
         mpp_log("to OMX_StateIdle");
-    } else if ((destState == OMX_StateLoaded) && (pFpComponent->currentState == OMX_StateIdle)) {
-        pFpComponent->transientState = FP_OMX_TransStateIdleToLoaded;
+    } else if ((destState == OMX_StateLoaded) && (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateIdle)) {
+        FP_OMX_STORE(pFpComponent->transientState, FP_OMX_TransStateIdleToLoaded);
         for (i = 0; i < pFpComponent->portParam.nPorts; i++) {
-            pFpComponent->pFoilplanetPort[i].portState = OMX_StateLoaded;
+            FP_OMX_STORE(pFpComponent->pFoilplanetPort[i].portState, OMX_StateLoaded);
         }
         mpp_log("to OMX_StateLoaded");
-    } else if ((destState == OMX_StateIdle) && (pFpComponent->currentState == OMX_StateExecuting)) {
+    } else if ((destState == OMX_StateIdle) && (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateExecuting)) {
         FP_OMX_BASEPORT *pFoilplanetPort = NULL;
 
         pFoilplanetPort = &(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX]);
         if ((pFoilplanetPort->portDefinition.bEnabled == OMX_FALSE) &&
-            (pFoilplanetPort->portState == OMX_StateIdle)) {
+            (FP_OMX_LOAD(pFoilplanetPort->portState) == OMX_StateIdle)) {
             pFoilplanetPort->exceptionFlag = INVALID_STATE;
             OSAL_SemaphorePost(pFoilplanetPort->loadedResource);
         }
 
         pFoilplanetPort = &(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX]);
         if ((pFoilplanetPort->portDefinition.bEnabled == OMX_FALSE) &&
-            (pFoilplanetPort->portState == OMX_StateIdle)) {
+            (FP_OMX_LOAD(pFoilplanetPort->portState) == OMX_StateIdle)) {
             pFoilplanetPort->exceptionFlag = INVALID_STATE;
             OSAL_SemaphorePost(pFoilplanetPort->loadedResource);
         }
 
-        pFpComponent->transientState = FP_OMX_TransStateExecutingToIdle;
+        FP_OMX_STORE(pFpComponent->transientState, FP_OMX_TransStateExecutingToIdle);
         mpp_log("to OMX_StateIdle");
-    } else if ((destState == OMX_StateExecuting) && (pFpComponent->currentState == OMX_StateIdle)) {
-        pFpComponent->transientState = FP_OMX_TransStateIdleToExecuting;
+    } else if ((destState == OMX_StateExecuting) && (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateIdle)) {
+        FP_OMX_STORE(pFpComponent->transientState, FP_OMX_TransStateIdleToExecuting);
         mpp_log("to OMX_StateExecuting");
     } else if (destState == OMX_StateInvalid) {
         for (i = 0; i < pFpComponent->portParam.nPorts; i++) {
-            pFpComponent->pFoilplanetPort[i].portState = OMX_StateInvalid;
+            FP_OMX_STORE(pFpComponent->pFoilplanetPort[i].portState, OMX_StateInvalid);
         }
     }
 
@@ -720,8 +869,8 @@ static OMX_ERRORTYPE Foilplanet_SetPortFlush(FP_OMX_BASECOMPONENT *pFpComponent,
     OMX_U16              i = 0, cnt = 0, index = 0;
 
 
-    if ((pFpComponent->currentState == OMX_StateExecuting) ||
-        (pFpComponent->currentState == OMX_StatePause)) {
+    if ((FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateExecuting) ||
+        (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StatePause)) {
         if ((portIndex != ALL_PORT_INDEX) &&
             ((OMX_S32)portIndex >= (OMX_S32)pFpComponent->portParam.nPorts)) {
             ret = OMX_ErrorBadPortIndex;
@@ -737,7 +886,7 @@ static OMX_ERRORTYPE Foilplanet_SetPortFlush(FP_OMX_BASECOMPONENT *pFpComponent,
                 index = i;
             else
                 index = portIndex;
-            pFpComponent->pFoilplanetPort[index].bIsPortFlushed = OMX_TRUE;
+            FP_OMX_STORE(pFpComponent->pFoilplanetPort[index].bIsPortFlushed, OMX_TRUE);
         }
     } else {
         ret = OMX_ErrorIncorrectStateOperation;
@@ -771,7 +920,7 @@ static OMX_ERRORTYPE Foilplanet_SetPortEnable(FP_OMX_BASECOMPONENT *pFpComponent
                 ret = OMX_ErrorIncorrectStateOperation;
                 goto EXIT;
             } else {
-                pFoilplanetPort->portState = OMX_StateIdle;
+                FP_OMX_STORE(pFoilplanetPort->portState, OMX_StateIdle);
             }
         }
     } else {
@@ -780,7 +929,7 @@ static OMX_ERRORTYPE Foilplanet_SetPortEnable(FP_OMX_BASECOMPONENT *pFpComponent
             ret = OMX_ErrorIncorrectStateOperation;
             goto EXIT;
         } else {
-            pFoilplanetPort->portState = OMX_StateIdle;
+            FP_OMX_STORE(pFoilplanetPort->portState, OMX_StateIdle);
         }
     }
     ret = OMX_ErrorNone;
@@ -814,13 +963,13 @@ static OMX_ERRORTYPE Foilplanet_SetPortDisable(FP_OMX_BASECOMPONENT *pFpComponen
                 ret = OMX_ErrorIncorrectStateOperation;
                 goto EXIT;
             }
-            pFoilplanetPort->portState = OMX_StateLoaded;
-            pFoilplanetPort->bIsPortDisabled = OMX_TRUE;
+            FP_OMX_STORE(pFoilplanetPort->portState, OMX_StateLoaded);
+            FP_OMX_STORE(pFoilplanetPort->bIsPortDisabled, OMX_TRUE);
         }
     } else {
         pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
-        pFoilplanetPort->portState = OMX_StateLoaded;
-        pFoilplanetPort->bIsPortDisabled = OMX_TRUE;
+        FP_OMX_STORE(pFoilplanetPort->portState, OMX_StateLoaded);
+        FP_OMX_STORE(pFoilplanetPort->bIsPortDisabled, OMX_TRUE);
     }
     ret = OMX_ErrorNone;
 
@@ -843,8 +992,8 @@ static OMX_ERRORTYPE Foilplanet_SetMarkBuffer(FP_OMX_BASECOMPONENT *pFpComponent
         goto EXIT;
     }
 
-    if ((pFpComponent->currentState == OMX_StateExecuting) ||
-        (pFpComponent->currentState == OMX_StatePause)) {
+    if ((FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateExecuting) ||
+        (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StatePause)) {
         ret = OMX_ErrorNone;
     } else {
         ret = OMX_ErrorIncorrectStateOperation;
@@ -855,27 +1004,25 @@ EXIT:
 }
 
 static OMX_ERRORTYPE FP_OMX_CommandQueue(
+    OMX_COMPONENTTYPE     *pOMXComponent,
     FP_OMX_BASECOMPONENT *pFpComponent,
     OMX_COMMANDTYPE        Cmd,
     OMX_U32                nParam,
     OMX_PTR                pCmdData)
 {
     OMX_ERRORTYPE    ret = OMX_ErrorNone;
-    FP_OMX_MESSAGE *command = mpp_malloc(FP_OMX_MESSAGE, 1);
+    FP_OMX_MESSAGE   command;
 
-    if (command == NULL) {
-        ret = OMX_ErrorInsufficientResources;
-        goto EXIT;
-    }
-    command->messageType  = (OMX_U32)Cmd;
-    command->messageParam = nParam;
-    command->pCmdData     = pCmdData;
+    /* messageQ stores the message by value, no heap copy is needed here */
+    command.messageType  = (OMX_U32)Cmd;
+    command.messageParam = nParam;
+    command.pCmdData     = pCmdData;
 
-    if (GET_MPPLIST(pFpComponent->messageQ)->add_at_tail(command, sizeof(FP_OMX_MESSAGE))) {
+    if (GET_MPPLIST(pFpComponent->messageQ)->add_at_tail(&command, sizeof(FP_OMX_MESSAGE))) {
         ret = OMX_ErrorUndefined;
         goto EXIT;
     }
-    ret = OSAL_SemaphorePost(pFpComponent->msgSemaphoreHandle);
+    ret = OSAL_SerialQueueSubmit(pFpComponent->hMessageHandler, _OMX_MessageHandlerTask, pOMXComponent);
 
 EXIT:
     return ret;
@@ -910,7 +1057,7 @@ OMX_ERRORTYPE FP_OMX_SendCommand(
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -949,7 +1096,7 @@ OMX_ERRORTYPE FP_OMX_SendCommand(
         break;
     }
 
-    ret = FP_OMX_CommandQueue(pFpComponent, Cmd, nParam, pCmdData);
+    ret = FP_OMX_CommandQueue(pOMXComponent, pFpComponent, Cmd, nParam, pCmdData);
 
 EXIT:
     FunctionOut();
@@ -988,7 +1135,7 @@ OMX_ERRORTYPE FP_OMX_GetParameter(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -1043,8 +1190,8 @@ OMX_ERRORTYPE FP_OMX_GetParameter(
         OMX_U32                       portIndex = bufferSupplier->nPortIndex;
         FP_OMX_BASEPORT          *pFoilplanetPort;
 
-        if ((pFpComponent->currentState == OMX_StateLoaded) ||
-            (pFpComponent->currentState == OMX_StateWaitForResources)) {
+        if ((FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateLoaded) ||
+            (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateWaitForResources)) {
             if (portIndex >= pFpComponent->portParam.nPorts) {
                 ret = OMX_ErrorBadPortIndex;
                 goto EXIT;
@@ -1127,7 +1274,7 @@ OMX_ERRORTYPE FP_OMX_SetParameter(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -1143,8 +1290,8 @@ OMX_ERRORTYPE FP_OMX_SetParameter(
             goto EXIT;
         }
 
-        if ((pFpComponent->currentState != OMX_StateLoaded) &&
-            (pFpComponent->currentState != OMX_StateWaitForResources)) {
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) &&
+            (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateWaitForResources)) {
             ret = OMX_ErrorIncorrectStateOperation;
             goto EXIT;
         }
@@ -1168,13 +1315,14 @@ OMX_ERRORTYPE FP_OMX_SetParameter(
 
         pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
 
-        if ((pFpComponent->currentState != OMX_StateLoaded) && (pFpComponent->currentState != OMX_StateWaitForResources)) {
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) && (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateWaitForResources)) {
             if (pFoilplanetPort->portDefinition.bEnabled == OMX_TRUE) {
                 ret = OMX_ErrorIncorrectStateOperation;
                 goto EXIT;
             }
         }
-        if (portDefinition->nBufferCountActual < pFoilplanetPort->portDefinition.nBufferCountMin) {
+        if ((portDefinition->nBufferCountActual < pFoilplanetPort->portDefinition.nBufferCountMin) ||
+            (portDefinition->nBufferCountActual > PORT_BUFFER_NUM_MAX)) {
             ret = OMX_ErrorBadParameter;
             goto EXIT;
         }
@@ -1185,8 +1333,8 @@ OMX_ERRORTYPE FP_OMX_SetParameter(
     case OMX_IndexParamPriorityMgmt: {
         OMX_PRIORITYMGMTTYPE *compPriority = (OMX_PRIORITYMGMTTYPE *)ComponentParameterStructure;
 
-        if ((pFpComponent->currentState != OMX_StateLoaded) &&
-            (pFpComponent->currentState != OMX_StateWaitForResources)) {
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) &&
+            (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateWaitForResources)) {
             ret = OMX_ErrorIncorrectStateOperation;
             goto EXIT;
         }
@@ -1216,7 +1364,7 @@ OMX_ERRORTYPE FP_OMX_SetParameter(
         }
 
         pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
-        if ((pFpComponent->currentState != OMX_StateLoaded) && (pFpComponent->currentState != OMX_StateWaitForResources)) {
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) && (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateWaitForResources)) {
             if (pFoilplanetPort->portDefinition.bEnabled == OMX_TRUE) {
                 ret = OMX_ErrorIncorrectStateOperation;
                 goto EXIT;
@@ -1289,6 +1437,80 @@ EXIT:
     return ret;
 }
 
+void FP_OMX_CodecThreadEnter(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex)
+{
+    FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    OSAL_THREAD_POLICY    policy;
+
+    MUTEX_LOCK(pFpComponent->compMutex);
+    policy = pFpComponent->threadPolicy[pFpComponent->codecThreadRole[nPortIndex]];
+    pFpComponent->codecThreadId[nPortIndex] = OSAL_GetThreadId();
+    MUTEX_UNLOCK(pFpComponent->compMutex);
+
+    OSAL_ApplyThreadPolicy(0, &policy);
+}
+
+void FP_OMX_CodecThreadLeave(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex)
+{
+    FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    OSAL_THREAD_POLICY    policy;
+
+    MUTEX_LOCK(pFpComponent->compMutex);
+    pFpComponent->codecThreadId[nPortIndex] = 0;
+    MUTEX_UNLOCK(pFpComponent->compMutex);
+
+    /*
+     * The loop ran on a codec pool worker, the next loop on it may be of
+     * another role or component. Cpus and nice left open by the worker
+     * policy go back to their defaults, a cgroup is kept.
+     */
+    OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_WORKER, &policy);
+    if (policy.nCpuMask == 0)
+        policy.nCpuMask = ~(OMX_U32)0;
+    if (policy.nNice == OSAL_THREAD_NICE_UNCHANGED)
+        policy.nNice = 0;
+    OSAL_ApplyThreadPolicy(0, &policy);
+}
+
+/* stores the policy of a role and moves the running codec threads of that role */
+static OMX_ERRORTYPE FP_OMX_SetThreadPolicy(FP_OMX_BASECOMPONENT *pFpComponent, FP_OMX_CONFIG_THREADPOLICY *pConfig)
+{
+    OMX_ERRORTYPE      ret = OMX_ErrorNone;
+    OSAL_THREAD_POLICY policy;
+    OMX_U32            i = 0;
+
+    if (pConfig->eRole != OSAL_THREAD_ROLE_CONTROL && pConfig->eRole != OSAL_THREAD_ROLE_COPY) {
+        /* worker threads are shared by all components, properties only */
+        ret = OMX_ErrorUnsupportedSetting;
+        goto EXIT;
+    }
+
+    MUTEX_LOCK(pFpComponent->compMutex);
+    policy = pFpComponent->threadPolicy[pConfig->eRole];
+    if (pConfig->cCgroup[0] != '\0' &&
+        strncmp(pConfig->cCgroup, policy.cCgroup, OSAL_THREAD_CGROUP_SIZE - 1) != 0) {
+        /* cgroups only come from properties, a client may not name a file to write */
+        MUTEX_UNLOCK(pFpComponent->compMutex);
+        ret = OMX_ErrorUnsupportedSetting;
+        goto EXIT;
+    }
+    policy.nCpuMask      = pConfig->nCpuMask;
+    policy.nNice         = pConfig->nNice;
+    policy.nFifoPriority = OSAL_ClampFifoPriority(pConfig->nFifoPriority, OSAL_THREAD_FIFO_CONFIG_MAX);
+    pFpComponent->threadPolicy[pConfig->eRole] = policy;
+    for (i = 0; i < ALL_PORT_NUM; i++) {
+        if (pFpComponent->codecThreadId[i] != 0 &&
+            pFpComponent->codecThreadRole[i] == (OSAL_THREAD_ROLE)pConfig->eRole) {
+            if (OSAL_ApplyThreadPolicy(pFpComponent->codecThreadId[i], &policy) != OMX_ErrorNone)
+                ret = OMX_ErrorInsufficientResources;
+        }
+    }
+    MUTEX_UNLOCK(pFpComponent->compMutex);
+
+EXIT:
+    return ret;
+}
+
 OMX_ERRORTYPE FP_OMX_GetConfig(
     OMX_IN OMX_HANDLETYPE hComponent,
     OMX_IN OMX_INDEXTYPE  nIndex,
@@ -1320,12 +1542,37 @@ OMX_ERRORTYPE FP_OMX_GetConfig(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
 
-    switch (nIndex) {
+    switch ((OMX_U32)nIndex) {
+    case OMX_IndexConfigFpThreadPolicy: {
+        FP_OMX_CONFIG_THREADPOLICY *pConfig = (FP_OMX_CONFIG_THREADPOLICY *)pComponentConfigStructure;
+        OSAL_THREAD_POLICY          policy;
+
+        ret = FP_OMX_Check_SizeVersion(pConfig, sizeof(FP_OMX_CONFIG_THREADPOLICY));
+        if (ret != OMX_ErrorNone)
+            break;
+        if (pConfig->eRole >= OSAL_THREAD_ROLE_NUM) {
+            ret = OMX_ErrorBadParameter;
+            break;
+        }
+        if (pConfig->eRole == OSAL_THREAD_ROLE_WORKER) {
+            OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_WORKER, &policy);
+        } else {
+            MUTEX_LOCK(pFpComponent->compMutex);
+            policy = pFpComponent->threadPolicy[pConfig->eRole];
+            MUTEX_UNLOCK(pFpComponent->compMutex);
+        }
+        pConfig->nCpuMask      = policy.nCpuMask;
+        pConfig->nNice         = policy.nNice;
+        pConfig->nFifoPriority = policy.nFifoPriority;
+        memset(pConfig->cCgroup, 0, sizeof(pConfig->cCgroup));
+        strncpy(pConfig->cCgroup, policy.cCgroup, sizeof(pConfig->cCgroup) - 1);
+    }
+    break;
     default:
         ret = OMX_ErrorUnsupportedIndex;
         break;
@@ -1368,12 +1615,21 @@ OMX_ERRORTYPE FP_OMX_SetConfig(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
 
-    switch (nIndex) {
+    switch ((OMX_U32)nIndex) {
+    case OMX_IndexConfigFpThreadPolicy: {
+        FP_OMX_CONFIG_THREADPOLICY *pConfig = (FP_OMX_CONFIG_THREADPOLICY *)pComponentConfigStructure;
+
+        ret = FP_OMX_Check_SizeVersion(pConfig, sizeof(FP_OMX_CONFIG_THREADPOLICY));
+        if (ret != OMX_ErrorNone)
+            break;
+        ret = FP_OMX_SetThreadPolicy(pFpComponent, pConfig);
+    }
+    break;
     default:
         ret = OMX_ErrorUnsupportedIndex;
         break;
@@ -1416,11 +1672,17 @@ OMX_ERRORTYPE FP_OMX_GetExtensionIndex(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
 
+    if (strcmp(cParameterName, FOILPLANET_INDEX_CONFIG_THREAD_POLICY) == 0) {
+        *pIndexType = (OMX_INDEXTYPE)OMX_IndexConfigFpThreadPolicy;
+        ret = OMX_ErrorNone;
+        goto EXIT;
+    }
+
     ret = OMX_ErrorBadParameter;
 
 EXIT:
@@ -1467,13 +1729,13 @@ OMX_ERRORTYPE FP_OMX_SetCallbacks (
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
 
         mpp_err("OMX_ErrorInvalidState :%d", __LINE__);
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
-    if (pFpComponent->currentState != OMX_StateLoaded) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) {
         mpp_err("OMX_StateLoaded :%d", __LINE__);
         ret = OMX_ErrorIncorrectStateOperation;
         goto EXIT;
@@ -1511,6 +1773,7 @@ OMX_ERRORTYPE FP_OMX_BaseComponent_Constructor(
     OMX_ERRORTYPE             ret = OMX_ErrorNone;
     OMX_COMPONENTTYPE        *pOMXComponent;
     FP_OMX_BASECOMPONENT *pFpComponent = NULL;
+    OMX_U32                   i = 0;
 
     FunctionIn();
 
@@ -1530,18 +1793,15 @@ OMX_ERRORTYPE FP_OMX_BaseComponent_Constructor(
     pFpComponent->rkversion = &OMX_version[0];
     pOMXComponent->pComponentPrivate = (OMX_PTR)pFpComponent;
 
-    ret = OSAL_SemaphoreCreate(&pFpComponent->msgSemaphoreHandle);
-    if (ret != OMX_ErrorNone) {
-        ret = OMX_ErrorInsufficientResources;
-        mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
-        goto EXIT;
-    }
     pFpComponent->compMutex = MUTEX_CREATE();
     if (!pFpComponent->compMutex) {
         ret = OMX_ErrorInsufficientResources;
         mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
         goto EXIT;
     }
+    for (i = 0; i < OSAL_THREAD_ROLE_NUM; i++) {
+        OSAL_GetThreadPolicy((OSAL_THREAD_ROLE)i, &pFpComponent->threadPolicy[i]);
+    }
     ret = OSAL_SignalCreate(&pFpComponent->abendStateEvent);
     if (ret != OMX_ErrorNone) {
         ret = OMX_ErrorInsufficientResources;
@@ -1549,12 +1809,45 @@ OMX_ERRORTYPE FP_OMX_BaseComponent_Constructor(
         goto EXIT;
     }
 
-    pFpComponent->bExitMessageHandlerThread = OMX_FALSE;
-
     // MAX_QUEUE_ELEMENTS
     pFpComponent->messageQ = new mpp_list();
 
-    pFpComponent->hMessageHandler = new MppThread((void *(*)(void *))_OMX_MessageHandlerThread, pOMXComponent);
+    ret = OSAL_SerialQueueCreate(&pFpComponent->hMessageHandler, OSAL_TASK_POOL_COMMAND, MAX_COMMAND_TASKS);
+    if (ret != OMX_ErrorNone) {
+        ret = OMX_ErrorInsufficientResources;
+        mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+        goto EXIT;
+    }
+
+    ret = OSAL_ArenaCreate(&pFpComponent->hSessionArena, OSAL_ARENA_CHUNK_DEFAULT, OMX_TRUE);
+    if (ret != OMX_ErrorNone) {
+        mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+        goto EXIT;
+    }
+    ret = OSAL_ArenaCreate(&pFpComponent->hScratchArena, OSAL_ARENA_CHUNK_DEFAULT, OMX_FALSE);
+    if (ret != OMX_ErrorNone) {
+        mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+        goto EXIT;
+    }
+
+    pFpComponent->callbackMutex = MUTEX_CREATE();
+    if (!pFpComponent->callbackMutex) {
+        ret = OMX_ErrorInsufficientResources;
+        mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+        goto EXIT;
+    }
+    /* bCallbackScheduled keeps at most one dispatcher task queued */
+    ret = OSAL_SerialQueueCreate(&pFpComponent->hCallbackDispatcher, OSAL_TASK_POOL_CALLBACK, 1);
+    if (ret != OMX_ErrorNone) {
+        ret = OMX_ErrorInsufficientResources;
+        mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+        goto EXIT;
+    }
+    ret = OSAL_ReorderCreate(&pFpComponent->hReorderMap, MAX_REORDER_DEPTH);
+    if (ret != OMX_ErrorNone) {
+        mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+        goto EXIT;
+    }
 
     pFpComponent->bMultiThreadProcess = OMX_FALSE;
 
@@ -1576,7 +1869,6 @@ OMX_ERRORTYPE FP_OMX_BaseComponent_Destructor(
     OMX_ERRORTYPE             ret = OMX_ErrorNone;
     OMX_COMPONENTTYPE        *pOMXComponent = NULL;
     FP_OMX_BASECOMPONENT *pFpComponent = NULL;
-    OMX_S32                   semaValue = 0;
 
     FunctionIn();
 
@@ -1596,24 +1888,40 @@ OMX_ERRORTYPE FP_OMX_BaseComponent_Destructor(
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    FP_OMX_CommandQueue(pFpComponent, (OMX_COMMANDTYPE)FP_OMX_CommandComponentDeInit, 0, NULL);
-    usleep(0); // wait
-    OSAL_Get_SemaphoreCount(pFpComponent->msgSemaphoreHandle, &semaValue);
-    if (semaValue == 0)
-        OSAL_SemaphorePost(pFpComponent->msgSemaphoreHandle);
-    OSAL_SemaphorePost(pFpComponent->msgSemaphoreHandle);
-
-    delete ((MppThread *)pFpComponent->hMessageHandler);
+    /* runs the commands still pending before the component goes away */
+    OSAL_SerialQueueTerminate(pFpComponent->hMessageHandler);
     pFpComponent->hMessageHandler = NULL;
 
+    /* delivers the callbacks still queued, must not run on the dispatcher itself */
+    OSAL_SerialQueueTerminate(pFpComponent->hCallbackDispatcher);
+    pFpComponent->hCallbackDispatcher = NULL;
+    if (pFpComponent->nCallbackCount > 0) {
+        mpp_log("callbacks %d, queue latency avg %lld us max %lld us",
+                pFpComponent->nCallbackCount,
+                (long long)(pFpComponent->nCallbackLatencySum / pFpComponent->nCallbackCount),
+                (long long)pFpComponent->nCallbackLatencyMax);
+    }
+    /* callbacks live in the session arena */
+    pFpComponent->callbackFree = NULL;
+    MUTEX_FREE(pFpComponent->callbackMutex);
+    pFpComponent->callbackMutex = NULL;
+
+    OSAL_ReorderTerminate(pFpComponent->hReorderMap);
+    pFpComponent->hReorderMap = NULL;
+
     OSAL_SignalTerminate(pFpComponent->abendStateEvent);
     pFpComponent->abendStateEvent = NULL;
     MUTEX_FREE(pFpComponent->compMutex);
     pFpComponent->compMutex = NULL;
-    OSAL_SemaphoreTerminate(pFpComponent->msgSemaphoreHandle);
-    pFpComponent->msgSemaphoreHandle = NULL;
     delete GET_MPPLIST(pFpComponent->messageQ);
 
+    mpp_log("arena peak session %d scratch %d bytes",
+            OSAL_ArenaPeak(pFpComponent->hSessionArena), OSAL_ArenaPeak(pFpComponent->hScratchArena));
+    OSAL_ArenaTerminate(pFpComponent->hSessionArena);
+    pFpComponent->hSessionArena = NULL;
+    OSAL_ArenaTerminate(pFpComponent->hScratchArena);
+    pFpComponent->hScratchArena = NULL;
+
     mpp_free(pFpComponent);
     pFpComponent = NULL;
 
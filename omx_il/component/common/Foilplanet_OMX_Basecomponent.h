@@ -20,6 +20,8 @@
 #include "OMX_Def.h"
 #include "OMX_Component.h"
 #include "Foilplanet_OMX_Baseport.h"
+#include "osal_thread.h"
+#include "osal_reorder.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,6 +33,24 @@ typedef struct _FP_OMX_MESSAGE {
     OMX_PTR pCmdData;
 } FP_OMX_MESSAGE;
 
+typedef enum _FP_OMX_CALLBACK_TYPE {
+    FP_OMX_CALLBACK_EVENT = 0,
+    FP_OMX_CALLBACK_EMPTY_BUFFER_DONE,
+    FP_OMX_CALLBACK_FILL_BUFFER_DONE,
+} FP_OMX_CALLBACK_TYPE;
+
+/* a client callback waiting in the component callback queue */
+typedef struct _FP_OMX_CALLBACK {
+    FP_OMX_CALLBACK_TYPE     type;
+    OMX_EVENTTYPE            eEvent;
+    OMX_U32                  nData1;
+    OMX_U32                  nData2;
+    OMX_PTR                  pEventData;
+    OMX_BUFFERHEADERTYPE    *bufferHeader;
+    OMX_U64                  nQueueTime;     /* us, CLOCK_MONOTONIC */
+    struct _FP_OMX_CALLBACK *next;
+} FP_OMX_CALLBACK;
+
 /* for Check TimeStamp after Seek */
 typedef struct _FP_OMX_TIMESTAMP {
     OMX_BOOL  needSetStartTimeStamp;
@@ -63,11 +83,14 @@ typedef struct _FP_OMX_BASECOMPONENT {
     OMX_HANDLETYPE                  hComponentHandle;
 
     /* Message Handler */
-    OMX_BOOL                        bExitMessageHandlerThread;
-    OMX_HANDLETYPE                  hMessageHandler;
-    OMX_HANDLETYPE                  msgSemaphoreHandle;
+    OMX_HANDLETYPE                  hMessageHandler;    /* serial queue on the shared worker pool */
     OMX_QUEUE                       messageQ;
 
+    /* Codec thread placement, codecThreadId is 0 while the thread is not running */
+    OSAL_THREAD_POLICY              threadPolicy[OSAL_THREAD_ROLE_NUM];
+    OSAL_THREAD_ROLE                codecThreadRole[ALL_PORT_NUM];
+    pid_t                           codecThreadId[ALL_PORT_NUM];
+
     /* Port */
     OMX_PORT_PARAM_TYPE             portParam;
     FP_OMX_BASEPORT                *pFoilplanetPort;
@@ -78,12 +101,26 @@ typedef struct _FP_OMX_BASECOMPONENT {
     OMX_CALLBACKTYPE                *pCallbacks;
     OMX_PTR                         callbackData;
 
+    /* Callback dispatcher, callbacks are delivered in the order they are posted */
+    OMX_HANDLETYPE                  hCallbackDispatcher;    /* serial queue on the callback pool */
+    OMX_HANDLETYPE                  callbackMutex;
+    FP_OMX_CALLBACK                *callbackHead;
+    FP_OMX_CALLBACK                *callbackTail;
+    FP_OMX_CALLBACK                *callbackFree;
+    OMX_BOOL                        bCallbackScheduled;
+    OMX_U32                         nCallbackCount;
+    OMX_U64                         nCallbackLatencySum;    /* us from post to dispatch */
+    OMX_U64                         nCallbackLatencyMax;
+
+    /* Arenas, released all at once when the component goes away */
+    OMX_HANDLETYPE                  hSessionArena;          /* shared, lives as long as the component */
+    OMX_HANDLETYPE                  hScratchArena;          /* codec input thread only, reset per input */
+
     /* Save Timestamp */
-    OMX_TICKS                       timeStamp[MAX_TIMESTAMP];
     FP_OMX_TIMESTAMP                checkTimeStamp;
 
-    /* Save Flags */
-    OMX_U32                         nFlags[MAX_FLAGS];
+    /* flags and mark of queued input, matched to output frames by timestamp */
+    OMX_HANDLETYPE                  hReorderMap;
 
     OMX_BOOL                        getAllDelayBuffer;
     OMX_BOOL                        reInputData;
@@ -135,6 +172,20 @@ OMX_ERRORTYPE FP_OMX_BaseComponent_Destructor(OMX_IN OMX_HANDLETYPE hComponent);
 
 OMX_ERRORTYPE FP_OMX_Check_SizeVersion(OMX_PTR header, OMX_U32 size);
 
+/* queue a client callback, never calls into client code */
+OMX_ERRORTYPE FP_OMX_PostEvent(
+    OMX_COMPONENTTYPE *pOMXComponent,
+    OMX_EVENTTYPE      eEvent,
+    OMX_U32            nData1,
+    OMX_U32            nData2,
+    OMX_PTR            pEventData);
+OMX_ERRORTYPE FP_OMX_PostEmptyBufferDone(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader);
+OMX_ERRORTYPE FP_OMX_PostFillBufferDone(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE *bufferHeader);
+
+/* called by the codec loop of a port when it starts and before it returns */
+void FP_OMX_CodecThreadEnter(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex);
+void FP_OMX_CodecThreadLeave(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex);
+
 #ifdef __cplusplus
 };
 #endif
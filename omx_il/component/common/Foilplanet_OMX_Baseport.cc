@@ -16,42 +16,382 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "OMX_Macros.h"
 
 #include "Foilplanet_OMX_Baseport.h"
 #include "Foilplanet_OMX_Basecomponent.h"
+#include "Foilplanet_OMX_Tunnel.h"
 
 #include "osal_event.h"
+#include "osal_queue.h"
 #include "osal/mpp_log.h"
-#include "osal/mpp_list.h"
 #include "osal/mpp_mem.h"
+#include "osal/mpp_thread.h"
 
 #ifdef MODULE_TAG
 # undef MODULE_TAG
 # define MODULE_TAG     "FP_OMX_PORT"
 #endif
 
-#define GET_MPPLIST(q)      ((mpp_list *)q)
+/* slot n travels through the port queues as n + 1, NULL means empty */
+#define MESSAGE_TO_TOKEN(n)     ((OMX_PTR)(uintptr_t)((n) + 1))
+#define TOKEN_TO_MESSAGE(t)     ((OMX_U32)((uintptr_t)(t) - 1))
+
+static OMX_ERRORTYPE FP_OMX_PortQueueCreate(FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+
+    /* ETB and FTB may come from any client thread */
+    ret = OSAL_QueueCreate(&pFoilplanetPort->bufferQ, PORT_MESSAGE_NUM, OMX_FALSE);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
+    /* filled by FP_OMX_PortReserveBuffers once the slab is sized */
+    ret = OSAL_QueueCreate(&pFoilplanetPort->messageFreeQ, PORT_MESSAGE_NUM, OMX_FALSE);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
+EXIT:
+    if (ret != OMX_ErrorNone) {
+        mpp_err("port queue create failed, ret 0x%x", ret);
+        if (pFoilplanetPort->messageFreeQ != NULL) {
+            OSAL_QueueTerminate(pFoilplanetPort->messageFreeQ);
+            pFoilplanetPort->messageFreeQ = NULL;
+        }
+        if (pFoilplanetPort->bufferQ != NULL) {
+            OSAL_QueueTerminate(pFoilplanetPort->bufferQ);
+            pFoilplanetPort->bufferQ = NULL;
+        }
+    }
+
+    return ret;
+}
+
+static void FP_OMX_PortQueueTerminate(FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    if (pFoilplanetPort->bufferQ != NULL) {
+        OSAL_QueueTerminate(pFoilplanetPort->bufferQ);
+        pFoilplanetPort->bufferQ = NULL;
+    }
+    if (pFoilplanetPort->messageFreeQ != NULL) {
+        OSAL_QueueTerminate(pFoilplanetPort->messageFreeQ);
+        pFoilplanetPort->messageFreeQ = NULL;
+    }
+}
+
+static void FP_OMX_PortFreeBuffers(FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    free(pFoilplanetPort->extendBufferHeader);
+    pFoilplanetPort->extendBufferHeader = NULL;
+    mpp_free(pFoilplanetPort->bufferStateAllocate);
+    pFoilplanetPort->bufferStateAllocate = NULL;
+    mpp_free(pFoilplanetPort->messageSlab);
+    pFoilplanetPort->messageSlab = NULL;
+    mpp_free(pFoilplanetPort->fdMap);
+    pFoilplanetPort->fdMap = NULL;
+    pFoilplanetPort->nFdMapBits = 0;
+    pFoilplanetPort->nBufferSlots = 0;
+}
+
+/* releases what FP_OMX_Port_Constructor created, NULL members are skipped */
+static void FP_OMX_PortRelease(FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    if (pFoilplanetPort->loadedResource != NULL) {
+        OSAL_SemaphoreTerminate(pFoilplanetPort->loadedResource);
+        pFoilplanetPort->loadedResource = NULL;
+    }
+    if (pFoilplanetPort->unloadedResource != NULL) {
+        OSAL_SemaphoreTerminate(pFoilplanetPort->unloadedResource);
+        pFoilplanetPort->unloadedResource = NULL;
+    }
+    FP_OMX_PortFreeBuffers(pFoilplanetPort);
+    FP_OMX_PortQueueTerminate(pFoilplanetPort);
+    if (pFoilplanetPort->securebufferQ != NULL) {
+        OSAL_QueueTerminate(pFoilplanetPort->securebufferQ);
+        pFoilplanetPort->securebufferQ = NULL;
+    }
+}
+
+/*
+ * Sizes the per-buffer arrays of a port to nBufferCountActual. Called before a
+ * buffer is assigned, the arrays are only replaced while the port is empty so
+ * no other thread can hold a slot or a message of the old ones.
+ */
+OMX_ERRORTYPE FP_OMX_PortReserveBuffers(FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    OMX_ERRORTYPE            ret = OMX_ErrorNone;
+    OMX_U32                  nBufferNum = pFoilplanetPort->portDefinition.nBufferCountActual;
+    OMX_U32                  nMessageNum = nBufferNum + PORT_MESSAGE_CMD_NUM;
+    OMX_U32                  nFdMapBits = PORT_FD_MAP_MIN_BITS;
+    FP_OMX_BUFFERHEADERTYPE *extendBufferHeader = NULL;
+    OMX_U32                 *bufferStateAllocate = NULL;
+    FP_OMX_MESSAGE          *messageSlab = NULL;
+    FP_OMX_FDMAP_ENTRY      *fdMap = NULL;
+    OMX_U32                  i = 0;
+
+    if (pFoilplanetPort->assignedBufferNum != 0 || pFoilplanetPort->nBufferSlots == nBufferNum)
+        goto EXIT;
+
+    if (nBufferNum == 0 || nBufferNum > PORT_BUFFER_NUM_MAX) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+
+    while ((1U << nFdMapBits) < nBufferNum * 2)
+        nFdMapBits++;
+
+    /* one cache line aligned entry per slot, client and codec threads touch different slots */
+    if (posix_memalign((void **)&extendBufferHeader, PORT_CACHE_LINE, sizeof(FP_OMX_BUFFERHEADERTYPE) * nBufferNum))
+        extendBufferHeader = NULL;
+    bufferStateAllocate = mpp_malloc(OMX_U32, nBufferNum);
+    messageSlab = mpp_malloc(FP_OMX_MESSAGE, nMessageNum);
+    fdMap = mpp_malloc(FP_OMX_FDMAP_ENTRY, 1 << nFdMapBits);
+    if (extendBufferHeader == NULL || bufferStateAllocate == NULL || messageSlab == NULL || fdMap == NULL) {
+        ret = OMX_ErrorInsufficientResources;
+        goto EXIT;
+    }
+    memset(extendBufferHeader, 0, sizeof(FP_OMX_BUFFERHEADERTYPE) * nBufferNum);
+    memset(bufferStateAllocate, 0, sizeof(OMX_U32) * nBufferNum);
+    memset(messageSlab, 0, sizeof(FP_OMX_MESSAGE) * nMessageNum);
+    memset(fdMap, 0, sizeof(FP_OMX_FDMAP_ENTRY) << nFdMapBits);
+
+    /* the port is empty, any token left refers to the old slab */
+    while (OSAL_Dequeue(pFoilplanetPort->bufferQ) != NULL)
+        ;
+    while (OSAL_Dequeue(pFoilplanetPort->messageFreeQ) != NULL)
+        ;
+    FP_OMX_PortFreeBuffers(pFoilplanetPort);
+
+    pFoilplanetPort->extendBufferHeader = extendBufferHeader;
+    pFoilplanetPort->bufferStateAllocate = bufferStateAllocate;
+    pFoilplanetPort->messageSlab = messageSlab;
+    pFoilplanetPort->fdMap = fdMap;
+    pFoilplanetPort->nFdMapBits = nFdMapBits;
+    pFoilplanetPort->nBufferSlots = nBufferNum;
+    for (i = 0; i < nMessageNum; i++)
+        OSAL_Queue(pFoilplanetPort->messageFreeQ, MESSAGE_TO_TOKEN(i));
+
+    extendBufferHeader = NULL;
+    bufferStateAllocate = NULL;
+    messageSlab = NULL;
+    fdMap = NULL;
+
+EXIT:
+    if (ret != OMX_ErrorNone)
+        mpp_err("port %d reserve %d buffers failed, ret 0x%x",
+                pFoilplanetPort->portDefinition.nPortIndex, nBufferNum, ret);
+    free(extendBufferHeader);
+    mpp_free(bufferStateAllocate);
+    mpp_free(messageSlab);
+    mpp_free(fdMap);
+
+    return ret;
+}
+
+FP_OMX_MESSAGE *FP_OMX_PortMessageAlloc(FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    OMX_PTR token = OSAL_Dequeue(pFoilplanetPort->messageFreeQ);
+
+    if (token == NULL)
+        return NULL;
+
+    return &pFoilplanetPort->messageSlab[TOKEN_TO_MESSAGE(token)];
+}
+
+void FP_OMX_PortMessageFree(FP_OMX_BASEPORT *pFoilplanetPort, FP_OMX_MESSAGE *message)
+{
+    if (message == NULL)
+        return;
+
+    OSAL_Queue(pFoilplanetPort->messageFreeQ, MESSAGE_TO_TOKEN(message - pFoilplanetPort->messageSlab));
+}
+
+OMX_ERRORTYPE FP_OMX_PortMessageQueue(FP_OMX_BASEPORT *pFoilplanetPort, FP_OMX_MESSAGE *message)
+{
+    return OSAL_Queue(pFoilplanetPort->bufferQ, MESSAGE_TO_TOKEN(message - pFoilplanetPort->messageSlab));
+}
+
+FP_OMX_MESSAGE *FP_OMX_PortMessageDequeue(FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    OMX_PTR token = OSAL_Dequeue(pFoilplanetPort->bufferQ);
+
+    if (token == NULL)
+        return NULL;
+
+    return &pFoilplanetPort->messageSlab[TOKEN_TO_MESSAGE(token)];
+}
+
+/*
+ * Header stamp kept in pInputPortPrivate / pOutputPortPrivate:
+ * generation in the high 16 bits, slot in extendBufferHeader[] in the low 16.
+ */
+#define STAMP_SLOT_BITS         16
+#define STAMP_SLOT_MASK         ((1 << STAMP_SLOT_BITS) - 1)
+#define STAMP_GENERATION_MASK   0xFFFF
+
+void FP_OMX_StampBufferHeader(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 nSlot)
+{
+    FP_OMX_BUFFERHEADERTYPE *pExtHeader = &pFoilplanetPort->extendBufferHeader[nSlot];
+    OMX_PTR                  stamp;
+
+    /* generation 0 is reserved for free slots */
+    pFoilplanetPort->bufferGeneration = (pFoilplanetPort->bufferGeneration + 1) & STAMP_GENERATION_MASK;
+    if (pFoilplanetPort->bufferGeneration == 0)
+        pFoilplanetPort->bufferGeneration = 1;
+
+    pExtHeader->nGeneration = pFoilplanetPort->bufferGeneration;
+    stamp = (OMX_PTR)(uintptr_t)((pExtHeader->nGeneration << STAMP_SLOT_BITS) | nSlot);
+
+    if (pFoilplanetPort->portDefinition.eDir == OMX_DirInput)
+        pExtHeader->OMXBufferHeader->pInputPortPrivate = stamp;
+    else
+        pExtHeader->OMXBufferHeader->pOutputPortPrivate = stamp;
+}
+
+/* returns the slot of pBufferHdr in extendBufferHeader[], -1 if it is not a live header of this port */
+OMX_S32 FP_OMX_LookupBufferHeader(FP_OMX_BASEPORT *pFoilplanetPort, OMX_BUFFERHEADERTYPE *pBufferHdr)
+{
+    FP_OMX_BUFFERHEADERTYPE *pExtHeader;
+    uintptr_t                stamp;
+    OMX_U32                  nSlot;
+
+    if (pFoilplanetPort->portDefinition.eDir == OMX_DirInput)
+        stamp = (uintptr_t)pBufferHdr->pInputPortPrivate;
+    else
+        stamp = (uintptr_t)pBufferHdr->pOutputPortPrivate;
+
+    nSlot = stamp & STAMP_SLOT_MASK;
+    if (nSlot >= pFoilplanetPort->nBufferSlots)
+        return -1;
+
+    pExtHeader = &pFoilplanetPort->extendBufferHeader[nSlot];
+    if ((pExtHeader->OMXBufferHeader != pBufferHdr) ||
+        (pExtHeader->nGeneration == 0) ||
+        (pExtHeader->nGeneration != ((stamp >> STAMP_SLOT_BITS) & STAMP_GENERATION_MASK)))
+        return -1;
+
+    return (OMX_S32)nSlot;
+}
+
+static inline OMX_U32 FP_OMX_FdMapHash(FP_OMX_BASEPORT *pFoilplanetPort, int fd)
+{
+    return ((uint32_t)fd * 2654435761U) >> (32 - pFoilplanetPort->nFdMapBits);
+}
+
+static OMX_S32 FP_OMX_FdMapFind(FP_OMX_BASEPORT *pFoilplanetPort, int fd)
+{
+    OMX_U32 mask = (1U << pFoilplanetPort->nFdMapBits) - 1;
+    OMX_U32 pos;
+    OMX_U32 n;
+
+    if (pFoilplanetPort->fdMap == NULL)
+        return -1;
+
+    pos = FP_OMX_FdMapHash(pFoilplanetPort, fd);
+    for (n = 0; n <= mask; n++) {
+        FP_OMX_FDMAP_ENTRY *entry = &pFoilplanetPort->fdMap[pos];
+        if (entry->nSlot == 0)
+            break;
+        if (entry->fd == fd)
+            return (OMX_S32)pos;
+        pos = (pos + 1) & mask;
+    }
+
+    return -1;
+}
+
+static void FP_OMX_FdMapRemove(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 pos)
+{
+    FP_OMX_FDMAP_ENTRY *map = pFoilplanetPort->fdMap;
+    OMX_U32             mask = (1U << pFoilplanetPort->nFdMapBits) - 1;
+    OMX_U32             next = pos;
+    OMX_U32             home;
+
+    /* backward shift deletion, keeps probe chains intact without tombstones */
+    for (;;) {
+        next = (next + 1) & mask;
+        if (map[next].nSlot == 0)
+            break;
+        home = FP_OMX_FdMapHash(pFoilplanetPort, map[next].fd);
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            map[pos] = map[next];
+            pos = next;
+        }
+    }
+    map[pos].fd = 0;
+    map[pos].nSlot = 0;
+}
+
+/* sets buf_fd[0] of a slot and keeps the fd map in step, fd <= 0 unregisters */
+void FP_OMX_SetBufferFd(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 nSlot, int fd)
+{
+    FP_OMX_BUFFERHEADERTYPE *pExtHeader = &pFoilplanetPort->extendBufferHeader[nSlot];
+    OMX_U32                  mask = (1U << pFoilplanetPort->nFdMapBits) - 1;
+    OMX_S32                  pos;
+    OMX_U32                  n;
+
+    if (pExtHeader->buf_fd[0] > 0) {
+        pos = FP_OMX_FdMapFind(pFoilplanetPort, pExtHeader->buf_fd[0]);
+        if (pos >= 0 && pFoilplanetPort->fdMap[pos].nSlot == nSlot + 1)
+            FP_OMX_FdMapRemove(pFoilplanetPort, pos);
+    }
+
+    pExtHeader->buf_fd[0] = fd;
+    if (fd <= 0)
+        return;
+
+    pos = FP_OMX_FdMapFind(pFoilplanetPort, fd);
+    if (pos >= 0) {
+        pFoilplanetPort->fdMap[pos].nSlot = nSlot + 1;
+        return;
+    }
+
+    pos = FP_OMX_FdMapHash(pFoilplanetPort, fd);
+    for (n = 0; n <= mask; n++) {
+        if (pFoilplanetPort->fdMap[pos].nSlot == 0) {
+            pFoilplanetPort->fdMap[pos].fd = fd;
+            pFoilplanetPort->fdMap[pos].nSlot = nSlot + 1;
+            return;
+        }
+        pos = (pos + 1) & mask;
+    }
+    mpp_err("fd map full, fd %d of buffer %d not indexed", fd, nSlot);
+}
+
+/* returns the slot whose buf_fd[0] is fd, -1 if none */
+OMX_S32 FP_OMX_LookupBufferFd(FP_OMX_BASEPORT *pFoilplanetPort, int fd)
+{
+    OMX_S32 pos;
+
+    if (fd <= 0)
+        return -1;
+
+    pos = FP_OMX_FdMapFind(pFoilplanetPort, fd);
+    if (pos < 0)
+        return -1;
+
+    return (OMX_S32)pFoilplanetPort->fdMap[pos].nSlot - 1;
+}
 
 OMX_ERRORTYPE FP_OMX_InputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE* bufferHeader)
 {
     OMX_ERRORTYPE         ret = OMX_ErrorNone;
     FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     FP_OMX_BASEPORT      *pFoilplanetPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
-    OMX_U32               i = 0;
+    OMX_S32               slot = FP_OMX_LookupBufferHeader(pFoilplanetPort, bufferHeader);
 
-    MUTEX_LOCK(pFoilplanetPort->hPortMutex);
-    for (i = 0; i < pFoilplanetPort->portDefinition.nBufferCountActual; i++) {
-        if (bufferHeader == pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader) {
-            pFoilplanetPort->extendBufferHeader[i].bBufferInOMX = OMX_FALSE;
-            break;
-        }
+    if (slot >= 0) {
+        MUTEX_LOCK(pFoilplanetPort->hPortMutex);
+        pFoilplanetPort->extendBufferHeader[slot].bBufferInOMX = OMX_FALSE;
+        MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
     }
-
-    MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
-    pFpComponent->pCallbacks->EmptyBufferDone(pOMXComponent, pFpComponent->callbackData, bufferHeader);
+    if (CHECK_PORT_TUNNELED(pFoilplanetPort))
+        FP_OMX_TunnelReturn(pOMXComponent, INPUT_PORT_INDEX, bufferHeader);
+    else
+        FP_OMX_PostEmptyBufferDone(pOMXComponent, bufferHeader);
 
     return ret;
 }
@@ -61,18 +401,17 @@ OMX_ERRORTYPE FP_OMX_OutputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent, OMX_BU
     OMX_ERRORTYPE         ret = OMX_ErrorNone;
     FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     FP_OMX_BASEPORT      *pFoilplanetPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
-    OMX_U32               i = 0;
+    OMX_S32               slot = FP_OMX_LookupBufferHeader(pFoilplanetPort, bufferHeader);
 
-    MUTEX_LOCK(pFoilplanetPort->hPortMutex);
-    for (i = 0; i < MAX_BUFFER_NUM; i++) {
-        if (bufferHeader == pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader) {
-            pFoilplanetPort->extendBufferHeader[i].bBufferInOMX = OMX_FALSE;
-            break;
-        }
+    if (slot >= 0) {
+        MUTEX_LOCK(pFoilplanetPort->hPortMutex);
+        pFoilplanetPort->extendBufferHeader[slot].bBufferInOMX = OMX_FALSE;
+        MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
     }
-
-    MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
-    pFpComponent->pCallbacks->FillBufferDone(pOMXComponent, pFpComponent->callbackData, bufferHeader);
+    if (CHECK_PORT_TUNNELED(pFoilplanetPort))
+        FP_OMX_TunnelReturn(pOMXComponent, OUTPUT_PORT_INDEX, bufferHeader);
+    else
+        FP_OMX_PostFillBufferDone(pOMXComponent, bufferHeader);
 
 EXIT:
     mpp_log("bufferHeader:0x%x", bufferHeader);
@@ -114,15 +453,14 @@ OMX_ERRORTYPE FP_OMX_BufferFlushProcess(OMX_COMPONENTTYPE *pOMXComponent, OMX_S3
             portIndex = nPortIndex;
 
         pFpComponent->fp_BufferFlush(pOMXComponent, portIndex, bEvent);
+        if (bEvent == OMX_TRUE)
+            FP_OMX_TunnelFlush(pOMXComponent, portIndex);
     }
 
 EXIT:
     if ((ret != OMX_ErrorNone) && (pOMXComponent != NULL) && (pFpComponent != NULL)) {
         mpp_err("ERROR");
-        pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                     pFpComponent->callbackData,
-                                                     OMX_EventError,
-                                                     ret, 0, NULL);
+        FP_OMX_PostEvent(pOMXComponent, OMX_EventError, ret, 0, NULL);
     }
 
     FunctionOut();
@@ -141,7 +479,7 @@ OMX_ERRORTYPE FP_OMX_EnablePort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portIn
 
     pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
 
-    if ((pFpComponent->currentState != OMX_StateLoaded) && (pFpComponent->currentState != OMX_StateWaitForResources)) {
+    if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) && (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateWaitForResources)) {
         OSAL_SemaphoreWait(pFoilplanetPort->loadedResource);
 
         if (pFoilplanetPort->exceptionFlag == INVALID_STATE) {
@@ -195,19 +533,13 @@ OMX_ERRORTYPE FP_OMX_PortEnableProcess(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32
 
         ret = FP_OMX_EnablePort(pOMXComponent, portIndex);
         if (ret == OMX_ErrorNone) {
-            pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                         pFpComponent->callbackData,
-                                                         OMX_EventCmdComplete,
-                                                         OMX_CommandPortEnable, portIndex, NULL);
+            FP_OMX_PostEvent(pOMXComponent, OMX_EventCmdComplete, OMX_CommandPortEnable, portIndex, NULL);
         }
     }
 
 EXIT:
     if ((ret != OMX_ErrorNone) && (pOMXComponent != NULL) && (pFpComponent != NULL)) {
-        pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                     pFpComponent->callbackData,
-                                                     OMX_EventError,
-                                                     ret, 0, NULL);
+        FP_OMX_PostEvent(pOMXComponent, OMX_EventError, ret, 0, NULL);
     }
 
     FunctionOut();
@@ -232,10 +564,10 @@ OMX_ERRORTYPE FP_OMX_DisablePort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portI
         goto EXIT;
     }
 
-    if (pFpComponent->currentState != OMX_StateLoaded) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) {
         if (CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort)) {
-            while (!GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE))) {
-                mpp_free(message);
+            while ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) != NULL) {
+                FP_OMX_PortMessageFree(pFoilplanetPort, message);
             }
         }
         pFoilplanetPort->portDefinition.bPopulated = OMX_FALSE;
@@ -295,21 +627,15 @@ OMX_ERRORTYPE FP_OMX_PortDisableProcess(OMX_COMPONENTTYPE *pOMXComponent, OMX_S3
             portIndex = nPortIndex;
 
         ret = FP_OMX_DisablePort(pOMXComponent, portIndex);
-        pFpComponent->pFoilplanetPort[portIndex].bIsPortDisabled = OMX_FALSE;
+        FP_OMX_STORE(pFpComponent->pFoilplanetPort[portIndex].bIsPortDisabled, OMX_FALSE);
         if (ret == OMX_ErrorNone) {
-            pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                         pFpComponent->callbackData,
-                                                         OMX_EventCmdComplete,
-                                                         OMX_CommandPortDisable, portIndex, NULL);
+            FP_OMX_PostEvent(pOMXComponent, OMX_EventCmdComplete, OMX_CommandPortDisable, portIndex, NULL);
         }
     }
 
 EXIT:
     if ((ret != OMX_ErrorNone) && (pOMXComponent != NULL) && (pFpComponent != NULL)) {
-        pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                     pFpComponent->callbackData,
-                                                     OMX_EventError,
-                                                     ret, 0, NULL);
+        FP_OMX_PostEvent(pOMXComponent, OMX_EventError, ret, 0, NULL);
     }
 
     FunctionOut();
@@ -325,9 +651,8 @@ OMX_ERRORTYPE FP_OMX_EmptyThisBuffer(
     OMX_COMPONENTTYPE      *pOMXComponent = NULL;
     FP_OMX_BASECOMPONENT *pFpComponent = NULL;
     FP_OMX_BASEPORT      *pFoilplanetPort = NULL;
-    OMX_BOOL               findBuffer = OMX_FALSE;
     FP_OMX_MESSAGE       *message;
-    OMX_U32                i = 0;
+    OMX_S32                slot = -1;
 
     FunctionIn();
 
@@ -346,7 +671,7 @@ OMX_ERRORTYPE FP_OMX_EmptyThisBuffer(
         goto EXIT;
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -365,9 +690,9 @@ OMX_ERRORTYPE FP_OMX_EmptyThisBuffer(
         goto EXIT;
     }
 
-    if ((pFpComponent->currentState != OMX_StateIdle) &&
-        (pFpComponent->currentState != OMX_StateExecuting) &&
-        (pFpComponent->currentState != OMX_StatePause)) {
+    if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateIdle) &&
+        (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateExecuting) &&
+        (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StatePause)) {
         ret = OMX_ErrorIncorrectStateOperation;
         goto EXIT;
     }
@@ -376,43 +701,38 @@ OMX_ERRORTYPE FP_OMX_EmptyThisBuffer(
     if ((!CHECK_PORT_ENABLED(pFoilplanetPort)) ||
         (CHECK_PORT_BEING_FLUSHED(pFoilplanetPort) &&
          (!CHECK_PORT_TUNNELED(pFoilplanetPort) || !CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort))) ||
-        ((pFpComponent->transientState == FP_OMX_TransStateExecutingToIdle) &&
+        ((FP_OMX_LOAD(pFpComponent->transientState) == FP_OMX_TransStateExecutingToIdle) &&
          (CHECK_PORT_TUNNELED(pFoilplanetPort) && !CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort)))) {
         ret = OMX_ErrorIncorrectStateOperation;
         goto EXIT;
     }
 
-    MUTEX_LOCK(pFoilplanetPort->hPortMutex);
-    for (i = 0; i < pFoilplanetPort->portDefinition.nBufferCountActual; i++) {
-        if (pBuffer == pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader) {
-            pFoilplanetPort->extendBufferHeader[i].bBufferInOMX = OMX_TRUE;
-            findBuffer = OMX_TRUE;
-            break;
-        }
-    }
-
-    if (findBuffer == OMX_FALSE) {
+    slot = FP_OMX_LookupBufferHeader(pFoilplanetPort, pBuffer);
+    if (slot < 0) {
         ret = OMX_ErrorBadParameter;
-        MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
         goto EXIT;
     }
+    if (FP_OMX_TunnelHold(pOMXComponent, INPUT_PORT_INDEX, slot) == OMX_TRUE)
+        goto EXIT;
 
-    message = mpp_malloc(FP_OMX_MESSAGE, 1);
+    message = FP_OMX_PortMessageAlloc(pFoilplanetPort);
     if (message == NULL) {
         ret = OMX_ErrorInsufficientResources;
-        MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
         goto EXIT;
     }
     message->messageType = FP_OMX_CommandEmptyBuffer;
-    message->messageParam = (OMX_U32) i;
+    message->messageParam = (OMX_U32) slot;
     message->pCmdData = (OMX_PTR)pBuffer;
 
-    if (GET_MPPLIST(pFoilplanetPort->bufferQ)->add_at_tail(message, sizeof(FP_OMX_MESSAGE))) {
-        ret = OMX_ErrorUndefined;
+    MUTEX_LOCK(pFoilplanetPort->hPortMutex);
+    pFoilplanetPort->extendBufferHeader[slot].bBufferInOMX = OMX_TRUE;
+    ret = FP_OMX_PortMessageQueue(pFoilplanetPort, message);
+    if (ret != OMX_ErrorNone) {
+        pFoilplanetPort->extendBufferHeader[slot].bBufferInOMX = OMX_FALSE;
+        FP_OMX_PortMessageFree(pFoilplanetPort, message);
         MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
         goto EXIT;
     }
-    ret = OSAL_SemaphorePost(pFoilplanetPort->bufferSemID);
     MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
 
 EXIT:
@@ -429,9 +749,8 @@ OMX_ERRORTYPE FP_OMX_FillThisBuffer(
     OMX_COMPONENTTYPE     *pOMXComponent = NULL;
     FP_OMX_BASECOMPONENT  *pFpComponent = NULL;
     FP_OMX_BASEPORT       *pFoilplanetPort = NULL;
-    OMX_BOOL               findBuffer = OMX_FALSE;
     FP_OMX_MESSAGE        *message;
-    OMX_U32                i = 0;
+    OMX_S32                slot = -1;
 
     FunctionIn();
 
@@ -450,7 +769,7 @@ OMX_ERRORTYPE FP_OMX_FillThisBuffer(
         goto EXIT;
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -469,9 +788,9 @@ OMX_ERRORTYPE FP_OMX_FillThisBuffer(
         goto EXIT;
     }
 
-    if ((pFpComponent->currentState != OMX_StateIdle) &&
-        (pFpComponent->currentState != OMX_StateExecuting) &&
-        (pFpComponent->currentState != OMX_StatePause)) {
+    if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateIdle) &&
+        (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateExecuting) &&
+        (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StatePause)) {
         ret = OMX_ErrorIncorrectStateOperation;
         goto EXIT;
     }
@@ -480,44 +799,41 @@ OMX_ERRORTYPE FP_OMX_FillThisBuffer(
     if ((!CHECK_PORT_ENABLED(pFoilplanetPort)) ||
         (CHECK_PORT_BEING_FLUSHED(pFoilplanetPort) &&
          (!CHECK_PORT_TUNNELED(pFoilplanetPort) || !CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort))) ||
-        ((pFpComponent->transientState == FP_OMX_TransStateExecutingToIdle) &&
+        ((FP_OMX_LOAD(pFpComponent->transientState) == FP_OMX_TransStateExecutingToIdle) &&
          (CHECK_PORT_TUNNELED(pFoilplanetPort) && !CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort)))) {
         ret = OMX_ErrorIncorrectStateOperation;
         goto EXIT;
     }
 
-    MUTEX_LOCK(pFoilplanetPort->hPortMutex);
-    for (i = 0; i < MAX_BUFFER_NUM; i++) {
-        if (pBuffer == pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader) {
-            pFoilplanetPort->extendBufferHeader[i].bBufferInOMX = OMX_TRUE;
-            findBuffer = OMX_TRUE;
-            break;
-        }
-    }
-
-    if (findBuffer == OMX_FALSE) {
+    slot = FP_OMX_LookupBufferHeader(pFoilplanetPort, pBuffer);
+    if (slot < 0) {
         ret = OMX_ErrorBadParameter;
-        MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
         goto EXIT;
     }
+    if (FP_OMX_TunnelHold(pOMXComponent, OUTPUT_PORT_INDEX, slot) == OMX_TRUE)
+        goto EXIT;
 
-    message = mpp_malloc(FP_OMX_MESSAGE, 1);
+    message = FP_OMX_PortMessageAlloc(pFoilplanetPort);
     if (message == NULL) {
         ret = OMX_ErrorInsufficientResources;
-        MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
         goto EXIT;
     }
     message->messageType = FP_OMX_CommandFillBuffer;
-    message->messageParam = (OMX_U32) i;
+    message->messageParam = (OMX_U32) slot;
     message->pCmdData = (OMX_PTR)pBuffer;
 
-    if (GET_MPPLIST(pFoilplanetPort->bufferQ)->add_at_tail(message, sizeof(FP_OMX_MESSAGE))) {
-        ret = OMX_ErrorUndefined;
+    MUTEX_LOCK(pFoilplanetPort->hPortMutex);
+    pFoilplanetPort->extendBufferHeader[slot].bBufferInOMX = OMX_TRUE;
+    ret = FP_OMX_PortMessageQueue(pFoilplanetPort, message);
+    if (ret != OMX_ErrorNone) {
+        pFoilplanetPort->extendBufferHeader[slot].bBufferInOMX = OMX_FALSE;
+        FP_OMX_PortMessageFree(pFoilplanetPort, message);
         MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
         goto EXIT;
     }
 
-    ret = OSAL_SemaphorePost(pFoilplanetPort->bufferSemID);
+    /* a fresh output buffer may unblock a frame held back by the codec thread */
+    OSAL_SignalSet(pFoilplanetPort->hCodecReadyEvent);
     MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
 
 EXIT:
@@ -560,7 +876,9 @@ OMX_ERRORTYPE FP_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     pFpComponent->portParam.nPorts = ALL_PORT_NUM;
     pFpComponent->portParam.nStartPortNumber = INPUT_PORT_INDEX;
 
-    pFoilplanetPort = mpp_malloc(FP_OMX_BASEPORT, ALL_PORT_NUM);
+    /* ports keep codec thread and client thread fields on separate cache lines */
+    if (posix_memalign((void **)&pFoilplanetPort, PORT_CACHE_LINE, sizeof(FP_OMX_BASEPORT) * ALL_PORT_NUM))
+        pFoilplanetPort = NULL;
     if (pFoilplanetPort == NULL) {
         ret = OMX_ErrorInsufficientResources;
         mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
@@ -572,33 +890,15 @@ OMX_ERRORTYPE FP_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     /* Input Port */
     pFoilplanetInputPort = &pFoilplanetPort[INPUT_PORT_INDEX];
 
-    // MAX_QUEUE_ELEMENTS
-    pFoilplanetInputPort->bufferQ = new mpp_list();
-    pFoilplanetInputPort->securebufferQ = new mpp_list();
-
-    pFoilplanetInputPort->extendBufferHeader = mpp_malloc(FP_OMX_BUFFERHEADERTYPE, MAX_BUFFER_NUM);
-    if (pFoilplanetInputPort->extendBufferHeader == NULL) {
-        mpp_free(pFoilplanetPort);
-        pFoilplanetPort = NULL;
-        ret = OMX_ErrorInsufficientResources;
-        mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+    ret = FP_OMX_PortQueueCreate(pFoilplanetInputPort);
+    if (ret != OMX_ErrorNone)
         goto EXIT;
-    }
-    memset(pFoilplanetInputPort->extendBufferHeader, 0, sizeof(FP_OMX_BUFFERHEADERTYPE) * MAX_BUFFER_NUM);
-
-    pFoilplanetInputPort->bufferStateAllocate = mpp_malloc(OMX_U32, MAX_BUFFER_NUM);
-    if (pFoilplanetInputPort->bufferStateAllocate == NULL) {
-        mpp_free(pFoilplanetInputPort->extendBufferHeader);
-        pFoilplanetInputPort->extendBufferHeader = NULL;
-        mpp_free(pFoilplanetPort);
-        pFoilplanetPort = NULL;
-        ret = OMX_ErrorInsufficientResources;
-        mpp_err("OMX_ErrorInsufficientResources, Line:%d", __LINE__);
+    /* secure buffers are queued by the input thread only */
+    ret = OSAL_QueueCreate(&pFoilplanetInputPort->securebufferQ, PORT_BUFFER_NUM_MAX, OMX_TRUE);
+    if (ret != OMX_ErrorNone)
         goto EXIT;
-    }
-    memset(pFoilplanetInputPort->bufferStateAllocate, 0, sizeof(OMX_U32) * MAX_BUFFER_NUM);
 
-    pFoilplanetInputPort->bufferSemID = NULL;
+
     pFoilplanetInputPort->assignedBufferNum = 0;
     pFoilplanetInputPort->portState = OMX_StateMax;
     pFoilplanetInputPort->bIsPortFlushed = OMX_FALSE;
@@ -609,27 +909,11 @@ OMX_ERRORTYPE FP_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     pFoilplanetInputPort->bufferSupplier = OMX_BufferSupplyUnspecified;
     pFoilplanetInputPort->tunnelFlags = 0;
     ret = OSAL_SemaphoreCreate(&pFoilplanetInputPort->loadedResource);
-    if (ret != OMX_ErrorNone) {
-        mpp_free(pFoilplanetInputPort->bufferStateAllocate);
-        pFoilplanetInputPort->bufferStateAllocate = NULL;
-        mpp_free(pFoilplanetInputPort->extendBufferHeader);
-        pFoilplanetInputPort->extendBufferHeader = NULL;
-        mpp_free(pFoilplanetPort);
-        pFoilplanetPort = NULL;
+    if (ret != OMX_ErrorNone)
         goto EXIT;
-    }
     ret = OSAL_SemaphoreCreate(&pFoilplanetInputPort->unloadedResource);
-    if (ret != OMX_ErrorNone) {
-        OSAL_SemaphoreTerminate(pFoilplanetInputPort->loadedResource);
-        pFoilplanetInputPort->loadedResource = NULL;
-        mpp_free(pFoilplanetInputPort->bufferStateAllocate);
-        pFoilplanetInputPort->bufferStateAllocate = NULL;
-        mpp_free(pFoilplanetInputPort->extendBufferHeader);
-        pFoilplanetInputPort->extendBufferHeader = NULL;
-        mpp_free(pFoilplanetPort);
-        pFoilplanetPort = NULL;
+    if (ret != OMX_ErrorNone)
         goto EXIT;
-    }
 
     INIT_SET_SIZE_VERSION(&pFoilplanetInputPort->portDefinition, OMX_PARAM_PORTDEFINITIONTYPE);
     pFoilplanetInputPort->portDefinition.nPortIndex = INPUT_PORT_INDEX;
@@ -650,47 +934,11 @@ OMX_ERRORTYPE FP_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     pFoilplanetOutputPort = &pFoilplanetPort[OUTPUT_PORT_INDEX];
 
     /* For in case of "Output Buffer Share", MAX ELEMENTS(DPB + EDPB) */
-    // MAX_QUEUE_ELEMENTS
-    pFoilplanetOutputPort->bufferQ = new mpp_list();
-
-    pFoilplanetOutputPort->extendBufferHeader = mpp_malloc(FP_OMX_BUFFERHEADERTYPE, MAX_BUFFER_NUM);
-    if (pFoilplanetOutputPort->extendBufferHeader == NULL) {
-        OSAL_SemaphoreTerminate(pFoilplanetInputPort->unloadedResource);
-        pFoilplanetInputPort->unloadedResource = NULL;
-        OSAL_SemaphoreTerminate(pFoilplanetInputPort->loadedResource);
-        pFoilplanetInputPort->loadedResource = NULL;
-        mpp_free(pFoilplanetInputPort->bufferStateAllocate);
-        pFoilplanetInputPort->bufferStateAllocate = NULL;
-        mpp_free(pFoilplanetInputPort->extendBufferHeader);
-        pFoilplanetInputPort->extendBufferHeader = NULL;
-        mpp_free(pFoilplanetPort);
-        pFoilplanetPort = NULL;
-        ret = OMX_ErrorInsufficientResources;
+    ret = FP_OMX_PortQueueCreate(pFoilplanetOutputPort);
+    if (ret != OMX_ErrorNone)
         goto EXIT;
-    }
-    memset(pFoilplanetOutputPort->extendBufferHeader, 0, sizeof(FP_OMX_BUFFERHEADERTYPE) * MAX_BUFFER_NUM);
-
-    pFoilplanetOutputPort->bufferStateAllocate = mpp_malloc(OMX_U32, MAX_BUFFER_NUM);
-    if (pFoilplanetOutputPort->bufferStateAllocate == NULL) {
-        mpp_free(pFoilplanetOutputPort->extendBufferHeader);
-        pFoilplanetOutputPort->extendBufferHeader = NULL;
 
-        OSAL_SemaphoreTerminate(pFoilplanetInputPort->unloadedResource);
-        pFoilplanetInputPort->unloadedResource = NULL;
-        OSAL_SemaphoreTerminate(pFoilplanetInputPort->loadedResource);
-        pFoilplanetInputPort->loadedResource = NULL;
-        mpp_free(pFoilplanetInputPort->bufferStateAllocate);
-        pFoilplanetInputPort->bufferStateAllocate = NULL;
-        mpp_free(pFoilplanetInputPort->extendBufferHeader);
-        pFoilplanetInputPort->extendBufferHeader = NULL;
-        mpp_free(pFoilplanetPort);
-        pFoilplanetPort = NULL;
-        ret = OMX_ErrorInsufficientResources;
-        goto EXIT;
-    }
-    memset(pFoilplanetOutputPort->bufferStateAllocate, 0, sizeof(OMX_U32) * MAX_BUFFER_NUM);
 
-    pFoilplanetOutputPort->bufferSemID = NULL;
     pFoilplanetOutputPort->assignedBufferNum = 0;
     pFoilplanetOutputPort->portState = OMX_StateMax;
     pFoilplanetOutputPort->bIsPortFlushed = OMX_FALSE;
@@ -701,45 +949,11 @@ OMX_ERRORTYPE FP_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
     pFoilplanetOutputPort->bufferSupplier = OMX_BufferSupplyUnspecified;
     pFoilplanetOutputPort->tunnelFlags = 0;
     ret = OSAL_SemaphoreCreate(&pFoilplanetOutputPort->loadedResource);
-    if (ret != OMX_ErrorNone) {
-        mpp_free(pFoilplanetOutputPort->bufferStateAllocate);
-        pFoilplanetOutputPort->bufferStateAllocate = NULL;
-        mpp_free(pFoilplanetOutputPort->extendBufferHeader);
-        pFoilplanetOutputPort->extendBufferHeader = NULL;
-
-        OSAL_SemaphoreTerminate(pFoilplanetInputPort->unloadedResource);
-        pFoilplanetInputPort->unloadedResource = NULL;
-        OSAL_SemaphoreTerminate(pFoilplanetInputPort->loadedResource);
-        pFoilplanetInputPort->loadedResource = NULL;
-        mpp_free(pFoilplanetInputPort->bufferStateAllocate);
-        pFoilplanetInputPort->bufferStateAllocate = NULL;
-        mpp_free(pFoilplanetInputPort->extendBufferHeader);
-        pFoilplanetInputPort->extendBufferHeader = NULL;
-        mpp_free(pFoilplanetPort);
-        pFoilplanetPort = NULL;
+    if (ret != OMX_ErrorNone)
         goto EXIT;
-    }
-    ret = OSAL_SignalCreate(&pFoilplanetOutputPort->unloadedResource);
-    if (ret != OMX_ErrorNone) {
-        OSAL_SemaphoreTerminate(pFoilplanetOutputPort->loadedResource);
-        pFoilplanetOutputPort->loadedResource = NULL;
-        mpp_free(pFoilplanetOutputPort->bufferStateAllocate);
-        pFoilplanetOutputPort->bufferStateAllocate = NULL;
-        mpp_free(pFoilplanetOutputPort->extendBufferHeader);
-        pFoilplanetOutputPort->extendBufferHeader = NULL;
-
-        OSAL_SemaphoreTerminate(pFoilplanetInputPort->unloadedResource);
-        pFoilplanetInputPort->unloadedResource = NULL;
-        OSAL_SemaphoreTerminate(pFoilplanetInputPort->loadedResource);
-        pFoilplanetInputPort->loadedResource = NULL;
-        mpp_free(pFoilplanetInputPort->bufferStateAllocate);
-        pFoilplanetInputPort->bufferStateAllocate = NULL;
-        mpp_free(pFoilplanetInputPort->extendBufferHeader);
-        pFoilplanetInputPort->extendBufferHeader = NULL;
-        mpp_free(pFoilplanetPort);
-        pFoilplanetPort = NULL;
+    ret = OSAL_SemaphoreCreate(&pFoilplanetOutputPort->unloadedResource);
+    if (ret != OMX_ErrorNone)
         goto EXIT;
-    }
 
     INIT_SET_SIZE_VERSION(&pFoilplanetOutputPort->portDefinition, OMX_PARAM_PORTDEFINITIONTYPE);
     pFoilplanetOutputPort->portDefinition.nPortIndex = OUTPUT_PORT_INDEX;
@@ -766,6 +980,14 @@ OMX_ERRORTYPE FP_OMX_Port_Constructor(OMX_HANDLETYPE hComponent)
 
     ret = OMX_ErrorNone;
 EXIT:
+    if (ret != OMX_ErrorNone && pFoilplanetPort != NULL) {
+        mpp_err("port constructor failed, ret 0x%x", ret);
+        /* the ports are zeroed, whatever was not created yet is still NULL */
+        for (i = 0; i < ALL_PORT_NUM; i++)
+            FP_OMX_PortRelease(&pFoilplanetPort[i]);
+        free(pFoilplanetPort);
+        pFpComponent->pFoilplanetPort = NULL;
+    }
     FunctionOut();
 
     return ret;
@@ -798,7 +1020,7 @@ OMX_ERRORTYPE FP_OMX_Port_Destructor(OMX_HANDLETYPE hComponent)
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    if (pFpComponent->transientState == FP_OMX_TransStateLoadedToIdle) {
+    if (FP_OMX_LOAD(pFpComponent->transientState) == FP_OMX_TransStateLoadedToIdle) {
         pFpComponent->abendState = OMX_TRUE;
         for (i = 0; i < ALL_PORT_NUM; i++) {
             pFoilplanetPort = &pFpComponent->pFoilplanetPort[i];
@@ -808,22 +1030,9 @@ OMX_ERRORTYPE FP_OMX_Port_Destructor(OMX_HANDLETYPE hComponent)
         OSAL_SignalReset(pFpComponent->abendStateEvent);
     }
 
-    for (i = 0; i < ALL_PORT_NUM; i++) {
-        pFoilplanetPort = &pFpComponent->pFoilplanetPort[i];
-
-        OSAL_SemaphoreTerminate(pFoilplanetPort->loadedResource);
-        pFoilplanetPort->loadedResource = NULL;
-        OSAL_SemaphoreTerminate(pFoilplanetPort->unloadedResource);
-        pFoilplanetPort->unloadedResource = NULL;
-        mpp_free(pFoilplanetPort->bufferStateAllocate);
-        pFoilplanetPort->bufferStateAllocate = NULL;
-        mpp_free(pFoilplanetPort->extendBufferHeader);
-        pFoilplanetPort->extendBufferHeader = NULL;
-
-        delete GET_MPPLIST(pFoilplanetPort->bufferQ);
-        delete GET_MPPLIST(pFoilplanetPort->securebufferQ);
-    }
-    mpp_free(pFpComponent->pFoilplanetPort);
+    for (i = 0; i < ALL_PORT_NUM; i++)
+        FP_OMX_PortRelease(&pFpComponent->pFoilplanetPort[i]);
+    free(pFpComponent->pFoilplanetPort);
     pFpComponent->pFoilplanetPort = NULL;
     ret = OMX_ErrorNone;
 EXIT:
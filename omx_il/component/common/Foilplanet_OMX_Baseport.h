@@ -25,7 +25,19 @@
 #define HEADER_STATE_ALLOCATED  (1 << 2)
 #define BUFFER_STATE_FREE       0
 
-#define MAX_BUFFER_NUM          40
+/*
+ * Per-buffer bookkeeping is sized to nBufferCountActual when a port gets its
+ * first buffer, PORT_BUFFER_NUM_MAX only bounds the port queues.
+ */
+#define PORT_BUFFER_NUM_MAX     256
+#define PORT_CACHE_LINE         64
+
+/* port messages: one per buffer plus room for port commands (fake buffer) */
+#define PORT_MESSAGE_CMD_NUM    4
+#define PORT_MESSAGE_NUM        (PORT_BUFFER_NUM_MAX + PORT_MESSAGE_CMD_NUM)
+
+/* open addressing dma-buf fd -> buffer slot map, kept under half full */
+#define PORT_FD_MAP_MIN_BITS    4
 
 #define INPUT_PORT_INDEX        0
 #define OUTPUT_PORT_INDEX       1
@@ -44,7 +56,16 @@ typedef struct _FP_OMX_BUFFERHEADERTYPE {
     int                   buf_fd[MAX_BUFFER_PLANE];
     int                   pRegisterFlag;
     OMX_PTR               pPrivate;
-} FP_OMX_BUFFERHEADERTYPE;
+    OMX_U32               nGeneration;    /* matches the stamp in the header port-private, 0 when free */
+    OMX_PTR               pTunnelMem;     /* VPUMemLinear_t of a buffer this port supplies to a tunnel */
+    OMX_BOOL              bTunnelHeld;    /* supplied buffer kept by the port, see FP_OMX_TunnelResume */
+    OMX_PTR               pVpumem;        /* VPUMemLinear_t behind an input buffer from AllocateBuffer */
+} __attribute__((aligned(PORT_CACHE_LINE))) FP_OMX_BUFFERHEADERTYPE;
+
+typedef struct _FP_OMX_FDMAP_ENTRY {
+    int                   fd;
+    OMX_U32               nSlot;          /* slot + 1, 0 when the entry is empty */
+} FP_OMX_FDMAP_ENTRY;
 
 typedef struct _FP_OMX_DATABUFFER {
     OMX_HANDLETYPE        bufferMutex;
@@ -127,9 +148,16 @@ typedef struct _FP_OMX_BASEPORT {
     FP_OMX_BUFFERHEADERTYPE *extendBufferHeader;
     OMX_U32                       *bufferStateAllocate;
     OMX_PARAM_PORTDEFINITIONTYPE   portDefinition;
-    OMX_HANDLETYPE                 bufferSemID;
-    OMX_QUEUE                      bufferQ;
+    OMX_QUEUE                      bufferQ;          /* codec threads block in OSAL_QueueWait */
     OMX_QUEUE                      securebufferQ;
+    /* bufferQ carries slot indexes of this slab, free slots wait in messageFreeQ */
+    struct _FP_OMX_MESSAGE        *messageSlab;
+    OMX_QUEUE                      messageFreeQ;
+    OMX_U32                        bufferGeneration;
+    /* slots in extendBufferHeader[], bufferStateAllocate[] and messageSlab */
+    OMX_U32                        nBufferSlots;
+    FP_OMX_FDMAP_ENTRY            *fdMap;
+    OMX_U32                        nFdMapBits;
     OMX_U32                        assignedBufferNum;
     OMX_STATETYPE                  portState;
     OMX_HANDLETYPE                 loadedResource;
@@ -156,18 +184,20 @@ typedef struct _FP_OMX_BASEPORT {
     OMX_QUEUE                      codecBufferQ;
 
     OMX_HANDLETYPE                 pauseEvent;
+    /* set when the codec thread of this port may be able to make progress */
+    OMX_HANDLETYPE                 hCodecReadyEvent;
 
-    /* Buffer */
+    /* Buffer, written by the codec thread only, kept off the client written lines */
     union {
         FP_OMX_PORT_1WAY_DATABUFFER port1WayDataBuffer;
         FP_OMX_PORT_2WAY_DATABUFFER port2WayDataBuffer;
-    } way;
+    } way __attribute__((aligned(PORT_CACHE_LINE)));
 
     /* Data */
     FP_OMX_DATA            processData;
 
     /* for flush of Shared buffer scheme */
-    OMX_HANDLETYPE                 hAllCodecBufferReturnEvent;
+    OMX_HANDLETYPE                 hAllCodecBufferReturnEvent __attribute__((aligned(PORT_CACHE_LINE)));
     OMX_HANDLETYPE                 hPortMutex;
     OMX_HANDLETYPE                 secureBufferMutex;
     FP_OMX_EXCEPTION_STATE exceptionFlag;
@@ -189,6 +219,17 @@ OMX_ERRORTYPE FP_OMX_OutputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent, OMX_BU
 
 OMX_ERRORTYPE FP_OMX_InputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE* bufferHeader);
 
+OMX_ERRORTYPE FP_OMX_PortReserveBuffers(FP_OMX_BASEPORT *pFoilplanetPort);
+void FP_OMX_StampBufferHeader(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 nSlot);
+OMX_S32 FP_OMX_LookupBufferHeader(FP_OMX_BASEPORT *pFoilplanetPort, OMX_BUFFERHEADERTYPE *pBufferHdr);
+void FP_OMX_SetBufferFd(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 nSlot, int fd);
+OMX_S32 FP_OMX_LookupBufferFd(FP_OMX_BASEPORT *pFoilplanetPort, int fd);
+
+struct _FP_OMX_MESSAGE *FP_OMX_PortMessageAlloc(FP_OMX_BASEPORT *pFoilplanetPort);
+void FP_OMX_PortMessageFree(FP_OMX_BASEPORT *pFoilplanetPort, struct _FP_OMX_MESSAGE *message);
+OMX_ERRORTYPE FP_OMX_PortMessageQueue(FP_OMX_BASEPORT *pFoilplanetPort, struct _FP_OMX_MESSAGE *message);
+struct _FP_OMX_MESSAGE *FP_OMX_PortMessageDequeue(FP_OMX_BASEPORT *pFoilplanetPort);
+
 #ifdef __cplusplus
 };
 #endif
@@ -20,6 +20,8 @@
 
 #include "Foilplanet_OMX_Resourcemanager.h"
 #include "Foilplanet_OMX_Basecomponent.h"
+#include "OMX_Macros.h"
+#include "osal_task.h"
 
 #include "osal/mpp_thread.h"
 #include "osal/mpp_log.h"
@@ -32,6 +34,16 @@
 #define MAX_RESOURCE_VIDEO_DEC 6    /* for Android */
 #define MAX_RESOURCE_VIDEO_ENC 4    /* for Android */
 
+/*
+ * Every component holding a resource may block a command worker and runs
+ * two codec loops. OSAL_TASK_MAX_WORKERS more are left for components that
+ * are loading, or are being preempted while another one takes their place.
+ */
+typedef char FP_OMX_RM_COMMAND_WORKERS_FIT[(MAX_RESOURCE_VIDEO_DEC + MAX_RESOURCE_VIDEO_ENC +
+                                            OSAL_TASK_MAX_WORKERS <= OSAL_TASK_MAX_COMMAND_WORKERS) ? 1 : -1];
+typedef char FP_OMX_RM_CODEC_WORKERS_FIT[(2 * (MAX_RESOURCE_VIDEO_DEC + MAX_RESOURCE_VIDEO_ENC) +
+                                          OSAL_TASK_MAX_WORKERS <= OSAL_TASK_MAX_CODEC_WORKERS) ? 1 : -1];
+
 struct _RM_COMPONENT_LIST;
 typedef struct _RM_COMPONENT_LIST {
     OMX_COMPONENTTYPE         *pOMXStandComp;
@@ -167,16 +179,14 @@ OMX_ERRORTYPE removeComponent(OMX_COMPONENTTYPE *pOMXComponent)
     FP_OMX_BASECOMPONENT *pFpComponent = NULL;
 
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    if (pFpComponent->currentState == OMX_StateIdle) {
-        (*(pFpComponent->pCallbacks->EventHandler))
-        (pOMXComponent, pFpComponent->callbackData,
-         OMX_EventError, OMX_ErrorResourcesLost, 0, NULL);
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateIdle) {
+        FP_OMX_PostEvent(pOMXComponent, OMX_EventError, OMX_ErrorResourcesLost, 0, NULL);
         ret = OMX_SendCommand(pOMXComponent, OMX_CommandStateSet, OMX_StateLoaded, NULL);
         if (ret != OMX_ErrorNone) {
             ret = OMX_ErrorUndefined;
             goto EXIT;
         }
-    } else if ((pFpComponent->currentState == OMX_StateExecuting) || (pFpComponent->currentState == OMX_StatePause)) {
+    } else if ((FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateExecuting) || (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StatePause)) {
         /* Todo */
     }
 
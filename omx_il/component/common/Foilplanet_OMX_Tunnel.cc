@@ -0,0 +1,452 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "OMX_Macros.h"
+
+#include "Foilplanet_OMX_Basecomponent.h"
+#include "Foilplanet_OMX_Baseport.h"
+#include "Foilplanet_OMX_Tunnel.h"
+
+#include "osal_event.h"
+#include "osal_vpumem.h"
+#include "osal/mpp_log.h"
+#include "osal/mpp_thread.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "FP_OMX_TUNNEL"
+#endif
+
+/* only our own components know what pPlatformPrivate of a tunnel buffer is */
+static OMX_BOOL FP_OMX_TunnelPeerSupported(OMX_HANDLETYPE hTunneledComp)
+{
+    char            name[OMX_MAX_STRINGNAME_SIZE];
+    OMX_VERSIONTYPE compVersion;
+    OMX_VERSIONTYPE specVersion;
+    OMX_UUIDTYPE    uuid;
+
+    memset(name, 0, sizeof(name));
+    if (OMX_GetComponentVersion(hTunneledComp, name, &compVersion, &specVersion, &uuid) != OMX_ErrorNone)
+        return OMX_FALSE;
+    if (strncmp(name, FP_OMX_TUNNEL_COMPONENT_PREFIX, strlen(FP_OMX_TUNNEL_COMPONENT_PREFIX)) != 0)
+        return OMX_FALSE;
+    /* secure buffers cannot be mapped by the peer */
+    if (strstr(name, ".secure") != NULL)
+        return OMX_FALSE;
+
+    return OMX_TRUE;
+}
+
+static void FP_OMX_TunnelReset(FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    pFoilplanetPort->tunneledComponent = NULL;
+    pFoilplanetPort->tunneledPort = 0;
+    pFoilplanetPort->tunnelBufferNum = 0;
+    pFoilplanetPort->bufferSupplier = OMX_BufferSupplyUnspecified;
+    pFoilplanetPort->tunnelFlags = 0;
+}
+
+OMX_ERRORTYPE FP_OMX_TunnelRequest(
+    OMX_HANDLETYPE       hComp,
+    OMX_U32              nPort,
+    OMX_HANDLETYPE       hTunneledComp,
+    OMX_U32              nTunneledPort,
+    OMX_TUNNELSETUPTYPE *pTunnelSetup)
+{
+    OMX_ERRORTYPE                 ret = OMX_ErrorNone;
+    OMX_COMPONENTTYPE            *pOMXComponent = NULL;
+    FP_OMX_BASECOMPONENT         *pFpComponent = NULL;
+    FP_OMX_BASEPORT              *pFoilplanetPort = NULL;
+    OMX_PARAM_PORTDEFINITIONTYPE  peerDefinition;
+    OMX_PARAM_BUFFERSUPPLIERTYPE  bufferSupplier;
+    OMX_BUFFERSUPPLIERTYPE        eSupplier;
+
+    FunctionIn();
+
+    if (hComp == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+    pOMXComponent = (OMX_COMPONENTTYPE *)hComp;
+    if (pOMXComponent->pComponentPrivate == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+    pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    if (nPort >= pFpComponent->portParam.nPorts) {
+        ret = OMX_ErrorBadPortIndex;
+        goto EXIT;
+    }
+    pFoilplanetPort = &pFpComponent->pFoilplanetPort[nPort];
+
+    if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) &&
+        CHECK_PORT_ENABLED(pFoilplanetPort)) {
+        ret = OMX_ErrorIncorrectStateOperation;
+        goto EXIT;
+    }
+
+    if (hTunneledComp == NULL) {
+        /* tear down, also used when the other side refused */
+        FP_OMX_TunnelReset(pFoilplanetPort);
+        goto EXIT;
+    }
+    if (pTunnelSetup == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+    if (FP_OMX_TunnelPeerSupported(hTunneledComp) != OMX_TRUE) {
+        ret = OMX_ErrorTunnelingUnsupported;
+        goto EXIT;
+    }
+
+    if (pFoilplanetPort->portDefinition.eDir == OMX_DirOutput) {
+        /* asked first, the input side makes the decision */
+        pFoilplanetPort->tunneledComponent = hTunneledComp;
+        pFoilplanetPort->tunneledPort = nTunneledPort;
+        pFoilplanetPort->tunnelFlags = FOILPLANET_TUNNEL_ESTABLISHED;
+        pTunnelSetup->nTunnelFlags = 0;
+        pTunnelSetup->eSupplier = OMX_BufferSupplyOutput;
+        goto EXIT;
+    }
+
+    memset(&peerDefinition, 0, sizeof(peerDefinition));
+    INIT_SET_SIZE_VERSION(&peerDefinition, OMX_PARAM_PORTDEFINITIONTYPE);
+    peerDefinition.nPortIndex = nTunneledPort;
+    ret = OMX_GetParameter(hTunneledComp, OMX_IndexParamPortDefinition, &peerDefinition);
+    if (ret != OMX_ErrorNone) {
+        ret = OMX_ErrorPortsNotCompatible;
+        goto EXIT;
+    }
+    /* raw video both ways, the client sets matching frame sizes as for any tunnel */
+    if ((peerDefinition.eDir != OMX_DirOutput) ||
+        (peerDefinition.eDomain != OMX_PortDomainVideo) ||
+        (pFoilplanetPort->portDefinition.eDomain != OMX_PortDomainVideo) ||
+        (peerDefinition.format.video.eCompressionFormat != OMX_VIDEO_CodingUnused) ||
+        (pFoilplanetPort->portDefinition.format.video.eCompressionFormat != OMX_VIDEO_CodingUnused)) {
+        mpp_err("tunnel to port %d not compatible", nTunneledPort);
+        ret = OMX_ErrorPortsNotCompatible;
+        goto EXIT;
+    }
+
+    eSupplier = pTunnelSetup->eSupplier;
+    if (pFoilplanetPort->bufferSupplier == OMX_BufferSupplyInput)
+        eSupplier = OMX_BufferSupplyInput;
+    else if (eSupplier != OMX_BufferSupplyInput)
+        eSupplier = OMX_BufferSupplyOutput;
+
+    pFoilplanetPort->tunneledComponent = hTunneledComp;
+    pFoilplanetPort->tunneledPort = nTunneledPort;
+    pFoilplanetPort->tunnelFlags = FOILPLANET_TUNNEL_ESTABLISHED;
+    if (eSupplier == OMX_BufferSupplyInput)
+        pFoilplanetPort->tunnelFlags |= FOILPLANET_TUNNEL_IS_SUPPLIER;
+
+    memset(&bufferSupplier, 0, sizeof(bufferSupplier));
+    INIT_SET_SIZE_VERSION(&bufferSupplier, OMX_PARAM_BUFFERSUPPLIERTYPE);
+    bufferSupplier.nPortIndex = nTunneledPort;
+    bufferSupplier.eBufferSupplier = eSupplier;
+    ret = OMX_SetParameter(hTunneledComp, OMX_IndexParamCompBufferSupplier, &bufferSupplier);
+    if (ret != OMX_ErrorNone) {
+        FP_OMX_TunnelReset(pFoilplanetPort);
+        ret = OMX_ErrorPortsNotCompatible;
+        goto EXIT;
+    }
+    pTunnelSetup->eSupplier = eSupplier;
+    mpp_log("tunnel port %d -> port %d, %s supplies", nTunneledPort, nPort,
+            (eSupplier == OMX_BufferSupplyInput) ? "input" : "output");
+
+EXIT:
+    FunctionOut();
+
+    return ret;
+}
+
+OMX_BOOL FP_OMX_TunnelAcceptsBuffer(FP_OMX_BASECOMPONENT *pFpComponent, FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    if (FP_OMX_LOAD(pFoilplanetPort->portState) == OMX_StateIdle)
+        return OMX_TRUE;
+
+    /*
+     * The supplier allocates in its own loaded to idle transition, which the
+     * client may start first. The buffers are taken while still loaded, the
+     * semaphore UseBuffer posts then lets our transition through at once.
+     */
+    return (CHECK_PORT_TUNNELED(pFoilplanetPort) && !CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort) &&
+            CHECK_PORT_ENABLED(pFoilplanetPort) &&
+            (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateLoaded)) ? OMX_TRUE : OMX_FALSE;
+}
+
+OMX_ERRORTYPE FP_OMX_TunnelAllocateBuffer(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 nPortIndex)
+{
+    OMX_ERRORTYPE                 ret = OMX_ErrorNone;
+    OMX_PARAM_PORTDEFINITIONTYPE  peerDefinition;
+    OMX_BUFFERHEADERTYPE         *pBufferHdr = NULL;
+    VPUMemLinear_t               *pVpumem = NULL;
+    OMX_U32                       nCount, nSize;
+    OMX_U32                       i;
+
+    FunctionIn();
+
+    memset(&peerDefinition, 0, sizeof(peerDefinition));
+    INIT_SET_SIZE_VERSION(&peerDefinition, OMX_PARAM_PORTDEFINITIONTYPE);
+    peerDefinition.nPortIndex = pFoilplanetPort->tunneledPort;
+    ret = OMX_GetParameter(pFoilplanetPort->tunneledComponent, OMX_IndexParamPortDefinition, &peerDefinition);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
+    /* enough buffers and bytes for both sides */
+    nCount = pFoilplanetPort->portDefinition.nBufferCountActual;
+    if (peerDefinition.nBufferCountActual > nCount)
+        nCount = peerDefinition.nBufferCountActual;
+    nSize = pFoilplanetPort->portDefinition.nBufferSize;
+    if (peerDefinition.nBufferSize > nSize)
+        nSize = peerDefinition.nBufferSize;
+    if (nCount > PORT_BUFFER_NUM_MAX) {
+        ret = OMX_ErrorInsufficientResources;
+        goto EXIT;
+    }
+    if (peerDefinition.nBufferCountActual != nCount) {
+        peerDefinition.nBufferCountActual = nCount;
+        ret = OMX_SetParameter(pFoilplanetPort->tunneledComponent, OMX_IndexParamPortDefinition, &peerDefinition);
+        if (ret != OMX_ErrorNone)
+            goto EXIT;
+    }
+    pFoilplanetPort->portDefinition.nBufferCountActual = nCount;
+    pFoilplanetPort->portDefinition.nBufferSize = nSize;
+
+    ret = FP_OMX_PortReserveBuffers(pFoilplanetPort);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
+    for (i = 0; i < nCount; i++) {
+        ret = OSAL_VpumemAcquire(nSize, &pVpumem);
+        if (ret != OMX_ErrorNone)
+            goto EXIT;
+
+        /* the peer takes them even before its own idle transition, nothing to wait for */
+        pBufferHdr = NULL;
+        ret = OMX_UseBuffer(pFoilplanetPort->tunneledComponent, &pBufferHdr, pFoilplanetPort->tunneledPort,
+                            NULL, nSize, (OMX_U8 *)pVpumem->vir_addr);
+        if (ret != OMX_ErrorNone) {
+            mpp_err("tunnel UseBuffer %d of %d failed 0x%x", i, nCount, ret);
+            OSAL_VpumemRelease(pVpumem);
+            goto EXIT;
+        }
+
+        pBufferHdr->pPlatformPrivate = (OMX_PTR)pVpumem;
+        if (pFoilplanetPort->portDefinition.eDir == OMX_DirInput)
+            pBufferHdr->nInputPortIndex = nPortIndex;
+        else
+            pBufferHdr->nOutputPortIndex = nPortIndex;
+
+        pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader = pBufferHdr;
+        pFoilplanetPort->extendBufferHeader[i].pTunnelMem = (OMX_PTR)pVpumem;
+        pFoilplanetPort->extendBufferHeader[i].bTunnelHeld = OMX_TRUE;
+        /* the peer owns the header */
+        pFoilplanetPort->bufferStateAllocate[i] = BUFFER_STATE_ALLOCATED;
+        FP_OMX_StampBufferHeader(pFoilplanetPort, i);
+        pFoilplanetPort->assignedBufferNum++;
+        pFoilplanetPort->tunnelBufferNum++;
+    }
+    pFoilplanetPort->portDefinition.bPopulated = OMX_TRUE;
+    mpp_log("tunnel port %d supplies %d buffers of %d bytes", nPortIndex, nCount, nSize);
+
+EXIT:
+    if (ret != OMX_ErrorNone)
+        FP_OMX_TunnelFreeBuffer(pFoilplanetPort, nPortIndex);
+
+    FunctionOut();
+
+    return ret;
+}
+
+OMX_ERRORTYPE FP_OMX_TunnelFreeBuffer(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 nPortIndex)
+{
+    OMX_ERRORTYPE            ret = OMX_ErrorNone;
+    FP_OMX_BUFFERHEADERTYPE *pExtHeader = NULL;
+    OMX_U32                  i;
+
+    FunctionIn();
+
+    for (i = 0; i < pFoilplanetPort->nBufferSlots; i++) {
+        pExtHeader = &pFoilplanetPort->extendBufferHeader[i];
+        if (pExtHeader->pTunnelMem == NULL)
+            continue;
+
+        /* frees the header, the memory stays ours */
+        ret = OMX_FreeBuffer(pFoilplanetPort->tunneledComponent, pFoilplanetPort->tunneledPort,
+                             pExtHeader->OMXBufferHeader);
+        if (ret != OMX_ErrorNone)
+            mpp_err("tunnel FreeBuffer of slot %d failed 0x%x", i, ret);
+        OSAL_VpumemRelease((VPUMemLinear_t *)pExtHeader->pTunnelMem);
+
+        pExtHeader->OMXBufferHeader = NULL;
+        pExtHeader->pTunnelMem = NULL;
+        pExtHeader->bTunnelHeld = OMX_FALSE;
+        pExtHeader->bBufferInOMX = OMX_FALSE;
+        pExtHeader->nGeneration = 0;
+        pFoilplanetPort->bufferStateAllocate[i] = BUFFER_STATE_FREE;
+        pFoilplanetPort->assignedBufferNum--;
+    }
+    pFoilplanetPort->tunnelBufferNum = 0;
+    pFoilplanetPort->portDefinition.bPopulated = OMX_FALSE;
+    (void)nPortIndex;
+
+    FunctionOut();
+
+    return OMX_ErrorNone;
+}
+
+/* a supplier that is flushing or on its way down keeps what comes home */
+static OMX_BOOL FP_OMX_TunnelQuiescing(FP_OMX_BASECOMPONENT *pFpComponent, FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    OMX_STATETYPE state = FP_OMX_LOAD(pFpComponent->currentState);
+
+    return (CHECK_PORT_BEING_FLUSHED_OR_DISABLED(pFoilplanetPort) ||
+            (FP_OMX_LOAD(pFpComponent->transientState) == FP_OMX_TransStateExecutingToIdle) ||
+            (state != OMX_StateExecuting && state != OMX_StatePause)) ? OMX_TRUE : OMX_FALSE;
+}
+
+static void FP_OMX_TunnelSetHeld(FP_OMX_BASEPORT *pFoilplanetPort, OMX_S32 nSlot, OMX_BOOL bHeld)
+{
+    MUTEX_LOCK(pFoilplanetPort->hPortMutex);
+    pFoilplanetPort->extendBufferHeader[nSlot].bTunnelHeld = bHeld;
+    MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
+}
+
+/* hands the buffer to the peer, the next stage for the data or for an empty buffer */
+static OMX_ERRORTYPE FP_OMX_TunnelPass(FP_OMX_BASEPORT *pFoilplanetPort, OMX_BUFFERHEADERTYPE *pBufferHdr)
+{
+    if (pFoilplanetPort->portDefinition.eDir == OMX_DirInput) {
+        pBufferHdr->nOutputPortIndex = pFoilplanetPort->tunneledPort;
+        pBufferHdr->nFilledLen = 0;
+        pBufferHdr->nOffset = 0;
+        pBufferHdr->nFlags = 0;
+        return OMX_FillThisBuffer(pFoilplanetPort->tunneledComponent, pBufferHdr);
+    }
+
+    pBufferHdr->nInputPortIndex = pFoilplanetPort->tunneledPort;
+    return OMX_EmptyThisBuffer(pFoilplanetPort->tunneledComponent, pBufferHdr);
+}
+
+void FP_OMX_TunnelReturn(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE *pBufferHdr)
+{
+    FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_BASEPORT      *pFoilplanetPort = &pFpComponent->pFoilplanetPort[nPortIndex];
+    OMX_S32               slot = FP_OMX_LookupBufferHeader(pFoilplanetPort, pBufferHdr);
+
+    if (slot < 0) {
+        mpp_err("tunnel buffer %p unknown to port %d", pBufferHdr, nPortIndex);
+        return;
+    }
+
+    if (CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort) && FP_OMX_TunnelQuiescing(pFpComponent, pFoilplanetPort)) {
+        FP_OMX_TunnelSetHeld(pFoilplanetPort, slot, OMX_TRUE);
+        return;
+    }
+
+    if (FP_OMX_TunnelPass(pFoilplanetPort, pBufferHdr) != OMX_ErrorNone) {
+        /* the peer is stopping, the buffer waits here for the next resume or free */
+        FP_OMX_TunnelSetHeld(pFoilplanetPort, slot, OMX_TRUE);
+    }
+}
+
+OMX_BOOL FP_OMX_TunnelHold(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex, OMX_S32 nSlot)
+{
+    FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_BASEPORT      *pFoilplanetPort = &pFpComponent->pFoilplanetPort[nPortIndex];
+    OMX_BUFFERHEADERTYPE *pBufferHdr = pFoilplanetPort->extendBufferHeader[nSlot].OMXBufferHeader;
+
+    if (!CHECK_PORT_TUNNELED(pFoilplanetPort) || !CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort))
+        return OMX_FALSE;
+
+    if (FP_OMX_TunnelQuiescing(pFpComponent, pFoilplanetPort)) {
+        FP_OMX_TunnelSetHeld(pFoilplanetPort, nSlot, OMX_TRUE);
+        return OMX_TRUE;
+    }
+
+    /* a flushed peer returns empty buffers, send them straight back to be filled */
+    if ((pFoilplanetPort->portDefinition.eDir == OMX_DirInput) &&
+        (pBufferHdr->nFilledLen == 0) &&
+        ((pBufferHdr->nFlags & OMX_BUFFERFLAG_EOS) == 0)) {
+        if (FP_OMX_TunnelPass(pFoilplanetPort, pBufferHdr) != OMX_ErrorNone)
+            FP_OMX_TunnelSetHeld(pFoilplanetPort, nSlot, OMX_TRUE);
+        return OMX_TRUE;
+    }
+
+    return OMX_FALSE;
+}
+
+void FP_OMX_TunnelResume(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex)
+{
+    FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_BASEPORT      *pFoilplanetPort = &pFpComponent->pFoilplanetPort[nPortIndex];
+    OMX_BUFFERHEADERTYPE *pBufferHdr = NULL;
+    OMX_ERRORTYPE         ret;
+    OMX_U32               i, nResumed = 0;
+
+    if (!CHECK_PORT_TUNNELED(pFoilplanetPort) || !CHECK_PORT_BUFFER_SUPPLIER(pFoilplanetPort))
+        return;
+
+    for (i = 0; i < pFoilplanetPort->nBufferSlots; i++) {
+        MUTEX_LOCK(pFoilplanetPort->hPortMutex);
+        if (pFoilplanetPort->extendBufferHeader[i].bTunnelHeld != OMX_TRUE) {
+            MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
+            continue;
+        }
+        pFoilplanetPort->extendBufferHeader[i].bTunnelHeld = OMX_FALSE;
+        pBufferHdr = pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader;
+        MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
+
+        if (pFoilplanetPort->portDefinition.eDir == OMX_DirOutput) {
+            /* empty buffers to fill, through our own queue */
+            pBufferHdr->nFilledLen = 0;
+            pBufferHdr->nFlags = 0;
+            pBufferHdr->nOutputPortIndex = nPortIndex;
+            ret = OMX_FillThisBuffer((OMX_HANDLETYPE)pOMXComponent, pBufferHdr);
+        } else {
+            ret = FP_OMX_TunnelPass(pFoilplanetPort, pBufferHdr);
+        }
+        if (ret != OMX_ErrorNone)
+            FP_OMX_TunnelSetHeld(pFoilplanetPort, i, OMX_TRUE);
+        else
+            nResumed++;
+    }
+    mpp_log("tunnel port %d resumed %d buffers", nPortIndex, nResumed);
+}
+
+void FP_OMX_TunnelFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex)
+{
+    FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_BASEPORT      *pFoilplanetPort = &pFpComponent->pFoilplanetPort[nPortIndex];
+    OMX_ERRORTYPE         ret;
+
+    if (!CHECK_PORT_TUNNELED(pFoilplanetPort))
+        return;
+
+    FP_OMX_TunnelResume(pOMXComponent, nPortIndex);
+
+    /* frames queued downstream are stale after a seek */
+    if (pFoilplanetPort->portDefinition.eDir == OMX_DirOutput) {
+        ret = OMX_SendCommand(pFoilplanetPort->tunneledComponent, OMX_CommandFlush,
+                              pFoilplanetPort->tunneledPort, NULL);
+        if (ret != OMX_ErrorNone)
+            mpp_err("tunnel flush of port %d failed 0x%x", pFoilplanetPort->tunneledPort, ret);
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FOILPLANET_OMX_TUNNEL_H_
+#define _FOILPLANET_OMX_TUNNEL_H_
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+#include "OMX_Component.h"
+
+#include "Foilplanet_OMX_Basecomponent.h"
+
+/*
+ * Proprietary tunnel between two Foilplanet components, a decoder output
+ * feeding an encoder input. The supplier port allocates linear vpu memory
+ * for every buffer and hands it to the peer with OMX_UseBuffer, the header
+ * pPlatformPrivate then points to the VPUMemLinear_t so the peer can give
+ * the physical address to the vpu instead of copying. The peer takes them
+ * even before its own idle transition, so neither side waits for the other. Buffers a port is
+ * done with go to the peer with EmptyThisBuffer / FillThisBuffer instead
+ * of the client callbacks.
+ *
+ * Buffers coming home to a supplier that is flushing or stopping are held
+ * (bTunnelHeld) and sent on again by FP_OMX_TunnelResume.
+ */
+#define FP_OMX_TUNNEL_COMPONENT_PREFIX  "OMX.fp."
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+OMX_ERRORTYPE FP_OMX_TunnelRequest(
+    OMX_HANDLETYPE       hComp,
+    OMX_U32              nPort,
+    OMX_HANDLETYPE       hTunneledComp,
+    OMX_U32              nTunneledPort,
+    OMX_TUNNELSETUPTYPE *pTunnelSetup);
+/* UseBuffer state check, a non supplier port also takes the supplier's buffers while loaded */
+OMX_BOOL      FP_OMX_TunnelAcceptsBuffer(FP_OMX_BASECOMPONENT *pFpComponent, FP_OMX_BASEPORT *pFoilplanetPort);
+OMX_ERRORTYPE FP_OMX_TunnelAllocateBuffer(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 nPortIndex);
+OMX_ERRORTYPE FP_OMX_TunnelFreeBuffer(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 nPortIndex);
+
+/* a buffer the port is done with, passed to the peer or held by the supplier */
+void          FP_OMX_TunnelReturn(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE *pBufferHdr);
+/* a buffer given to the port, OMX_TRUE when the supplier keeps it instead of queueing it */
+OMX_BOOL      FP_OMX_TunnelHold(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex, OMX_S32 nSlot);
+/* puts the held buffers of a supplier port back into circulation */
+void          FP_OMX_TunnelResume(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex);
+/* a client flush of a tunneled output also flushes the input it feeds */
+void          FP_OMX_TunnelFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_U32 nPortIndex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FOILPLANET_OMX_TUNNEL_H_ */
@@ -48,17 +48,6 @@
 # define MODULE_TAG         "OSAL_ANDROID"
 #endif
 
-/** gralloc_private_handle_t
- * defined in 'librkvpu/omx_get_gralloc_private/gralloc_priv_omx.h'
- */
-typedef struct _gralloc_priv_handle {
-    int format;
-    int share_fd;
-    int type;
-    int stride;
-    int size;
-} gralloc_handle_t;
-
 OMX_S32 get_gralloc_private(uint32_t *handle, gralloc_handle_t *private_hnd)
 {
     // TODO
@@ -206,40 +195,6 @@ EXIT:
     return nStride;
 }
 
-OMX_U32 Get_Video_HorAlign(OMX_VIDEO_CODINGTYPE codecId, OMX_U32 width, OMX_U32 height)
-{
-    OMX_U32 stride = 0;;
-    if (codecId == OMX_VIDEO_CodingHEVC) {
-        stride = ((width + 255) & (~255)) | (256);
-    } else if (codecId == OMX_VIDEO_CodingVP9) {
-        stride = (width + 127) & (~127);
-    } else {
-        stride = ((width + 15) & (~15));
-    }
-    if (access("/dev/rkvdec", 06) == 0) {
-        if (width > 1920 || height > 1088) {
-            if (codecId == OMX_VIDEO_CodingAVC) {
-                stride = ((width + 255) & (~255)) | (256);
-            }
-        }
-    }
-    return stride;
-}
-
-OMX_U32 Get_Video_VerAlign(OMX_VIDEO_CODINGTYPE codecId, OMX_U32 height)
-{
-    OMX_U32 stride = 0;;
-    if (codecId == OMX_VIDEO_CodingHEVC) {
-        stride = (height + 7) & (~7);
-    } else if (codecId == OMX_VIDEO_CodingVP9) {
-        stride = (height + 63) & (~63);
-    } else {
-        stride = ((height + 15) & (~15));
-    }
-    return stride;
-}
-
-
 OMX_ERRORTYPE OSAL_LockANB(
     OMX_IN OMX_PTR pBuffer,
     OMX_IN OMX_U32 width,
@@ -313,6 +268,7 @@ EXIT:
 }
 
 OMX_ERRORTYPE useAndroidNativeBuffer(
+    FP_OMX_BASECOMPONENT  *pFpComponent,
     FP_OMX_BASEPORT       *pFoilplanetPort,
     OMX_BUFFERHEADERTYPE **ppBufferHdr,
     OMX_U32                nPortIndex,
@@ -333,7 +289,7 @@ OMX_ERRORTYPE useAndroidNativeBuffer(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFoilplanetPort->portState != OMX_StateIdle) {
+    if (FP_OMX_LOAD(pFoilplanetPort->portState) != OMX_StateIdle) {
         ret = OMX_ErrorIncorrectStateOperation;
         goto EXIT;
     }
@@ -342,6 +298,10 @@ OMX_ERRORTYPE useAndroidNativeBuffer(
         goto EXIT;
     }
 
+    ret = FP_OMX_PortReserveBuffers(pFoilplanetPort);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
     temp_bufferHeader = (OMX_BUFFERHEADERTYPE *)malloc(sizeof(OMX_BUFFERHEADERTYPE));
     if (temp_bufferHeader == NULL) {
         ret = OMX_ErrorInsufficientResources;
@@ -366,15 +326,20 @@ OMX_ERRORTYPE useAndroidNativeBuffer(
             height = pFoilplanetPort->portDefinition.format.video.nFrameHeight;
             OSAL_LockANB(temp_bufferHeader->pBuffer, width, height,
                                   pFoilplanetPort->portDefinition.format.video.eColorFormat, planes);
-            pFoilplanetPort->extendBufferHeader[i].buf_fd[0] = planes[0].fd;
+            FP_OMX_SetBufferFd(pFoilplanetPort, i, planes[0].fd);
             pFoilplanetPort->extendBufferHeader[i].pYUVBuf[0] = planes[0].addr;
             OSAL_UnlockANB(temp_bufferHeader->pBuffer);
             mpp_log("useAndroidNativeBuffer: buf %d pYUVBuf[0]:0x%x (fd:%d)",
                       i, pFoilplanetPort->extendBufferHeader[i].pYUVBuf[0], planes[0].fd);
 
+            FP_OMX_StampBufferHeader(pFoilplanetPort, i);
+
             pFoilplanetPort->assignedBufferNum++;
             if (pFoilplanetPort->assignedBufferNum == pFoilplanetPort->portDefinition.nBufferCountActual) {
                 pFoilplanetPort->portDefinition.bPopulated = OMX_TRUE;
+                /* same import decision as FP_OMX_UseBuffer */
+                if (nPortIndex == OUTPUT_PORT_INDEX && pFpComponent->codecType == HW_VIDEO_DEC_CODEC)
+                    OSAL_ANBTryShare(pFpComponent);
                 /* OSAL_MutexLock(pFpComponent->compMutex); */
                 OSAL_SemaphorePost(pFoilplanetPort->loadedResource);
                 /* OSAL_MutexUnlock(pFpComponent->compMutex); */
@@ -423,7 +388,7 @@ OMX_ERRORTYPE OSAL_GetANBParameter(
     }
 
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    if (pFpComponent->currentState == OMX_StateInvalid ) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid ) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -581,7 +546,7 @@ OMX_ERRORTYPE OSAL_SetANBParameter(
     }
 
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    if (pFpComponent->currentState == OMX_StateInvalid ) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid ) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -677,6 +642,8 @@ OMX_ERRORTYPE OSAL_SetANBParameter(
         }
 
         if ((portIndex == OUTPUT_PORT_INDEX) && !pVideoDec->bIsANBEnabled) {
+            /* drop the pool opened above or by an earlier enable before the copy one */
+            OSAL_Closevpumempool(pFpComponent);
             pFoilplanetPort->bufferProcessType = BUFFER_COPY;
             OSAL_Openvpumempool(pFpComponent, portIndex);
         }
@@ -717,7 +684,7 @@ OMX_ERRORTYPE OSAL_SetANBParameter(
             goto EXIT;
         }
 
-        if (pFoilplanetPort->portState != OMX_StateIdle) {
+        if (FP_OMX_LOAD(pFoilplanetPort->portState) != OMX_StateIdle) {
             mpp_err("%s: Port state should be IDLE", __func__);
             ret = OMX_ErrorIncorrectStateOperation;
             goto EXIT;
@@ -729,7 +696,8 @@ OMX_ERRORTYPE OSAL_SetANBParameter(
         nSizeBytes = ALIGN(pANB->width, 16) * ALIGN(pANB->height, 16);
         nSizeBytes += ALIGN(pANB->width / 2, 16) * ALIGN(pANB->height / 2, 16) * 2;
 
-        ret = useAndroidNativeBuffer(pFoilplanetPort,
+        ret = useAndroidNativeBuffer(pFpComponent,
+                                     pFoilplanetPort,
                                      pANBParams->bufferHeader,
                                      pANBParams->nPortIndex,
                                      pANBParams->pAppPrivate,
@@ -1056,148 +1024,6 @@ unsigned int OSAL_OMX2HalPixelFormat(
     return hal_format;
 }
 
-OMX_ERRORTYPE OSAL_Fd2VpumemPool(FP_OMX_BASECOMPONENT *pFpComponent, OMX_BUFFERHEADERTYPE* bufferHeader)
-{
-    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
-    FP_OMX_BASEPORT        *pFoilplanetPort        = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
-    struct vpu_display_mem_pool *pMem_pool = (struct vpu_display_mem_pool*)pVideoDec->vpumem_handle;
-    OMX_U32 i = 0;
-    OMX_U32 width = pFoilplanetPort->portDefinition.format.video.nStride;
-    OMX_U32 height = pFoilplanetPort->portDefinition.format.video.nSliceHeight;
-#if 1//LOW_VRESION
-    OMX_U32 nBytesize = width * height * 2;
-#else
-    OMX_U32 nBytesize = width * height * 9 / 5;
-#endif
-    OMX_S32 dupshared_fd = -1;
-
-    for (i = 0; i < pFoilplanetPort->portDefinition.nBufferCountActual; i++) {
-        if (pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader == bufferHeader) {
-            mpp_log("commit bufferHeader 0x%x", bufferHeader);
-            break;
-        }
-    }
-    if (!pFoilplanetPort->extendBufferHeader[i].pRegisterFlag) {
-        buffer_handle_t bufferHandle = NULL;
-        if (pVideoDec->bStoreMetaData == OMX_TRUE) {
-            OMX_PTR pBufferHandle;
-            OSAL_GetInfoFromMetaData(bufferHeader->pBuffer, &pBufferHandle);
-            bufferHandle =  (buffer_handle_t)pBufferHandle;
-        } else {
-            bufferHandle = (buffer_handle_t) bufferHeader->pBuffer;
-        }
-        gralloc_handle_t priv_hnd;
-        memset(&priv_hnd, 0, sizeof(priv_hnd));
-        get_gralloc_private((uint32_t*)bufferHandle, &priv_hnd);
-        if (((!VPUMemJudgeIommu()) ? (priv_hnd.type != ANB_PRIVATE_BUF_VIRTUAL) : 1)) {
-            pFoilplanetPort->extendBufferHeader[i].buf_fd[0] = priv_hnd.share_fd;
-            pFoilplanetPort->extendBufferHeader[i].pRegisterFlag = 1;
-            mpp_log("priv_hnd.share_fd = 0x%x", priv_hnd.share_fd);
-            if (priv_hnd.share_fd > 0) {
-                if (priv_hnd.size) {
-                    nBytesize = priv_hnd.size;
-                }
-                if (pVideoDec->bDRMPlayerMode == OMX_TRUE) {
-                    priv_hnd.share_fd |= 1 << 10;
-                }
-                dupshared_fd = pMem_pool->commit_hdl(pMem_pool, priv_hnd.share_fd , nBytesize);
-                if (dupshared_fd > 0) {
-                    pFoilplanetPort->extendBufferHeader[i].buf_fd[0] = dupshared_fd;
-                }
-                mpp_log("commit bufferHeader 0x%x share_fd = 0x%x nBytesize = %d", bufferHeader, pFoilplanetPort->extendBufferHeader[i].buf_fd[0], nBytesize);
-            }
-        } else {
-            mpp_log("cma case gpu vmalloc can't used");
-        }
-    } else {
-        mpp_log(" free bufferHeader 0x%x", pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader);
-        if (pFoilplanetPort->extendBufferHeader[i].pPrivate != NULL) {
-            OSAL_FreeVpumem(pFoilplanetPort->extendBufferHeader[i].pPrivate);
-            pFoilplanetPort->extendBufferHeader[i].pPrivate = NULL;
-        };
-    }
-    return OMX_ErrorNone;
-}
-
-OMX_ERRORTYPE OSAL_ResetVpumemPool(FP_OMX_BASECOMPONENT *pFpComponent)
-{
-    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
-    FP_OMX_BASEPORT        *pFoilplanetPort        = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
-    struct vpu_display_mem_pool *pMem_pool = (struct vpu_display_mem_pool*)pVideoDec->vpumem_handle;
-    pMem_pool->reset(pMem_pool);
-    return OMX_ErrorNone;
-}
-OMX_ERRORTYPE OSAL_FreeVpumem(OMX_IN OMX_PTR pVpuframe)
-{
-    mpp_log("freeVpumem");
-    VPU_FRAME *pframe = (VPU_FRAME *)pVpuframe;
-    VPUMemLink(&pframe->vpumem);
-    VPUFreeLinear(&pframe->vpumem);
-    free(pframe);
-    return OMX_ErrorNone;
-}
-
-OMX_BUFFERHEADERTYPE *OSAL_Fd2OmxBufferHeader(FP_OMX_BASEPORT *pFoilplanetPort, OMX_IN OMX_S32 fd, OMX_IN OMX_PTR pVpuframe)
-{
-    OMX_U32 i = 0;
-    for (i = 0; i < pFoilplanetPort->portDefinition.nBufferCountActual; i++) {
-        if (fd == pFoilplanetPort->extendBufferHeader[i].buf_fd[0]) {
-            mpp_log(" current fd = 0x%x send to render current header 0x%x", fd, pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader);
-            if ( pFoilplanetPort->extendBufferHeader[i].pPrivate != NULL) {
-                mpp_log("This buff alreay send to display ");
-                return NULL;
-            }
-            if (pVpuframe) {
-                pFoilplanetPort->extendBufferHeader[i].pPrivate = pVpuframe;
-            } else {
-                mpp_log("vpu_mem point is NULL may error");
-            }
-            return pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader;
-        }
-    }
-    return NULL;
-}
-
-OMX_ERRORTYPE  OSAL_Openvpumempool(OMX_IN FP_OMX_BASECOMPONENT *pFpComponent, OMX_U32 portIndex)
-{
-    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
-    VpuCodecContext_t           *p_vpu_ctx = pVideoDec->vpu_ctx;
-    FP_OMX_BASEPORT *pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
-    if (pFoilplanetPort->bufferProcessType == BUFFER_SHARE) {
-        pVideoDec->vpumem_handle = (void*)open_vpu_memory_pool();
-        if (pVideoDec->vpumem_handle != NULL) {
-            mpp_log("open_vpu_memory_pool success handle 0x%x", pVideoDec->vpumem_handle);
-        }
-    } else {
-        vpu_display_mem_pool   *pool = NULL;
-        OMX_U32 hor_stride = Get_Video_HorAlign(pVideoDec->codecId, pFoilplanetPort->portDefinition.format.video.nFrameWidth, pFoilplanetPort->portDefinition.format.video.nFrameHeight);
-
-        OMX_U32 ver_stride = Get_Video_VerAlign(pVideoDec->codecId, pFoilplanetPort->portDefinition.format.video.nFrameHeight);
-        mpp_err("hor_stride %d ver_stride %d", hor_stride, ver_stride);
-        if (0 != create_vpu_memory_pool_allocator(&pool, 8, (hor_stride * ver_stride * 2))) {
-            mpp_err("create_vpu_memory_pool_allocator fail");
-        }
-        pVideoDec->vpumem_handle = (void*)(pool);
-    }
-    return OMX_ErrorNone;
-}
-
-
-OMX_ERRORTYPE  OSAL_Closevpumempool(OMX_IN FP_OMX_BASECOMPONENT *pFpComponent)
-{
-
-    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
-    FP_OMX_BASEPORT *pFoilplanetPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
-    if (pFoilplanetPort->bufferProcessType == BUFFER_SHARE) {
-        close_vpu_memory_pool((vpu_display_mem_pool *)pVideoDec->vpumem_handle);
-        pVideoDec->vpumem_handle = NULL;
-    } else if (pVideoDec->vpumem_handle != NULL) {
-        release_vpu_memory_pool_allocator((vpu_display_mem_pool*)pVideoDec->vpumem_handle );
-        pVideoDec->vpumem_handle  = NULL;
-    }
-    return OMX_ErrorNone;
-}
-
 
 //DDR Frequency conversion
 OMX_ERRORTYPE OSAL_PowerControl(
@@ -23,6 +23,7 @@
 
 #include "Foilplanet_OMX_Baseport.h"
 #include "Foilplanet_OMX_Basecomponent.h"
+#include "osal_vpupool.h"
 
 #ifndef mpp_trace
 # define mpp_trace          mpp_log
@@ -110,28 +111,10 @@ OMX_COLOR_FORMATTYPE OSAL_Hal2OMXPixelFormat(unsigned int hal_format);
 
 unsigned int OSAL_OMX2HalPixelFormat(OMX_COLOR_FORMATTYPE omx_format);
 
-OMX_ERRORTYPE OSAL_Fd2VpumemPool(FP_OMX_BASECOMPONENT *pRockchipComponent,
-                                 OMX_BUFFERHEADERTYPE* bufferHeader);
-
-OMX_BUFFERHEADERTYPE *OSAL_Fd2OmxBufferHeader(FP_OMX_BASEPORT *pRockchipPort,
-                                              OMX_IN OMX_S32 fd, OMX_IN OMX_PTR pVpumem);
-
-OMX_ERRORTYPE  OSAL_FreeVpumem(OMX_IN OMX_PTR pVpumem);
-
-OMX_ERRORTYPE  OSAL_Openvpumempool(OMX_IN FP_OMX_BASECOMPONENT *pRockchipComponent, OMX_U32 portIndex);
-
-OMX_ERRORTYPE  OSAL_Closevpumempool(OMX_IN FP_OMX_BASECOMPONENT *pRockchipComponent);
-
-OMX_ERRORTYPE OSAL_ResetVpumemPool(OMX_IN FP_OMX_BASECOMPONENT *pRockchipComponent);
-
 OMX_COLOR_FORMATTYPE OSAL_CheckFormat(FP_OMX_BASECOMPONENT *pRockchipComponent, OMX_IN OMX_PTR pVpuframe);
 
 OMX_ERRORTYPE OSAL_getANBHandle(OMX_IN OMX_PTR handle, OMX_OUT OMX_PTR planes);
 
-OMX_U32 Get_Video_HorAlign(OMX_VIDEO_CODINGTYPE codecId, OMX_U32 width, OMX_U32 height);
-
-OMX_U32 Get_Video_VerAlign(OMX_VIDEO_CODINGTYPE codecId, OMX_U32 height);
-
 OMX_ERRORTYPE OSAL_PowerControl(FP_OMX_BASECOMPONENT *pRockchipComponent,
                                 int32_t width,
                                 int32_t height,
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "OMX_Def.h"
+
+#include "osal_arena.h"
+#include "osal/mpp_log.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "OSAL_ARENA"
+#endif
+
+#define OSAL_ARENA_ROUND(x)     (((x) + OSAL_ARENA_ALIGN - 1) & ~(OSAL_ARENA_ALIGN - 1))
+
+typedef struct _OSAL_ARENA_CHUNK {
+    struct _OSAL_ARENA_CHUNK   *next;
+    OMX_U32                     nSize;      /* usable bytes after the header */
+    OMX_U32                     nUsed;
+} OSAL_ARENA_CHUNK;
+
+#define OSAL_ARENA_CHUNK_HEADER OSAL_ARENA_ROUND(sizeof(OSAL_ARENA_CHUNK))
+
+typedef struct _OSAL_ARENA {
+    OSAL_ARENA_CHUNK   *pFirst;     /* survives resets */
+    OSAL_ARENA_CHUNK   *pCurrent;   /* allocations are carved from here */
+    OMX_U32             nChunkSize;
+    OMX_U32             nAllocated; /* since the last reset */
+    OMX_U32             nPeak;
+    OMX_BOOL            bShared;
+    pthread_mutex_t     mutex;
+} OSAL_ARENA;
+
+static OSAL_ARENA_CHUNK *OSAL_ArenaNewChunk(OMX_U32 nSize)
+{
+    OSAL_ARENA_CHUNK *chunk = (OSAL_ARENA_CHUNK *)malloc(OSAL_ARENA_CHUNK_HEADER + nSize);
+
+    if (chunk != NULL) {
+        chunk->next  = NULL;
+        chunk->nSize = nSize;
+        chunk->nUsed = 0;
+    }
+    return chunk;
+}
+
+static void OSAL_ArenaFreeChunks(OSAL_ARENA_CHUNK *chunk)
+{
+    while (chunk != NULL) {
+        OSAL_ARENA_CHUNK *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+OMX_ERRORTYPE OSAL_ArenaCreate(OMX_HANDLETYPE *arenaHandle, OMX_U32 nChunkSize, OMX_BOOL bShared)
+{
+    OSAL_ARENA *arena = NULL;
+
+    if (arenaHandle == NULL)
+        return OMX_ErrorBadParameter;
+
+    arena = (OSAL_ARENA *)calloc(1, sizeof(OSAL_ARENA));
+    if (arena == NULL)
+        return OMX_ErrorInsufficientResources;
+
+    if (nChunkSize == 0)
+        nChunkSize = OSAL_ARENA_CHUNK_DEFAULT;
+    arena->nChunkSize = OSAL_ARENA_ROUND(nChunkSize);
+    arena->pFirst = OSAL_ArenaNewChunk(arena->nChunkSize);
+    if (arena->pFirst == NULL) {
+        free(arena);
+        return OMX_ErrorInsufficientResources;
+    }
+    arena->pCurrent = arena->pFirst;
+    arena->bShared = bShared;
+    if (bShared)
+        pthread_mutex_init(&arena->mutex, NULL);
+
+    *arenaHandle = (OMX_HANDLETYPE)arena;
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_ArenaTerminate(OMX_HANDLETYPE arenaHandle)
+{
+    OSAL_ARENA *arena = (OSAL_ARENA *)arenaHandle;
+
+    if (arena == NULL)
+        return OMX_ErrorBadParameter;
+
+    OSAL_ArenaFreeChunks(arena->pFirst);
+    if (arena->bShared)
+        pthread_mutex_destroy(&arena->mutex);
+    free(arena);
+
+    return OMX_ErrorNone;
+}
+
+OMX_PTR OSAL_ArenaAlloc(OMX_HANDLETYPE arenaHandle, OMX_U32 nSize)
+{
+    OSAL_ARENA       *arena = (OSAL_ARENA *)arenaHandle;
+    OSAL_ARENA_CHUNK *chunk = NULL;
+    OMX_PTR           ptr = NULL;
+
+    if (arena == NULL || nSize == 0)
+        return NULL;
+
+    nSize = OSAL_ARENA_ROUND(nSize);
+
+    if (arena->bShared)
+        pthread_mutex_lock(&arena->mutex);
+
+    chunk = arena->pCurrent;
+    if (chunk->nSize - chunk->nUsed < nSize) {
+        /* the chunk may still have room for later small requests, append after it */
+        chunk = OSAL_ArenaNewChunk(nSize > arena->nChunkSize ? nSize : arena->nChunkSize);
+        if (chunk == NULL) {
+            mpp_err("arena chunk of %d bytes failed", nSize);
+            goto EXIT;
+        }
+        chunk->next = arena->pCurrent->next;
+        arena->pCurrent->next = chunk;
+        if (nSize <= arena->nChunkSize)
+            arena->pCurrent = chunk;
+    }
+
+    ptr = (OMX_U8 *)chunk + OSAL_ARENA_CHUNK_HEADER + chunk->nUsed;
+    chunk->nUsed += nSize;
+    arena->nAllocated += nSize;
+    if (arena->nAllocated > arena->nPeak)
+        arena->nPeak = arena->nAllocated;
+
+EXIT:
+    if (arena->bShared)
+        pthread_mutex_unlock(&arena->mutex);
+
+    return ptr;
+}
+
+void OSAL_ArenaReset(OMX_HANDLETYPE arenaHandle)
+{
+    OSAL_ARENA       *arena = (OSAL_ARENA *)arenaHandle;
+    OSAL_ARENA_CHUNK *extra = NULL;
+
+    if (arena == NULL)
+        return;
+
+    if (arena->bShared)
+        pthread_mutex_lock(&arena->mutex);
+    if (arena->nAllocated != 0) {
+        extra = arena->pFirst->next;
+        arena->pFirst->next = NULL;
+        arena->pFirst->nUsed = 0;
+        arena->pCurrent = arena->pFirst;
+        arena->nAllocated = 0;
+    }
+    if (arena->bShared)
+        pthread_mutex_unlock(&arena->mutex);
+
+    OSAL_ArenaFreeChunks(extra);
+}
+
+OMX_U32 OSAL_ArenaPeak(OMX_HANDLETYPE arenaHandle)
+{
+    OSAL_ARENA *arena = (OSAL_ARENA *)arenaHandle;
+
+    return (arena != NULL) ? arena->nPeak : 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _OSAL_ARENA_H_
+#define _OSAL_ARENA_H_
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+
+/*
+ * Bump allocator over a list of chunks. Nothing is freed on its own, a
+ * reset drops every allocation at once and keeps the first chunk for the
+ * next round, terminate releases everything. Requests larger than the
+ * chunk size get a chunk of their own. Allocations are aligned to
+ * OSAL_ARENA_ALIGN. Only arenas created with bShared may be used from
+ * more than one thread.
+ */
+#define OSAL_ARENA_ALIGN            16
+#define OSAL_ARENA_CHUNK_DEFAULT    (16 << 10)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+OMX_ERRORTYPE OSAL_ArenaCreate(OMX_HANDLETYPE *arenaHandle, OMX_U32 nChunkSize, OMX_BOOL bShared);
+OMX_ERRORTYPE OSAL_ArenaTerminate(OMX_HANDLETYPE arenaHandle);
+OMX_PTR       OSAL_ArenaAlloc(OMX_HANDLETYPE arenaHandle, OMX_U32 nSize);
+void          OSAL_ArenaReset(OMX_HANDLETYPE arenaHandle);
+/* largest number of bytes handed out between two resets */
+OMX_U32       OSAL_ArenaPeak(OMX_HANDLETYPE arenaHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OSAL_ARENA_H_ */
@@ -18,7 +18,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "OMX_Def.h"
 
@@ -37,10 +43,40 @@ typedef struct _OSAL_THREADEVENT {
     pthread_cond_t condition;
 } OSAL_THREADEVENT;
 
+/* counting semaphore on a futex word, count never goes below zero until terminated */
+#define SEMA_TERMINATED     (-1)
+
+typedef struct _OSAL_SEMAPHORE {
+    int32_t        count;
+    int32_t        waiters;
+} OSAL_SEMAPHORE;
+
+static inline long futex(int32_t *uaddr, int op, int32_t val, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+/*
+ * Absolute CLOCK_MONOTONIC deadline ms from now. The event conditions are
+ * bound to the monotonic clock, so wall clock steps do not move timeouts.
+ */
+static void OSAL_GetDeadline(struct timespec *deadline, OMX_U32 ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+
+    deadline->tv_sec  += ms / 1000;
+    deadline->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec  += 1;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
 OMX_ERRORTYPE OSAL_SignalCreate(OMX_HANDLETYPE *eventHandle)
 {
     OSAL_THREADEVENT *event;
     OMX_ERRORTYPE ret = OMX_ErrorNone;
+    pthread_condattr_t attr;
 
     event = (OSAL_THREADEVENT *)malloc(sizeof(OSAL_THREADEVENT));
     if (!event) {
@@ -53,12 +89,16 @@ OMX_ERRORTYPE OSAL_SignalCreate(OMX_HANDLETYPE *eventHandle)
 
     event->mutex = MUTEX_CREATE();
 
-    if (pthread_cond_init(&event->condition, NULL)) {
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (pthread_cond_init(&event->condition, &attr)) {
+        pthread_condattr_destroy(&attr);
         MUTEX_FREE(event->mutex);
         free(event);
         ret = OMX_ErrorUndefined;
         goto EXIT;
     }
+    pthread_condattr_destroy(&attr);
 
     *eventHandle = (OMX_HANDLETYPE)event;
     ret = OMX_ErrorNone;
@@ -141,9 +181,7 @@ OMX_ERRORTYPE OSAL_SignalWait(OMX_HANDLETYPE eventHandle, OMX_U32 ms)
     OSAL_THREADEVENT *event = (OSAL_THREADEVENT *)eventHandle;
     OMX_ERRORTYPE         ret = OMX_ErrorNone;
     struct timespec       timeout;
-    struct timeval        now;
     int                   funcret = 0;
-    OMX_U32               tv_us;
 
     FunctionIn();
 
@@ -152,11 +190,8 @@ OMX_ERRORTYPE OSAL_SignalWait(OMX_HANDLETYPE eventHandle, OMX_U32 ms)
         goto EXIT;
     }
 
-    gettimeofday(&now, NULL);
-
-    tv_us = now.tv_usec + ms * 1000;
-    timeout.tv_sec = now.tv_sec + tv_us / 1000000;
-    timeout.tv_nsec = (tv_us % 1000000) * 1000;
+    if (ms != 0 && ms != DEF_MAX_WAIT_TIME)
+        OSAL_GetDeadline(&timeout, ms);
 
     MUTEX_LOCK(event->mutex);
 
@@ -186,35 +221,86 @@ EXIT:
 }
 
 
+/*
+ * Auto-reset variant of OSAL_SignalWait: wait until the event is set or
+ * the timeout expires, and consume the signal under the same lock so a set
+ * that races with the waiter going to sleep is never lost.
+ */
+OMX_ERRORTYPE OSAL_SignalWaitReset(OMX_HANDLETYPE eventHandle, OMX_U32 ms)
+{
+    OSAL_THREADEVENT *event = (OSAL_THREADEVENT *)eventHandle;
+    OMX_ERRORTYPE         ret = OMX_ErrorNone;
+    struct timespec       timeout;
+    int                   funcret = 0;
+
+    FunctionIn();
+
+    if (!event) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+
+    if (ms != 0 && ms != DEF_MAX_WAIT_TIME)
+        OSAL_GetDeadline(&timeout, ms);
+
+    MUTEX_LOCK(event->mutex);
+
+    if (ms == DEF_MAX_WAIT_TIME) {
+        while (!event->signal)
+            pthread_cond_wait(&event->condition, (pthread_mutex_t *)(event->mutex));
+    } else if (ms != 0) {
+        while (!event->signal) {
+            funcret = pthread_cond_timedwait(&event->condition, (pthread_mutex_t *)(event->mutex), &timeout);
+            if (funcret == ETIMEDOUT)
+                break;
+        }
+    }
+
+    if (event->signal)
+        event->signal = OMX_FALSE;
+    else
+        ret = OMX_ErrorTimeout;
+
+    MUTEX_UNLOCK(event->mutex);
+
+EXIT:
+    FunctionOut();
+
+    return ret;
+}
+
 /* ---- semaphore -----*/
 OMX_ERRORTYPE OSAL_SemaphoreCreate(OMX_HANDLETYPE *semaphoreHandle)
 {
-    sem_t *sema;
+    OSAL_SEMAPHORE *sema;
 
-    sema = (sem_t *)malloc(sizeof(sem_t));
+    sema = (OSAL_SEMAPHORE *)malloc(sizeof(OSAL_SEMAPHORE));
     if (!sema)
         return OMX_ErrorInsufficientResources;
 
-    if (sem_init(sema, 0, 0) != 0) {
-        free(sema);
-        return OMX_ErrorUndefined;
-    }
+    sema->count = 0;
+    sema->waiters = 0;
 
     *semaphoreHandle = (OMX_HANDLETYPE)sema;
 
-    mpp_log("OSAL_SemaphorePost %p", sema);
     return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE OSAL_SemaphoreTerminate(OMX_HANDLETYPE semaphoreHandle)
 {
-    sem_t *sema = (sem_t *)semaphoreHandle;
+    OSAL_SEMAPHORE *sema = (OSAL_SEMAPHORE *)semaphoreHandle;
 
     if (sema == NULL)
         return OMX_ErrorBadParameter;
 
-    if (sem_destroy(sema) != 0)
-        return OMX_ErrorUndefined;
+    /* fail blocked waits and free only once the last one has left */
+    __atomic_store_n(&sema->count, SEMA_TERMINATED, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sema->waiters, __ATOMIC_SEQ_CST) > 0) {
+        mpp_log("semaphore %p terminated with waiters", sema);
+        futex(&sema->count, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+        while (__atomic_load_n(&sema->waiters, __ATOMIC_ACQUIRE) > 0)
+            sched_yield();
+    }
 
     free(sema);
     return OMX_ErrorNone;
@@ -222,66 +308,90 @@ OMX_ERRORTYPE OSAL_SemaphoreTerminate(OMX_HANDLETYPE semaphoreHandle)
 
 OMX_ERRORTYPE OSAL_SemaphoreWait(OMX_HANDLETYPE semaphoreHandle)
 {
-    mpp_log("OSAL_SemaphoreWait %p", semaphoreHandle);
-    sem_t *sema = (sem_t *)semaphoreHandle;
+    OSAL_SEMAPHORE *sema = (OSAL_SEMAPHORE *)semaphoreHandle;
+    OMX_ERRORTYPE   ret = OMX_ErrorNone;
+    int32_t         count;
 
     FunctionIn();
 
     if (sema == NULL)
         return OMX_ErrorBadParameter;
 
-    if (sem_wait(sema) != 0)
-        return OMX_ErrorUndefined;
+    count = __atomic_load_n(&sema->count, __ATOMIC_ACQUIRE);
+    for (;;) {
+        while (count > 0) {
+            if (__atomic_compare_exchange_n(&sema->count, &count, count - 1, true,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+                goto EXIT;
+        }
+        if (count == SEMA_TERMINATED) {
+            ret = OMX_ErrorInvalidState;
+            goto EXIT;
+        }
 
+        /*
+         * The kernel re-checks count == 0, a post or terminate in between
+         * returns EAGAIN. The count is read before leaving the waiters,
+         * terminate may free the semaphore right after.
+         */
+        __atomic_add_fetch(&sema->waiters, 1, __ATOMIC_SEQ_CST);
+        futex(&sema->count, FUTEX_WAIT_PRIVATE, 0, NULL);
+        count = __atomic_load_n(&sema->count, __ATOMIC_ACQUIRE);
+        if (count == SEMA_TERMINATED) {
+            __atomic_sub_fetch(&sema->waiters, 1, __ATOMIC_RELEASE);
+            ret = OMX_ErrorInvalidState;
+            goto EXIT;
+        }
+        __atomic_sub_fetch(&sema->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+
+EXIT:
     FunctionOut();
 
-    return OMX_ErrorNone;
+    return ret;
 }
 
 OMX_ERRORTYPE OSAL_SemaphorePost(OMX_HANDLETYPE semaphoreHandle)
 {
-
-    // omx_err("OSAL_SemaphorePost %p",semaphoreHandle);
-    sem_t *sema = (sem_t *)semaphoreHandle;
+    OSAL_SEMAPHORE *sema = (OSAL_SEMAPHORE *)semaphoreHandle;
 
     FunctionIn();
 
     if (sema == NULL)
         return OMX_ErrorBadParameter;
 
-    if (sem_post(sema) != 0)
-        return OMX_ErrorUndefined;
+    __atomic_add_fetch(&sema->count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sema->waiters, __ATOMIC_SEQ_CST) > 0)
+        futex(&sema->count, FUTEX_WAKE_PRIVATE, 1, NULL);
 
     FunctionOut();
 
     return OMX_ErrorNone;
 }
 
+/* atomically replaces the count, waiters blocked on it stay valid */
 OMX_ERRORTYPE OSAL_Set_SemaphoreCount(OMX_HANDLETYPE semaphoreHandle, OMX_S32 val)
 {
-    sem_t *sema = (sem_t *)semaphoreHandle;
+    OSAL_SEMAPHORE *sema = (OSAL_SEMAPHORE *)semaphoreHandle;
 
-    if (sema == NULL)
+    if (sema == NULL || val < 0)
         return OMX_ErrorBadParameter;
 
-    if (sem_init(sema, 0, val) != 0)
-        return OMX_ErrorUndefined;
+    __atomic_store_n(&sema->count, val, __ATOMIC_SEQ_CST);
+    if (val > 0 && __atomic_load_n(&sema->waiters, __ATOMIC_SEQ_CST) > 0)
+        futex(&sema->count, FUTEX_WAKE_PRIVATE, val, NULL);
 
     return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE OSAL_Get_SemaphoreCount(OMX_HANDLETYPE semaphoreHandle, OMX_S32 *val)
 {
-    sem_t *sema = (sem_t *)semaphoreHandle;
-    int semaVal = 0;
+    OSAL_SEMAPHORE *sema = (OSAL_SEMAPHORE *)semaphoreHandle;
 
     if (sema == NULL)
         return OMX_ErrorBadParameter;
 
-    if (sem_getvalue(sema, &semaVal) != 0)
-        return OMX_ErrorUndefined;
-
-    *val = (OMX_S32)semaVal;
+    *val = (OMX_S32)__atomic_load_n(&sema->count, __ATOMIC_ACQUIRE);
 
     return OMX_ErrorNone;
 }
@@ -37,8 +37,10 @@ OMX_ERRORTYPE OSAL_SignalTerminate(OMX_HANDLETYPE eventHandle);
 OMX_ERRORTYPE OSAL_SignalReset(OMX_HANDLETYPE eventHandle);
 OMX_ERRORTYPE OSAL_SignalSet(OMX_HANDLETYPE eventHandle);
 OMX_ERRORTYPE OSAL_SignalWait(OMX_HANDLETYPE eventHandle, OMX_U32 ms);
+OMX_ERRORTYPE OSAL_SignalWaitReset(OMX_HANDLETYPE eventHandle, OMX_U32 ms);
 
 OMX_ERRORTYPE OSAL_SemaphoreCreate(OMX_HANDLETYPE *semaphoreHandle);
+/* blocked OSAL_SemaphoreWait calls return OMX_ErrorInvalidState before the free */
 OMX_ERRORTYPE OSAL_SemaphoreTerminate(OMX_HANDLETYPE semaphoreHandle);
 OMX_ERRORTYPE OSAL_SemaphoreWait(OMX_HANDLETYPE semaphoreHandle);
 OMX_ERRORTYPE OSAL_SemaphorePost(OMX_HANDLETYPE semaphoreHandle);
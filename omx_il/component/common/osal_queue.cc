@@ -0,0 +1,281 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "OMX_Def.h"
+
+#include "osal_event.h"
+#include "osal_queue.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "OSAL_QUEUE"
+#endif
+
+#define QUEUE_CACHE_LINE    64
+#define QUEUE_SPIN_COUNT    200
+
+typedef struct _OSAL_QUEUE_CELL {
+    OMX_U32 sequence;
+    OMX_PTR data;
+} OSAL_QUEUE_CELL;
+
+typedef struct _OSAL_QUEUE {
+    OSAL_QUEUE_CELL *cells;
+    OMX_U32          mask;
+    OMX_BOOL         bSingleProducer;
+
+    /* producer and consumer cursors live on separate cache lines */
+    OMX_U32          enqueuePos __attribute__((aligned(QUEUE_CACHE_LINE)));
+    OMX_U32          dequeuePos __attribute__((aligned(QUEUE_CACHE_LINE)));
+
+    int32_t          elemNum __attribute__((aligned(QUEUE_CACHE_LINE)));
+    /* futex word of OSAL_QueueWait, bumped by enqueues seen by a waiter and by wakes */
+    int32_t          wakeSeq;
+    int32_t          wakePending;
+    int32_t          waiters;
+} OSAL_QUEUE;
+
+static inline long futex(int32_t *uaddr, int op, int32_t val, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+OMX_ERRORTYPE OSAL_QueueCreate(OMX_HANDLETYPE *queueHandle, OMX_U32 maxNumElem, OMX_BOOL bSingleProducer)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+    OSAL_QUEUE   *queue = NULL;
+    OMX_U32       size = 2;
+    OMX_U32       i = 0;
+
+    if (queueHandle == NULL || maxNumElem == 0) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+
+    while (size < maxNumElem)
+        size <<= 1;
+
+    if (posix_memalign((void **)&queue, QUEUE_CACHE_LINE, sizeof(OSAL_QUEUE))) {
+        ret = OMX_ErrorInsufficientResources;
+        goto EXIT;
+    }
+    memset(queue, 0, sizeof(OSAL_QUEUE));
+
+    queue->cells = (OSAL_QUEUE_CELL *)malloc(sizeof(OSAL_QUEUE_CELL) * size);
+    if (queue->cells == NULL) {
+        free(queue);
+        ret = OMX_ErrorInsufficientResources;
+        goto EXIT;
+    }
+
+    for (i = 0; i < size; i++) {
+        queue->cells[i].sequence = i;
+        queue->cells[i].data = NULL;
+    }
+    queue->mask = size - 1;
+    queue->bSingleProducer = bSingleProducer;
+
+    *queueHandle = (OMX_HANDLETYPE)queue;
+
+EXIT:
+    return ret;
+}
+
+OMX_ERRORTYPE OSAL_QueueTerminate(OMX_HANDLETYPE queueHandle)
+{
+    OSAL_QUEUE *queue = (OSAL_QUEUE *)queueHandle;
+
+    if (queue == NULL)
+        return OMX_ErrorBadParameter;
+
+    free(queue->cells);
+    free(queue);
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_Queue(OMX_HANDLETYPE queueHandle, OMX_PTR data)
+{
+    OSAL_QUEUE      *queue = (OSAL_QUEUE *)queueHandle;
+    OSAL_QUEUE_CELL *cell = NULL;
+    OMX_U32          pos, seq;
+    OMX_S32          diff;
+
+    if (queue == NULL)
+        return OMX_ErrorBadParameter;
+
+    pos = __atomic_load_n(&queue->enqueuePos, __ATOMIC_RELAXED);
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        seq  = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        diff = (OMX_S32)(seq - pos);
+        if (diff == 0) {
+            if (queue->bSingleProducer) {
+                __atomic_store_n(&queue->enqueuePos, pos + 1, __ATOMIC_RELAXED);
+                break;
+            }
+            if (__atomic_compare_exchange_n(&queue->enqueuePos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            /* slot still held by a consumer one lap behind, ring is full */
+            return OMX_ErrorInsufficientResources;
+        } else {
+            pos = __atomic_load_n(&queue->enqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->data = data;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    __atomic_add_fetch(&queue->elemNum, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&queue->waiters, __ATOMIC_SEQ_CST) > 0) {
+        __atomic_add_fetch(&queue->wakeSeq, 1, __ATOMIC_SEQ_CST);
+        futex(&queue->wakeSeq, FUTEX_WAKE_PRIVATE, 1, NULL);
+    }
+
+    return OMX_ErrorNone;
+}
+
+OMX_PTR OSAL_Dequeue(OMX_HANDLETYPE queueHandle)
+{
+    OSAL_QUEUE      *queue = (OSAL_QUEUE *)queueHandle;
+    OSAL_QUEUE_CELL *cell = NULL;
+    OMX_PTR          data = NULL;
+    OMX_U32          pos, seq;
+    OMX_S32          diff;
+
+    if (queue == NULL)
+        return NULL;
+
+    pos = __atomic_load_n(&queue->dequeuePos, __ATOMIC_RELAXED);
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        seq  = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        diff = (OMX_S32)(seq - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->dequeuePos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&queue->dequeuePos, __ATOMIC_RELAXED);
+        }
+    }
+
+    data = cell->data;
+    __atomic_store_n(&cell->sequence, pos + queue->mask + 1, __ATOMIC_RELEASE);
+    __atomic_sub_fetch(&queue->elemNum, 1, __ATOMIC_SEQ_CST);
+
+    return data;
+}
+
+OMX_S32 OSAL_GetElemNum(OMX_HANDLETYPE queueHandle)
+{
+    OSAL_QUEUE *queue = (OSAL_QUEUE *)queueHandle;
+    OMX_S32     num;
+
+    if (queue == NULL)
+        return -1;
+
+    num = __atomic_load_n(&queue->elemNum, __ATOMIC_ACQUIRE);
+    return (num > 0) ? num : 0;
+}
+
+OMX_ERRORTYPE OSAL_QueueWait(OMX_HANDLETYPE queueHandle, OMX_U32 ms)
+{
+    OSAL_QUEUE     *queue = (OSAL_QUEUE *)queueHandle;
+    OMX_ERRORTYPE   ret = OMX_ErrorNone;
+    struct timespec now, deadline, remain;
+    int32_t         seq;
+    int             spin;
+
+    if (queue == NULL)
+        return OMX_ErrorBadParameter;
+
+    /* a producer that is already running usually refills within a few hundred ns */
+    for (spin = 0; spin < QUEUE_SPIN_COUNT; spin++) {
+        if (__atomic_load_n(&queue->elemNum, __ATOMIC_ACQUIRE) > 0 ||
+            __atomic_load_n(&queue->wakePending, __ATOMIC_RELAXED) != 0)
+            break;
+    }
+
+    if (ms != DEF_MAX_WAIT_TIME) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec  += ms / 1000;
+        deadline.tv_nsec += (ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec  += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    __atomic_add_fetch(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+    for (;;) {
+        seq = __atomic_load_n(&queue->wakeSeq, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&queue->elemNum, __ATOMIC_SEQ_CST) > 0)
+            break;
+        if (__atomic_exchange_n(&queue->wakePending, 0, __ATOMIC_SEQ_CST) != 0)
+            break;
+
+        if (ms == DEF_MAX_WAIT_TIME) {
+            futex(&queue->wakeSeq, FUTEX_WAIT_PRIVATE, seq, NULL);
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        remain.tv_sec  = deadline.tv_sec - now.tv_sec;
+        remain.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+        if (remain.tv_nsec < 0) {
+            remain.tv_sec  -= 1;
+            remain.tv_nsec += 1000000000;
+        }
+        if (remain.tv_sec < 0) {
+            ret = OMX_ErrorTimeout;
+            break;
+        }
+
+        /* EAGAIN, EINTR and spurious wakeups all re-check the count */
+        futex(&queue->wakeSeq, FUTEX_WAIT_PRIVATE, seq, &remain);
+    }
+    __atomic_sub_fetch(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+
+    return ret;
+}
+
+OMX_ERRORTYPE OSAL_QueueWake(OMX_HANDLETYPE queueHandle)
+{
+    OSAL_QUEUE *queue = (OSAL_QUEUE *)queueHandle;
+
+    if (queue == NULL)
+        return OMX_ErrorBadParameter;
+
+    __atomic_store_n(&queue->wakePending, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&queue->wakeSeq, 1, __ATOMIC_SEQ_CST);
+    futex(&queue->wakeSeq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+
+    return OMX_ErrorNone;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _OSAL_QUEUE_H_
+#define _OSAL_QUEUE_H_
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+
+/*
+ * Bounded lock-free ring of pointers.
+ * Dequeue is safe from any thread, enqueue from one thread only when the
+ * queue is created with bSingleProducer set.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+OMX_ERRORTYPE OSAL_QueueCreate(OMX_HANDLETYPE *queueHandle, OMX_U32 maxNumElem, OMX_BOOL bSingleProducer);
+OMX_ERRORTYPE OSAL_QueueTerminate(OMX_HANDLETYPE queueHandle);
+OMX_ERRORTYPE OSAL_Queue(OMX_HANDLETYPE queueHandle, OMX_PTR data);
+OMX_PTR       OSAL_Dequeue(OMX_HANDLETYPE queueHandle);
+OMX_S32       OSAL_GetElemNum(OMX_HANDLETYPE queueHandle);
+/* blocks until an element is queued or OSAL_QueueWake is called, OMX_ErrorTimeout after ms */
+OMX_ERRORTYPE OSAL_QueueWait(OMX_HANDLETYPE queueHandle, OMX_U32 ms);
+/* ends one OSAL_QueueWait without an element, kept for the next wait when nobody waits */
+OMX_ERRORTYPE OSAL_QueueWake(OMX_HANDLETYPE queueHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OSAL_QUEUE_H_*/
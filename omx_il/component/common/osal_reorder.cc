@@ -0,0 +1,241 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "OMX_Def.h"
+
+#include "osal_reorder.h"
+#include "osal/mpp_log.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "OSAL_REORDER"
+#endif
+
+typedef struct _OSAL_REORDER_SLOT {
+    OSAL_REORDER_ENTRY entry;
+    OMX_U32            nSeq;        /* put sequence, 0 when the slot is empty */
+} OSAL_REORDER_SLOT;
+
+typedef struct _OSAL_REORDER_AGE {
+    OMX_TICKS          nTimeStamp;
+    OMX_U32            nSeq;
+} OSAL_REORDER_AGE;
+
+typedef struct _OSAL_REORDER {
+    pthread_mutex_t    mutex;
+    /* open addressing on the timestamp, at least twice nDepth slots */
+    OSAL_REORDER_SLOT *slots;
+    OMX_U32            nBits;
+    /* ring of the last nDepth puts, the head is the next one to expire */
+    OSAL_REORDER_AGE  *ages;
+    OMX_U32            nDepth;
+    OMX_U32            nAgeHead;
+    OMX_U32            nAgeCount;
+    OMX_U32            nSeq;
+    OMX_U32            nDropped;
+} OSAL_REORDER;
+
+static inline OMX_U32 OSAL_ReorderHash(OSAL_REORDER *reorder, OMX_TICKS nTimeStamp)
+{
+    return (OMX_U32)(((uint64_t)nTimeStamp * 0x9E3779B97F4A7C15ULL) >> (64 - reorder->nBits));
+}
+
+/*
+ * Inputs sharing a timestamp keep one entry each. Finds the entry put with
+ * nSeq, or with nSeq 0 the oldest entry of nTimeStamp, so equal timestamps
+ * are taken in put order.
+ */
+static OMX_S32 OSAL_ReorderFind(OSAL_REORDER *reorder, OMX_TICKS nTimeStamp, OMX_U32 nSeq)
+{
+    OMX_U32 mask = (1U << reorder->nBits) - 1;
+    OMX_U32 pos = OSAL_ReorderHash(reorder, nTimeStamp);
+    OMX_S32 found = -1;
+    OMX_U32 n;
+
+    for (n = 0; n <= mask; n++) {
+        OSAL_REORDER_SLOT *slot = &reorder->slots[pos];
+        if (slot->nSeq == 0)
+            break;
+        if (slot->entry.nTimeStamp == nTimeStamp) {
+            if (nSeq != 0) {
+                if (slot->nSeq == nSeq)
+                    return (OMX_S32)pos;
+            } else if (found < 0 ||
+                       (OMX_S32)(slot->nSeq - reorder->slots[found].nSeq) < 0) {
+                found = (OMX_S32)pos;
+            }
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    return found;
+}
+
+static void OSAL_ReorderRemove(OSAL_REORDER *reorder, OMX_U32 pos)
+{
+    OSAL_REORDER_SLOT *slots = reorder->slots;
+    OMX_U32            mask = (1U << reorder->nBits) - 1;
+    OMX_U32            next = pos;
+    OMX_U32            home;
+
+    /* backward shift deletion, same as the port fd map */
+    for (;;) {
+        next = (next + 1) & mask;
+        if (slots[next].nSeq == 0)
+            break;
+        home = OSAL_ReorderHash(reorder, slots[next].entry.nTimeStamp);
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            slots[pos] = slots[next];
+            pos = next;
+        }
+    }
+    memset(&slots[pos], 0, sizeof(OSAL_REORDER_SLOT));
+}
+
+OMX_ERRORTYPE OSAL_ReorderCreate(OMX_HANDLETYPE *reorderHandle, OMX_U32 nDepth)
+{
+    OSAL_REORDER *reorder = NULL;
+    OMX_U32       nBits = 1;
+
+    if (reorderHandle == NULL || nDepth == 0)
+        return OMX_ErrorBadParameter;
+
+    while ((1U << nBits) < nDepth * 2)
+        nBits++;
+
+    reorder = (OSAL_REORDER *)calloc(1, sizeof(OSAL_REORDER));
+    if (reorder == NULL)
+        return OMX_ErrorInsufficientResources;
+
+    reorder->slots = (OSAL_REORDER_SLOT *)calloc(1U << nBits, sizeof(OSAL_REORDER_SLOT));
+    reorder->ages = (OSAL_REORDER_AGE *)calloc(nDepth, sizeof(OSAL_REORDER_AGE));
+    if (reorder->slots == NULL || reorder->ages == NULL) {
+        free(reorder->slots);
+        free(reorder->ages);
+        free(reorder);
+        return OMX_ErrorInsufficientResources;
+    }
+    reorder->nBits = nBits;
+    reorder->nDepth = nDepth;
+    pthread_mutex_init(&reorder->mutex, NULL);
+
+    *reorderHandle = (OMX_HANDLETYPE)reorder;
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_ReorderTerminate(OMX_HANDLETYPE reorderHandle)
+{
+    OSAL_REORDER *reorder = (OSAL_REORDER *)reorderHandle;
+
+    if (reorder == NULL)
+        return OMX_ErrorBadParameter;
+
+    if (reorder->nDropped)
+        mpp_log("%d timestamps expired without output", reorder->nDropped);
+
+    pthread_mutex_destroy(&reorder->mutex);
+    free(reorder->slots);
+    free(reorder->ages);
+    free(reorder);
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_ReorderPut(OMX_HANDLETYPE reorderHandle, const OSAL_REORDER_ENTRY *entry)
+{
+    OSAL_REORDER      *reorder = (OSAL_REORDER *)reorderHandle;
+    OSAL_REORDER_AGE  *age = NULL;
+    OMX_U32            mask;
+    OMX_U32            pos;
+    OMX_S32            found;
+
+    if (reorder == NULL || entry == NULL)
+        return OMX_ErrorBadParameter;
+
+    mask = (1U << reorder->nBits) - 1;
+
+    pthread_mutex_lock(&reorder->mutex);
+
+    if (reorder->nAgeCount == reorder->nDepth) {
+        age = &reorder->ages[reorder->nAgeHead];
+        reorder->nAgeHead = (reorder->nAgeHead + 1) % reorder->nDepth;
+        reorder->nAgeCount--;
+        found = OSAL_ReorderFind(reorder, age->nTimeStamp, age->nSeq);
+        if (found >= 0) {
+            OSAL_ReorderRemove(reorder, found);
+            reorder->nDropped++;
+        }
+    }
+
+    if (++reorder->nSeq == 0)
+        reorder->nSeq = 1;
+
+    /* at most nDepth live entries in twice as many slots, an empty one exists */
+    pos = OSAL_ReorderHash(reorder, entry->nTimeStamp);
+    while (reorder->slots[pos].nSeq != 0)
+        pos = (pos + 1) & mask;
+    reorder->slots[pos].entry = *entry;
+    reorder->slots[pos].nSeq = reorder->nSeq;
+
+    age = &reorder->ages[(reorder->nAgeHead + reorder->nAgeCount) % reorder->nDepth];
+    age->nTimeStamp = entry->nTimeStamp;
+    age->nSeq = reorder->nSeq;
+    reorder->nAgeCount++;
+
+    pthread_mutex_unlock(&reorder->mutex);
+
+    return OMX_ErrorNone;
+}
+
+/* removes and returns the oldest entry put with nTimeStamp, OMX_FALSE if there is none */
+OMX_BOOL OSAL_ReorderTake(OMX_HANDLETYPE reorderHandle, OMX_TICKS nTimeStamp, OSAL_REORDER_ENTRY *entry)
+{
+    OSAL_REORDER *reorder = (OSAL_REORDER *)reorderHandle;
+    OMX_S32       found;
+
+    if (reorder == NULL || entry == NULL)
+        return OMX_FALSE;
+
+    pthread_mutex_lock(&reorder->mutex);
+    found = OSAL_ReorderFind(reorder, nTimeStamp, 0);
+    if (found >= 0) {
+        *entry = reorder->slots[found].entry;
+        OSAL_ReorderRemove(reorder, found);
+    }
+    pthread_mutex_unlock(&reorder->mutex);
+
+    return (found >= 0) ? OMX_TRUE : OMX_FALSE;
+}
+
+void OSAL_ReorderReset(OMX_HANDLETYPE reorderHandle)
+{
+    OSAL_REORDER *reorder = (OSAL_REORDER *)reorderHandle;
+
+    if (reorder == NULL)
+        return;
+
+    pthread_mutex_lock(&reorder->mutex);
+    memset(reorder->slots, 0, sizeof(OSAL_REORDER_SLOT) << reorder->nBits);
+    reorder->nAgeHead = 0;
+    reorder->nAgeCount = 0;
+    pthread_mutex_unlock(&reorder->mutex);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _OSAL_REORDER_H_
+#define _OSAL_REORDER_H_
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+
+/*
+ * Timestamp keyed map of what came with an input buffer, taken again when
+ * the frame with that timestamp leaves the codec in output order. Inputs
+ * with equal timestamps get an entry each and are taken first in, first
+ * out, flags and marks are never merged. Holds at most nDepth entries, the
+ * oldest one is dropped when a new one does not fit (frames the codec never
+ * outputs). Put and Take may be called from different threads.
+ */
+
+typedef struct _OSAL_REORDER_ENTRY {
+    OMX_TICKS      nTimeStamp;
+    OMX_U32        nFlags;
+    OMX_HANDLETYPE hMarkTargetComponent;
+    OMX_PTR        pMarkData;
+    OMX_U64        nSendTime;       /* us, CLOCK_MONOTONIC, when the codec took the input */
+} OSAL_REORDER_ENTRY;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+OMX_ERRORTYPE OSAL_ReorderCreate(OMX_HANDLETYPE *reorderHandle, OMX_U32 nDepth);
+OMX_ERRORTYPE OSAL_ReorderTerminate(OMX_HANDLETYPE reorderHandle);
+OMX_ERRORTYPE OSAL_ReorderPut(OMX_HANDLETYPE reorderHandle, const OSAL_REORDER_ENTRY *entry);
+OMX_BOOL      OSAL_ReorderTake(OMX_HANDLETYPE reorderHandle, OMX_TICKS nTimeStamp, OSAL_REORDER_ENTRY *entry);
+void          OSAL_ReorderReset(OMX_HANDLETYPE reorderHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OSAL_REORDER_H_ */
@@ -0,0 +1,309 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "OMX_Def.h"
+
+#include "osal_repack.h"
+#include "osal_thread.h"
+#include "osal/mpp_log.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "OSAL_REPACK"
+#endif
+
+struct _OSAL_REPACK;
+
+typedef struct _OSAL_REPACK_STRIPE {
+    struct _OSAL_REPACK *repack;
+    OMX_U8              *dst;
+    const OMX_U8        *src;
+    OMX_U32              nDstStride;
+    OMX_U32              nSrcStride;
+    OMX_U32              nWidth;
+    OMX_U32              nRows;
+    OMX_BOOL             bActive;
+} OSAL_REPACK_STRIPE;
+
+/*
+ * Each repacker owns its stripe workers, so one decoder never waits
+ * behind another one's copies and all of them are joined on terminate.
+ */
+typedef struct _OSAL_REPACK {
+    OMX_U32             nStripes;
+    pthread_t           worker[OSAL_REPACK_MAX_STRIPES];   /* [0] unused, stripe 0 runs on the caller */
+    OSAL_REPACK_STRIPE  stripe[OSAL_REPACK_MAX_STRIPES];
+    pthread_mutex_t     mutex;
+    pthread_cond_t      workCond;
+    pthread_cond_t      doneCond;
+    OMX_U32             nGeneration;                       /* bumped for every split plane */
+    OMX_U32             nPending;
+    OMX_BOOL            bStop;
+} OSAL_REPACK;
+
+/* one row through non-temporal stores, head and tail bytes by memcpy */
+static void OSAL_RepackRowStream(OMX_U8 *dst, const OMX_U8 *src, OMX_U32 len)
+{
+#if defined(__SSE2__)
+    OMX_U32 head = (OMX_U32)((16 - ((uintptr_t)dst & 15)) & 15);
+
+    if (head > len)
+        head = len;
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    len -= head;
+
+    for (; len >= 64; len -= 64, src += 64, dst += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src +  0));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+        _mm_stream_si128((__m128i *)(dst +  0), a);
+        _mm_stream_si128((__m128i *)(dst + 16), b);
+        _mm_stream_si128((__m128i *)(dst + 32), c);
+        _mm_stream_si128((__m128i *)(dst + 48), d);
+    }
+#elif defined(__aarch64__)
+    for (; len >= 64; len -= 64, src += 64, dst += 64) {
+        __asm__ __volatile__(
+            "ldp q0, q1, [%1]\n\t"
+            "ldp q2, q3, [%1, #32]\n\t"
+            "stnp q0, q1, [%0]\n\t"
+            "stnp q2, q3, [%0, #32]\n\t"
+            : : "r"(dst), "r"(src) : "v0", "v1", "v2", "v3", "memory");
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    /* armv7 has no non-temporal store, wide aligned stores and a read ahead keep the bus busy */
+    OMX_U32 head = (OMX_U32)((16 - ((uintptr_t)dst & 15)) & 15);
+
+    if (head > len)
+        head = len;
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    len -= head;
+
+    for (; len >= 64; len -= 64) {
+        __asm__ __volatile__(
+            "pld [%1, #256]\n\t"
+            "vld1.8 {d0-d3}, [%1]!\n\t"
+            "vld1.8 {d4-d7}, [%1]!\n\t"
+            "vst1.8 {d0-d3}, [%0:128]!\n\t"
+            "vst1.8 {d4-d7}, [%0:128]!\n\t"
+            : "+r"(dst), "+r"(src) : : "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "memory");
+    }
+#endif
+    memcpy(dst, src, len);
+}
+
+static void OSAL_RepackRows(OMX_U8 *dst, OMX_U32 nDstStride, const OMX_U8 *src, OMX_U32 nSrcStride,
+                            OMX_U32 nWidth, OMX_U32 nRows)
+{
+    OMX_U32 i = 0;
+
+    if (nWidth == 0 || nRows == 0)
+        return;
+
+    if (nDstStride == nWidth && nSrcStride == nWidth) {
+        memcpy(dst, src, (size_t)nWidth * nRows);
+        return;
+    }
+
+#if defined(__SSE2__) || defined(__aarch64__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+    if ((size_t)nWidth * nRows >= OSAL_REPACK_STREAM_BYTES) {
+        for (i = 0; i < nRows; i++) {
+            if (i + 2 < nRows)
+                __builtin_prefetch(src + 2 * (size_t)nSrcStride, 0, 0);
+            OSAL_RepackRowStream(dst, src, nWidth);
+            dst += nDstStride;
+            src += nSrcStride;
+        }
+#if defined(__SSE2__)
+        _mm_sfence();
+#else
+        __asm__ __volatile__("dmb ishst" : : : "memory");
+#endif
+        return;
+    }
+#endif
+
+    for (i = 0; i < nRows; i++) {
+        if (i + 2 < nRows)
+            __builtin_prefetch(src + 2 * (size_t)nSrcStride, 0, 0);
+        memcpy(dst, src, nWidth);
+        dst += nDstStride;
+        src += nSrcStride;
+    }
+}
+
+static void *OSAL_RepackWorker(void *arg)
+{
+    OSAL_REPACK_STRIPE *stripe = (OSAL_REPACK_STRIPE *)arg;
+    OSAL_REPACK        *repack = stripe->repack;
+    OSAL_THREAD_POLICY  policy;
+    OMX_U32             nGeneration = 0;
+
+    OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_COPY, &policy);
+    OSAL_ApplyThreadPolicy(0, &policy);
+
+    pthread_mutex_lock(&repack->mutex);
+    for (;;) {
+        while (!repack->bStop && repack->nGeneration == nGeneration)
+            pthread_cond_wait(&repack->workCond, &repack->mutex);
+        if (repack->bStop)
+            break;
+        nGeneration = repack->nGeneration;
+        if (!stripe->bActive)
+            continue;
+        pthread_mutex_unlock(&repack->mutex);
+
+        OSAL_RepackRows(stripe->dst, stripe->nDstStride, stripe->src, stripe->nSrcStride,
+                        stripe->nWidth, stripe->nRows);
+
+        pthread_mutex_lock(&repack->mutex);
+        stripe->bActive = OMX_FALSE;
+        if (--repack->nPending == 0)
+            pthread_cond_signal(&repack->doneCond);
+    }
+    pthread_mutex_unlock(&repack->mutex);
+
+    return NULL;
+}
+
+OMX_ERRORTYPE OSAL_RepackCreate(OMX_HANDLETYPE *repackHandle, OMX_U32 nStripes)
+{
+    OSAL_REPACK *repack = NULL;
+    OMX_U32      i = 0;
+
+    if (repackHandle == NULL)
+        return OMX_ErrorBadParameter;
+
+    if (nStripes < 1)
+        nStripes = 1;
+    if (nStripes > OSAL_REPACK_MAX_STRIPES)
+        nStripes = OSAL_REPACK_MAX_STRIPES;
+
+    repack = (OSAL_REPACK *)calloc(1, sizeof(OSAL_REPACK));
+    if (repack == NULL)
+        return OMX_ErrorInsufficientResources;
+
+    pthread_mutex_init(&repack->mutex, NULL);
+    pthread_cond_init(&repack->workCond, NULL);
+    pthread_cond_init(&repack->doneCond, NULL);
+
+    for (i = 1; i < nStripes; i++) {
+        repack->stripe[i].repack = repack;
+        if (pthread_create(&repack->worker[i], NULL, OSAL_RepackWorker, &repack->stripe[i]) != 0) {
+            mpp_err("repack worker create fail, repacking with %d stripes", (int)i);
+            break;
+        }
+    }
+    repack->nStripes = i;
+
+    *repackHandle = (OMX_HANDLETYPE)repack;
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_RepackTerminate(OMX_HANDLETYPE repackHandle)
+{
+    OSAL_REPACK *repack = (OSAL_REPACK *)repackHandle;
+    OMX_U32      i = 0;
+
+    if (repack == NULL)
+        return OMX_ErrorBadParameter;
+
+    pthread_mutex_lock(&repack->mutex);
+    repack->bStop = OMX_TRUE;
+    pthread_cond_broadcast(&repack->workCond);
+    pthread_mutex_unlock(&repack->mutex);
+
+    for (i = 1; i < repack->nStripes; i++)
+        pthread_join(repack->worker[i], NULL);
+
+    pthread_cond_destroy(&repack->doneCond);
+    pthread_cond_destroy(&repack->workCond);
+    pthread_mutex_destroy(&repack->mutex);
+    free(repack);
+
+    return OMX_ErrorNone;
+}
+
+OMX_BOOL OSAL_RepackLayoutMatches(OMX_S32 nShareFd, OMX_U32 nStride, OMX_U32 nSize,
+                                  OMX_U32 nHorStride, OMX_U32 nVerStride)
+{
+    if (nShareFd <= 0 || nStride != nHorStride)
+        return OMX_FALSE;
+    if (nSize && nSize < nHorStride * nVerStride * 3 / 2)
+        return OMX_FALSE;
+
+    return OMX_TRUE;
+}
+
+void OSAL_RepackPlane(OMX_HANDLETYPE repackHandle,
+                      OMX_U8 *dst, OMX_U32 nDstStride,
+                      const OMX_U8 *src, OMX_U32 nSrcStride,
+                      OMX_U32 nWidth, OMX_U32 nRows)
+{
+    OSAL_REPACK *repack = (OSAL_REPACK *)repackHandle;
+    OMX_U32      nStripeRows = 0;
+    OMX_U32      nRow = 0;
+    OMX_U32      i = 0;
+
+    if (repack == NULL || repack->nStripes < 2 ||
+        (size_t)nWidth * nRows < OSAL_REPACK_SPLIT_BYTES) {
+        OSAL_RepackRows(dst, nDstStride, src, nSrcStride, nWidth, nRows);
+        return;
+    }
+
+    nStripeRows = (nRows + repack->nStripes - 1) / repack->nStripes;
+
+    /* the workers are idle here, the previous plane waited for all of them */
+    pthread_mutex_lock(&repack->mutex);
+    for (i = 1, nRow = nStripeRows; i < repack->nStripes && nRow < nRows; i++, nRow += nStripeRows) {
+        OSAL_REPACK_STRIPE *stripe = &repack->stripe[i];
+
+        stripe->dst        = dst + (size_t)nRow * nDstStride;
+        stripe->src        = src + (size_t)nRow * nSrcStride;
+        stripe->nDstStride = nDstStride;
+        stripe->nSrcStride = nSrcStride;
+        stripe->nWidth     = nWidth;
+        stripe->nRows      = (nRows - nRow < nStripeRows) ? (nRows - nRow) : nStripeRows;
+        stripe->bActive    = OMX_TRUE;
+        repack->nPending++;
+    }
+    repack->nGeneration++;
+    pthread_cond_broadcast(&repack->workCond);
+    pthread_mutex_unlock(&repack->mutex);
+
+    OSAL_RepackRows(dst, nDstStride, src, nSrcStride, nWidth, nStripeRows);
+
+    pthread_mutex_lock(&repack->mutex);
+    while (repack->nPending > 0)
+        pthread_cond_wait(&repack->doneCond, &repack->mutex);
+    pthread_mutex_unlock(&repack->mutex);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _OSAL_REPACK_H_
+#define _OSAL_REPACK_H_
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+
+/*
+ * Copies of a plane between different row pitches. Planes with matching
+ * pitches go in one memcpy; otherwise rows are prefetched and, above
+ * OSAL_REPACK_STREAM_BYTES, written with non-temporal stores so a 4K frame
+ * does not evict the cache (armv7 NEON has none, it uses 64 byte vld1/vst1
+ * blocks behind a pld). A repacker created with more than one stripe
+ * splits planes above OSAL_REPACK_SPLIT_BYTES over worker threads of its
+ * own, the calling thread copies the first stripe itself.
+ */
+#define OSAL_REPACK_MAX_STRIPES     4
+#define OSAL_REPACK_SPLIT_BYTES     (2 << 20)
+#define OSAL_REPACK_STREAM_BYTES    (1 << 20)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+OMX_ERRORTYPE OSAL_RepackCreate(OMX_HANDLETYPE *repackHandle, OMX_U32 nStripes);
+OMX_ERRORTYPE OSAL_RepackTerminate(OMX_HANDLETYPE repackHandle);
+/*
+ * NV12 buffer the decoder can write into at nHorStride x nVerStride, so no
+ * repack is needed: dma-buf backed, same stride and large enough. An
+ * nSize of 0 is unknown and accepted.
+ */
+OMX_BOOL      OSAL_RepackLayoutMatches(OMX_S32 nShareFd, OMX_U32 nStride, OMX_U32 nSize,
+                                       OMX_U32 nHorStride, OMX_U32 nVerStride);
+/* repackHandle may be NULL, the copy then stays on the calling thread */
+void          OSAL_RepackPlane(OMX_HANDLETYPE repackHandle,
+                               OMX_U8 *dst, OMX_U32 nDstStride,
+                               const OMX_U8 *src, OMX_U32 nSrcStride,
+                               OMX_U32 nWidth, OMX_U32 nRows);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OSAL_REPACK_H_ */
@@ -65,6 +65,7 @@ OMX_S32 rga_dev_open(void **rga_ctx)
     ctx->rga_fd = open("/dev/rga", O_RDWR, 0);
     if (ctx->rga_fd < 0) {
         mpp_err("rga open fail");
+        mpp_free(ctx);
         return -1;
     }
     *rga_ctx = ctx;
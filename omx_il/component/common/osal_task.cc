@@ -0,0 +1,371 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "OMX_Def.h"
+
+#include "osal_task.h"
+#include "osal_thread.h"
+#include "osal/mpp_log.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "OSAL_TASK"
+#endif
+
+typedef struct _OSAL_TASK {
+    OSAL_TASK_FUNC      func;
+    OMX_PTR             pTaskData;
+    struct _OSAL_TASK  *next;
+} OSAL_TASK;
+
+typedef struct _OSAL_SERIALQUEUE {
+    struct _OSAL_TASKPOOL     *pool;
+    OSAL_TASK                 *head;
+    OSAL_TASK                 *tail;
+    OSAL_TASK                 *taskSlab;       /* nTasks nodes allocated with the queue */
+    OMX_U32                    nTasks;
+    OSAL_TASK                 *freeHead;       /* recycled nodes, slab and overflow */
+    OMX_BOOL                   bScheduled;     /* on the ready list or running on a worker */
+    OMX_BOOL                   bTerminating;
+    struct _OSAL_SERIALQUEUE  *next;           /* ready list link */
+} OSAL_SERIALQUEUE;
+
+typedef struct _OSAL_TASKWORKER {
+    pthread_t                  thread;
+    struct _OSAL_TASKPOOL     *pool;
+    OMX_BOOL                   bExited;        /* returned, waiting to be joined */
+    struct _OSAL_TASKWORKER   *next;
+} OSAL_TASKWORKER;
+
+typedef struct _OSAL_TASKPOOL {
+    pthread_mutex_t     mutex;
+    pthread_cond_t      workCond;              /* a serial queue became ready */
+    pthread_cond_t      drainCond;             /* a serial queue ran out of tasks, a worker exited */
+    OSAL_SERIALQUEUE   *readyHead;
+    OSAL_SERIALQUEUE   *readyTail;
+    OSAL_TASKWORKER    *workers;
+    OMX_U32             nMaxWorkers;
+    OMX_U32             nWorkers;
+    OMX_U32             nIdle;
+    OMX_U32             nQueues;
+    OMX_BOOL            bShutdown;
+} OSAL_TASKPOOL;
+
+static OSAL_TASKPOOL  gTaskPool[OSAL_TASK_POOL_NUM];
+static pthread_once_t gTaskPoolOnce = PTHREAD_ONCE_INIT;
+
+static const OMX_U32  gTaskPoolMaxWorkers[OSAL_TASK_POOL_NUM] = {
+    OSAL_TASK_MAX_COMMAND_WORKERS,          /* OSAL_TASK_POOL_COMMAND */
+    OSAL_TASK_MAX_WORKERS,                  /* OSAL_TASK_POOL_CALLBACK */
+    OSAL_TASK_MAX_CODEC_WORKERS,            /* OSAL_TASK_POOL_CODEC */
+};
+
+static void OSAL_TaskPoolInit(void)
+{
+    pthread_condattr_t attr;
+    int                i = 0;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    for (i = 0; i < OSAL_TASK_POOL_NUM; i++) {
+        pthread_mutex_init(&gTaskPool[i].mutex, NULL);
+        pthread_cond_init(&gTaskPool[i].workCond, &attr);
+        pthread_cond_init(&gTaskPool[i].drainCond, NULL);
+        gTaskPool[i].nMaxWorkers = gTaskPoolMaxWorkers[i];
+    }
+    pthread_condattr_destroy(&attr);
+}
+
+/* called with the pool mutex held */
+static void OSAL_TaskPoolPushReady(OSAL_TASKPOOL *pool, OSAL_SERIALQUEUE *queue)
+{
+    queue->next = NULL;
+    if (pool->readyTail)
+        pool->readyTail->next = queue;
+    else
+        pool->readyHead = queue;
+    pool->readyTail = queue;
+}
+
+/* called with the pool mutex held, exited workers no longer need it */
+static void OSAL_TaskPoolReap(OSAL_TASKPOOL *pool)
+{
+    OSAL_TASKWORKER **link = &pool->workers;
+    OSAL_TASKWORKER  *worker = NULL;
+
+    while ((worker = *link) != NULL) {
+        if (worker->bExited) {
+            *link = worker->next;
+            pthread_join(worker->thread, NULL);
+            free(worker);
+        } else {
+            link = &worker->next;
+        }
+    }
+}
+
+static void *OSAL_TaskWorker(void *arg)
+{
+    OSAL_TASKWORKER   *worker = (OSAL_TASKWORKER *)arg;
+    OSAL_TASKPOOL     *pool = worker->pool;
+    OSAL_SERIALQUEUE  *queue = NULL;
+    OSAL_TASK         *task = NULL;
+    OSAL_THREAD_POLICY policy;
+    struct timespec    deadline;
+    int                err = 0;
+
+    OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_WORKER, &policy);
+    OSAL_ApplyThreadPolicy(0, &policy);
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        if (pool->readyHead == NULL) {
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += OSAL_TASK_IDLE_TIME_MS / 1000;
+
+            err = 0;
+            pool->nIdle++;
+            while (pool->readyHead == NULL && !pool->bShutdown && err != ETIMEDOUT)
+                err = pthread_cond_timedwait(&pool->workCond, &pool->mutex, &deadline);
+            pool->nIdle--;
+
+            if (pool->readyHead == NULL)
+                break;
+        }
+
+        queue = pool->readyHead;
+        pool->readyHead = queue->next;
+        if (pool->readyHead == NULL)
+            pool->readyTail = NULL;
+
+        task = queue->head;
+        queue->head = task->next;
+        if (queue->head == NULL)
+            queue->tail = NULL;
+        pthread_mutex_unlock(&pool->mutex);
+
+        task->func(task->pTaskData);
+
+        pthread_mutex_lock(&pool->mutex);
+        task->next = queue->freeHead;
+        queue->freeHead = task;
+        if (queue->head) {
+            /* one task per turn, so a busy queue cannot starve the others */
+            OSAL_TaskPoolPushReady(pool, queue);
+        } else {
+            queue->bScheduled = OMX_FALSE;
+            if (queue->bTerminating)
+                pthread_cond_broadcast(&pool->drainCond);
+        }
+    }
+    pool->nWorkers--;
+    worker->bExited = OMX_TRUE;
+    pthread_cond_broadcast(&pool->drainCond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/* called with the pool mutex held */
+static void OSAL_TaskPoolWake(OSAL_TASKPOOL *pool)
+{
+    OSAL_TASKWORKER *worker = NULL;
+
+    if (pool->nIdle > 0) {
+        pthread_cond_signal(&pool->workCond);
+        return;
+    }
+    /* the ready queue waits for a worker to finish its task */
+    if (pool->nWorkers >= pool->nMaxWorkers)
+        return;
+
+    OSAL_TaskPoolReap(pool);
+
+    worker = (OSAL_TASKWORKER *)malloc(sizeof(OSAL_TASKWORKER));
+    if (worker == NULL) {
+        mpp_err("alloc task worker failed, %d workers running", pool->nWorkers);
+        return;
+    }
+    worker->pool = pool;
+    worker->bExited = OMX_FALSE;
+
+    if (pthread_create(&worker->thread, NULL, OSAL_TaskWorker, worker) == 0) {
+        worker->next = pool->workers;
+        pool->workers = worker;
+        pool->nWorkers++;
+    } else {
+        mpp_err("create task worker failed, %d workers running", pool->nWorkers);
+        free(worker);
+    }
+}
+
+/*
+ * Called with the pool mutex held once the last serial queue is gone.
+ * Joins every worker so nothing of the pool runs when the library that
+ * holds it is unloaded. A worker terminating the last queue of its own
+ * pool leaves the workers to the idle timeout instead.
+ */
+static void OSAL_TaskPoolShutdown(OSAL_TASKPOOL *pool)
+{
+    OSAL_TASKWORKER *worker = NULL;
+    OSAL_TASKWORKER *workers = NULL;
+
+    for (worker = pool->workers; worker; worker = worker->next) {
+        if (!worker->bExited && pthread_equal(worker->thread, pthread_self())) {
+            mpp_log("last serial queue terminated from its own pool, workers left running");
+            return;
+        }
+    }
+
+    pool->bShutdown = OMX_TRUE;
+    pthread_cond_broadcast(&pool->workCond);
+    while (pool->nWorkers > 0)
+        pthread_cond_wait(&pool->drainCond, &pool->mutex);
+
+    workers = pool->workers;
+    pool->workers = NULL;
+    pool->bShutdown = OMX_FALSE;
+    pthread_cond_broadcast(&pool->drainCond);
+
+    while ((worker = workers) != NULL) {
+        workers = worker->next;
+        pthread_join(worker->thread, NULL);
+        free(worker);
+    }
+}
+
+OMX_ERRORTYPE OSAL_SerialQueueCreate(OMX_HANDLETYPE *serialHandle, OSAL_TASK_POOL_TYPE poolType, OMX_U32 nTasks)
+{
+    OSAL_SERIALQUEUE *queue = NULL;
+    OSAL_TASKPOOL    *pool = NULL;
+    OMX_U32           i = 0;
+
+    if (serialHandle == NULL || poolType < 0 || poolType >= OSAL_TASK_POOL_NUM)
+        return OMX_ErrorBadParameter;
+
+    pthread_once(&gTaskPoolOnce, OSAL_TaskPoolInit);
+
+    if (nTasks == 0)
+        nTasks = 1;
+
+    /* the queue and its task nodes in one allocation */
+    queue = (OSAL_SERIALQUEUE *)malloc(sizeof(OSAL_SERIALQUEUE) + sizeof(OSAL_TASK) * nTasks);
+    if (queue == NULL)
+        return OMX_ErrorInsufficientResources;
+    memset(queue, 0, sizeof(OSAL_SERIALQUEUE));
+
+    queue->taskSlab = (OSAL_TASK *)(queue + 1);
+    queue->nTasks = nTasks;
+    for (i = 0; i < nTasks; i++) {
+        queue->taskSlab[i].next = queue->freeHead;
+        queue->freeHead = &queue->taskSlab[i];
+    }
+
+    pool = &gTaskPool[poolType];
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->bShutdown)
+        pthread_cond_wait(&pool->drainCond, &pool->mutex);
+    pool->nQueues++;
+    pthread_mutex_unlock(&pool->mutex);
+    queue->pool = pool;
+
+    *serialHandle = (OMX_HANDLETYPE)queue;
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_SerialQueueTerminate(OMX_HANDLETYPE serialHandle)
+{
+    OSAL_SERIALQUEUE *queue = (OSAL_SERIALQUEUE *)serialHandle;
+    OSAL_TASKPOOL    *pool = NULL;
+    OSAL_TASK        *task = NULL;
+
+    if (queue == NULL)
+        return OMX_ErrorBadParameter;
+
+    pool = queue->pool;
+    pthread_mutex_lock(&pool->mutex);
+    queue->bTerminating = OMX_TRUE;
+    while (queue->bScheduled)
+        pthread_cond_wait(&pool->drainCond, &pool->mutex);
+    if (--pool->nQueues == 0)
+        OSAL_TaskPoolShutdown(pool);
+    pthread_mutex_unlock(&pool->mutex);
+
+    while ((task = queue->freeHead) != NULL) {
+        queue->freeHead = task->next;
+        if (task < queue->taskSlab || task >= queue->taskSlab + queue->nTasks)
+            free(task);
+    }
+    free(queue);
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_SerialQueueSubmit(OMX_HANDLETYPE serialHandle, OSAL_TASK_FUNC func, OMX_PTR pTaskData)
+{
+    OSAL_SERIALQUEUE *queue = (OSAL_SERIALQUEUE *)serialHandle;
+    OSAL_TASK        *task = NULL;
+    OMX_ERRORTYPE     ret = OMX_ErrorNone;
+
+    if (queue == NULL || func == NULL)
+        return OMX_ErrorBadParameter;
+
+    pthread_mutex_lock(&queue->pool->mutex);
+    if (queue->bTerminating) {
+        ret = OMX_ErrorIncorrectStateOperation;
+        goto EXIT;
+    }
+
+    task = queue->freeHead;
+    if (task != NULL) {
+        queue->freeHead = task->next;
+    } else {
+        /* more tasks in flight than the queue was sized for, kept on the free list afterwards */
+        task = (OSAL_TASK *)malloc(sizeof(OSAL_TASK));
+        if (task == NULL) {
+            ret = OMX_ErrorInsufficientResources;
+            goto EXIT;
+        }
+    }
+
+    task->func = func;
+    task->pTaskData = pTaskData;
+    task->next = NULL;
+
+    if (queue->tail)
+        queue->tail->next = task;
+    else
+        queue->head = task;
+    queue->tail = task;
+
+    if (!queue->bScheduled) {
+        queue->bScheduled = OMX_TRUE;
+        OSAL_TaskPoolPushReady(queue->pool, queue);
+        OSAL_TaskPoolWake(queue->pool);
+    }
+
+EXIT:
+    pthread_mutex_unlock(&queue->pool->mutex);
+
+    return ret;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _OSAL_TASK_H_
+#define _OSAL_TASK_H_
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+
+/*
+ * Process wide worker pools. Work is submitted to serial queues: tasks of
+ * one serial queue run one at a time in submission order, tasks of
+ * different serial queues run in parallel on the workers of their pool, up
+ * to the cap of the pool. Workers are started on demand and exit after
+ * being idle for OSAL_TASK_IDLE_TIME_MS. They are joined when the last
+ * serial queue of their pool is terminated.
+ */
+#define OSAL_TASK_MAX_WORKERS       4
+#define OSAL_TASK_IDLE_TIME_MS      2000
+
+/*
+ * Command tasks only block in transitions of components that hold a codec
+ * resource, and codec loops run while it is held, two per component. Both
+ * caps cover the resource manager limits, Foilplanet_OMX_Resourcemanager.cc
+ * checks that at build time.
+ */
+#define OSAL_TASK_MAX_COMMAND_WORKERS   16
+#define OSAL_TASK_MAX_CODEC_WORKERS     24
+
+typedef void (*OSAL_TASK_FUNC)(OMX_PTR pTaskData);
+
+/*
+ * command tasks may block until buffers come back through client
+ * callbacks, so callbacks are dispatched from a pool of their own. A codec
+ * loop holds its worker until the component leaves Idle.
+ */
+typedef enum _OSAL_TASK_POOL_TYPE {
+    OSAL_TASK_POOL_COMMAND = 0,
+    OSAL_TASK_POOL_CALLBACK,
+    OSAL_TASK_POOL_CODEC,
+    OSAL_TASK_POOL_NUM,
+} OSAL_TASK_POOL_TYPE;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* nTasks task nodes are preallocated, sized for the tasks the queue usually has in flight */
+OMX_ERRORTYPE OSAL_SerialQueueCreate(OMX_HANDLETYPE *serialHandle, OSAL_TASK_POOL_TYPE poolType, OMX_U32 nTasks);
+/*
+ * runs the pending tasks, must not be called from a task of the same queue.
+ * The last queue of a pool joins the pool workers before it returns.
+ */
+OMX_ERRORTYPE OSAL_SerialQueueTerminate(OMX_HANDLETYPE serialHandle);
+OMX_ERRORTYPE OSAL_SerialQueueSubmit(OMX_HANDLETYPE serialHandle, OSAL_TASK_FUNC func, OMX_PTR pTaskData);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OSAL_TASK_H_*/
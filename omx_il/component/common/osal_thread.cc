@@ -0,0 +1,260 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <cutils/properties.h>
+
+#include "osal_thread.h"
+#include "osal/mpp_log.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "OSAL_THREAD"
+#endif
+
+/* cpu masks are OMX_U32, cpus past its low 32 bits are never placed */
+#define OSAL_THREAD_MAX_CPUS    32
+typedef char OSAL_THREAD_MASK_FITS[(OSAL_THREAD_MAX_CPUS <= sizeof(OMX_U32) * 8) ? 1 : -1];
+
+/* ANDROID_PRIORITY_VIDEO */
+#define OSAL_THREAD_NICE_VIDEO  -10
+
+static const char *gThreadRoleName[OSAL_THREAD_ROLE_NUM] = {
+    "control",
+    "copy",
+    "worker",
+};
+
+static OMX_U32        gBigClusterMask = 0;
+static pthread_once_t gBigClusterOnce = PTHREAD_ONCE_INIT;
+
+OMX_U32 OSAL_BigClusterMask(const OMX_U32 *pMaxFreq, OMX_U32 nCpus)
+{
+    OMX_U32 maxFreq = 0, minFreq = 0, mask = 0;
+    OMX_U32 i = 0;
+
+    if (nCpus > OSAL_THREAD_MAX_CPUS)
+        nCpus = OSAL_THREAD_MAX_CPUS;
+
+    for (i = 0; i < nCpus; i++) {
+        if (pMaxFreq[i] > maxFreq)
+            maxFreq = pMaxFreq[i];
+        if (i == 0 || pMaxFreq[i] < minFreq)
+            minFreq = pMaxFreq[i];
+    }
+    if (maxFreq == minFreq)
+        return 0;
+
+    for (i = 0; i < nCpus; i++) {
+        if (pMaxFreq[i] == maxFreq)
+            mask |= (OMX_U32)1 << i;
+    }
+    return mask;
+}
+
+static void OSAL_FindBigCluster(void)
+{
+    OMX_U32 freq[OSAL_THREAD_MAX_CPUS];
+    char    path[128];
+    FILE   *fp = NULL;
+    int     i = 0;
+
+    for (i = 0; i < OSAL_THREAD_MAX_CPUS; i++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", i);
+        fp = fopen(path, "r");
+        if (fp == NULL)
+            break;
+        if (fscanf(fp, "%lu", &freq[i]) != 1)
+            freq[i] = 0;
+        fclose(fp);
+    }
+
+    gBigClusterMask = OSAL_BigClusterMask(freq, (OMX_U32)i);
+    if (gBigClusterMask)
+        mpp_log("big cluster cpu mask 0x%lx", gBigClusterMask);
+}
+
+OMX_U32 OSAL_ParseCpuList(const char *list)
+{
+    OMX_U32       mask = 0;
+    char         *end = NULL;
+    unsigned long first = 0, last = 0;
+
+    if (list == NULL || *list == '\0')
+        return 0;
+
+    if (!strncmp(list, "0x", 2)) {
+        first = strtoul(list + 2, &end, 16);
+        if (end == list + 2 || *end != '\0')
+            return 0;
+        return (OMX_U32)(first & 0xFFFFFFFFUL);
+    }
+
+    for (;;) {
+        /* strtoul would take a sign, cpu numbers start with a digit */
+        if (*list < '0' || *list > '9')
+            return 0;
+        first = strtoul(list, &end, 10);
+        last = first;
+        if (*end == '-') {
+            list = end + 1;
+            if (*list < '0' || *list > '9')
+                return 0;
+            last = strtoul(list, &end, 10);
+            if (last < first)
+                return 0;
+        }
+        for (; first <= last && first < OSAL_THREAD_MAX_CPUS; first++)
+            mask |= (OMX_U32)1 << first;
+        if (*end == '\0')
+            break;
+        if (*end != ',')
+            return 0;
+        list = end + 1;
+    }
+
+    return mask;
+}
+
+void OSAL_GetThreadPolicy(OSAL_THREAD_ROLE role, OSAL_THREAD_POLICY *policy)
+{
+    char key[PROPERTY_KEY_MAX];
+    char value[PROPERTY_VALUE_MAX];
+
+    if (policy == NULL || role < 0 || role >= OSAL_THREAD_ROLE_NUM)
+        return;
+
+    pthread_once(&gBigClusterOnce, OSAL_FindBigCluster);
+
+    memset(policy, 0, sizeof(OSAL_THREAD_POLICY));
+    switch (role) {
+    case OSAL_THREAD_ROLE_COPY:
+        /* row copies are cpu bound, keep them off the little cores */
+        policy->nCpuMask = gBigClusterMask;
+        policy->nNice = OSAL_THREAD_NICE_VIDEO;
+        break;
+    case OSAL_THREAD_ROLE_CONTROL:
+        /* short bursts that keep the vpu busy, any core will do */
+        policy->nNice = OSAL_THREAD_NICE_VIDEO;
+        break;
+    default:
+        policy->nNice = OSAL_THREAD_NICE_UNCHANGED;
+        break;
+    }
+
+    snprintf(key, sizeof(key), "vendor.omx.thread.%s.cpus", gThreadRoleName[role]);
+    if (property_get(key, value, NULL) > 0)
+        policy->nCpuMask = OSAL_ParseCpuList(value);
+    snprintf(key, sizeof(key), "vendor.omx.thread.%s.nice", gThreadRoleName[role]);
+    if (property_get(key, value, NULL) > 0)
+        policy->nNice = atoi(value);
+    snprintf(key, sizeof(key), "vendor.omx.thread.%s.fifo", gThreadRoleName[role]);
+    if (property_get(key, value, NULL) > 0)
+        policy->nFifoPriority = atoi(value);
+    snprintf(key, sizeof(key), "vendor.omx.thread.%s.cgroup", gThreadRoleName[role]);
+    if (property_get(key, value, NULL) > 0)
+        strncpy(policy->cCgroup, value, OSAL_THREAD_CGROUP_SIZE - 1);
+}
+
+OMX_U32 OSAL_ClampFifoPriority(OMX_U32 nPriority, OMX_U32 nCap)
+{
+    OMX_U32 nMin = (OMX_U32)sched_get_priority_min(SCHED_FIFO);
+    OMX_U32 nMax = (OMX_U32)sched_get_priority_max(SCHED_FIFO);
+
+    if (nPriority == 0)
+        return 0;
+    if (nCap < nMax)
+        nMax = nCap;
+    if (nPriority < nMin)
+        nPriority = nMin;
+    if (nPriority > nMax)
+        nPriority = nMax;
+    return nPriority;
+}
+
+pid_t OSAL_GetThreadId(void)
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+OMX_ERRORTYPE OSAL_ApplyThreadPolicy(pid_t tid, const OSAL_THREAD_POLICY *policy)
+{
+    OMX_ERRORTYPE      ret = OMX_ErrorNone;
+    cpu_set_t          cpus;
+    struct sched_param param;
+    char               path[OSAL_THREAD_CGROUP_SIZE + 8];
+    char               buf[16];
+    int                fd = -1, len = 0, i = 0;
+
+    if (policy == NULL)
+        return OMX_ErrorBadParameter;
+
+    if (tid == 0)
+        tid = OSAL_GetThreadId();
+
+    if (policy->cCgroup[0]) {
+        snprintf(path, sizeof(path), "%s/tasks", policy->cCgroup);
+        fd = open(path, O_WRONLY | O_CLOEXEC);
+        len = snprintf(buf, sizeof(buf), "%d", tid);
+        if (fd < 0 || write(fd, buf, len) != len) {
+            mpp_err("thread %d: join cgroup %s failed", tid, policy->cCgroup);
+            ret = OMX_ErrorInsufficientResources;
+        }
+        if (fd >= 0)
+            close(fd);
+    }
+
+    if (policy->nCpuMask) {
+        CPU_ZERO(&cpus);
+        for (i = 0; i < OSAL_THREAD_MAX_CPUS; i++) {
+            if (policy->nCpuMask & ((OMX_U32)1 << i))
+                CPU_SET(i, &cpus);
+        }
+        if (sched_setaffinity(tid, sizeof(cpus), &cpus)) {
+            mpp_err("thread %d: set cpu mask 0x%lx failed", tid, policy->nCpuMask);
+            ret = OMX_ErrorInsufficientResources;
+        }
+    }
+
+    if (policy->nFifoPriority) {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = OSAL_ClampFifoPriority(policy->nFifoPriority, OSAL_THREAD_FIFO_MAX);
+        if (sched_setscheduler(tid, SCHED_FIFO, &param)) {
+            mpp_err("thread %d: set SCHED_FIFO %d failed", tid, param.sched_priority);
+            ret = OMX_ErrorInsufficientResources;
+        }
+    } else {
+        if (sched_getscheduler(tid) == SCHED_FIFO) {
+            memset(&param, 0, sizeof(param));
+            sched_setscheduler(tid, SCHED_OTHER, &param);
+        }
+        if (policy->nNice != OSAL_THREAD_NICE_UNCHANGED &&
+            setpriority(PRIO_PROCESS, tid, policy->nNice)) {
+            mpp_err("thread %d: set nice %ld failed", tid, policy->nNice);
+            ret = OMX_ErrorInsufficientResources;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _OSAL_THREAD_H_
+#define _OSAL_THREAD_H_
+
+#include <sys/types.h>
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+
+/*
+ * Thread placement per role. Defaults can be overridden with the
+ * properties vendor.omx.thread.<role>.{cpus,nice,fifo,cgroup}, where
+ * <role> is control, copy or worker, e.g.
+ *   vendor.omx.thread.copy.cpus   = 4-5
+ *   vendor.omx.thread.copy.nice   = -10
+ *   vendor.omx.thread.copy.fifo   = 0      (1..99 selects SCHED_FIFO)
+ *   vendor.omx.thread.copy.cgroup = /dev/cpuset/foreground
+ */
+#define OSAL_THREAD_NICE_UNCHANGED  0x7FFFFFFF
+#define OSAL_THREAD_CGROUP_SIZE     64
+
+/*
+ * SCHED_FIFO caps, properties up to the scheduler maximum. A policy set by
+ * an OMX client stays below the audio and display threads, and may not
+ * name a cgroup, those only come from properties.
+ */
+#define OSAL_THREAD_FIFO_MAX        99
+#define OSAL_THREAD_FIFO_CONFIG_MAX 1
+
+typedef enum _OSAL_THREAD_ROLE {
+    OSAL_THREAD_ROLE_CONTROL = 0,   /* feeds or drains the vpu, little cpu work */
+    OSAL_THREAD_ROLE_COPY,          /* frame copies and colour conversion */
+    OSAL_THREAD_ROLE_WORKER,        /* shared command and callback workers */
+    OSAL_THREAD_ROLE_NUM,
+} OSAL_THREAD_ROLE;
+
+typedef struct _OSAL_THREAD_POLICY {
+    OMX_U32 nCpuMask;               /* 0: any cpu */
+    OMX_S32 nNice;                  /* OSAL_THREAD_NICE_UNCHANGED: keep */
+    OMX_U32 nFifoPriority;          /* 0: SCHED_OTHER */
+    char    cCgroup[OSAL_THREAD_CGROUP_SIZE];   /* empty: keep */
+} OSAL_THREAD_POLICY;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void OSAL_GetThreadPolicy(OSAL_THREAD_ROLE role, OSAL_THREAD_POLICY *policy);
+/* "4-5", "0,2,3" or "0x30"; 0 for a malformed list, cpus past the mask are dropped */
+OMX_U32 OSAL_ParseCpuList(const char *list);
+/* the cpus with the highest max frequency, 0 when all cores are alike */
+OMX_U32 OSAL_BigClusterMask(const OMX_U32 *pMaxFreq, OMX_U32 nCpus);
+/* 0 stays 0 (SCHED_OTHER), anything else is moved into [fifo min, min(fifo max, nCap)] */
+OMX_U32 OSAL_ClampFifoPriority(OMX_U32 nPriority, OMX_U32 nCap);
+/* tid 0 applies the policy to the calling thread */
+OMX_ERRORTYPE OSAL_ApplyThreadPolicy(pid_t tid, const OSAL_THREAD_POLICY *policy);
+pid_t OSAL_GetThreadId(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OSAL_THREAD_H_ */
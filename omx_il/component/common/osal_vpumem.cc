@@ -0,0 +1,297 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <cutils/properties.h>
+
+#include "OMX_Def.h"
+
+#include "osal_vpumem.h"
+#include "osal/mpp_log.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "OSAL_VPUMEM"
+#endif
+
+typedef struct _OSAL_VPUMEM_BLOCK {
+    VPUMemLinear_t              vpumem;     /* first, handed out to callers */
+    OMX_U32                     nSize;      /* page rounded size actually allocated */
+    OMX_U32                     nRef;
+    OMX_U64                     nIdleSince; /* ms, CLOCK_MONOTONIC */
+    struct _OSAL_VPUMEM_BLOCK  *next;       /* cache link, most recently released first */
+} OSAL_VPUMEM_BLOCK;
+
+static pthread_mutex_t    gVpumemMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t     gVpumemCond;
+static pthread_once_t     gVpumemOnce = PTHREAD_ONCE_INIT;
+static OSAL_VPUMEM_BLOCK *gVpumemCache = NULL;
+static OMX_U32            gVpumemCachedBytes = 0;
+static OMX_U32            gVpumemIdleMs = OSAL_VPUMEM_IDLE_TIME_MS;
+
+/* frees idle blocks while the cache is not empty, joined by whoever starts the next one */
+static pthread_t          gVpumemReaper;
+static OMX_BOOL           gVpumemReaperRunning = OMX_FALSE;
+static OMX_BOOL           gVpumemReaperExited = OMX_FALSE;
+static OMX_BOOL           gVpumemStop = OMX_FALSE;
+
+static void OSAL_VpumemInit(void)
+{
+    pthread_condattr_t attr;
+    char               value[PROPERTY_VALUE_MAX];
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&gVpumemCond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (property_get("vendor.omx.vpumem.idle_ms", value, NULL) > 0 && atoi(value) > 0)
+        gVpumemIdleMs = atoi(value);
+}
+
+static OMX_U64 OSAL_VpumemNowMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (OMX_U64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void OSAL_VpumemFreeBlock(OSAL_VPUMEM_BLOCK *block)
+{
+    VPUFreeLinear(&block->vpumem);
+    free(block);
+}
+
+/*
+ * Unlinks idle blocks and the oldest ones above nKeepBytes, called with the
+ * mutex held. The blocks are returned as a list so they are freed unlocked.
+ */
+static OSAL_VPUMEM_BLOCK *OSAL_VpumemCollect(OMX_U32 nKeepBytes, OMX_U64 now)
+{
+    OSAL_VPUMEM_BLOCK **link = &gVpumemCache;
+    OSAL_VPUMEM_BLOCK  *freed = NULL;
+    OMX_U32             nKept = 0;
+
+    while (*link != NULL) {
+        OSAL_VPUMEM_BLOCK *block = *link;
+        if ((nKept + block->nSize > nKeepBytes) ||
+            (now - block->nIdleSince >= gVpumemIdleMs)) {
+            *link = block->next;
+            gVpumemCachedBytes -= block->nSize;
+            block->next = freed;
+            freed = block;
+        } else {
+            nKept += block->nSize;
+            link = &block->next;
+        }
+    }
+
+    return freed;
+}
+
+static void OSAL_VpumemFreeList(OSAL_VPUMEM_BLOCK *list)
+{
+    while (list != NULL) {
+        OSAL_VPUMEM_BLOCK *next = list->next;
+        OSAL_VpumemFreeBlock(list);
+        list = next;
+    }
+}
+
+static void *OSAL_VpumemReaper(void *)
+{
+    OSAL_VPUMEM_BLOCK *freed = NULL;
+    OSAL_VPUMEM_BLOCK *block = NULL;
+    struct timespec    deadline;
+    OMX_U64            oldest;
+
+    pthread_mutex_lock(&gVpumemMutex);
+    while (gVpumemCache != NULL && !gVpumemStop) {
+        /* the list is most recent first, the tail expires first */
+        for (block = gVpumemCache; block->next != NULL; block = block->next)
+            ;
+        oldest = block->nIdleSince + gVpumemIdleMs;
+        deadline.tv_sec = oldest / 1000;
+        deadline.tv_nsec = (oldest % 1000) * 1000000;
+        if (pthread_cond_timedwait(&gVpumemCond, &gVpumemMutex, &deadline) != ETIMEDOUT)
+            continue;
+
+        freed = OSAL_VpumemCollect(OSAL_VPUMEM_CACHE_MAX, OSAL_VpumemNowMs());
+        pthread_mutex_unlock(&gVpumemMutex);
+        OSAL_VpumemFreeList(freed);
+        pthread_mutex_lock(&gVpumemMutex);
+    }
+    gVpumemReaperRunning = OMX_FALSE;
+    gVpumemReaperExited = OMX_TRUE;
+    pthread_mutex_unlock(&gVpumemMutex);
+
+    return NULL;
+}
+
+/* called with the mutex held after a block went into the cache */
+static void OSAL_VpumemStartReaper(void)
+{
+    if (gVpumemReaperRunning || gVpumemStop)
+        return;
+
+    if (gVpumemReaperExited) {
+        pthread_join(gVpumemReaper, NULL);
+        gVpumemReaperExited = OMX_FALSE;
+    }
+    if (pthread_create(&gVpumemReaper, NULL, OSAL_VpumemReaper, NULL) == 0)
+        gVpumemReaperRunning = OMX_TRUE;
+    else
+        mpp_err("create vpumem reaper failed, idle blocks wait for the next acquire");
+}
+
+/* the cache outlives the components, give the CMA back when the library goes */
+static void __attribute__((destructor)) OSAL_VpumemShutdown(void)
+{
+    pthread_mutex_lock(&gVpumemMutex);
+    gVpumemStop = OMX_TRUE;
+    if (gVpumemReaperRunning || gVpumemReaperExited) {
+        pthread_cond_signal(&gVpumemCond);
+        pthread_mutex_unlock(&gVpumemMutex);
+        pthread_join(gVpumemReaper, NULL);
+        pthread_mutex_lock(&gVpumemMutex);
+        gVpumemReaperExited = OMX_FALSE;
+    }
+    pthread_mutex_unlock(&gVpumemMutex);
+
+    OSAL_VpumemTrim(0);
+}
+
+OMX_ERRORTYPE OSAL_VpumemAcquire(OMX_U32 nSize, VPUMemLinear_t **ppVpumem)
+{
+    OSAL_VPUMEM_BLOCK **link = NULL;
+    OSAL_VPUMEM_BLOCK **best = NULL;
+    OSAL_VPUMEM_BLOCK  *block = NULL;
+    OSAL_VPUMEM_BLOCK  *freed = NULL;
+    OMX_U32             nAlloc;
+    OMX_U32             nLimit;
+
+    if (ppVpumem == NULL || nSize == 0 || nSize > OSAL_VPUMEM_CACHE_MAX)
+        return OMX_ErrorBadParameter;
+
+    pthread_once(&gVpumemOnce, OSAL_VpumemInit);
+
+    nAlloc = (nSize + OSAL_VPUMEM_PAGE_SIZE - 1) & ~(OSAL_VPUMEM_PAGE_SIZE - 1);
+    /* do not hand a 4K block to a 720p session, a quarter of slack at most */
+    nLimit = nAlloc + nAlloc / 4;
+
+    pthread_mutex_lock(&gVpumemMutex);
+    for (link = &gVpumemCache; *link != NULL; link = &(*link)->next) {
+        OMX_U32 size = (*link)->nSize;
+        if (size >= nAlloc && size <= nLimit &&
+            (best == NULL || size < (*best)->nSize)) {
+            best = link;
+        }
+    }
+    if (best != NULL) {
+        block = *best;
+        *best = block->next;
+        gVpumemCachedBytes -= block->nSize;
+    }
+    freed = OSAL_VpumemCollect(OSAL_VPUMEM_CACHE_MAX, OSAL_VpumemNowMs());
+    pthread_mutex_unlock(&gVpumemMutex);
+
+    OSAL_VpumemFreeList(freed);
+
+    if (block == NULL) {
+        block = (OSAL_VPUMEM_BLOCK *)calloc(1, sizeof(OSAL_VPUMEM_BLOCK));
+        if (block == NULL)
+            return OMX_ErrorInsufficientResources;
+        if (VPUMallocLinear(&block->vpumem, nAlloc) != 0) {
+            /* fragmented or short on CMA, give everything cached back and retry once */
+            OSAL_VpumemTrim(0);
+            if (VPUMallocLinear(&block->vpumem, nAlloc) != 0) {
+                mpp_err("VPUMallocLinear %d bytes failed", nAlloc);
+                free(block);
+                return OMX_ErrorInsufficientResources;
+            }
+        }
+        block->nSize = nAlloc;
+    }
+
+    block->nRef = 1;
+    block->next = NULL;
+    *ppVpumem = &block->vpumem;
+
+    return OMX_ErrorNone;
+}
+
+void OSAL_VpumemAddRef(VPUMemLinear_t *pVpumem)
+{
+    OSAL_VPUMEM_BLOCK *block = (OSAL_VPUMEM_BLOCK *)pVpumem;
+
+    if (block == NULL)
+        return;
+
+    pthread_mutex_lock(&gVpumemMutex);
+    block->nRef++;
+    pthread_mutex_unlock(&gVpumemMutex);
+}
+
+void OSAL_VpumemRelease(VPUMemLinear_t *pVpumem)
+{
+    OSAL_VPUMEM_BLOCK *block = (OSAL_VPUMEM_BLOCK *)pVpumem;
+    OSAL_VPUMEM_BLOCK *freed = NULL;
+
+    if (block == NULL)
+        return;
+
+    pthread_mutex_lock(&gVpumemMutex);
+    if (--block->nRef == 0) {
+        block->nIdleSince = OSAL_VpumemNowMs();
+        block->next = gVpumemCache;
+        gVpumemCache = block;
+        gVpumemCachedBytes += block->nSize;
+        if (gVpumemCachedBytes > OSAL_VPUMEM_CACHE_MAX)
+            freed = OSAL_VpumemCollect(OSAL_VPUMEM_CACHE_MAX, block->nIdleSince);
+        if (gVpumemCache != NULL)
+            OSAL_VpumemStartReaper();
+    }
+    pthread_mutex_unlock(&gVpumemMutex);
+
+    OSAL_VpumemFreeList(freed);
+}
+
+void OSAL_VpumemTrim(OMX_U32 nKeepBytes)
+{
+    OSAL_VPUMEM_BLOCK *freed = NULL;
+
+    pthread_mutex_lock(&gVpumemMutex);
+    freed = OSAL_VpumemCollect(nKeepBytes, OSAL_VpumemNowMs());
+    pthread_mutex_unlock(&gVpumemMutex);
+
+    OSAL_VpumemFreeList(freed);
+}
+
+OMX_U32 OSAL_VpumemCachedBytes(void)
+{
+    OMX_U32 nBytes;
+
+    pthread_mutex_lock(&gVpumemMutex);
+    nBytes = gVpumemCachedBytes;
+    pthread_mutex_unlock(&gVpumemMutex);
+
+    return nBytes;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _OSAL_VPUMEM_H_
+#define _OSAL_VPUMEM_H_
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+
+#include "vpu_api.h"
+
+/*
+ * Process wide cache of linear vpu memory, built into libfpomx_rm so every
+ * component library shares one. Sizes are rounded up to pages, a released
+ * block is kept for the next acquire of the same or up to a quarter smaller
+ * size, so component restarts do not go back to the CMA allocator. Cached
+ * blocks idle for OSAL_VPUMEM_IDLE_TIME_MS (vendor.omx.vpumem.idle_ms) are
+ * freed by a reaper thread, as are blocks beyond OSAL_VPUMEM_CACHE_MAX
+ * bytes. The whole cache is dropped when an allocation fails and when the
+ * library is unloaded.
+ */
+#define OSAL_VPUMEM_PAGE_SIZE       4096
+#define OSAL_VPUMEM_CACHE_MAX       (64 << 20)
+#define OSAL_VPUMEM_IDLE_TIME_MS    10000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+OMX_ERRORTYPE OSAL_VpumemAcquire(OMX_U32 nSize, VPUMemLinear_t **ppVpumem);
+void          OSAL_VpumemAddRef(VPUMemLinear_t *pVpumem);
+/* drops a reference, the block goes back to the cache with the last one */
+void          OSAL_VpumemRelease(VPUMemLinear_t *pVpumem);
+/* frees cached blocks until at most nKeepBytes remain */
+void          OSAL_VpumemTrim(OMX_U32 nKeepBytes);
+OMX_U32       OSAL_VpumemCachedBytes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OSAL_VPUMEM_H_ */
@@ -0,0 +1,282 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "OMX_Macros.h"
+
+#include "osal_android.h"
+#include "osal_repack.h"
+#include "osal/mpp_log.h"
+#include "osal/mpp_mem.h"
+
+#include "video/dec/vdec.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "OSAL_VPUPOOL"
+#endif
+
+OMX_U32 Get_Video_HorAlign(OMX_VIDEO_CODINGTYPE codecId, OMX_U32 width, OMX_U32 height)
+{
+    OMX_U32 stride = 0;;
+    if (codecId == OMX_VIDEO_CodingHEVC) {
+        stride = ((width + 255) & (~255)) | (256);
+    } else if (codecId == OMX_VIDEO_CodingVP9) {
+        stride = (width + 127) & (~127);
+    } else {
+        stride = ((width + 15) & (~15));
+    }
+    if (access("/dev/rkvdec", 06) == 0) {
+        if (width > 1920 || height > 1088) {
+            if (codecId == OMX_VIDEO_CodingAVC) {
+                stride = ((width + 255) & (~255)) | (256);
+            }
+        }
+    }
+    return stride;
+}
+
+OMX_U32 Get_Video_VerAlign(OMX_VIDEO_CODINGTYPE codecId, OMX_U32 height)
+{
+    OMX_U32 stride = 0;;
+    if (codecId == OMX_VIDEO_CodingHEVC) {
+        stride = (height + 7) & (~7);
+    } else if (codecId == OMX_VIDEO_CodingVP9) {
+        stride = (height + 63) & (~63);
+    } else {
+        stride = ((height + 15) & (~15));
+    }
+    return stride;
+}
+
+OMX_ERRORTYPE OSAL_Fd2VpumemPool(FP_OMX_BASECOMPONENT *pFpComponent, OMX_BUFFERHEADERTYPE* bufferHeader)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT        *pFoilplanetPort        = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
+    struct vpu_display_mem_pool *pMem_pool = (struct vpu_display_mem_pool*)pVideoDec->vpumem_handle;
+    OMX_U32 i = 0;
+    OMX_U32 width = pFoilplanetPort->portDefinition.format.video.nStride;
+    OMX_U32 height = pFoilplanetPort->portDefinition.format.video.nSliceHeight;
+#if 1//LOW_VRESION
+    OMX_U32 nBytesize = width * height * 2;
+#else
+    OMX_U32 nBytesize = width * height * 9 / 5;
+#endif
+    OMX_S32 dupshared_fd = -1;
+    OMX_S32 slot = FP_OMX_LookupBufferHeader(pFoilplanetPort, bufferHeader);
+
+    if (slot < 0) {
+        mpp_err("commit unknown bufferHeader 0x%x", bufferHeader);
+        return OMX_ErrorBadParameter;
+    }
+    i = (OMX_U32)slot;
+    mpp_log("commit bufferHeader 0x%x", bufferHeader);
+
+    if (!pFoilplanetPort->extendBufferHeader[i].pRegisterFlag) {
+        OMX_PTR bufferHandle = NULL;
+        if (pVideoDec->bStoreMetaData == OMX_TRUE) {
+            OSAL_GetInfoFromMetaData(bufferHeader->pBuffer, &bufferHandle);
+        } else {
+            bufferHandle = (OMX_PTR)bufferHeader->pBuffer;
+        }
+        gralloc_handle_t priv_hnd;
+        memset(&priv_hnd, 0, sizeof(priv_hnd));
+        get_gralloc_private((uint32_t*)bufferHandle, &priv_hnd);
+        if (((!VPUMemJudgeIommu()) ? (priv_hnd.type != ANB_PRIVATE_BUF_VIRTUAL) : 1)) {
+            FP_OMX_SetBufferFd(pFoilplanetPort, i, priv_hnd.share_fd);
+            pFoilplanetPort->extendBufferHeader[i].pRegisterFlag = 1;
+            mpp_log("priv_hnd.share_fd = 0x%x", priv_hnd.share_fd);
+            if (priv_hnd.share_fd > 0) {
+                if (priv_hnd.size) {
+                    nBytesize = priv_hnd.size;
+                }
+                if (pVideoDec->bDRMPlayerMode == OMX_TRUE) {
+                    priv_hnd.share_fd |= 1 << 10;
+                }
+                dupshared_fd = pMem_pool->commit_hdl(pMem_pool, priv_hnd.share_fd , nBytesize);
+                if (dupshared_fd > 0) {
+                    FP_OMX_SetBufferFd(pFoilplanetPort, i, dupshared_fd);
+                }
+                mpp_log("commit bufferHeader 0x%x share_fd = 0x%x nBytesize = %d", bufferHeader, pFoilplanetPort->extendBufferHeader[i].buf_fd[0], nBytesize);
+            }
+        } else {
+            mpp_log("cma case gpu vmalloc can't used");
+        }
+    } else {
+        mpp_log(" free bufferHeader 0x%x", pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader);
+        if (pFoilplanetPort->extendBufferHeader[i].pPrivate != NULL) {
+            OSAL_FreeVpumem(pFpComponent, pFoilplanetPort->extendBufferHeader[i].pPrivate);
+            pFoilplanetPort->extendBufferHeader[i].pPrivate = NULL;
+        };
+    }
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_ResetVpumemPool(FP_OMX_BASECOMPONENT *pFpComponent)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT        *pFoilplanetPort        = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
+    struct vpu_display_mem_pool *pMem_pool = (struct vpu_display_mem_pool*)pVideoDec->vpumem_handle;
+    pMem_pool->reset(pMem_pool);
+    return OMX_ErrorNone;
+}
+OMX_ERRORTYPE OSAL_FreeVpumem(FP_OMX_BASECOMPONENT *pFpComponent, OMX_IN OMX_PTR pVpuframe)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    VPU_FRAME *pframe = (VPU_FRAME *)pVpuframe;
+    mpp_log("freeVpumem");
+    VPUMemLink(&pframe->vpumem);
+    VPUFreeLinear(&pframe->vpumem);
+    FP_Dec_PutFrame(pVideoDec, pframe);
+    return OMX_ErrorNone;
+}
+
+OMX_BUFFERHEADERTYPE *OSAL_Fd2OmxBufferHeader(FP_OMX_BASEPORT *pFoilplanetPort, OMX_IN OMX_S32 fd, OMX_IN OMX_PTR pVpuframe)
+{
+    OMX_S32 i = FP_OMX_LookupBufferFd(pFoilplanetPort, fd);
+
+    if (i < 0)
+        return NULL;
+
+    mpp_log(" current fd = 0x%x send to render current header 0x%x", fd, pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader);
+    if ( pFoilplanetPort->extendBufferHeader[i].pPrivate != NULL) {
+        mpp_log("This buff alreay send to display ");
+        return NULL;
+    }
+    if (pVpuframe) {
+        pFoilplanetPort->extendBufferHeader[i].pPrivate = pVpuframe;
+    } else {
+        mpp_log("vpu_mem point is NULL may error");
+    }
+    return pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader;
+}
+
+OMX_ERRORTYPE  OSAL_Openvpumempool(OMX_IN FP_OMX_BASECOMPONENT *pFpComponent, OMX_U32 portIndex)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    VpuCodecContext_t           *p_vpu_ctx = pVideoDec->vpu_ctx;
+    FP_OMX_BASEPORT *pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
+    if (pFoilplanetPort->bufferProcessType == BUFFER_SHARE) {
+        pVideoDec->vpumem_handle = (void*)open_vpu_memory_pool();
+        if (pVideoDec->vpumem_handle != NULL) {
+            mpp_log("open_vpu_memory_pool success handle 0x%x", pVideoDec->vpumem_handle);
+        }
+    } else {
+        vpu_display_mem_pool   *pool = NULL;
+        OMX_U32 hor_stride = Get_Video_HorAlign(pVideoDec->codecId, pFoilplanetPort->portDefinition.format.video.nFrameWidth, pFoilplanetPort->portDefinition.format.video.nFrameHeight);
+
+        OMX_U32 ver_stride = Get_Video_VerAlign(pVideoDec->codecId, pFoilplanetPort->portDefinition.format.video.nFrameHeight);
+        mpp_err("hor_stride %d ver_stride %d", hor_stride, ver_stride);
+        OMX_U32 nFrames = VDEC_COPY_POOL_DEFAULT_NUM;
+
+        if (pVideoDec->nDpbFrames != 0)
+            nFrames = pVideoDec->nDpbFrames + VDEC_DPB_EXTRA_NUM;
+        if (0 != create_vpu_memory_pool_allocator(&pool, nFrames, (hor_stride * ver_stride * 2))) {
+            mpp_err("create_vpu_memory_pool_allocator fail");
+        }
+        pVideoDec->vpumem_handle = (void*)(pool);
+    }
+    return OMX_ErrorNone;
+}
+
+
+OMX_ERRORTYPE  OSAL_Closevpumempool(OMX_IN FP_OMX_BASECOMPONENT *pFpComponent)
+{
+
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT *pFoilplanetPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
+    if (pFoilplanetPort->bufferProcessType == BUFFER_SHARE) {
+        close_vpu_memory_pool((vpu_display_mem_pool *)pVideoDec->vpumem_handle);
+        pVideoDec->vpumem_handle = NULL;
+    } else if (pVideoDec->vpumem_handle != NULL) {
+        release_vpu_memory_pool_allocator((vpu_display_mem_pool*)pVideoDec->vpumem_handle );
+        pVideoDec->vpumem_handle  = NULL;
+    }
+    return OMX_ErrorNone;
+}
+
+/*
+ * Native window buffers that already have the layout the decoder writes
+ * (NV12 at the decoder stride, dma-buf backed) are committed to the vpu as
+ * an external buffer group instead of being filled from the copy pool.
+ * Only decided once the output port is populated and before the decoder
+ * is initialised, the vpu keeps whichever pool it was started with.
+ */
+OMX_BOOL OSAL_ANBImportable(FP_OMX_BASECOMPONENT *pFpComponent, OMX_IN OMX_PTR handle)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT *pFoilplanetPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
+    OMX_U32 nWidth = pFoilplanetPort->portDefinition.format.video.nFrameWidth;
+    OMX_U32 nHeight = pFoilplanetPort->portDefinition.format.video.nFrameHeight;
+    OMX_U32 hor_stride = Get_Video_HorAlign(pVideoDec->codecId, nWidth, nHeight);
+    OMX_U32 ver_stride = Get_Video_VerAlign(pVideoDec->codecId, nHeight);
+    gralloc_handle_t priv_hnd;
+
+    if (handle == NULL)
+        return OMX_FALSE;
+
+    memset(&priv_hnd, 0, sizeof(priv_hnd));
+    get_gralloc_private((uint32_t*)handle, &priv_hnd);
+
+    if (priv_hnd.format != HAL_PIXEL_FORMAT_YCrCb_NV12)
+        return OMX_FALSE;
+    if (!VPUMemJudgeIommu() && priv_hnd.type == ANB_PRIVATE_BUF_VIRTUAL)
+        return OMX_FALSE;
+
+    return OSAL_RepackLayoutMatches(priv_hnd.share_fd, (OMX_U32)priv_hnd.stride, (OMX_U32)priv_hnd.size,
+                                    hor_stride, ver_stride);
+}
+
+OMX_ERRORTYPE OSAL_ANBTryShare(OMX_IN FP_OMX_BASECOMPONENT *pFpComponent)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT *pFoilplanetPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
+    OMX_U32 i = 0;
+
+    if (pVideoDec->bIsANBEnabled != OMX_TRUE || pVideoDec->bStoreMetaData == OMX_TRUE ||
+        pVideoDec->bDRMPlayerMode == OMX_TRUE || pVideoDec->bFirstFrame != OMX_TRUE ||
+        pFoilplanetPort->bufferProcessType != BUFFER_COPY)
+        return OMX_ErrorNone;
+
+    /* the decoder holds the DPB in them now, with room for the display side */
+    if (pVideoDec->nDpbFrames != 0 &&
+        pFoilplanetPort->portDefinition.nBufferCountActual < pVideoDec->nDpbFrames + VDEC_DPB_EXTRA_NUM)
+        return OMX_ErrorNone;
+
+    for (i = 0; i < pFoilplanetPort->portDefinition.nBufferCountActual; i++) {
+        OMX_BUFFERHEADERTYPE *bufferHeader = pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader;
+        if (bufferHeader == NULL || !OSAL_ANBImportable(pFpComponent, bufferHeader->pBuffer))
+            return OMX_ErrorNone;
+    }
+
+    OSAL_Closevpumempool(pFpComponent);
+    pFoilplanetPort->bufferProcessType = BUFFER_SHARE;
+    OSAL_Openvpumempool(pFpComponent, OUTPUT_PORT_INDEX);
+    if (pVideoDec->vpumem_handle == NULL) {
+        mpp_err("import pool open failed, back to copying into native buffers");
+        pFoilplanetPort->bufferProcessType = BUFFER_COPY;
+        OSAL_Openvpumempool(pFpComponent, OUTPUT_PORT_INDEX);
+        return OMX_ErrorInsufficientResources;
+    }
+
+    mpp_log("native buffers match the decoder layout, decoding into them");
+    return OMX_ErrorNone;
+}
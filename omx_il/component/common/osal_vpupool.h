@@ -0,0 +1,80 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _OSAL_VPUPOOL_H_
+#define _OSAL_VPUPOOL_H_
+
+#include <stdint.h>
+
+#include "OMX_Types.h"
+#include "OMX_Core.h"
+#include "OMX_Video.h"
+
+#include "Foilplanet_OMX_Baseport.h"
+#include "Foilplanet_OMX_Basecomponent.h"
+
+/*
+ * Decoder output pools handed to the vpu: the copy pool frames are decoded
+ * into before FP_Frame2Outbuf, or the import pool the native window buffers
+ * are committed to. Only the gralloc lookup is platform code.
+ */
+
+/** gralloc_private_handle_t
+ * defined in 'librkvpu/omx_get_gralloc_private/gralloc_priv_omx.h'
+ */
+typedef struct _gralloc_priv_handle {
+    int format;
+    int share_fd;
+    int type;
+    int stride;
+    int size;
+} gralloc_handle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+OMX_S32 get_gralloc_private(uint32_t *handle, gralloc_handle_t *private_hnd);
+
+OMX_ERRORTYPE OSAL_Fd2VpumemPool(FP_OMX_BASECOMPONENT *pRockchipComponent,
+                                 OMX_BUFFERHEADERTYPE* bufferHeader);
+
+OMX_BUFFERHEADERTYPE *OSAL_Fd2OmxBufferHeader(FP_OMX_BASEPORT *pRockchipPort,
+                                              OMX_IN OMX_S32 fd, OMX_IN OMX_PTR pVpumem);
+
+OMX_ERRORTYPE  OSAL_FreeVpumem(FP_OMX_BASECOMPONENT *pFpComponent, OMX_IN OMX_PTR pVpumem);
+
+OMX_ERRORTYPE  OSAL_Openvpumempool(OMX_IN FP_OMX_BASECOMPONENT *pRockchipComponent, OMX_U32 portIndex);
+
+OMX_ERRORTYPE  OSAL_Closevpumempool(OMX_IN FP_OMX_BASECOMPONENT *pRockchipComponent);
+
+OMX_ERRORTYPE OSAL_ResetVpumemPool(OMX_IN FP_OMX_BASECOMPONENT *pRockchipComponent);
+
+OMX_BOOL OSAL_ANBImportable(FP_OMX_BASECOMPONENT *pRockchipComponent, OMX_IN OMX_PTR handle);
+
+/* switches a copy mode native window port to decoding into its buffers when they all qualify */
+OMX_ERRORTYPE OSAL_ANBTryShare(OMX_IN FP_OMX_BASECOMPONENT *pRockchipComponent);
+
+OMX_U32 Get_Video_HorAlign(OMX_VIDEO_CODINGTYPE codecId, OMX_U32 width, OMX_U32 height);
+
+OMX_U32 Get_Video_VerAlign(OMX_VIDEO_CODINGTYPE codecId, OMX_U32 height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OSAL_VPUPOOL_H_ */
@@ -38,6 +38,7 @@ endif
 LOCAL_SRC_FILES :=  \
     vdec_control.cc \
     vdec.cc         \
+    vdec_sps.cc     \
     library_register.c
 
 LOCAL_MODULE := libomxvpu_dec
@@ -29,16 +29,20 @@
 
 #include "vdec.h"
 #include "vdec_control.h"
+#include "vdec_sps.h"
 
 //#include "vpu_mem_pool.h"
 //#include "vpu_api_private_cmd.h"
 //#include "vpu_mem.h"
 
 #include "osal_android.h"
+#include "osal_arena.h"
 #include "osal_event.h"
+#include "osal_queue.h"
+#include "osal_repack.h"
 #include "osal_rga.h"
+#include "osal_task.h"
 #include "osal/mpp_thread.h"
-#include "osal/mpp_list.h"
 #include "osal/mpp_mem.h"
 
 #ifdef MODULE_TAG
@@ -49,7 +53,16 @@
 #define VPU_API_SET_IMMEDIATE_OUT       (VPU_API_CMD)0x1000
 #define VPU_API_DEC_GET_STREAM_TOTAL    (VPU_API_CMD)0x2000
 
-#define GET_MPPLIST(q)      ((mpp_list *)q)
+/*
+ * Upper bounds for a codec thread waiting on hCodecReadyEvent. The threads
+ * are normally woken by the peer thread or by FillThisBuffer; the output
+ * bound stays short because vpu_api has no notification for decode done.
+ */
+#define CODEC_WAIT_TIME_MS      20
+#define OUTPUT_POLL_TIME_MS     3
+
+/* input flags that belong to the frame and follow it to FillBufferDone */
+#define FRAME_CARRIED_FLAGS     (OMX_BUFFERFLAG_SYNCFRAME | OMX_BUFFERFLAG_DECODEONLY | OMX_BUFFERFLAG_DATACORRUPT)
 
 /** vpu_api_private_cmd.h (rkvpu)
  */
@@ -136,6 +149,14 @@ static void controlFPS(OMX_BOOL isInput)
     return;
 }
 
+static OMX_U64 FP_Dec_NowUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (OMX_U64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 
 void UpdateFrameSize(OMX_COMPONENTTYPE *pOMXComponent)
 {
@@ -182,10 +203,10 @@ OMX_BOOL FP_Check_BufferProcess_State(FP_OMX_BASECOMPONENT *pFpComponent, OMX_U3
 {
     OMX_BOOL ret = OMX_FALSE;
 
-    if ((pFpComponent->currentState == OMX_StateExecuting) &&
-        (pFpComponent->pFoilplanetPort[nPortIndex].portState == OMX_StateIdle) &&
-        (pFpComponent->transientState != FP_OMX_TransStateExecutingToIdle) &&
-        (pFpComponent->transientState != FP_OMX_TransStateIdleToExecuting)) {
+    if ((FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateExecuting) &&
+        (FP_OMX_LOAD(pFpComponent->pFoilplanetPort[nPortIndex].portState) == OMX_StateIdle) &&
+        (FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateExecutingToIdle) &&
+        (FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateIdleToExecuting)) {
         ret = OMX_TRUE;
     } else {
         ret = OMX_FALSE;
@@ -202,6 +223,7 @@ OMX_ERRORTYPE FP_OMX_CheckIsNeedFastmode(
     FP_OMX_BASEPORT           *pInputPort  = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
     VpuCodecContext_t         *p_vpu_ctx   = pVideoDec->vpu_ctx;
     if (pVideoDec->bFastMode == OMX_FALSE
+        && !(pVideoDec->flags & FP_OMX_VDEC_LOW_LATENCY)
         && pVideoDec->codecId == OMX_VIDEO_CodingHEVC
         && pInputPort->portDefinition.format.video.nFrameWidth > 1920
         && pInputPort->portDefinition.format.video.nFrameHeight > 1080) {
@@ -236,6 +258,12 @@ OMX_ERRORTYPE FP_OMX_DebugSwitchfromPropget(
         pVideoDec->bPrintFps = OMX_TRUE;
     }
 
+    memset(value, 0, sizeof(value));
+    if (property_get("dump_omx_latency", value, "0") && (atoi(value) > 0)) {
+        mpp_log("print low latency decode time of every frame");
+        pVideoDec->bPrintLatency = OMX_TRUE;
+    }
+
     memset(value, 0, sizeof(value));
     if (property_get("dump_omx_buf_position", value, "0") && (atoi(value) > 0)) {
         mpp_log("print all buf position");
@@ -303,11 +331,11 @@ void FP_Wait_ProcessPause(FP_OMX_BASECOMPONENT *pFpComponent, OMX_U32 nPortIndex
 
     fpOMXPort = &pFpComponent->pFoilplanetPort[nPortIndex];
 
-    if (((pFpComponent->currentState == OMX_StatePause) ||
-         (pFpComponent->currentState == OMX_StateIdle) ||
-         (pFpComponent->transientState == FP_OMX_TransStateLoadedToIdle) ||
-         (pFpComponent->transientState == FP_OMX_TransStateExecutingToIdle)) &&
-        (pFpComponent->transientState != FP_OMX_TransStateIdleToLoaded) &&
+    if (((FP_OMX_LOAD(pFpComponent->currentState) == OMX_StatePause) ||
+         (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateIdle) ||
+         (FP_OMX_LOAD(pFpComponent->transientState) == FP_OMX_TransStateLoadedToIdle) ||
+         (FP_OMX_LOAD(pFpComponent->transientState) == FP_OMX_TransStateExecutingToIdle)) &&
+        (FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateIdleToLoaded) &&
         (!CHECK_PORT_BEING_FLUSHED(fpOMXPort))) {
 
         OSAL_SignalWait(pFpComponent->pFoilplanetPort[nPortIndex].pauseEvent, DEF_MAX_WAIT_TIME);
@@ -319,6 +347,235 @@ void FP_Wait_ProcessPause(FP_OMX_BASECOMPONENT *pFpComponent, OMX_U32 nPortIndex
     return;
 }
 
+/* output buffer counts for the DPB the SPS asked for, only BUFFER_SHARE decodes into them */
+static void FP_Dec_OutputBufferCount(FP_OMX_VIDEODEC_COMPONENT *pVideoDec, FP_OMX_BASEPORT *pOutputPort,
+                                     OMX_U32 *nMin, OMX_U32 *nActual)
+{
+    *nMin = pOutputPort->portDefinition.nBufferCountMin;
+    *nActual = pOutputPort->portDefinition.nBufferCountActual;
+
+    if (pVideoDec->nDpbFrames == 0 || pOutputPort->bufferProcessType != BUFFER_SHARE)
+        return;
+
+    *nMin = pVideoDec->nDpbFrames + VDEC_DPB_EXTRA_NUM;
+    *nActual = *nMin + VDEC_DISPLAY_EXTRA_NUM;
+    if (*nActual > PORT_BUFFER_NUM_MAX)
+        *nActual = PORT_BUFFER_NUM_MAX;
+}
+
+/* same handshake as a vpu info change: bInfoChange holds until the port is flushed for reconfiguration */
+static void FP_Dec_SpsPortUpdate(OMX_COMPONENTTYPE *pOMXComponent, VDEC_SPS_INFO *sps,
+                                 OMX_U32 nStride, OMX_U32 nSliceHeight, OMX_U32 nMin, OMX_U32 nActual)
+{
+    FP_OMX_BASECOMPONENT      *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT           *pInputPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
+    FP_OMX_BASEPORT           *pOutputPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
+
+    pOutputPort->newCropRectangle.nWidth = sps->nWidth;
+    pOutputPort->newCropRectangle.nHeight = sps->nHeight;
+    pOutputPort->newPortDefinition.format.video.eColorFormat = pOutputPort->portDefinition.format.video.eColorFormat;
+    pOutputPort->newPortDefinition.nBufferCountActual = nActual;
+    pOutputPort->newPortDefinition.nBufferCountMin = nMin;
+    pInputPort->newPortDefinition.format.video.nFrameWidth = sps->nWidth;
+    pInputPort->newPortDefinition.format.video.nFrameHeight = sps->nHeight;
+    pInputPort->newPortDefinition.format.video.nStride = nStride;
+    pInputPort->newPortDefinition.format.video.nSliceHeight = nSliceHeight;
+    FP_ResolutionUpdate(pOMXComponent);
+    FP_OMX_PostEvent(pOMXComponent,
+                     OMX_EventPortSettingsChanged,
+                     OUTPUT_PORT_INDEX, OMX_IndexParamPortDefinition, NULL);
+    if (pOutputPort->bufferProcessType == BUFFER_SHARE)
+        OSAL_ResetVpumemPool(pFpComponent);
+    pVideoDec->bInfoChange = OMX_TRUE;
+}
+
+/*
+ * Sizes the output port from the SPS before the vpu is initialized, so the
+ * client reallocates once up front instead of after output stalls. Stride
+ * and slice height follow the vpu alignment, the info change reported with
+ * the first frame then finds the port already matching.
+ */
+static void FP_Dec_ConfigFromSps(OMX_COMPONENTTYPE *pOMXComponent, OMX_U8 *data, OMX_U32 size)
+{
+    FP_OMX_BASECOMPONENT      *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT           *pInputPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
+    FP_OMX_BASEPORT           *pOutputPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
+    VDEC_SPS_INFO              sps;
+    OMX_U32                    nStride, nSliceHeight, nMin, nActual;
+
+    if (FP_Dec_ParseSps(pVideoDec->codecId, data, size, &sps) != OMX_TRUE)
+        return;
+
+    mpp_log("sps %dx%d %d bit, dpb %d frames", sps.nWidth, sps.nHeight, sps.nBitDepth, sps.nDpbFrames);
+
+    /* same limit as decoded frames, the client must not size buffers for more */
+    if (sps.nWidth > VDEC_SPS_MAX_WIDTH || sps.nHeight > VDEC_SPS_MAX_HEIGHT) {
+        mpp_err("sps %dx%d exceeds %dx%d, ignored", sps.nWidth, sps.nHeight,
+                VDEC_SPS_MAX_WIDTH, VDEC_SPS_MAX_HEIGHT);
+        return;
+    }
+    pVideoDec->nDpbFrames = sps.nDpbFrames;
+
+    /* high bit depth changes the output format, leave it to the vpu info change */
+    if (sps.nBitDepth > 8)
+        return;
+    /* a port reconfiguration is already pending, the vpu reports the size again */
+    if (pVideoDec->bInfoChange == OMX_TRUE)
+        return;
+
+    nStride = Get_Video_HorAlign(pVideoDec->codecId, sps.nWidth, sps.nHeight);
+    nSliceHeight = Get_Video_VerAlign(pVideoDec->codecId, sps.nHeight);
+    FP_Dec_OutputBufferCount(pVideoDec, pOutputPort, &nMin, &nActual);
+
+    if ((pInputPort->portDefinition.format.video.nFrameWidth != sps.nWidth) ||
+        (pInputPort->portDefinition.format.video.nFrameHeight != sps.nHeight) ||
+        (pInputPort->portDefinition.format.video.nStride != (OMX_S32)nStride) ||
+        (pInputPort->portDefinition.format.video.nSliceHeight != nSliceHeight) ||
+        (pOutputPort->portDefinition.nBufferCountMin != nMin) ||
+        (pOutputPort->portDefinition.nBufferCountActual != nActual)) {
+        FP_Dec_SpsPortUpdate(pOMXComponent, &sps, nStride, nSliceHeight, nMin, nActual);
+    }
+
+    /* the copy mode pool is not handed to the vpu yet, reopen it for the DPB and size */
+    if (pOutputPort->bufferProcessType != BUFFER_SHARE && pVideoDec->vpumem_handle != NULL) {
+        OSAL_Closevpumempool(pFpComponent);
+        OSAL_Openvpumempool(pFpComponent, OUTPUT_PORT_INDEX);
+    }
+}
+
+void FP_Dec_ResetFrameAsm(FP_OMX_VIDEODEC_COMPONENT *pVideoDec)
+{
+    pVideoDec->nFrameAsmLen = 0;
+    pVideoDec->bFrameAsmReady = OMX_FALSE;
+}
+
+/*
+ * Frames larger than the input buffers may come split over several
+ * buffers, the last one flagged OMX_BUFFERFLAG_ENDOFFRAME. The parts are
+ * appended to a staging buffer that grows as needed, so a high bitrate
+ * stream needs no input port reconfiguration. Only used once the client
+ * has shown it flags frame ends, older clients send whole frames unflagged.
+ * Returns OMX_TRUE when a complete frame is ready, OMX_FALSE when the
+ * buffer was taken as a part and already returned.
+ */
+static OMX_BOOL FP_Dec_AssembleFrame(OMX_COMPONENTTYPE *pOMXComponent, FP_OMX_DATABUFFER *inputUseBuffer)
+{
+    FP_OMX_BASECOMPONENT      *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    OMX_U32                    nLen = inputUseBuffer->dataLen;
+    OMX_BOOL                   bEnd;
+
+    if (pVideoDec->bDRMPlayerMode == OMX_TRUE)
+        return OMX_TRUE;
+
+    if (inputUseBuffer->nFlags & OMX_BUFFERFLAG_ENDOFFRAME)
+        pVideoDec->bEndOfFrameSeen = OMX_TRUE;
+    bEnd = ((pVideoDec->bEndOfFrameSeen == OMX_FALSE) ||
+            (inputUseBuffer->nFlags & (OMX_BUFFERFLAG_ENDOFFRAME | OMX_BUFFERFLAG_EOS))) ? OMX_TRUE : OMX_FALSE;
+
+    /* whole frame in one buffer, sent from the buffer itself */
+    if (bEnd && pVideoDec->nFrameAsmLen == 0)
+        return OMX_TRUE;
+    /* the vpu was full last time, the frame is already assembled */
+    if (pVideoDec->bFrameAsmReady == OMX_TRUE)
+        return OMX_TRUE;
+
+    if (pVideoDec->nFrameAsmLen + nLen > pVideoDec->nFrameAsmSize) {
+        OMX_U32 nSize = pVideoDec->nFrameAsmSize ? pVideoDec->nFrameAsmSize : VDEC_INPUT_BUFFER_SIZE_MIN;
+        OMX_U8 *pNew = NULL;
+
+        while (nSize < pVideoDec->nFrameAsmLen + nLen && nSize < VDEC_INPUT_FRAME_SIZE_MAX)
+            nSize *= 2;
+        if (pVideoDec->nFrameAsmLen + nLen <= nSize)
+            pNew = mpp_malloc(OMX_U8, nSize);
+        if (pNew == NULL) {
+            mpp_err("input frame of %d bytes dropped", pVideoDec->nFrameAsmLen + nLen);
+            FP_Dec_ResetFrameAsm(pVideoDec);
+            FP_InputBufferReturn(pOMXComponent, inputUseBuffer);
+            return OMX_FALSE;
+        }
+        if (pVideoDec->pFrameAsm != NULL) {
+            memcpy(pNew, pVideoDec->pFrameAsm, pVideoDec->nFrameAsmLen);
+            mpp_free(pVideoDec->pFrameAsm);
+        }
+        pVideoDec->pFrameAsm = pNew;
+        pVideoDec->nFrameAsmSize = nSize;
+    }
+    memcpy(pVideoDec->pFrameAsm + pVideoDec->nFrameAsmLen,
+           inputUseBuffer->bufferHeader->pBuffer + inputUseBuffer->usedDataLen, nLen);
+    pVideoDec->nFrameAsmLen += nLen;
+
+    if (bEnd == OMX_FALSE) {
+        FP_InputBufferReturn(pOMXComponent, inputUseBuffer);
+        return OMX_FALSE;
+    }
+    pVideoDec->bFrameAsmReady = OMX_TRUE;
+
+    return OMX_TRUE;
+}
+
+/* records flags and mark of an input accepted by the vpu, keyed by its timestamp */
+static void FP_Dec_PutReorder(OMX_COMPONENTTYPE *pOMXComponent, FP_OMX_DATABUFFER *inputUseBuffer,
+                              OMX_U64 nSendTime)
+{
+    FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_BASEPORT      *fpInputPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
+    OMX_BUFFERHEADERTYPE *bufferHeader = inputUseBuffer->bufferHeader;
+    OSAL_REORDER_ENTRY    entry;
+
+    memset(&entry, 0, sizeof(OSAL_REORDER_ENTRY));
+    entry.nTimeStamp = inputUseBuffer->timeStamp;
+    entry.nFlags = inputUseBuffer->nFlags & FRAME_CARRIED_FLAGS;
+    entry.nSendTime = nSendTime;
+
+    if (fpInputPort->markType.hMarkTargetComponent != NULL) {
+        bufferHeader->hMarkTargetComponent = fpInputPort->markType.hMarkTargetComponent;
+        bufferHeader->pMarkData = fpInputPort->markType.pMarkData;
+        fpInputPort->markType.hMarkTargetComponent = NULL;
+        fpInputPort->markType.pMarkData = NULL;
+    }
+    /* marks for this component are still signalled when the input returns */
+    if ((bufferHeader->hMarkTargetComponent != NULL) &&
+        (bufferHeader->hMarkTargetComponent != pOMXComponent)) {
+        entry.hMarkTargetComponent = bufferHeader->hMarkTargetComponent;
+        entry.pMarkData = bufferHeader->pMarkData;
+        bufferHeader->hMarkTargetComponent = NULL;
+        bufferHeader->pMarkData = NULL;
+    }
+
+    OSAL_ReorderPut(pFpComponent->hReorderMap, &entry);
+}
+
+/* puts flags and mark of the input with the same timestamp on a decoded frame */
+static void FP_Dec_TakeReorder(FP_OMX_BASECOMPONENT *pFpComponent, OMX_BUFFERHEADERTYPE *bufferHeader,
+                               OMX_TICKS nTimeStamp, OMX_U32 *pFlags)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    OSAL_REORDER_ENTRY entry;
+
+    bufferHeader->hMarkTargetComponent = NULL;
+    bufferHeader->pMarkData = NULL;
+    if (OSAL_ReorderTake(pFpComponent->hReorderMap, nTimeStamp, &entry) == OMX_FALSE)
+        return;
+
+    *pFlags |= entry.nFlags;
+    bufferHeader->hMarkTargetComponent = entry.hMarkTargetComponent;
+    bufferHeader->pMarkData = entry.pMarkData;
+
+    if (pVideoDec->flags & FP_OMX_VDEC_LOW_LATENCY) {
+        OMX_U64 latency = FP_Dec_NowUs() - entry.nSendTime;
+
+        pVideoDec->nLatencyCount++;
+        pVideoDec->nLatencySum += latency;
+        if (latency > pVideoDec->nLatencyMax)
+            pVideoDec->nLatencyMax = latency;
+        if (pVideoDec->bPrintLatency == OMX_TRUE)
+            mpp_log("frame %lld decode latency %lld us", (long long)nTimeStamp, (long long)latency);
+    }
+}
+
 OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_BOOL               ret = OMX_FALSE;
@@ -330,8 +587,9 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
     OMX_S32 i = 0;
     OMX_S32 numInOmxAl = 0;
     OMX_S32 temp_size;
-    OMX_S32 maxBufferNum = fpInputPort->portDefinition.nBufferCountActual;
+    OMX_S32 maxBufferNum = fpInputPort->nBufferSlots;
     OMX_S32 dec_ret = 0;
+    OMX_U64 nSendTime = 0;
     FunctionIn();
 
     for (i = 0; i < maxBufferNum; i++) {
@@ -365,8 +623,8 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
                     }
                     mpp_log("extraData = %p", extraData);
                 } else {
-                    mpp_log("FP_SendInputData malloc");
-                    extraData = mpp_malloc(OMX_U8, inputUseBuffer->dataLen);
+                    /* only needed until the vpu is initialised, the input loop resets the arena */
+                    extraData = (OMX_U8 *)OSAL_ArenaAlloc(pFpComponent->hScratchArena, inputUseBuffer->dataLen);
                     if (extraData == NULL) {
                         mpp_err("malloc Extra Data fail");
                         ret = OMX_FALSE;
@@ -384,6 +642,16 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
                 extraFlag = 1;
             }
 
+            if (pVideoDec->bDRMPlayerMode == OMX_FALSE) {
+                if (extraFlag) {
+                    FP_Dec_ConfigFromSps(pOMXComponent, extraData, extraSize);
+                } else {
+                    FP_Dec_ConfigFromSps(pOMXComponent,
+                                         inputUseBuffer->bufferHeader->pBuffer + inputUseBuffer->usedDataLen,
+                                         inputUseBuffer->dataLen);
+                }
+            }
+
             mpp_log("decode init");
             //add by xhr
             if (pVideoDec->bDRMPlayerMode == OMX_TRUE) {
@@ -403,15 +671,16 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
             }
 
             p_vpu_ctx->init(p_vpu_ctx, extraData, extraSize);
-            // not use iep when thumbNail decode
-            if (!(pVideoDec->flags & FP_OMX_VDEC_THUMBNAIL)) {
+            // not use iep when thumbNail decode, nor at low latency where it holds a field back
+            if (!(pVideoDec->flags & (FP_OMX_VDEC_THUMBNAIL | FP_OMX_VDEC_LOW_LATENCY))) {
                 p_vpu_ctx->control(p_vpu_ctx, VPU_API_ENABLE_DEINTERLACE, &enableDinterlace);
             }
             if (pVideoDec->vpumem_handle != NULL) {
                 p_vpu_ctx->control(p_vpu_ctx, VPU_API_SET_VPUMEM_CONTEXT, pVideoDec->vpumem_handle);
             }
 
-            if (fpInputPort->portDefinition.format.video.bFlagErrorConcealment) {
+            if (fpInputPort->portDefinition.format.video.bFlagErrorConcealment ||
+                (pVideoDec->flags & FP_OMX_VDEC_LOW_LATENCY)) {
                 mpp_log("use directly output mode for media");
                 RK_U32 flag = 1;
                 p_vpu_ctx->control(p_vpu_ctx, VPU_API_SET_IMMEDIATE_OUT, (void*)&flag);
@@ -425,13 +694,12 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
             if (extraFlag) {
                 ret = OMX_TRUE;
                 if (extraData  && !pVideoDec->bDRMPlayerMode) {
-                    mpp_free(extraData);
                     extraData = NULL;
                     FP_InputBufferReturn(pOMXComponent, inputUseBuffer);
                 } else if (extraData && pVideoDec->bDRMPlayerMode) {
                     inputUseBuffer->dataValid = OMX_FALSE;
                     FP_OMX_DATABUFFER * inputInValidBuffer;
-                    inputInValidBuffer = mpp_malloc(FP_OMX_DATABUFFER, 1);
+                    inputInValidBuffer = FP_Dec_GetSecureBuffer(pFpComponent);
                     if (inputInValidBuffer == NULL) {
                         mpp_err("inputInValidBuffer malloc failed!");
                         return OMX_FALSE;
@@ -440,9 +708,11 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
                     inputInValidBuffer->dataLen = inputUseBuffer->dataLen;
                     inputInValidBuffer->timeStamp = inputUseBuffer->timeStamp;
 
-                    MUTEX_LOCK(fpInputPort->secureBufferMutex);
-                    GET_MPPLIST(fpInputPort->securebufferQ)->add_at_tail(inputInValidBuffer, sizeof(FP_OMX_DATABUFFER));
-                    MUTEX_UNLOCK(fpInputPort->secureBufferMutex);
+                    /* only this thread produces into securebufferQ, no lock needed */
+                    if (OSAL_Queue(fpInputPort->securebufferQ, (OMX_PTR)inputInValidBuffer) != OMX_ErrorNone) {
+                        FP_InputBufferReturn(pOMXComponent, inputInValidBuffer);
+                        FP_Dec_PutSecureBuffer(pFpComponent, inputInValidBuffer);
+                    }
 
                 } else {
                     // NOTHING
@@ -457,6 +727,10 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
             pFpComponent->bSaveFlagEOS = OMX_TRUE;
             //  if (inputUseBuffer->dataLen != 0)
         }
+        if (FP_Dec_AssembleFrame(pOMXComponent, inputUseBuffer) == OMX_FALSE) {
+            ret = OMX_TRUE;
+            goto EXIT;
+        }
         memset(&pkt, 0, sizeof(VideoPacket_t));
         pkt.data =  inputUseBuffer->bufferHeader->pBuffer + inputUseBuffer->usedDataLen;
         mpp_log("in sendInputData data = %p", pkt.data);
@@ -468,6 +742,10 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
             mpp_log("out sendInputData data = %p", pkt.data);
         }
         pkt.size = inputUseBuffer->dataLen;
+        if (pVideoDec->bFrameAsmReady == OMX_TRUE) {
+            pkt.data = pVideoDec->pFrameAsm;
+            pkt.size = pVideoDec->nFrameAsmLen;
+        }
 
         if (pVideoDec->flags & FP_OMX_VDEC_USE_DTS) {
             pkt.pts = VPU_API_NOPTS_VALUE;
@@ -482,14 +760,14 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
         mpp_log("pkt.size:%d, pkt.dts:%lld,pkt.pts:%lld,pkt.nFlags:%d",
                   pkt.size, pkt.dts, pkt.pts, pkt.nFlags);
         mpp_log("decode_sendstream pkt.data = %p", pkt.data);
+        nSendTime = FP_Dec_NowUs();
         dec_ret = p_vpu_ctx->decode_sendstream(p_vpu_ctx, &pkt);
         if (dec_ret < 0) {
             mpp_err("decode_sendstream failed , ret = %x", dec_ret);
             /*
-            pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                             pFpComponent->callbackData, OMX_EventError,
-                                                             INPUT_PORT_INDEX,
-                                                             OMX_IndexParamPortDefinition, NULL);
+            FP_OMX_PostEvent(pOMXComponent,
+                             OMX_EventError,
+                             INPUT_PORT_INDEX, OMX_IndexParamPortDefinition, NULL);
             FP_InputBufferReturn(pOMXComponent, inputUseBuffer);
             ret = OMX_TRUE;
             goto EXIT;*/
@@ -498,17 +776,19 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
             mpp_err("stream list full wait");
             goto EXIT;
         }
+        FP_Dec_ResetFrameAsm(pVideoDec);
         // mpp_log("decode_sendstream pkt.data = %p",pkt.data);
         if (pVideoDec->bPrintFps == OMX_TRUE) {
             OMX_BOOL isInput = OMX_TRUE;
             controlFPS(isInput);
         }
+        FP_Dec_PutReorder(pOMXComponent, inputUseBuffer, nSendTime);
 
 
         if (pVideoDec->bDRMPlayerMode == OMX_TRUE) {
             inputUseBuffer->dataValid = OMX_FALSE;
             FP_OMX_DATABUFFER * inputInValidBuffer;
-            inputInValidBuffer = mpp_malloc(FP_OMX_DATABUFFER, 1);
+            inputInValidBuffer = FP_Dec_GetSecureBuffer(pFpComponent);
             if (inputInValidBuffer == NULL) {
                 mpp_err("inputInValidBuffer malloc failed!");
                 return OMX_FALSE;
@@ -516,9 +796,11 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
             inputInValidBuffer->bufferHeader = inputUseBuffer->bufferHeader;
             inputInValidBuffer->dataLen = inputUseBuffer->dataLen;
             inputInValidBuffer->timeStamp = inputUseBuffer->timeStamp;
-            MUTEX_LOCK(fpInputPort->secureBufferMutex);
-            GET_MPPLIST(fpInputPort->securebufferQ)->add_at_tail(inputInValidBuffer, sizeof(FP_OMX_DATABUFFER));
-            MUTEX_UNLOCK(fpInputPort->secureBufferMutex);
+            /* only this thread produces into securebufferQ, no lock needed */
+            if (OSAL_Queue(fpInputPort->securebufferQ, (OMX_PTR)inputInValidBuffer) != OMX_ErrorNone) {
+                FP_InputBufferReturn(pOMXComponent, inputInValidBuffer);
+                FP_Dec_PutSecureBuffer(pFpComponent, inputInValidBuffer);
+            }
         } else {
             FP_InputBufferReturn(pOMXComponent, inputUseBuffer);
         }
@@ -538,6 +820,75 @@ EXIT:
     return ret;
 }
 
+VPU_FRAME *FP_Dec_GetFrame(FP_OMX_VIDEODEC_COMPONENT *pVideoDec)
+{
+    VPU_FRAME *pframe = NULL;
+
+    if (pVideoDec->hFramePool != NULL)
+        pframe = (VPU_FRAME *)OSAL_Dequeue(pVideoDec->hFramePool);
+    if (pframe == NULL) {
+        pframe = mpp_malloc(VPU_FRAME, 1);
+        if (pframe == NULL)
+            return NULL;
+        __atomic_add_fetch(&pVideoDec->nFrameAllocCount, 1, __ATOMIC_RELAXED);
+    }
+    memset(pframe, 0, sizeof(VPU_FRAME));
+
+    return pframe;
+}
+
+/* the frame's vpumem must be released by the caller */
+void FP_Dec_PutFrame(FP_OMX_VIDEODEC_COMPONENT *pVideoDec, VPU_FRAME *pframe)
+{
+    if (pframe == NULL)
+        return;
+    if (pVideoDec == NULL || pVideoDec->hFramePool == NULL ||
+        OSAL_Queue(pVideoDec->hFramePool, (OMX_PTR)pframe) != OMX_ErrorNone) {
+        mpp_free(pframe);
+    }
+}
+
+/* descriptors taken from the heap so far, the prefill included */
+OMX_U32 FP_Dec_FrameAllocCount(FP_OMX_VIDEODEC_COMPONENT *pVideoDec)
+{
+    return __atomic_load_n(&pVideoDec->nFrameAllocCount, __ATOMIC_RELAXED);
+}
+
+FP_OMX_DATABUFFER *FP_Dec_GetSecureBuffer(FP_OMX_BASECOMPONENT *pFpComponent)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_DATABUFFER         *pBuffer = NULL;
+
+    if (pVideoDec->hSecureBufferPool != NULL)
+        pBuffer = (FP_OMX_DATABUFFER *)OSAL_Dequeue(pVideoDec->hSecureBufferPool);
+    if (pBuffer == NULL)
+        pBuffer = (FP_OMX_DATABUFFER *)OSAL_ArenaAlloc(pFpComponent->hSessionArena, sizeof(FP_OMX_DATABUFFER));
+    if (pBuffer != NULL)
+        memset(pBuffer, 0, sizeof(FP_OMX_DATABUFFER));
+
+    return pBuffer;
+}
+
+/* records belong to the session arena, one that does not fit the pool is left there */
+void FP_Dec_PutSecureBuffer(FP_OMX_BASECOMPONENT *pFpComponent, FP_OMX_DATABUFFER *pBuffer)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+
+    if (pBuffer == NULL || pVideoDec->hSecureBufferPool == NULL)
+        return;
+    OSAL_Queue(pVideoDec->hSecureBufferPool, (OMX_PTR)pBuffer);
+}
+
+static void FP_Dec_DrainFramePool(FP_OMX_VIDEODEC_COMPONENT *pVideoDec)
+{
+    VPU_FRAME *pframe = NULL;
+
+    if (pVideoDec->hFramePool == NULL)
+        return;
+    while ((pframe = (VPU_FRAME *)OSAL_Dequeue(pVideoDec->hFramePool)) != NULL)
+        mpp_free(pframe);
+}
+
 OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_BOOL                  ret = OMX_FALSE;
@@ -547,7 +898,7 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
     FP_OMX_BASEPORT           *pOutputPort   = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
     FP_OMX_DATABUFFER         *outputUseBuffer = &pOutputPort->way.port2WayDataBuffer.outputDataBuffer;
     VpuCodecContext_t         *p_vpu_ctx = pVideoDec->vpu_ctx;
-    OMX_U32         pOWnBycomponetNum = GET_MPPLIST(pOutputPort->bufferQ)->list_size();
+    OMX_U32         pOWnBycomponetNum = OSAL_GetElemNum(pOutputPort->bufferQ);
     OMX_S32 maxBufferNum = 0;
     OMX_S32 i = 0, numInOmxAl = 0, limitNum = 8;
     OMX_S32 bufferUnusedInVpu = 0;
@@ -557,7 +908,7 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
         (pVideoDec->bDecSendEOS == OMX_TRUE)) {
         goto EXIT;
     }
-    maxBufferNum = pOutputPort->portDefinition.nBufferCountActual;
+    maxBufferNum = pOutputPort->nBufferSlots;
     for (i = 0; i < maxBufferNum; i++) {
         if (pOutputPort->extendBufferHeader[i].bBufferInOMX == OMX_FALSE) {
             numInOmxAl++;
@@ -576,13 +927,19 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
         int imageSize = 0;
         OMX_S32 dec_ret = 0;
         DecoderOut_t pOutput;
-        VPU_FRAME *pframe = mpp_malloc(VPU_FRAME, 1);
+        VPU_FRAME *pframe = FP_Dec_GetFrame(pVideoDec);
         OMX_BUFFERHEADERTYPE     *bufferHeader = NULL;
+        if (pframe == NULL) {
+            mpp_err("no VPU_FRAME for decode output");
+            ret = OMX_FALSE;
+            goto EXIT;
+        }
         memset(&pOutput, 0, sizeof(DecoderOut_t));
-        memset(pframe, 0, sizeof(VPU_FRAME));
         pOutput.data = (unsigned char *)pframe;
+        /* low latency takes every frame, the display does the pacing */
         if ((numInOmxAl < limitNum) ||
-            (pVideoDec->maxCount > 20)) {
+            (pVideoDec->maxCount > 20) ||
+            (pVideoDec->flags & FP_OMX_VDEC_LOW_LATENCY)) {
             dec_ret =  p_vpu_ctx->decode_getframe(p_vpu_ctx, &pOutput);
             mpp_log("pOutput.size %d", pOutput.size);
             pVideoDec->maxCount = 0;
@@ -602,10 +959,9 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
                 mpp_log("OMX_BUFFERFLAG_EOS");
             } else {
                 mpp_err("OMX_DECODER ERROR");
-                pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                             pFpComponent->callbackData, OMX_EventError,
-                                                             OUTPUT_PORT_INDEX,
-                                                             OMX_IndexParamPortDefinition, NULL);
+                FP_OMX_PostEvent(pOMXComponent,
+                                 OMX_EventError,
+                                 OUTPUT_PORT_INDEX, OMX_IndexParamPortDefinition, NULL);
             }
             FP_OutputBufferReturn(pOMXComponent, outputUseBuffer);
         }
@@ -622,7 +978,7 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
                 MUTEX_LOCK(pInputPort->secureBufferMutex);
                 FP_OMX_DATABUFFER *securebuffer = NULL;
 
-                GET_MPPLIST(pInputPort->securebufferQ)->del_at_head(&securebuffer, sizeof(FP_OMX_DATABUFFER));
+                securebuffer = (FP_OMX_DATABUFFER *)OSAL_Dequeue(pInputPort->securebufferQ);
 
                 if (securebuffer != NULL) {
 #ifdef USE_ION
@@ -632,7 +988,7 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
                     mpp_log("output secure buffer:%p", data);
 #endif
                     FP_InputBufferReturn(pOMXComponent, securebuffer);
-                    mpp_free(securebuffer);
+                    FP_Dec_PutSecureBuffer(pFpComponent, securebuffer);
                 }
                 MUTEX_UNLOCK(pInputPort->secureBufferMutex);
             }
@@ -642,14 +998,13 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
          *do not check here, ACodec will alloc large 4K size memory
          *cause lower memory fault
         */
-        if (pframe->DisplayWidth > 8192 ||  pframe->DisplayHeight > 4096) {
-            pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                         pFpComponent->callbackData,
-                                                         OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+        if (pframe->DisplayWidth > VDEC_SPS_MAX_WIDTH ||  pframe->DisplayHeight > VDEC_SPS_MAX_HEIGHT) {
+            FP_OMX_PostEvent(pOMXComponent, OMX_EventError, OMX_ErrorUndefined, 0, NULL);
             if (pframe->vpumem.phy_addr > 0) {
                 VPUMemLink(&pframe->vpumem);
                 VPUFreeLinear(&pframe->vpumem);
             }
+            FP_Dec_PutFrame(pVideoDec, pframe);
             ret = OMX_FALSE;
             goto EXIT;
         }
@@ -673,23 +1028,23 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
                 pOutputPort->newCropRectangle.nWidth = pframe->DisplayWidth;
                 pOutputPort->newCropRectangle.nHeight = pframe->DisplayHeight;
                 pOutputPort->newPortDefinition.format.video.eColorFormat = eColorFormat;
-                pOutputPort->newPortDefinition.nBufferCountActual = pOutputPort->portDefinition.nBufferCountActual;
-                pOutputPort->newPortDefinition.nBufferCountMin = pOutputPort->portDefinition.nBufferCountMin;
+                FP_Dec_OutputBufferCount(pVideoDec, pOutputPort,
+                                         &pOutputPort->newPortDefinition.nBufferCountMin,
+                                         &pOutputPort->newPortDefinition.nBufferCountActual);
                 pInputPort->newPortDefinition.format.video.nFrameWidth = pframe->DisplayWidth;
                 pInputPort->newPortDefinition.format.video.nFrameHeight = pframe->DisplayHeight;
 
                 pInputPort->newPortDefinition.format.video.nStride         = pframe->FrameWidth;
                 pInputPort->newPortDefinition.format.video.nSliceHeight    = pframe->FrameHeight;
                 FP_ResolutionUpdate(pOMXComponent);
-                pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                             pFpComponent->callbackData, OMX_EventPortSettingsChanged,
-                                                             OUTPUT_PORT_INDEX,
-                                                             OMX_IndexParamPortDefinition, NULL);
+                FP_OMX_PostEvent(pOMXComponent,
+                                 OMX_EventPortSettingsChanged,
+                                 OUTPUT_PORT_INDEX, OMX_IndexParamPortDefinition, NULL);
                 if (pframe->vpumem.phy_addr > 0) {
                     VPUMemLink(&pframe->vpumem);
                     VPUFreeLinear(&pframe->vpumem);
                 }
-                mpp_free(pframe);
+                FP_Dec_PutFrame(pVideoDec, pframe);
                 OSAL_ResetVpumemPool(pFpComponent);
                 p_vpu_ctx->control(p_vpu_ctx, VPU_API_SET_INFO_CHANGE, NULL);
                 pVideoDec->bInfoChange = OMX_TRUE;
@@ -707,6 +1062,7 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
                     VPUMemLink(&pframe->vpumem);
                     VPUFreeLinear(&pframe->vpumem);
                 }
+                FP_Dec_PutFrame(pVideoDec, pframe);
                 goto EXIT;
             }
 
@@ -726,13 +1082,14 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
                     bufferHeader->nFlags     = 0;
                 }
                 bufferHeader->nTimeStamp = pOutput.timeUs;
+                FP_Dec_TakeReorder(pFpComponent, bufferHeader, pOutput.timeUs, &bufferHeader->nFlags);
                 mpp_log("FP_OutputBufferReturn %lld", pOutput.timeUs);
             } else {
                 if (pframe->vpumem.phy_addr > 0) {
                     VPUMemLink(&pframe->vpumem);
                     VPUFreeLinear(&pframe->vpumem);
                 }
-                mpp_free(pframe);
+                FP_Dec_PutFrame(pVideoDec, pframe);
                 goto EXIT;
             }
 
@@ -748,8 +1105,8 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
             if (pOutput.size && (pframe->vpumem.phy_addr > 0)) {
                 VPUMemLink(&pframe->vpumem);
                 VPUFreeLinear(&pframe->vpumem);
-                mpp_free(pframe);
             }
+            FP_Dec_PutFrame(pVideoDec, pframe);
             outputUseBuffer->dataLen = 0;
             outputUseBuffer->remainDataLen = 0;
             outputUseBuffer->nFlags = 0;
@@ -761,10 +1118,7 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
             //pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
             //                                        pFpComponent->callbackData,
             //                                        OMX_EventError, OMX_ErrorUndefined, 0, NULL);
-            if (pframe != NULL) {
-                mpp_free(pframe);
-                pframe = NULL;
-            }
+            FP_Dec_PutFrame(pVideoDec, pframe);
             ret = OMX_FALSE;
         }
     } else {
@@ -790,10 +1144,9 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
                     mpp_err("OMX_BUFFERFLAG_EOS");
                 } else {
                     mpp_err("OMX_DECODER ERROR");
-                    pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                                 pFpComponent->callbackData, OMX_EventError,
-                                                                 OUTPUT_PORT_INDEX,
-                                                                 OMX_IndexParamPortDefinition, NULL);
+                    FP_OMX_PostEvent(pOMXComponent,
+                                     OMX_EventError,
+                                     OUTPUT_PORT_INDEX, OMX_IndexParamPortDefinition, NULL);
                 }
                 FP_OutputBufferReturn(pOMXComponent, outputUseBuffer);
             }
@@ -803,10 +1156,8 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
              *do not check here, ACodec will alloc large 4K size memory.
              *cause lower memory fault
             */
-            if (pframe.DisplayWidth > 8192 ||  pframe.DisplayHeight > 4096) {
-                pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                             pFpComponent->callbackData,
-                                                             OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+            if (pframe.DisplayWidth > VDEC_SPS_MAX_WIDTH ||  pframe.DisplayHeight > VDEC_SPS_MAX_HEIGHT) {
+                FP_OMX_PostEvent(pOMXComponent, OMX_EventError, OMX_ErrorUndefined, 0, NULL);
                 if (pframe.vpumem.phy_addr > 0) {
                     VPUMemLink(&pframe.vpumem);
                     VPUFreeLinear(&pframe.vpumem);
@@ -830,10 +1181,9 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
                     pInputPort->newPortDefinition.format.video.nSliceHeight    = pframe.DisplayHeight;
 
                     FP_ResolutionUpdate(pOMXComponent);
-                    pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                                 pFpComponent->callbackData, OMX_EventPortSettingsChanged,
-                                                                 OUTPUT_PORT_INDEX,
-                                                                 OMX_IndexParamPortDefinition, NULL);
+                    FP_OMX_PostEvent(pOMXComponent,
+                                     OMX_EventPortSettingsChanged,
+                                     OUTPUT_PORT_INDEX, OMX_IndexParamPortDefinition, NULL);
                     if (pframe.vpumem.phy_addr > 0) {
                         VPUMemLink(&pframe.vpumem);
                         VPUFreeLinear(&pframe.vpumem);
@@ -849,8 +1199,13 @@ OMX_BOOL FP_Post_OutputFrame(OMX_COMPONENTTYPE *pOMXComponent)
                 }
 
                 FP_Frame2Outbuf(pOMXComponent, outputUseBuffer->bufferHeader, &pframe);
+                if (CHECK_PORT_TUNNELED(pOutputPort) && outputUseBuffer->bufferHeader->pPlatformPrivate != NULL) {
+                    /* the tunneled encoder reads it by physical address */
+                    VPUMemClean((VPUMemLinear_t *)outputUseBuffer->bufferHeader->pPlatformPrivate);
+                }
                 outputUseBuffer->remainDataLen = pframe.DisplayHeight * pframe.DisplayWidth * 3 / 2;
                 outputUseBuffer->timeStamp = pOutput.timeUs;
+                FP_Dec_TakeReorder(pFpComponent, outputUseBuffer->bufferHeader, pOutput.timeUs, &outputUseBuffer->nFlags);
                 if (VPU_API_EOS_STREAM_REACHED == (VPU_API_ERR)pOutput.nFlags) {
                     outputUseBuffer->nFlags |= OMX_BUFFERFLAG_EOS;
                     pVideoDec->bDecSendEOS = OMX_TRUE;
@@ -905,12 +1260,11 @@ OMX_ERRORTYPE FP_OMX_InputBufferProcess(OMX_HANDLETYPE hComponent)
 
     FunctionIn();
 
-    while (!pVideoDec->bExitBufferProcessThread) {
-        usleep(0);  // release cpu-circle
+    while (!FP_OMX_LOAD(pVideoDec->bExitBufferProcessThread)) {
         FP_Wait_ProcessPause(pFpComponent, INPUT_PORT_INDEX);
         mpp_log("FP_Check_BufferProcess_State in");
         while ((FP_Check_BufferProcess_State(pFpComponent, INPUT_PORT_INDEX)) &&
-               (!pVideoDec->bExitBufferProcessThread)) {
+               (!FP_OMX_LOAD(pVideoDec->bExitBufferProcessThread))) {
 
             mpp_log("FP_OMX_InputBufferProcess in");
 
@@ -918,7 +1272,7 @@ OMX_ERRORTYPE FP_OMX_InputBufferProcess(OMX_HANDLETYPE hComponent)
                 (((FP_OMX_EXCEPTION_STATE)fpOutputPort->exceptionFlag != GENERAL_STATE) && ((FP_OMX_ERRORTYPE)ret == OMX_ErrorInputDataDecodeYet)))
                 break;
 
-            if (fpInputPort->portState != OMX_StateIdle)
+            if (FP_OMX_LOAD(fpInputPort->portState) != OMX_StateIdle)
                 break;
 
             MUTEX_LOCK(srcInputUseBuffer->bufferMutex);
@@ -941,8 +1295,11 @@ OMX_ERRORTYPE FP_OMX_InputBufferProcess(OMX_HANDLETYPE hComponent)
                 if (srcInputUseBuffer->dataValid == OMX_TRUE) {
                     if (FP_SendInputData((OMX_COMPONENTTYPE *)hComponent) != OMX_TRUE) {
                         mpp_log("stream list is full");
-                        usleep(5 * 1000);
+                        OSAL_SignalWaitReset(fpInputPort->hCodecReadyEvent, CODEC_WAIT_TIME_MS);
+                    } else {
+                        OSAL_SignalSet(fpOutputPort->hCodecReadyEvent);
                     }
+                    OSAL_ArenaReset(pFpComponent->hScratchArena);
                 }
                 if (CHECK_PORT_BEING_FLUSHED(fpInputPort)) {
                     MUTEX_UNLOCK(srcInputUseBuffer->bufferMutex);
@@ -951,8 +1308,12 @@ OMX_ERRORTYPE FP_OMX_InputBufferProcess(OMX_HANDLETYPE hComponent)
             }
             MUTEX_UNLOCK(srcInputUseBuffer->bufferMutex);
             if ((FP_OMX_ERRORTYPE)ret == OMX_ErrorCodecInit)
-                pVideoDec->bExitBufferProcessThread = OMX_TRUE;
+                FP_OMX_STORE(pVideoDec->bExitBufferProcessThread, OMX_TRUE);
         }
+
+        /* flush done and exit set hCodecReadyEvent, the rest ends on timeout */
+        if (!FP_OMX_LOAD(pVideoDec->bExitBufferProcessThread))
+            OSAL_SignalWaitReset(fpInputPort->hCodecReadyEvent, CODEC_WAIT_TIME_MS);
     }
 
 EXIT:
@@ -969,17 +1330,17 @@ OMX_ERRORTYPE FP_OMX_OutputBufferProcess(OMX_HANDLETYPE hComponent)
     OMX_COMPONENTTYPE     *pOMXComponent = (OMX_COMPONENTTYPE *)hComponent;
     FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT      *fpInputPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
     FP_OMX_BASEPORT      *fpOutputPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
     FP_OMX_DATABUFFER    *dstOutputUseBuffer = &fpOutputPort->way.port2WayDataBuffer.outputDataBuffer;
 
     FunctionIn();
 
-    while (!pVideoDec->bExitBufferProcessThread) {
-        usleep(0);
+    while (!FP_OMX_LOAD(pVideoDec->bExitBufferProcessThread)) {
         FP_Wait_ProcessPause(pFpComponent, OUTPUT_PORT_INDEX);
 
         while ((FP_Check_BufferProcess_State(pFpComponent, OUTPUT_PORT_INDEX)) &&
-               (!pVideoDec->bExitBufferProcessThread)) {
+               (!FP_OMX_LOAD(pVideoDec->bExitBufferProcessThread))) {
 
             if (CHECK_PORT_BEING_FLUSHED(fpOutputPort))
                 break;
@@ -998,13 +1359,19 @@ OMX_ERRORTYPE FP_OMX_OutputBufferProcess(OMX_HANDLETYPE hComponent)
 
             if (dstOutputUseBuffer->dataValid == OMX_TRUE) {
                 if (FP_Post_OutputFrame(pOMXComponent) != OMX_TRUE) {
-                    usleep(3 * 1000);
+                    OSAL_SignalWaitReset(fpOutputPort->hCodecReadyEvent, OUTPUT_POLL_TIME_MS);
+                } else {
+                    /* the decoder drained its stream list, let input refill it */
+                    OSAL_SignalSet(fpInputPort->hCodecReadyEvent);
                 }
             }
 
             /* reset outputData */
             MUTEX_UNLOCK(dstOutputUseBuffer->bufferMutex);
         }
+
+        if (!FP_OMX_LOAD(pVideoDec->bExitBufferProcessThread))
+            OSAL_SignalWaitReset(fpOutputPort->hCodecReadyEvent, CODEC_WAIT_TIME_MS);
     }
 
 EXIT:
@@ -1014,121 +1381,108 @@ EXIT:
     return ret;
 }
 
-static OMX_ERRORTYPE FP_OMX_InputProcessThread(OMX_PTR threadData)
+static void FP_OMX_InputProcessTask(OMX_PTR pTaskData)
 {
-    OMX_ERRORTYPE          ret = OMX_ErrorNone;
-    OMX_COMPONENTTYPE     *pOMXComponent = NULL;
-    FP_OMX_BASECOMPONENT *pFpComponent = NULL;
-    FP_OMX_MESSAGE       *message = NULL;
+    OMX_COMPONENTTYPE *pOMXComponent = (OMX_COMPONENTTYPE *)pTaskData;
 
     FunctionIn();
 
-    if (threadData == NULL) {
-        ret = OMX_ErrorBadParameter;
+    if (FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE)) != OMX_ErrorNone)
         goto EXIT;
-    }
-    pOMXComponent = (OMX_COMPONENTTYPE *)threadData;
-    ret = FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE));
-    if (ret != OMX_ErrorNone) {
-        goto EXIT;
-    }
-    pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    FP_OMX_InputBufferProcess(pOMXComponent);
 
-    pthread_exit(NULL);
+    FP_OMX_CodecThreadEnter(pOMXComponent, INPUT_PORT_INDEX);
+    FP_OMX_InputBufferProcess(pOMXComponent);
+    FP_OMX_CodecThreadLeave(pOMXComponent, INPUT_PORT_INDEX);
 
 EXIT:
     FunctionOut();
-
-    return ret;
 }
 
-static OMX_ERRORTYPE FP_OMX_OutputProcessThread(OMX_PTR threadData)
+static void FP_OMX_OutputProcessTask(OMX_PTR pTaskData)
 {
-    OMX_ERRORTYPE         ret = OMX_ErrorNone;
-    OMX_COMPONENTTYPE    *pOMXComponent = NULL;
-    FP_OMX_BASECOMPONENT *pFpComponent = NULL;
-    FP_OMX_MESSAGE       *message = NULL;
+    OMX_COMPONENTTYPE *pOMXComponent = (OMX_COMPONENTTYPE *)pTaskData;
 
     FunctionIn();
 
-    if (threadData == NULL) {
-        ret = OMX_ErrorBadParameter;
+    if (FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE)) != OMX_ErrorNone)
         goto EXIT;
-    }
-    pOMXComponent = (OMX_COMPONENTTYPE *)threadData;
-    ret = FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE));
-    if (ret != OMX_ErrorNone) {
-        goto EXIT;
-    }
-    pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    FP_OMX_OutputBufferProcess(pOMXComponent);
 
-    pthread_exit(NULL);
+    FP_OMX_CodecThreadEnter(pOMXComponent, OUTPUT_PORT_INDEX);
+    FP_OMX_OutputBufferProcess(pOMXComponent);
+    FP_OMX_CodecThreadLeave(pOMXComponent, OUTPUT_PORT_INDEX);
 
 EXIT:
     FunctionOut();
-
-    return ret;
 }
 
-OMX_ERRORTYPE FP_OMX_BufferProcess_Create(OMX_COMPONENTTYPE *pOMXComponent)
+OMX_ERRORTYPE FP_OMX_BufferProcess_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
 {
-    OMX_ERRORTYPE               ret         = OMX_ErrorNone;
-    FP_OMX_BASECOMPONENT      *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    FP_OMX_VIDEODEC_COMPONENT *pVideoDec    = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    OMX_ERRORTYPE          ret = OMX_ErrorNone;
+    FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
 
     FunctionIn();
 
-    pVideoDec->bExitBufferProcessThread = OMX_FALSE;
+    FP_OMX_STORE(pVideoDec->bExitBufferProcessThread, OMX_TRUE);
 
-    pVideoDec->hOutputThread = new MppThread((MppThreadFunc)FP_OMX_OutputProcessThread, pOMXComponent);
+    OSAL_QueueWake(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].bufferQ);
+    OSAL_SignalSet(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].pauseEvent);
+    OSAL_SignalSet(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].hCodecReadyEvent);
 
-    pVideoDec->hInputThread  = new MppThread((MppThreadFunc)FP_OMX_InputProcessThread, pOMXComponent); 
+    OSAL_QueueWake(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].bufferQ);
+    OSAL_SignalSet(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].pauseEvent);
+    OSAL_SignalSet(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].hCodecReadyEvent);
+
+    /* returns once the loop has, the caller frees the port mutexes it uses next */
+    if (pVideoDec->hInputQueue != NULL) {
+        OSAL_SerialQueueTerminate(pVideoDec->hInputQueue);
+        pVideoDec->hInputQueue = NULL;
+    }
+    if (pVideoDec->hOutputQueue != NULL) {
+        OSAL_SerialQueueTerminate(pVideoDec->hOutputQueue);
+        pVideoDec->hOutputQueue = NULL;
+    }
+
+    pFpComponent->checkTimeStamp.needSetStartTimeStamp = OMX_FALSE;
+    pFpComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
 
-EXIT:
     FunctionOut();
 
     return ret;
 }
 
-OMX_ERRORTYPE FP_OMX_BufferProcess_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
+/*
+ * The input and output loops run on the codec pool, each on a serial queue
+ * of its own. A loop holds its worker until FP_OMX_BufferProcess_Terminate.
+ */
+OMX_ERRORTYPE FP_OMX_BufferProcess_Create(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
     FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
-    OMX_S32                countValue = 0;
-    unsigned int           i = 0;
 
     FunctionIn();
 
-    pVideoDec->bExitBufferProcessThread = OMX_TRUE;
-
-    OSAL_Get_SemaphoreCount(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].bufferSemID, &countValue);
-    if (countValue == 0)
-        OSAL_SemaphorePost(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].bufferSemID);
+    FP_OMX_STORE(pVideoDec->bExitBufferProcessThread, OMX_FALSE);
 
-    OSAL_SignalSet(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].pauseEvent);
-
-    delete (MppThread *)pVideoDec->hInputThread;
-    pVideoDec->hInputThread = NULL;
-
-    OSAL_Get_SemaphoreCount(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].bufferSemID, &countValue);
-    if (countValue == 0)
-        OSAL_SemaphorePost(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].bufferSemID);
-
-
-    OSAL_SignalSet(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].pauseEvent);
-
-    OSAL_SignalSet(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].pauseEvent);
-    
-    delete (MppThread *)(pVideoDec->hOutputThread);
-    pVideoDec->hOutputThread = NULL;
+    ret = OSAL_SerialQueueCreate(&pVideoDec->hOutputQueue, OSAL_TASK_POOL_CODEC, 1);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+    ret = OSAL_SerialQueueCreate(&pVideoDec->hInputQueue, OSAL_TASK_POOL_CODEC, 1);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
 
-    pFpComponent->checkTimeStamp.needSetStartTimeStamp = OMX_FALSE;
-    pFpComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
+    ret = OSAL_SerialQueueSubmit(pVideoDec->hOutputQueue, FP_OMX_OutputProcessTask, pOMXComponent);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+    ret = OSAL_SerialQueueSubmit(pVideoDec->hInputQueue, FP_OMX_InputProcessTask, pOMXComponent);
 
 EXIT:
+    if (ret != OMX_ErrorNone) {
+        mpp_err("start codec loops failed, ret 0x%x", ret);
+        FP_OMX_BufferProcess_Terminate(pOMXComponent);
+        ret = OMX_ErrorInsufficientResources;
+    }
     FunctionOut();
 
     return ret;
@@ -1230,6 +1584,21 @@ OMX_ERRORTYPE FP_Dec_ComponentInit(OMX_COMPONENTTYPE *pOMXComponent)
     pVideoDec->bFirstFrame = OMX_TRUE;
     pVideoDec->maxCount = 0;
     pVideoDec->bInfoChange = OMX_FALSE;
+    pVideoDec->nDpbFrames = 0;
+
+    if (pVideoDec->hFramePool != NULL) {
+        FP_OMX_BASEPORT *pFpOutputPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
+        OMX_U32 nFrames = pFpOutputPort->portDefinition.nBufferCountActual + VDEC_FRAME_POOL_DPB_NUM;
+        OMX_U32 n = 0;
+
+        for (n = OSAL_GetElemNum(pVideoDec->hFramePool); n < nFrames; n++) {
+            VPU_FRAME *pframe = mpp_malloc(VPU_FRAME, 1);
+            if (pframe == NULL)
+                break;
+            pVideoDec->nFrameAllocCount++;
+            FP_Dec_PutFrame(pVideoDec, pframe);
+        }
+    }
 
     if (rga_dev_open(&pVideoDec->rga_ctx)  < 0) {
         mpp_err("open rga device fail!");
@@ -1305,6 +1674,16 @@ OMX_ERRORTYPE FP_Dec_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
 #if 1
     OSAL_Closevpumempool(pFpComponent);
 #endif
+    /* frames still on output headers come back when the buffers are freed */
+    FP_Dec_DrainFramePool(pVideoDec);
+
+    if (pVideoDec->pFrameAsm != NULL) {
+        mpp_free(pVideoDec->pFrameAsm);
+        pVideoDec->pFrameAsm = NULL;
+        pVideoDec->nFrameAsmSize = 0;
+    }
+    FP_Dec_ResetFrameAsm(pVideoDec);
+    pVideoDec->bEndOfFrameSeen = OMX_FALSE;
     FP_ResetAllPortConfig(pOMXComponent);
 
 EXIT:
@@ -1361,6 +1740,25 @@ OMX_ERRORTYPE FP_OMX_ComponentConstructor(OMX_HANDLETYPE hComponent, OMX_STRING
 
     memset(pVideoDec, 0, sizeof(FP_OMX_VIDEODEC_COMPONENT));
 
+    if (OSAL_QueueCreate(&pVideoDec->hFramePool, VDEC_FRAME_POOL_MAX, OMX_FALSE) != OMX_ErrorNone) {
+        mpp_err("frame pool create fail, frames come from the heap");
+        pVideoDec->hFramePool = NULL;
+    }
+    if (OSAL_QueueCreate(&pVideoDec->hSecureBufferPool, PORT_BUFFER_NUM_MAX, OMX_FALSE) != OMX_ErrorNone) {
+        mpp_err("secure buffer pool create fail, records are not reused");
+        pVideoDec->hSecureBufferPool = NULL;
+    }
+    {
+        /* copy mode output is split over this many threads above OSAL_REPACK_SPLIT_BYTES */
+        char value[PROPERTY_VALUE_MAX];
+        memset(value, 0, sizeof(value));
+        property_get("omx_dec_repack_threads", value, "2");
+        if (OSAL_RepackCreate(&pVideoDec->hRepack, (OMX_U32)atoi(value)) != OMX_ErrorNone) {
+            mpp_err("repack create fail, output copies stay on the output thread");
+            pVideoDec->hRepack = NULL;
+        }
+    }
+
 #ifdef USE_ION
     pVideoDec->hSharedMemory = OSAL_SharedMemory_Open();
     if (pVideoDec->hSharedMemory == NULL) {
@@ -1386,6 +1784,7 @@ OMX_ERRORTYPE FP_OMX_ComponentConstructor(OMX_HANDLETYPE hComponent, OMX_STRING
     pVideoDec->bPvr_Flag = OMX_FALSE;
     pVideoDec->bFastMode = OMX_FALSE;
     pVideoDec->bPrintFps = OMX_FALSE;
+    pVideoDec->bPrintLatency = OMX_FALSE;
     pVideoDec->bPrintBufferPosition = OMX_FALSE;
     pVideoDec->bGtsMediaTest = OMX_FALSE;
     pVideoDec->bGtsExoTest = OMX_FALSE;
@@ -1485,6 +1884,10 @@ OMX_ERRORTYPE FP_OMX_ComponentConstructor(OMX_HANDLETYPE hComponent, OMX_STRING
     pFpComponent->fp_BufferProcessTerminate = &FP_OMX_BufferProcess_Terminate;
     pFpComponent->fp_BufferFlush            = &FP_OMX_BufferFlush;
 
+    /* the output thread copies decoded frames out, keep it on the fast cores */
+    pFpComponent->codecThreadRole[INPUT_PORT_INDEX]  = OSAL_THREAD_ROLE_CONTROL;
+    pFpComponent->codecThreadRole[OUTPUT_PORT_INDEX] = OSAL_THREAD_ROLE_COPY;
+
     pFoilplanetPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
     if (!strcmp(componentName, FP_OMX_COMPONENT_H264_DEC)) {
         memset(pFoilplanetPort->portDefinition.format.video.cMIMEType, 0, MAX_OMX_MIMETYPE_SIZE);
@@ -1704,6 +2107,27 @@ OMX_ERRORTYPE FP_OMX_ComponentDeInit(OMX_HANDLETYPE hComponent)
         property_set("use_mpp_mode", "0");
     }
 
+    if (pVideoDec->hFramePool != NULL) {
+        FP_Dec_DrainFramePool(pVideoDec);
+        OSAL_QueueTerminate(pVideoDec->hFramePool);
+        pVideoDec->hFramePool = NULL;
+    }
+    mpp_log("decode frame descriptors allocated %d", FP_Dec_FrameAllocCount(pVideoDec));
+    if (pVideoDec->hSecureBufferPool != NULL) {
+        OSAL_QueueTerminate(pVideoDec->hSecureBufferPool);
+        pVideoDec->hSecureBufferPool = NULL;
+    }
+    if (pVideoDec->hRepack != NULL) {
+        OSAL_RepackTerminate(pVideoDec->hRepack);
+        pVideoDec->hRepack = NULL;
+    }
+    if (pVideoDec->nLatencyCount > 0) {
+        mpp_log("decode latency %d frames, avg %lld us, max %lld us",
+                pVideoDec->nLatencyCount,
+                (long long)(pVideoDec->nLatencySum / pVideoDec->nLatencyCount),
+                (long long)pVideoDec->nLatencyMax);
+    }
+
     mpp_free(pVideoDec);
     pFpComponent->hComponentHandle = pVideoDec = NULL;
 
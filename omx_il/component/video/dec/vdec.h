@@ -37,6 +37,27 @@
 
 #define INPUT_PORT_SUPPORTFORMAT_NUM_MAX    1
 
+/* input sizing: a coded frame is at most raw / MinCR and fits in the level's CPB */
+#define VDEC_INPUT_MIN_CR                   2
+#define VDEC_INPUT_BUFFER_SIZE_MIN          (64 * 1024)
+#define VDEC_INPUT_POOL_SIZE                (8 * 1024 * 1024)
+#define VDEC_INPUT_BUFFER_NUM_MAX           8
+/* low latency: one frame being decoded, one being filled */
+#define VDEC_LOW_LATENCY_INPUT_NUM          2
+/* frames split over several input buffers are put together up to this size */
+#define VDEC_INPUT_FRAME_SIZE_MAX           (64 * 1024 * 1024)
+
+/* VPU_FRAME descriptors kept for reuse: DPB plus the output buffers */
+#define VDEC_FRAME_POOL_DPB_NUM             16
+#define VDEC_FRAME_POOL_MAX                 (PORT_BUFFER_NUM_MAX + VDEC_FRAME_POOL_DPB_NUM)
+
+/* frames the vpu holds beyond the DPB: decode target, deinterlace reference, copy out */
+#define VDEC_DPB_EXTRA_NUM                  3
+/* output buffers on top of the minimum for the display pipeline */
+#define VDEC_DISPLAY_EXTRA_NUM              4
+/* internal frame pool of BUFFER_COPY mode when the SPS is unknown */
+#define VDEC_COPY_POOL_DEFAULT_NUM          8
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -66,6 +87,7 @@ typedef enum _FP_OMX_VDEC_FLAG_MAP {
     FP_OMX_VDEC_IS_DIV3      = 0x01,
     FP_OMX_VDEC_USE_DTS      = 0x02,
     FP_OMX_VDEC_THUMBNAIL    = 0x04,
+    FP_OMX_VDEC_LOW_LATENCY  = 0x08,
     FP_OMX_VDEC_BUTT,
 } FP_OMX_VDEC_FLAG_MAP;
 
@@ -77,8 +99,8 @@ typedef struct _FP_OMX_VIDEODEC_COMPONENT {
 
     /* Buffer Process */
     OMX_BOOL       bExitBufferProcessThread;
-    OMX_HANDLETYPE hInputThread;
-    OMX_HANDLETYPE hOutputThread;
+    OMX_HANDLETYPE hInputQueue;        /* codec pool serial queues running the loops */
+    OMX_HANDLETYPE hOutputQueue;
 
     OMX_VIDEO_CODINGTYPE codecId;
 
@@ -111,6 +133,27 @@ typedef struct _FP_OMX_VIDEODEC_COMPONENT {
     OMX_BOOL bStoreMetaData;
     OMX_BOOL bPvr_Flag;
     OMX_PTR  vpumem_handle;
+    OMX_U32  nDpbFrames;            /* from the SPS, 0 until known */
+
+    /* Input sizing */
+    OMX_U32  nInputLevel;           /* OMX level of the stream, 0 when not given */
+    OMX_U32  nInputSizeHint;        /* nBufferSize / count the client asked for, 0 if none */
+    OMX_U32  nInputCountHint;
+
+    /* Input frames split over several buffers without OMX_BUFFERFLAG_ENDOFFRAME */
+    OMX_U8  *pFrameAsm;
+    OMX_U32  nFrameAsmLen;
+    OMX_U32  nFrameAsmSize;
+    OMX_BOOL bFrameAsmReady;        /* complete, waiting for the vpu to take it */
+    OMX_BOOL bEndOfFrameSeen;       /* the client marks frame ends */
+    OMX_HANDLETYPE hFramePool;      /* free VPU_FRAME descriptors */
+    OMX_U32  nFrameAllocCount;      /* descriptors taken from the heap, flat in steady state */
+    OMX_HANDLETYPE hSecureBufferPool;   /* free DRM input records, backed by the session arena */
+    OMX_HANDLETYPE hRepack;             /* stride repack of copy mode output, may be NULL */
+    /* FP_OMX_VDEC_LOW_LATENCY, sendstream to getframe */
+    OMX_U32  nLatencyCount;
+    OMX_U64  nLatencySum;           /* us */
+    OMX_U64  nLatencyMax;
     OMX_U32 maxCount; // when buffer in AL big than 8,if max timeout no consume we continue send one buffer to AL
     OMX_BOOL bOld_api;
     OMX_BOOL b4K_flags;
@@ -130,6 +173,7 @@ typedef struct _FP_OMX_VIDEODEC_COMPONENT {
     /* For debug */
     FILE *fp_in;
     OMX_BOOL bPrintFps;
+    OMX_BOOL bPrintLatency;
     OMX_BOOL bPrintBufferPosition;
     OMX_BOOL bGtsMediaTest;
     OMX_BOOL bGtsExoTest;
@@ -151,6 +195,13 @@ OMX_BOOL FP_Check_BufferProcess_State(FP_OMX_BASECOMPONENT *pRockchipComponent,
 
 OMX_ERRORTYPE FP_OMX_InputBufferProcess(OMX_HANDLETYPE hComponent);
 OMX_ERRORTYPE FP_OMX_OutputBufferProcess(OMX_HANDLETYPE hComponent);
+void FP_Dec_UpdateInputBufferSize(FP_OMX_BASECOMPONENT *pFpComponent);
+void FP_Dec_ResetFrameAsm(FP_OMX_VIDEODEC_COMPONENT *pVideoDec);
+VPU_FRAME *FP_Dec_GetFrame(FP_OMX_VIDEODEC_COMPONENT *pVideoDec);
+void FP_Dec_PutFrame(FP_OMX_VIDEODEC_COMPONENT *pVideoDec, VPU_FRAME *pframe);
+OMX_U32 FP_Dec_FrameAllocCount(FP_OMX_VIDEODEC_COMPONENT *pVideoDec);
+FP_OMX_DATABUFFER *FP_Dec_GetSecureBuffer(FP_OMX_BASECOMPONENT *pFpComponent);
+void FP_Dec_PutSecureBuffer(FP_OMX_BASECOMPONENT *pFpComponent, FP_OMX_DATABUFFER *pBuffer);
 OMX_ERRORTYPE FP_Dec_ComponentInit(OMX_COMPONENTTYPE *pOMXComponent);
 OMX_ERRORTYPE FP_Dec_Terminate(OMX_COMPONENTTYPE *pOMXComponent);
 
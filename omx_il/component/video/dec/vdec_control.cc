@@ -25,6 +25,7 @@
 #include "OMX_Macros.h"
 #include "OMX_Def.h"
 #include "Foilplanet_OMX_Basecomponent.h"
+#include "Foilplanet_OMX_Tunnel.h"
 
 #include "vdec.h"
 #include "vdec_control.h"
@@ -42,6 +43,8 @@
 #endif
 
 #include "osal_event.h"
+#include "osal_queue.h"
+#include "osal_repack.h"
 #include "osal/mpp_list.h"
 #include "osal/mpp_log.h"
 #include "osal/mpp_mem.h"
@@ -147,6 +150,80 @@ static const CodecProfileLevel kH265ProfileLevels[] = {
     { OMX_VIDEO_HEVCProfileMain10, OMX_VIDEO_HEVCMainTierLevel51 },
 };
 
+/* MaxCPB in 1000 bits, indexed by the bit of the OMX level */
+static const OMX_U32 kH264MaxCpb[] = {
+    175, 350, 500, 1000, 2000, 2000, 4000, 4000, 10000,
+    14000, 20000, 25000, 62500, 62500, 135000, 240000, 240000,
+};
+
+/* main and high tier alternate, as in OMX_VIDEO_HEVCLEVELTYPE */
+static const OMX_U32 kH265MaxCpb[] = {
+    350, 350, 1500, 1500, 3000, 3000, 6000, 6000, 10000, 10000,
+    12000, 30000, 20000, 50000, 25000, 100000, 40000, 160000, 60000, 240000,
+    60000, 240000, 120000, 480000, 240000, 800000,
+};
+
+/* largest coded frame the level allows, 0 when the level is unknown */
+static OMX_U32 FP_Dec_MaxCpbBytes(FP_OMX_VIDEODEC_COMPONENT *pVideoDec)
+{
+    OMX_U32 index;
+
+    if (pVideoDec->nInputLevel == 0)
+        return 0;
+    index = __builtin_ctz(pVideoDec->nInputLevel);
+
+    /* NAL HRD factor 1.2, times 1.25 for the high profiles */
+    if (pVideoDec->codecId == OMX_VIDEO_CodingAVC &&
+        index < sizeof(kH264MaxCpb) / sizeof(kH264MaxCpb[0]))
+        return kH264MaxCpb[index] * 1500 / 8;
+    if (pVideoDec->codecId == OMX_VIDEO_CodingHEVC &&
+        index < sizeof(kH265MaxCpb) / sizeof(kH265MaxCpb[0]))
+        return kH265MaxCpb[index] * 1100 / 8;
+
+    return 0;
+}
+
+/*
+ * Input buffers hold one coded frame: raw size / MinCR, no more than the
+ * level's CPB, no less than what the client asked for. Small buffers get
+ * more of them to absorb bitrate peaks, frames that still do not fit are
+ * put together from several buffers (FP_Dec_AssembleFrame).
+ */
+void FP_Dec_UpdateInputBufferSize(FP_OMX_BASECOMPONENT *pFpComponent)
+{
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT           *pInputPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
+    OMX_U32 width = pInputPort->portDefinition.format.video.nFrameWidth;
+    OMX_U32 height = pInputPort->portDefinition.format.video.nFrameHeight;
+    OMX_U32 size, cpb, count;
+
+    size = Get_Video_HorAlign(pVideoDec->codecId, width, height) *
+           Get_Video_VerAlign(pVideoDec->codecId, height) * 3 / 2 / VDEC_INPUT_MIN_CR;
+    cpb = FP_Dec_MaxCpbBytes(pVideoDec);
+    if (cpb != 0 && cpb < size)
+        size = cpb;
+    if (size < VDEC_INPUT_BUFFER_SIZE_MIN)
+        size = VDEC_INPUT_BUFFER_SIZE_MIN;
+    if (size < pVideoDec->nInputSizeHint)
+        size = pVideoDec->nInputSizeHint;
+    size = (size + 4095) & ~4095;
+
+    count = VDEC_INPUT_POOL_SIZE / size;
+    /* every queued input is a frame of delay */
+    if (pVideoDec->flags & FP_OMX_VDEC_LOW_LATENCY)
+        count = pInputPort->portDefinition.nBufferCountMin;
+    if (count < pInputPort->portDefinition.nBufferCountMin)
+        count = pInputPort->portDefinition.nBufferCountMin;
+    if (count > VDEC_INPUT_BUFFER_NUM_MAX)
+        count = VDEC_INPUT_BUFFER_NUM_MAX;
+    if (pVideoDec->nInputCountHint != 0)
+        count = pVideoDec->nInputCountHint;
+
+    pInputPort->portDefinition.nBufferSize = size;
+    pInputPort->portDefinition.nBufferCountActual = count;
+    mpp_log("input buffers %d x %d bytes, level 0x%x", count, size, pVideoDec->nInputLevel);
+}
+
 
 OMX_ERRORTYPE FP_OMX_UseBuffer(
     OMX_IN    OMX_HANDLETYPE         hComponent,
@@ -186,7 +263,7 @@ OMX_ERRORTYPE FP_OMX_UseBuffer(
         ret = OMX_ErrorBadPortIndex;
         goto EXIT;
     }
-    if (pFoilplanetPort->portState != OMX_StateIdle) {
+    if (FP_OMX_TunnelAcceptsBuffer(pFpComponent, pFoilplanetPort) != OMX_TRUE) {
         ret = OMX_ErrorIncorrectStateOperation;
         goto EXIT;
     }
@@ -196,6 +273,10 @@ OMX_ERRORTYPE FP_OMX_UseBuffer(
         goto EXIT;
     }
 
+    ret = FP_OMX_PortReserveBuffers(pFoilplanetPort);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
     temp_bufferHeader = mpp_malloc(OMX_BUFFERHEADERTYPE, 1);
     if (temp_bufferHeader == NULL) {
         ret = OMX_ErrorInsufficientResources;
@@ -220,9 +301,15 @@ OMX_ERRORTYPE FP_OMX_UseBuffer(
                 temp_bufferHeader->nOutputPortIndex = OUTPUT_PORT_INDEX;
             }
 
+            FP_OMX_StampBufferHeader(pFoilplanetPort, i);
+
             pFoilplanetPort->assignedBufferNum++;
             if (pFoilplanetPort->assignedBufferNum == pFoilplanetPort->portDefinition.nBufferCountActual) {
                 pFoilplanetPort->portDefinition.bPopulated = OMX_TRUE;
+#ifdef USE_ANB
+                if (nPortIndex == OUTPUT_PORT_INDEX)
+                    OSAL_ANBTryShare(pFpComponent);
+#endif
                 /* MUTEX_LOCK(pFoilplanetPort->compMutex); */
                 OSAL_SemaphorePost(pFoilplanetPort->loadedResource);
                 /* MUTEX_UNLOCK(pFoilplanetPort->compMutex); */
@@ -286,7 +373,7 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
         goto EXIT;
     }
     /*
-        if (pFoilplanetPort->portState != OMX_StateIdle ) {
+        if (FP_OMX_LOAD(pFoilplanetPort->portState) != OMX_StateIdle ) {
             ret = OMX_ErrorIncorrectStateOperation;
             goto EXIT;
         }
@@ -296,6 +383,10 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
         goto EXIT;
     }
 
+    ret = FP_OMX_PortReserveBuffers(pFoilplanetPort);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
 #if 0
     MEMORY_TYPE mem_type = NORMAL_MEMORY;
     if ((pVideoDec->bDRMPlayerMode == OMX_TRUE) && (nPortIndex == INPUT_PORT_INDEX)) {
@@ -335,7 +426,7 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
     for (i = 0; i < pFoilplanetPort->portDefinition.nBufferCountActual; i++) {
         if (pFoilplanetPort->bufferStateAllocate[i] == BUFFER_STATE_FREE) {
             pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader = temp_bufferHeader;
-            pFoilplanetPort->extendBufferHeader[i].buf_fd[0] = temp_buffer_fd;
+            FP_OMX_SetBufferFd(pFoilplanetPort, i, temp_buffer_fd);
             pFoilplanetPort->bufferStateAllocate[i] = (BUFFER_STATE_ALLOCATED | HEADER_STATE_ALLOCATED);
             INIT_SET_SIZE_VERSION(temp_bufferHeader, OMX_BUFFERHEADERTYPE);
             temp_bufferHeader->pBuffer        = temp_buffer;
@@ -345,6 +436,7 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
                 temp_bufferHeader->nInputPortIndex = INPUT_PORT_INDEX;
             else
                 temp_bufferHeader->nOutputPortIndex = OUTPUT_PORT_INDEX;
+            FP_OMX_StampBufferHeader(pFoilplanetPort, i);
             pFoilplanetPort->assignedBufferNum++;
             if (pFoilplanetPort->assignedBufferNum == pFoilplanetPort->portDefinition.nBufferCountActual) {
                 pFoilplanetPort->portDefinition.bPopulated = OMX_TRUE;
@@ -409,16 +501,11 @@ OMX_ERRORTYPE FP_OMX_FreeBuffer(
         goto EXIT;
     }
 
-    if ((pFoilplanetPort->portState != OMX_StateLoaded) && (pFoilplanetPort->portState != OMX_StateInvalid)) {
-        (*(pFpComponent->pCallbacks->EventHandler))(
-            pOMXComponent,
-            pFpComponent->callbackData,
-            OMX_EventError,
-            (OMX_U32)OMX_ErrorPortUnpopulated,
-            nPortIndex, NULL);
+    if ((FP_OMX_LOAD(pFoilplanetPort->portState) != OMX_StateLoaded) && (FP_OMX_LOAD(pFoilplanetPort->portState) != OMX_StateInvalid)) {
+        FP_OMX_PostEvent(pOMXComponent, OMX_EventError, (OMX_U32)OMX_ErrorPortUnpopulated, nPortIndex, NULL);
     }
 
-    for (i = 0; i < /*pFoilplanetPort->portDefinition.nBufferCountActual*/MAX_BUFFER_NUM; i++) {
+    for (i = 0; i < pFoilplanetPort->nBufferSlots; i++) {
         if (((pFoilplanetPort->bufferStateAllocate[i] | BUFFER_STATE_FREE) != 0) && (pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader != NULL)) {
             if (pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader->pBuffer == pBufferHdr->pBuffer) {
                 if (pFoilplanetPort->bufferStateAllocate[i] & BUFFER_STATE_ALLOCATED) {
@@ -435,6 +522,8 @@ OMX_ERRORTYPE FP_OMX_FreeBuffer(
                     pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader = NULL;
                     pBufferHdr = NULL;
                 }
+                pFoilplanetPort->extendBufferHeader[i].nGeneration = 0;
+                FP_OMX_SetBufferFd(pFoilplanetPort, i, 0);
                 pFoilplanetPort->bufferStateAllocate[i] = BUFFER_STATE_FREE;
                 ret = OMX_ErrorNone;
                 goto EXIT;
@@ -460,23 +549,12 @@ EXIT:
 
 OMX_ERRORTYPE FP_OMX_AllocateTunnelBuffer(FP_OMX_BASEPORT *pOMXBasePort, OMX_U32 nPortIndex)
 {
-    OMX_ERRORTYPE ret = OMX_ErrorNone;
-    (void) pOMXBasePort;
-    (void) nPortIndex;
-
-    ret = OMX_ErrorTunnelingUnsupported;
-EXIT:
-    return ret;
+    return FP_OMX_TunnelAllocateBuffer(pOMXBasePort, nPortIndex);
 }
 
 OMX_ERRORTYPE FP_OMX_FreeTunnelBuffer(FP_OMX_BASEPORT *pOMXBasePort, OMX_U32 nPortIndex)
 {
-    OMX_ERRORTYPE                 ret = OMX_ErrorNone;
-    (void) pOMXBasePort;
-    (void) nPortIndex;
-    ret = OMX_ErrorTunnelingUnsupported;
-EXIT:
-    return ret;
+    return FP_OMX_TunnelFreeBuffer(pOMXBasePort, nPortIndex);
 }
 
 OMX_ERRORTYPE FP_OMX_ComponentTunnelRequest(
@@ -486,15 +564,7 @@ OMX_ERRORTYPE FP_OMX_ComponentTunnelRequest(
     OMX_IN OMX_U32        nTunneledPort,
     OMX_INOUT OMX_TUNNELSETUPTYPE *pTunnelSetup)
 {
-    OMX_ERRORTYPE ret = OMX_ErrorNone;
-    (void) hComp;
-    (void) nPort;
-    (void) hTunneledComp;
-    (void) nTunneledPort;
-    (void) pTunnelSetup;
-    ret = OMX_ErrorTunnelingUnsupported;
-EXIT:
-    return ret;
+    return FP_OMX_TunnelRequest(hComp, nPort, hTunneledComp, nTunneledPort, pTunnelSetup);
 }
 
 OMX_ERRORTYPE FP_OMX_GetFlushBuffer(FP_OMX_BASEPORT *pFoilplanetPort, FP_OMX_DATABUFFER *pDataBuffer[])
@@ -528,20 +598,14 @@ OMX_ERRORTYPE FP_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portInd
     FP_OMX_DATABUFFER    *pDataPortBuffer[2] = {NULL, NULL};
     FP_OMX_MESSAGE       *message = NULL;
     OMX_U32               flushNum = 0;
-    OMX_S32               semValue = 0;
     int i = 0, maxBufferNum = 0;
     FunctionIn();
 
     pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
 
-    while (GET_MPPLIST(pFoilplanetPort->bufferQ)->list_size() > 0) {
-        OSAL_Get_SemaphoreCount(pFpComponent->pFoilplanetPort[portIndex].bufferSemID, &semValue);
-        if (semValue == 0)
-            OSAL_SemaphorePost(pFpComponent->pFoilplanetPort[portIndex].bufferSemID);
-
-        OSAL_SemaphoreWait(pFpComponent->pFoilplanetPort[portIndex].bufferSemID);
-        GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE));
-        if ((message != NULL) && (message->messageType != FP_OMX_CommandFakeBuffer)) {
+    /* the codec thread is parked on the port buffer mutexes, drain the queue directly */
+    while ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) != NULL) {
+        if (message->messageType != FP_OMX_CommandFakeBuffer) {
             bufferHeader = (OMX_BUFFERHEADERTYPE *)message->pCmdData;
             bufferHeader->nFilledLen = 0;
 
@@ -551,7 +615,7 @@ OMX_ERRORTYPE FP_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portInd
                 FP_OMX_InputBufferReturn(pOMXComponent, bufferHeader);
             }
         }
-        mpp_free(message);
+        FP_OMX_PortMessageFree(pFoilplanetPort, message);
         message = NULL;
     }
 
@@ -579,12 +643,12 @@ OMX_ERRORTYPE FP_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portInd
             }
             FP_ResetCodecData(&pFoilplanetPort->processData);
 
-            maxBufferNum = pFoilplanetPort->portDefinition.nBufferCountActual;
+            maxBufferNum = pFoilplanetPort->nBufferSlots;
             for (i = 0; i < maxBufferNum; i++) {
                 pFoilplanetPort->extendBufferHeader[i].pRegisterFlag = 0;
-                pFoilplanetPort->extendBufferHeader[i].buf_fd[0] = 0;
+                FP_OMX_SetBufferFd(pFoilplanetPort, i, 0);
                 if (pFoilplanetPort->extendBufferHeader[i].pPrivate != NULL) {
-                    OSAL_FreeVpumem(pFoilplanetPort->extendBufferHeader[i].pPrivate);
+                    OSAL_FreeVpumem(pFpComponent, pFoilplanetPort->extendBufferHeader[i].pPrivate);
                     pFoilplanetPort->extendBufferHeader[i].pPrivate = NULL;
                 }
 
@@ -613,16 +677,6 @@ OMX_ERRORTYPE FP_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portInd
         pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
     }
 
-    while (1) {
-        OMX_S32 cnt = 0;
-        OSAL_Get_SemaphoreCount(pFpComponent->pFoilplanetPort[portIndex].bufferSemID, &cnt);
-        if (cnt <= 0)
-            break;
-        OSAL_SemaphoreWait(pFpComponent->pFoilplanetPort[portIndex].bufferSemID);
-    }
-
-    // node_destructor ?
-    GET_MPPLIST(pFoilplanetPort->bufferQ)->flush();
 
 EXIT:
     FunctionOut();
@@ -660,7 +714,7 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
     pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
     pInputPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
 
-    pFpComponent->pFoilplanetPort[nPortIndex].bIsPortFlushed = OMX_TRUE;
+    FP_OMX_STORE(pFpComponent->pFoilplanetPort[nPortIndex].bIsPortFlushed, OMX_TRUE);
 
     if (pFpComponent->bMultiThreadProcess == OMX_FALSE) {
         OSAL_SignalSet(pFpComponent->pauseEvent);
@@ -671,7 +725,7 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
     pFoilplanetPort = &pFpComponent->pFoilplanetPort[nPortIndex];
     FP_OMX_GetFlushBuffer(pFoilplanetPort, flushPortBuffer);
 
-    OSAL_SemaphorePost(pFoilplanetPort->bufferSemID);
+    OSAL_QueueWake(pFoilplanetPort->bufferQ);
     
     MUTEX_LOCK(flushPortBuffer[0]->bufferMutex);
     MUTEX_LOCK(flushPortBuffer[1]->bufferMutex);
@@ -692,14 +746,16 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
 
     MUTEX_LOCK(pInputPort->secureBufferMutex);
     if (pVideoDec->bDRMPlayerMode == OMX_TRUE && pVideoDec->bInfoChange == OMX_FALSE) {
-        int securebufferNum = GET_MPPLIST(pInputPort->securebufferQ)->list_size();
+        int securebufferNum = OSAL_GetElemNum(pInputPort->securebufferQ);
         mpp_log("FP_OMX_BufferFlush in securebufferNum = %d", securebufferNum);
         while (securebufferNum != 0) {
             FP_OMX_DATABUFFER *securebuffer = NULL;
-            GET_MPPLIST(pInputPort->securebufferQ)->del_at_head(&securebuffer, sizeof(FP_OMX_DATABUFFER));
+            securebuffer = (FP_OMX_DATABUFFER *)OSAL_Dequeue(pInputPort->securebufferQ);
+            if (securebuffer == NULL)
+                break;
             FP_InputBufferReturn(pOMXComponent, securebuffer);
-            mpp_free(securebuffer);
-            securebufferNum = GET_MPPLIST(pInputPort->securebufferQ)->list_size();
+            FP_Dec_PutSecureBuffer(pFpComponent, securebuffer);
+            securebufferNum = OSAL_GetElemNum(pInputPort->securebufferQ);
         }
         mpp_log("FP_OMX_BufferFlush out securebufferNum = %d", securebufferNum);
     }
@@ -709,8 +765,8 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
         if (nPortIndex == INPUT_PORT_INDEX) {
             pFpComponent->checkTimeStamp.needSetStartTimeStamp = OMX_TRUE;
             pFpComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
-            memset(pFpComponent->timeStamp, -19771003, sizeof(OMX_TICKS) * MAX_TIMESTAMP);
-            memset(pFpComponent->nFlags, 0, sizeof(OMX_U32) * MAX_FLAGS);
+            OSAL_ReorderReset(pFpComponent->hReorderMap);
+            FP_Dec_ResetFrameAsm(pVideoDec);
             pFpComponent->getAllDelayBuffer = OMX_FALSE;
             pFpComponent->bSaveFlagEOS = OMX_FALSE;
             pFpComponent->bBehaviorEOS = OMX_FALSE;
@@ -718,13 +774,11 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
             pFpComponent->reInputData = OMX_FALSE;
         }
 
-        pFpComponent->pFoilplanetPort[nPortIndex].bIsPortFlushed = OMX_FALSE;
+        FP_OMX_STORE(pFpComponent->pFoilplanetPort[nPortIndex].bIsPortFlushed, OMX_FALSE);
+        OSAL_SignalSet(pFpComponent->pFoilplanetPort[nPortIndex].hCodecReadyEvent);
         mpp_log("OMX_CommandFlush EventCmdComplete, port:%d", nPortIndex);
         if (bEvent == OMX_TRUE)
-            pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                         pFpComponent->callbackData,
-                                                         OMX_EventCmdComplete,
-                                                         OMX_CommandFlush, nPortIndex, NULL);
+            FP_OMX_PostEvent(pOMXComponent, OMX_EventCmdComplete, OMX_CommandFlush, nPortIndex, NULL);
     }
 
     if (pVideoDec->bInfoChange == OMX_TRUE)
@@ -736,10 +790,7 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
 EXIT:
     if ((ret != OMX_ErrorNone) && (pOMXComponent != NULL) && (pFpComponent != NULL)) {
         mpp_err("ERROR");
-        pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                     pFpComponent->callbackData,
-                                                     OMX_EventError,
-                                                     ret, 0, NULL);
+        FP_OMX_PostEvent(pOMXComponent, OMX_EventError, ret, 0, NULL);
     }
 
     FunctionOut();
@@ -797,10 +848,7 @@ OMX_ERRORTYPE FP_InputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent, FP_OMX_DATA
 
         if (bufferHeader->hMarkTargetComponent != NULL) {
             if (bufferHeader->hMarkTargetComponent == pOMXComponent) {
-                pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                             pFpComponent->callbackData,
-                                                             OMX_EventMark,
-                                                             0, 0, bufferHeader->pMarkData);
+                FP_OMX_PostEvent(pOMXComponent, OMX_EventMark, 0, 0, bufferHeader->pMarkData);
             } else {
                 pFpComponent->propagateMarkType.hMarkTargetComponent = bufferHeader->hMarkTargetComponent;
                 pFpComponent->propagateMarkType.pMarkData = bufferHeader->pMarkData;
@@ -822,6 +870,21 @@ EXIT:
     return ret;
 }
 
+/* decoder NV12 at mStride x mSliceHeight into a tightly packed mWidth x mHeight buffer */
+static void FP_Dec_RepackNV12(FP_OMX_VIDEODEC_COMPONENT *pVideoDec, OMX_U8 *dst, OMX_U8 *src,
+                              OMX_U32 mWidth, OMX_U32 mHeight, OMX_U32 mStride, OMX_U32 mSliceHeight)
+{
+    /* same layout, luma and chroma are one contiguous block */
+    if (mStride == mWidth && mSliceHeight == mHeight) {
+        OSAL_RepackPlane(pVideoDec->hRepack, dst, mWidth, src, mStride, mWidth, mHeight * 3 / 2);
+        return;
+    }
+
+    OSAL_RepackPlane(pVideoDec->hRepack, dst, mWidth, src, mStride, mWidth, mHeight);
+    OSAL_RepackPlane(pVideoDec->hRepack, dst + mWidth * mHeight, mWidth,
+                     src + mStride * mSliceHeight, mStride, mWidth, mHeight / 2);
+}
+
 OMX_ERRORTYPE  FP_Frame2Outbuf(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADERTYPE* pOutputBuffer, VPU_FRAME *pframe)
 {
 
@@ -884,27 +947,10 @@ OMX_ERRORTYPE  FP_Frame2Outbuf(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADE
         {
             VPUMemLink(&pframe->vpumem);
             VPUMemInvalidate(&pframe->vpumem);
-            {
-                OMX_U8 * buff_vir = (OMX_U8 *)pframe->vpumem.vir_addr;
-                pOutputBuffer->nFilledLen = mWidth * mHeight * 3 / 2;
-                OMX_U32 uv_offset = mStride * mSliceHeight;
-                OMX_U32 y_size = mWidth * mHeight;
-                OMX_U32 uv_size = mWidth * mHeight / 2;
-                OMX_U8 *dst_uv = (OMX_U8 *)((OMX_U8 *)vplanes.addr + y_size);
-                OMX_U8 *src_uv =  (OMX_U8 *)(buff_vir + uv_offset);
-                OMX_U32 i = 0, j = 0;
-
-                mpp_log("mWidth = %d mHeight = %d mStride = %d,mSlicHeight %d", mWidth, mHeight, mStride, mSliceHeight);
-                for (i = 0; i < mHeight; i++) {
-                    memcpy((char*)vplanes.addr + i * mWidth, buff_vir + i * mStride, mWidth);
-                }
-
-                for (i = 0; i < mHeight / 2; i++) {
-                    memcpy((OMX_U8*)dst_uv, (OMX_U8*)src_uv, mWidth);
-                    dst_uv += mWidth;
-                    src_uv += mStride;
-                }
-            }
+            pOutputBuffer->nFilledLen = mWidth * mHeight * 3 / 2;
+            mpp_log("mWidth = %d mHeight = %d mStride = %d,mSlicHeight %d", mWidth, mHeight, mStride, mSliceHeight);
+            FP_Dec_RepackNV12(pVideoDec, (OMX_U8 *)vplanes.addr, (OMX_U8 *)pframe->vpumem.vir_addr,
+                              mWidth, mHeight, mStride, mSliceHeight);
             VPUFreeLinear(&pframe->vpumem);
         }
         OSAL_UnlockANB(pOutputBuffer->pBuffer);
@@ -923,25 +969,10 @@ OMX_ERRORTYPE  FP_Frame2Outbuf(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFFERHEADE
     mStride = Get_Video_HorAlign(pVideoDec->codecId, mWidth, mHeight);
     mSliceHeight = Get_Video_VerAlign(pVideoDec->codecId, mHeight);
     {
-        //csy@rock-chips.com
-        OMX_U8 *buff_vir = (OMX_U8 *)pframe->vpumem.vir_addr;
-        OMX_U32 uv_offset = mStride * mSliceHeight;
-        OMX_U32 y_size = mWidth * mHeight;
-        OMX_U32 uv_size = mWidth * mHeight / 2;
-        OMX_U8 *dst_uv = (OMX_U8 *)(pOutputBuffer->pBuffer + y_size);
-        OMX_U8 *src_uv =  (OMX_U8 *)(buff_vir + uv_offset);
-        OMX_U32 i = 0, j = 0;
-        mpp_err("mWidth = %d mHeight = %d mStride = %d,mSlicHeight %d", mWidth, mHeight, mStride, mSliceHeight);
+        mpp_log("mWidth = %d mHeight = %d mStride = %d,mSlicHeight %d", mWidth, mHeight, mStride, mSliceHeight);
         pOutputBuffer->nFilledLen = mWidth * mHeight * 3 / 2;
-        for (i = 0; i < mHeight; i++) {
-            memcpy((char*)pOutputBuffer->pBuffer + i * mWidth, buff_vir + i * mStride, mWidth);
-        }
-
-        for (i = 0; i < mHeight / 2; i++) {
-            memcpy((OMX_U8*)dst_uv, (OMX_U8*)src_uv, mWidth);
-            dst_uv += mWidth;
-            src_uv += mStride;
-        }
+        FP_Dec_RepackNV12(pVideoDec, pOutputBuffer->pBuffer, (OMX_U8 *)pframe->vpumem.vir_addr,
+                          mWidth, mHeight, mStride, mSliceHeight);
 #if 0
 
         if (pVideoDec->fp_out != NULL) {
@@ -967,23 +998,23 @@ OMX_ERRORTYPE FP_InputBufferGetQueue(FP_OMX_BASECOMPONENT *pFpComponent)
 
     inputUseBuffer = &(pFoilplanetPort->way.port2WayDataBuffer.inputDataBuffer);
 
-    if (pFpComponent->currentState != OMX_StateExecuting) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateExecuting) {
         ret = OMX_ErrorUndefined;
         goto EXIT;
-    } else if ((pFpComponent->transientState != FP_OMX_TransStateExecutingToIdle) &&
+    } else if ((FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateExecutingToIdle) &&
                (!CHECK_PORT_BEING_FLUSHED(pFoilplanetPort))) {
-        OSAL_SemaphoreWait(pFoilplanetPort->bufferSemID);
+        OSAL_QueueWait(pFoilplanetPort->bufferQ, DEF_MAX_WAIT_TIME);
         if (inputUseBuffer->dataValid != OMX_TRUE) {
-            if (GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE)) || message == NULL) {
+            if ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) == NULL) {
                 ret = OMX_ErrorUndefined;
                 goto EXIT;
             }
             if (message->messageType == FP_OMX_CommandFakeBuffer) {
-                mpp_free(message);
+                FP_OMX_PortMessageFree(pFoilplanetPort, message);
                 ret = (OMX_ERRORTYPE)OMX_ErrorCodecFlush;
                 goto EXIT;
             }
-            mpp_log("input buffer count = %d", GET_MPPLIST(pFoilplanetPort->bufferQ)->list_size());
+            mpp_log("input buffer count = %d", OSAL_GetElemNum(pFoilplanetPort->bufferQ));
             inputUseBuffer->bufferHeader  = (OMX_BUFFERHEADERTYPE *)(message->pCmdData);
             inputUseBuffer->allocSize     = inputUseBuffer->bufferHeader->nAllocLen;
             inputUseBuffer->dataLen       = inputUseBuffer->bufferHeader->nFilledLen;
@@ -993,7 +1024,7 @@ OMX_ERRORTYPE FP_InputBufferGetQueue(FP_OMX_BASECOMPONENT *pFpComponent)
             inputUseBuffer->nFlags        = inputUseBuffer->bufferHeader->nFlags;
             inputUseBuffer->timeStamp     = inputUseBuffer->bufferHeader->nTimeStamp;
 
-            mpp_free(message);
+            FP_OMX_PortMessageFree(pFoilplanetPort, message);
 
             if (inputUseBuffer->allocSize <= inputUseBuffer->dataLen)
                 mpp_log("Input Buffer Full, Check input buffer size! allocSize:%d, dataLen:%d", inputUseBuffer->allocSize, inputUseBuffer->dataLen);
@@ -1034,11 +1065,9 @@ OMX_ERRORTYPE FP_OutputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent, FP_OMX_DAT
 
         if ((bufferHeader->nFlags & OMX_BUFFERFLAG_EOS) == OMX_BUFFERFLAG_EOS) {
             mpp_err("event OMX_BUFFERFLAG_EOS!!!");
-            pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                   pFpComponent->callbackData,
-                                                   OMX_EventBufferFlag,
-                                                   OUTPUT_PORT_INDEX,
-                                                   bufferHeader->nFlags, NULL);
+            FP_OMX_PostEvent(pOMXComponent,
+                             OMX_EventBufferFlag,
+                             OUTPUT_PORT_INDEX, bufferHeader->nFlags, NULL);
         }
 
         FP_OMX_OutputBufferReturn(pOMXComponent, bufferHeader);
@@ -1064,19 +1093,19 @@ OMX_ERRORTYPE FP_OutputBufferGetQueue(FP_OMX_BASECOMPONENT *pFpComponent)
 
     outputUseBuffer = &(pFoilplanetPort->way.port2WayDataBuffer.outputDataBuffer);
 
-    if (pFpComponent->currentState != OMX_StateExecuting) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateExecuting) {
         ret = OMX_ErrorUndefined;
         goto EXIT;
-    } else if ((pFpComponent->transientState != FP_OMX_TransStateExecutingToIdle) &&
+    } else if ((FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateExecutingToIdle) &&
                (!CHECK_PORT_BEING_FLUSHED(pFoilplanetPort))) {
-        OSAL_SemaphoreWait(pFoilplanetPort->bufferSemID);
+        OSAL_QueueWait(pFoilplanetPort->bufferQ, DEF_MAX_WAIT_TIME);
         if (outputUseBuffer->dataValid != OMX_TRUE) {
-            if (GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE)) || message == NULL) {
+            if ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) == NULL) {
                 ret = OMX_ErrorUndefined;
                 goto EXIT;
             }
             if (message->messageType == FP_OMX_CommandFakeBuffer) {
-                mpp_free(message);
+                FP_OMX_PortMessageFree(pFoilplanetPort, message);
                 ret = (OMX_ERRORTYPE)OMX_ErrorCodecFlush;
                 goto EXIT;
             }
@@ -1087,7 +1116,7 @@ OMX_ERRORTYPE FP_OutputBufferGetQueue(FP_OMX_BASECOMPONENT *pFpComponent)
             outputUseBuffer->remainDataLen = outputUseBuffer->dataLen;
             outputUseBuffer->usedDataLen   = 0; //dataBuffer->bufferHeader->nOffset;
             outputUseBuffer->dataValid     = OMX_TRUE;
-            mpp_free(message);
+            FP_OMX_PortMessageFree(pFoilplanetPort, message);
         }
         ret = OMX_ErrorNone;
     }
@@ -1105,25 +1134,25 @@ OMX_BUFFERHEADERTYPE *FP_OutputBufferGetQueue_Direct(FP_OMX_BASECOMPONENT *pFpCo
 
     FunctionIn();
 
-    if (pFpComponent->currentState != OMX_StateExecuting) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateExecuting) {
         retBuffer = NULL;
         goto EXIT;
-    } else if ((pFpComponent->transientState != FP_OMX_TransStateExecutingToIdle) &&
+    } else if ((FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateExecutingToIdle) &&
                (!CHECK_PORT_BEING_FLUSHED(pFoilplanetPort))) {
-        OSAL_SemaphoreWait(pFoilplanetPort->bufferSemID);
+        OSAL_QueueWait(pFoilplanetPort->bufferQ, DEF_MAX_WAIT_TIME);
 
-        if (GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE)) || message == NULL) {
+        if ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) == NULL) {
             retBuffer = NULL;
             goto EXIT;
         }
         if (message->messageType == FP_OMX_CommandFakeBuffer) {
-            mpp_free(message);
+            FP_OMX_PortMessageFree(pFoilplanetPort, message);
             retBuffer = NULL;
             goto EXIT;
         }
 
         retBuffer  = (OMX_BUFFERHEADERTYPE *)(message->pCmdData);
-        mpp_free(message);
+        FP_OMX_PortMessageFree(pFoilplanetPort, message);
     }
 
 EXIT:
@@ -1190,7 +1219,7 @@ OMX_ERRORTYPE FPV_OMX_GetParameter(
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    if (pFpComponent->currentState == OMX_StateInvalid ) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid ) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -1457,6 +1486,14 @@ OMX_ERRORTYPE FPV_OMX_GetParameter(
         ret = OMX_ErrorNone;
     }
     break;
+    case OMX_IndexParamRkDecoderExtensionLowLatency: {
+        OMX_BOOL *pLowLatency = (OMX_BOOL *)ComponentParameterStructure;
+        FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+
+        *pLowLatency = (pVideoDec->flags & FP_OMX_VDEC_LOW_LATENCY) ? OMX_TRUE : OMX_FALSE;
+        ret = OMX_ErrorNone;
+    }
+    break;
     default: {
         ret = FP_OMX_GetParameter(hComponent, nParamIndex, ComponentParameterStructure);
     }
@@ -1497,7 +1534,7 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    if (pFpComponent->currentState == OMX_StateInvalid ) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid ) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -1556,17 +1593,26 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
 
         pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
 
-        if ((pFpComponent->currentState != OMX_StateLoaded) && (pFpComponent->currentState != OMX_StateWaitForResources)) {
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) && (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateWaitForResources)) {
             if (pFoilplanetPort->portDefinition.bEnabled == OMX_TRUE) {
                 ret = OMX_ErrorIncorrectStateOperation;
                 goto EXIT;
             }
         }
-        if (pPortDefinition->nBufferCountActual < pFoilplanetPort->portDefinition.nBufferCountMin) {
+        if ((pPortDefinition->nBufferCountActual < pFoilplanetPort->portDefinition.nBufferCountMin) ||
+            (pPortDefinition->nBufferCountActual > PORT_BUFFER_NUM_MAX)) {
             ret = OMX_ErrorBadParameter;
             goto EXIT;
         }
 
+        /* values that differ from what was reported are the client's own choice */
+        if (portIndex == INPUT_PORT_INDEX) {
+            pVideoDec->nInputSizeHint =
+                (pPortDefinition->nBufferSize != pFoilplanetPort->portDefinition.nBufferSize) ? pPortDefinition->nBufferSize : 0;
+            pVideoDec->nInputCountHint =
+                (pPortDefinition->nBufferCountActual != pFoilplanetPort->portDefinition.nBufferCountActual) ? pPortDefinition->nBufferCountActual : 0;
+        }
+
         memcpy(&pFoilplanetPort->portDefinition, pPortDefinition, pPortDefinition->nSize);
 
 
@@ -1603,9 +1649,11 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
         }
         pFoilplanetPort->portDefinition.format.video.nStride = stride;
         pFoilplanetPort->portDefinition.format.video.nSliceHeight = strideheight;
-        pFoilplanetPort->portDefinition.nBufferSize = (size > pFoilplanetPort->portDefinition.nBufferSize) ? size : pFoilplanetPort->portDefinition.nBufferSize;
+        if (portIndex == OUTPUT_PORT_INDEX)
+            pFoilplanetPort->portDefinition.nBufferSize = (size > pFoilplanetPort->portDefinition.nBufferSize) ? size : pFoilplanetPort->portDefinition.nBufferSize;
 
         if (portIndex == INPUT_PORT_INDEX) {
+            FP_Dec_UpdateInputBufferSize(pFpComponent);
             FP_OMX_BASEPORT *pFpOutputPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
             pFpOutputPort->portDefinition.format.video.nFrameWidth = pFoilplanetPort->portDefinition.format.video.nFrameWidth;
             pFpOutputPort->portDefinition.format.video.nFrameHeight = pFoilplanetPort->portDefinition.format.video.nFrameHeight;
@@ -1616,7 +1664,9 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
             memset(&(pFpOutputPort->cropRectangle), 0, sizeof(OMX_CONFIG_RECTTYPE));
             pFpOutputPort->cropRectangle.nWidth = pFpOutputPort->portDefinition.format.video.nFrameWidth;
             pFpOutputPort->cropRectangle.nHeight = pFpOutputPort->portDefinition.format.video.nFrameHeight;
-            pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent, pFpComponent->callbackData, OMX_EventPortSettingsChanged, OUTPUT_PORT_INDEX, OMX_IndexConfigCommonOutputCrop, NULL);
+            FP_OMX_PostEvent(pOMXComponent,
+                             OMX_EventPortSettingsChanged,
+                             OUTPUT_PORT_INDEX, OMX_IndexConfigCommonOutputCrop, NULL);
             if (pFpOutputPort->portDefinition.format.video.nFrameWidth
                 * pFpOutputPort->portDefinition.format.video.nFrameHeight > 1920 * 1088) {
                 pFpOutputPort->portDefinition.nBufferCountActual = 14;
@@ -1722,6 +1772,32 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
     }
     break;
 
+    case OMX_IndexParamRkDecoderExtensionLowLatency: {
+        OMX_BOOL *pLowLatency = (OMX_BOOL *)ComponentParameterStructure;
+        FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+        FP_OMX_BASEPORT *pFpInputPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
+
+        /* the vpu output mode is fixed when the first frame initialises it */
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) &&
+            (pFpInputPort->portDefinition.bEnabled == OMX_TRUE)) {
+            ret = OMX_ErrorIncorrectStateOperation;
+            goto EXIT;
+        }
+
+        if ((*pLowLatency) == OMX_TRUE) {
+            pVideoDec->flags |= FP_OMX_VDEC_LOW_LATENCY;
+            pFpInputPort->portDefinition.nBufferCountMin = VDEC_LOW_LATENCY_INPUT_NUM;
+        } else {
+            pVideoDec->flags &= ~FP_OMX_VDEC_LOW_LATENCY;
+            pFpInputPort->portDefinition.nBufferCountMin = MAX_VIDEO_INPUTBUFFER_NUM;
+        }
+        FP_Dec_UpdateInputBufferSize(pFpComponent);
+        mpp_log("low latency mode %s", (*pLowLatency) ? "on" : "off");
+
+        ret = OMX_ErrorNone;
+    }
+    break;
+
 
 
     case OMX_IndexParamStandardComponentRole: {
@@ -1732,7 +1808,7 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
             goto EXIT;
         }
 
-        if ((pFpComponent->currentState != OMX_StateLoaded) && (pFpComponent->currentState != OMX_StateWaitForResources)) {
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) && (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateWaitForResources)) {
             ret = OMX_ErrorIncorrectStateOperation;
             goto EXIT;
         }
@@ -1785,8 +1861,35 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
         pDstAVCComponent = &pVideoDec->AVCComponent[pSrcAVCComponent->nPortIndex];
 
         memcpy(pDstAVCComponent, pSrcAVCComponent, sizeof(OMX_VIDEO_PARAM_AVCTYPE));
+        if ((pSrcAVCComponent->nPortIndex == INPUT_PORT_INDEX) && (pSrcAVCComponent->eLevel != 0) &&
+            ((FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateLoaded) ||
+             (pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].portDefinition.bEnabled == OMX_FALSE))) {
+            pVideoDec->nInputLevel = pSrcAVCComponent->eLevel;
+            FP_Dec_UpdateInputBufferSize(pFpComponent);
+        }
     }
 
+    break;
+    case OMX_IndexParamVideoProfileLevelCurrent: {
+        OMX_VIDEO_PARAM_PROFILELEVELTYPE *pProfileLevel = (OMX_VIDEO_PARAM_PROFILELEVELTYPE *)ComponentParameterStructure;
+        FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+        ret = FP_OMX_Check_SizeVersion(pProfileLevel, sizeof(OMX_VIDEO_PARAM_PROFILELEVELTYPE));
+        if (ret != OMX_ErrorNone) {
+            goto EXIT;
+        }
+        if (pProfileLevel->nPortIndex != INPUT_PORT_INDEX) {
+            ret = OMX_ErrorBadPortIndex;
+            goto EXIT;
+        }
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) &&
+            (pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].portDefinition.bEnabled == OMX_TRUE)) {
+            ret = OMX_ErrorIncorrectStateOperation;
+            goto EXIT;
+        }
+
+        pVideoDec->nInputLevel = pProfileLevel->eLevel;
+        FP_Dec_UpdateInputBufferSize(pFpComponent);
+    }
     break;
     default: {
         ret = FP_OMX_SetParameter(hComponent, nIndex, ComponentParameterStructure);
@@ -1829,7 +1932,7 @@ OMX_ERRORTYPE FPV_OMX_GetConfig(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -1895,7 +1998,7 @@ OMX_ERRORTYPE FPV_OMX_SetConfig(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -2006,7 +2109,7 @@ OMX_ERRORTYPE FPV_OMX_GetExtensionIndex(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -2051,6 +2154,10 @@ OMX_ERRORTYPE FPV_OMX_GetExtensionIndex(
         *pIndexType = (OMX_INDEXTYPE)OMX_IndexParamRkDecoderExtensionUseDts;
         goto EXIT;
     }
+    if (strcmp(cParameterName, FOILPLANET_INDEX_PARAM_ROCKCHIP_DEC_EXTENSION_LOW_LATENCY) == 0) {
+        *pIndexType = (OMX_INDEXTYPE)OMX_IndexParamRkDecoderExtensionLowLatency;
+        goto EXIT;
+    }
 #ifdef USE_STOREMETADATA
     if (strcmp(cParameterName, FOILPLANET_INDEX_PARAM_STORE_METADATA_BUFFER) == 0) {
         *pIndexType = (OMX_INDEXTYPE) NULL;
@@ -0,0 +1,465 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "vdec_sps.h"
+#include "osal/mpp_log.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG         "FP_VDEC_SPS"
+#endif
+
+/* enough for any SPS without huge VUI, a truncated one fails the bit reader */
+#define SPS_RBSP_MAX_SIZE       1024
+#define AVC_NAL_SPS             7
+#define HEVC_NAL_SPS            33
+#define AVC_DPB_FRAMES_MAX      16
+#define HEVC_DPB_FRAMES_MAX     16
+
+typedef struct _SPS_BITREADER {
+    OMX_U8  buf[SPS_RBSP_MAX_SIZE];
+    OMX_U32 size;
+    OMX_U32 pos;                    /* in bits */
+    OMX_BOOL bError;
+} SPS_BITREADER;
+
+/* copies a NAL payload dropping emulation prevention bytes */
+static void SPS_InitReader(SPS_BITREADER *br, const OMX_U8 *nal, OMX_U32 size)
+{
+    OMX_U32 i, zeros = 0;
+
+    br->size = 0;
+    br->pos = 0;
+    br->bError = OMX_FALSE;
+    for (i = 0; i < size && br->size < SPS_RBSP_MAX_SIZE; i++) {
+        if (zeros >= 2 && nal[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = (nal[i] == 0) ? zeros + 1 : 0;
+        br->buf[br->size++] = nal[i];
+    }
+}
+
+static OMX_U32 SPS_ReadBits(SPS_BITREADER *br, OMX_U32 n)
+{
+    OMX_U32 val = 0;
+
+    while (n--) {
+        if (br->pos >= br->size * 8) {
+            br->bError = OMX_TRUE;
+            return 0;
+        }
+        val = (val << 1) | ((br->buf[br->pos >> 3] >> (7 - (br->pos & 7))) & 1);
+        br->pos++;
+    }
+    return val;
+}
+
+static void SPS_SkipBits(SPS_BITREADER *br, OMX_U32 n)
+{
+    br->pos += n;
+    if (br->pos > br->size * 8)
+        br->bError = OMX_TRUE;
+}
+
+static OMX_U32 SPS_ReadUe(SPS_BITREADER *br)
+{
+    OMX_U32 zeros = 0;
+
+    while (SPS_ReadBits(br, 1) == 0) {
+        if (br->bError || ++zeros > 31) {
+            br->bError = OMX_TRUE;
+            return 0;
+        }
+    }
+    return ((1U << zeros) - 1) + SPS_ReadBits(br, zeros);
+}
+
+static OMX_S32 SPS_ReadSe(SPS_BITREADER *br)
+{
+    OMX_U32 val = SPS_ReadUe(br);
+
+    return (val & 1) ? (OMX_S32)((val + 1) >> 1) : -(OMX_S32)(val >> 1);
+}
+
+/* Table A-1 MaxDpbMbs */
+static OMX_U32 AVC_MaxDpbMbs(OMX_U32 level_idc)
+{
+    switch (level_idc) {
+    case 9:
+    case 10: return 396;
+    case 11: return 900;
+    case 12:
+    case 13:
+    case 20: return 2376;
+    case 21: return 4752;
+    case 22:
+    case 30: return 8100;
+    case 31: return 18000;
+    case 32: return 20480;
+    case 40:
+    case 41: return 32768;
+    case 42: return 34816;
+    case 50: return 110400;
+    case 51:
+    case 52: return 184320;
+    default: return 696320;
+    }
+}
+
+static void AVC_SkipScalingList(SPS_BITREADER *br, OMX_U32 size)
+{
+    OMX_S32 lastScale = 8, nextScale = 8;
+    OMX_U32 j;
+
+    for (j = 0; j < size && !br->bError; j++) {
+        if (nextScale != 0)
+            nextScale = (lastScale + SPS_ReadSe(br) + 256) % 256;
+        lastScale = (nextScale == 0) ? lastScale : nextScale;
+    }
+}
+
+static void AVC_SkipHrd(SPS_BITREADER *br)
+{
+    OMX_U32 cpb_cnt = SPS_ReadUe(br) + 1;
+    OMX_U32 i;
+
+    SPS_SkipBits(br, 8);            /* bit_rate_scale, cpb_size_scale */
+    for (i = 0; i < cpb_cnt && !br->bError; i++) {
+        SPS_ReadUe(br);
+        SPS_ReadUe(br);
+        SPS_SkipBits(br, 1);
+    }
+    SPS_SkipBits(br, 20);
+}
+
+static OMX_BOOL AVC_ParseSps(SPS_BITREADER *br, VDEC_SPS_INFO *info)
+{
+    OMX_U32 profile_idc, level_idc;
+    OMX_U32 chroma_format_idc = 1, separate_colour_plane = 0, bit_depth = 8;
+    OMX_U32 poc_type, max_num_ref_frames, frame_mbs_only;
+    OMX_U32 width_mbs, height_mbs;
+    OMX_U32 crop[4] = { 0, 0, 0, 0 };
+    OMX_U32 crop_x = 1, crop_y = 1;
+    OMX_U32 dpb;
+    OMX_U32 i;
+
+    SPS_SkipBits(br, 8);            /* nal header */
+    profile_idc = SPS_ReadBits(br, 8);
+    SPS_SkipBits(br, 8);            /* constraint flags */
+    level_idc = SPS_ReadBits(br, 8);
+    SPS_ReadUe(br);                 /* seq_parameter_set_id */
+
+    if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 ||
+        profile_idc == 244 || profile_idc == 44 || profile_idc == 83 ||
+        profile_idc == 86 || profile_idc == 118 || profile_idc == 128 ||
+        profile_idc == 138 || profile_idc == 139 || profile_idc == 134 ||
+        profile_idc == 135) {
+        chroma_format_idc = SPS_ReadUe(br);
+        if (chroma_format_idc == 3)
+            separate_colour_plane = SPS_ReadBits(br, 1);
+        bit_depth = SPS_ReadUe(br) + 8;
+        SPS_ReadUe(br);             /* bit_depth_chroma_minus8 */
+        SPS_SkipBits(br, 1);        /* qpprime_y_zero_transform_bypass_flag */
+        if (SPS_ReadBits(br, 1)) {
+            for (i = 0; i < ((chroma_format_idc != 3) ? 8U : 12U); i++) {
+                if (SPS_ReadBits(br, 1))
+                    AVC_SkipScalingList(br, (i < 6) ? 16 : 64);
+            }
+        }
+    }
+
+    SPS_ReadUe(br);                 /* log2_max_frame_num_minus4 */
+    poc_type = SPS_ReadUe(br);
+    if (poc_type == 0) {
+        SPS_ReadUe(br);
+    } else if (poc_type == 1) {
+        OMX_U32 cycle;
+        SPS_SkipBits(br, 1);
+        SPS_ReadSe(br);
+        SPS_ReadSe(br);
+        cycle = SPS_ReadUe(br);
+        for (i = 0; i < cycle && !br->bError; i++)
+            SPS_ReadSe(br);
+    }
+    max_num_ref_frames = SPS_ReadUe(br);
+    SPS_SkipBits(br, 1);            /* gaps_in_frame_num_value_allowed_flag */
+    width_mbs = SPS_ReadUe(br);
+    height_mbs = SPS_ReadUe(br);
+    frame_mbs_only = SPS_ReadBits(br, 1);
+    if (!frame_mbs_only)
+        SPS_SkipBits(br, 1);
+    SPS_SkipBits(br, 1);            /* direct_8x8_inference_flag */
+    if (SPS_ReadBits(br, 1)) {
+        for (i = 0; i < 4; i++)
+            crop[i] = SPS_ReadUe(br);
+    }
+    if (br->bError)
+        return OMX_FALSE;
+
+    /* bounded before any arithmetic, the products below then fit in 32 bits */
+    if (width_mbs >= VDEC_SPS_MAX_WIDTH / 16 || height_mbs >= VDEC_SPS_MAX_HEIGHT / 16)
+        return OMX_FALSE;
+    width_mbs += 1;
+    height_mbs = (height_mbs + 1) * (2 - frame_mbs_only);
+    if (height_mbs > VDEC_SPS_MAX_HEIGHT / 16)
+        return OMX_FALSE;
+
+    dpb = AVC_MaxDpbMbs(level_idc) / (width_mbs * height_mbs);
+    if (dpb > AVC_DPB_FRAMES_MAX)
+        dpb = AVC_DPB_FRAMES_MAX;
+
+    /* VUI, only for bitstream_restriction; stop quietly if it is cut short */
+    if (SPS_ReadBits(br, 1)) {
+        OMX_U32 nal_hrd, vcl_hrd;
+
+        if (SPS_ReadBits(br, 1) && SPS_ReadBits(br, 8) == 255)
+            SPS_SkipBits(br, 32);
+        if (SPS_ReadBits(br, 1))
+            SPS_SkipBits(br, 1);
+        if (SPS_ReadBits(br, 1)) {
+            SPS_SkipBits(br, 4);
+            if (SPS_ReadBits(br, 1))
+                SPS_SkipBits(br, 24);
+        }
+        if (SPS_ReadBits(br, 1)) {
+            SPS_ReadUe(br);
+            SPS_ReadUe(br);
+        }
+        if (SPS_ReadBits(br, 1))
+            SPS_SkipBits(br, 65);
+        nal_hrd = SPS_ReadBits(br, 1);
+        if (nal_hrd)
+            AVC_SkipHrd(br);
+        vcl_hrd = SPS_ReadBits(br, 1);
+        if (vcl_hrd)
+            AVC_SkipHrd(br);
+        if (nal_hrd || vcl_hrd)
+            SPS_SkipBits(br, 1);
+        SPS_SkipBits(br, 1);        /* pic_struct_present_flag */
+        if (SPS_ReadBits(br, 1)) {
+            OMX_U32 max_dec_frame_buffering;
+            SPS_SkipBits(br, 1);
+            for (i = 0; i < 5; i++)
+                SPS_ReadUe(br);     /* up to max_num_reorder_frames */
+            max_dec_frame_buffering = SPS_ReadUe(br);
+            if (!br->bError && max_dec_frame_buffering <= AVC_DPB_FRAMES_MAX)
+                dpb = max_dec_frame_buffering;
+        }
+    }
+    if (dpb < max_num_ref_frames)
+        dpb = max_num_ref_frames;
+    if (dpb == 0)
+        dpb = 1;
+
+    if (chroma_format_idc != 0 && !separate_colour_plane) {
+        crop_x = (chroma_format_idc == 3) ? 1 : 2;
+        crop_y = (chroma_format_idc == 1) ? 2 : 1;
+    }
+    crop_y *= (2 - frame_mbs_only);
+
+    /* the crop must leave a picture */
+    for (i = 0; i < 4; i++) {
+        if (crop[i] >= VDEC_SPS_MAX_WIDTH)
+            return OMX_FALSE;
+    }
+    if ((crop[0] + crop[1]) * crop_x >= width_mbs * 16 ||
+        (crop[2] + crop[3]) * crop_y >= height_mbs * 16)
+        return OMX_FALSE;
+
+    info->nWidth = width_mbs * 16 - (crop[0] + crop[1]) * crop_x;
+    info->nHeight = height_mbs * 16 - (crop[2] + crop[3]) * crop_y;
+    info->nBitDepth = bit_depth;
+    info->nDpbFrames = dpb;
+
+    return OMX_TRUE;
+}
+
+static OMX_BOOL HEVC_ParseSps(SPS_BITREADER *br, VDEC_SPS_INFO *info)
+{
+    OMX_U32 max_sub_layers_minus1;
+    OMX_U32 chroma_format_idc, sub_width = 2, sub_height = 2;
+    OMX_U32 width, height, bit_depth;
+    OMX_U32 crop[4] = { 0, 0, 0, 0 };
+    OMX_U32 sub_layer_flags = 0;
+    OMX_U32 dpb = 0;
+    OMX_U32 i;
+
+    SPS_SkipBits(br, 16);           /* nal header */
+    SPS_SkipBits(br, 4);            /* sps_video_parameter_set_id */
+    max_sub_layers_minus1 = SPS_ReadBits(br, 3);
+    SPS_SkipBits(br, 1);
+
+    /* profile_tier_level */
+    SPS_SkipBits(br, 96);           /* general profile and level */
+    for (i = 0; i < max_sub_layers_minus1; i++)
+        sub_layer_flags |= SPS_ReadBits(br, 2) << (i * 2);
+    if (max_sub_layers_minus1 > 0)
+        SPS_SkipBits(br, (8 - max_sub_layers_minus1) * 2);
+    for (i = 0; i < max_sub_layers_minus1; i++) {
+        if (sub_layer_flags & (2U << (i * 2)))
+            SPS_SkipBits(br, 88);
+        if (sub_layer_flags & (1U << (i * 2)))
+            SPS_SkipBits(br, 8);
+    }
+
+    SPS_ReadUe(br);                 /* sps_seq_parameter_set_id */
+    chroma_format_idc = SPS_ReadUe(br);
+    if (chroma_format_idc == 3)
+        SPS_SkipBits(br, 1);
+    width = SPS_ReadUe(br);
+    height = SPS_ReadUe(br);
+    if (SPS_ReadBits(br, 1)) {
+        for (i = 0; i < 4; i++)
+            crop[i] = SPS_ReadUe(br);
+    }
+    bit_depth = SPS_ReadUe(br) + 8;
+    SPS_ReadUe(br);                 /* bit_depth_chroma_minus8 */
+    SPS_ReadUe(br);                 /* log2_max_pic_order_cnt_lsb_minus4 */
+    i = SPS_ReadBits(br, 1) ? 0 : max_sub_layers_minus1;
+    for (; i <= max_sub_layers_minus1; i++) {
+        dpb = SPS_ReadUe(br) + 1;   /* the highest sub-layer wins */
+        SPS_ReadUe(br);
+        SPS_ReadUe(br);
+    }
+    if (br->bError || dpb > HEVC_DPB_FRAMES_MAX)
+        return OMX_FALSE;
+    if (width == 0 || height == 0 || width > VDEC_SPS_MAX_WIDTH || height > VDEC_SPS_MAX_HEIGHT)
+        return OMX_FALSE;
+
+    if (chroma_format_idc == 0 || chroma_format_idc == 3) {
+        sub_width = 1;
+        sub_height = 1;
+    } else if (chroma_format_idc == 2) {
+        sub_height = 1;
+    }
+
+    /* the crop must leave a picture */
+    for (i = 0; i < 4; i++) {
+        if (crop[i] >= VDEC_SPS_MAX_WIDTH)
+            return OMX_FALSE;
+    }
+    if ((crop[0] + crop[1]) * sub_width >= width || (crop[2] + crop[3]) * sub_height >= height)
+        return OMX_FALSE;
+
+    info->nWidth = width - (crop[0] + crop[1]) * sub_width;
+    info->nHeight = height - (crop[2] + crop[3]) * sub_height;
+    info->nBitDepth = bit_depth;
+    info->nDpbFrames = dpb;
+
+    return OMX_TRUE;
+}
+
+static OMX_BOOL SPS_ParseNal(OMX_VIDEO_CODINGTYPE codecId, const OMX_U8 *nal, OMX_U32 size, VDEC_SPS_INFO *info)
+{
+    SPS_BITREADER br;
+    OMX_BOOL      ret = OMX_FALSE;
+
+    if (size < 4)
+        return OMX_FALSE;
+
+    if (codecId == OMX_VIDEO_CodingAVC && (nal[0] & 0x1f) == AVC_NAL_SPS) {
+        SPS_InitReader(&br, nal, size);
+        ret = AVC_ParseSps(&br, info);
+    } else if (codecId == OMX_VIDEO_CodingHEVC && ((nal[0] >> 1) & 0x3f) == HEVC_NAL_SPS) {
+        SPS_InitReader(&br, nal, size);
+        ret = HEVC_ParseSps(&br, info);
+    }
+
+    if (ret == OMX_TRUE && (info->nWidth == 0 || info->nHeight == 0))
+        ret = OMX_FALSE;
+
+    return ret;
+}
+
+static OMX_BOOL SPS_ParseAnnexB(OMX_VIDEO_CODINGTYPE codecId, const OMX_U8 *data, OMX_U32 size, VDEC_SPS_INFO *info)
+{
+    OMX_U32 i = 0, start = 0;
+    OMX_BOOL bInNal = OMX_FALSE;
+
+    while (i + 3 <= size) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            if (bInNal && SPS_ParseNal(codecId, data + start, i - start, info) == OMX_TRUE)
+                return OMX_TRUE;
+            i += 3;
+            start = i;
+            bInNal = OMX_TRUE;
+        } else {
+            i++;
+        }
+    }
+    if (bInNal)
+        return SPS_ParseNal(codecId, data + start, size - start, info);
+
+    return OMX_FALSE;
+}
+
+OMX_BOOL FP_Dec_ParseSps(OMX_VIDEO_CODINGTYPE codecId, const OMX_U8 *data, OMX_U32 size, VDEC_SPS_INFO *info)
+{
+    OMX_U32 pos, n, len;
+
+    if (data == NULL || info == NULL || size < 4)
+        return OMX_FALSE;
+    if (codecId != OMX_VIDEO_CodingAVC && codecId != OMX_VIDEO_CodingHEVC)
+        return OMX_FALSE;
+
+    memset(info, 0, sizeof(VDEC_SPS_INFO));
+
+    /* Annex-B starts with a zero byte, the config records with version 1 */
+    if (data[0] != 1)
+        return SPS_ParseAnnexB(codecId, data, size, info);
+
+    if (codecId == OMX_VIDEO_CodingAVC) {
+        if (size < 7)
+            return OMX_FALSE;
+        n = data[5] & 0x1f;
+        pos = 6;
+        while (n-- && pos + 2 <= size) {
+            len = (data[pos] << 8) | data[pos + 1];
+            pos += 2;
+            if (pos + len > size)
+                break;
+            if (SPS_ParseNal(codecId, data + pos, len, info) == OMX_TRUE)
+                return OMX_TRUE;
+            pos += len;
+        }
+    } else {
+        OMX_U32 arrays;
+        if (size < 23)
+            return OMX_FALSE;
+        arrays = data[22];
+        pos = 23;
+        while (arrays-- && pos + 3 <= size) {
+            n = (data[pos + 1] << 8) | data[pos + 2];
+            pos += 3;
+            while (n-- && pos + 2 <= size) {
+                len = (data[pos] << 8) | data[pos + 1];
+                pos += 2;
+                if (pos + len > size)
+                    return OMX_FALSE;
+                if (SPS_ParseNal(codecId, data + pos, len, info) == OMX_TRUE)
+                    return OMX_TRUE;
+                pos += len;
+            }
+        }
+    }
+
+    mpp_log("no SPS found in %d bytes of codec config", size);
+    return OMX_FALSE;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FOILPLANET_OMX_VIDEO_DECODE_SPS_H_
+#define _FOILPLANET_OMX_VIDEO_DECODE_SPS_H_
+
+#include "OMX_Types.h"
+#include "OMX_Video.h"
+
+/*
+ * What the decoder needs to know about a stream before the first frame:
+ * display size with cropping applied and the number of pictures the DPB
+ * holds (max_dec_frame_buffering for AVC, sps_max_dec_pic_buffering for
+ * HEVC, level limits when the stream does not signal it).
+ */
+/* largest coded picture the decoder takes, bigger streams are rejected */
+#define VDEC_SPS_MAX_WIDTH      8192
+#define VDEC_SPS_MAX_HEIGHT     4096
+
+typedef struct _VDEC_SPS_INFO {
+    OMX_U32 nWidth;
+    OMX_U32 nHeight;
+    OMX_U32 nBitDepth;
+    OMX_U32 nDpbFrames;
+} VDEC_SPS_INFO;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* data is avcC/hvcC or Annex-B, OMX_FALSE when no usable SPS is found */
+OMX_BOOL FP_Dec_ParseSps(OMX_VIDEO_CODINGTYPE codecId, const OMX_U8 *data, OMX_U32 size, VDEC_SPS_INFO *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FOILPLANET_OMX_VIDEO_DECODE_SPS_H_ */
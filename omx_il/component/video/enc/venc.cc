@@ -39,7 +39,10 @@
 #endif
 
 #include "osal_event.h"
+#include "osal_queue.h"
 #include "osal_rga.h"
+#include "osal_task.h"
+#include "osal_vpumem.h"
 #include "osal/mpp_thread.h"
 #include "osal/mpp_list.h"
 #include "osal/mpp_mem.h"
@@ -49,6 +52,13 @@
 # define MODULE_TAG     "FP_OMX_VDEC"
 #endif
 
+/*
+ * Upper bounds for a codec thread waiting on hCodecReadyEvent, wakeups
+ * normally come from the peer thread or from FillThisBuffer.
+ */
+#define CODEC_WAIT_TIME_MS      20
+#define OUTPUT_POLL_TIME_MS     5
+
 /** 
  * TO remove: old librkvpu/vpu_api.h
  */
@@ -177,10 +187,10 @@ OMX_BOOL FP_Check_BufferProcess_State(FP_OMX_BASECOMPONENT *pFpComponent, OMX_U3
 {
     OMX_BOOL ret = OMX_FALSE;
 
-    if ((pFpComponent->currentState == OMX_StateExecuting) &&
-        (pFpComponent->pFoilplanetPort[nPortIndex].portState == OMX_StateIdle) &&
-        (pFpComponent->transientState != FP_OMX_TransStateExecutingToIdle) &&
-        (pFpComponent->transientState != FP_OMX_TransStateIdleToExecuting)) {
+    if ((FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateExecuting) &&
+        (FP_OMX_LOAD(pFpComponent->pFoilplanetPort[nPortIndex].portState) == OMX_StateIdle) &&
+        (FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateExecutingToIdle) &&
+        (FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateIdleToExecuting)) {
         ret = OMX_TRUE;
     } else {
         ret = OMX_FALSE;
@@ -242,11 +252,11 @@ void FP_Wait_ProcessPause(FP_OMX_BASECOMPONENT *pFpComponent, OMX_U32 nPortIndex
 
     rockchipOMXPort = &pFpComponent->pFoilplanetPort[nPortIndex];
 
-    if (((pFpComponent->currentState == OMX_StatePause) ||
-         (pFpComponent->currentState == OMX_StateIdle) ||
-         (pFpComponent->transientState == FP_OMX_TransStateLoadedToIdle) ||
-         (pFpComponent->transientState == FP_OMX_TransStateExecutingToIdle)) &&
-        (pFpComponent->transientState != FP_OMX_TransStateIdleToLoaded) &&
+    if (((FP_OMX_LOAD(pFpComponent->currentState) == OMX_StatePause) ||
+         (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateIdle) ||
+         (FP_OMX_LOAD(pFpComponent->transientState) == FP_OMX_TransStateLoadedToIdle) ||
+         (FP_OMX_LOAD(pFpComponent->transientState) == FP_OMX_TransStateExecutingToIdle)) &&
+        (FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateIdleToLoaded) &&
         (!CHECK_PORT_BEING_FLUSHED(rockchipOMXPort))) {
         OSAL_SignalWait(pFpComponent->pFoilplanetPort[nPortIndex].pauseEvent, DEF_MAX_WAIT_TIME);
         OSAL_SignalReset(pFpComponent->pFoilplanetPort[nPortIndex].pauseEvent);
@@ -568,6 +578,28 @@ OMX_ERRORTYPE FP_ProcessStoreMetaData(OMX_COMPONENTTYPE *pOMXComponent, OMX_BUFF
     return OMX_ErrorNone;
 }
 #endif
+/*
+ * Frames in buffers the component allocated from vpu memory are handed to
+ * the encoder by physical address, without the 0x80000000 copy request.
+ */
+static OMX_BOOL FP_Enc_InputInPlace(FP_OMX_BASEPORT *fpInputPort, FP_OMX_DATABUFFER *inputUseBuffer,
+                                    EncInputStream_t *aInput)
+{
+    OMX_S32 slot = FP_OMX_LookupBufferHeader(fpInputPort, inputUseBuffer->bufferHeader);
+    VPUMemLinear_t *pVpumem = NULL;
+
+    if (slot < 0 || fpInputPort->extendBufferHeader[slot].pVpumem == NULL)
+        return OMX_FALSE;
+
+    pVpumem = (VPUMemLinear_t *)fpInputPort->extendBufferHeader[slot].pVpumem;
+    /* written by the client through the cpu */
+    VPUMemClean(pVpumem);
+    aInput->bufPhyAddr = pVpumem->phy_addr + inputUseBuffer->usedDataLen;
+    aInput->buf = NULL;
+
+    return OMX_TRUE;
+}
+
 OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_BOOL ret = OMX_FALSE;
@@ -628,10 +660,9 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
             if (ret != OMX_ErrorNone) {
                 mpp_err("FP_ProcessStoreMetaData return %d ", ret);
                 FP_InputBufferReturn(pOMXComponent, inputUseBuffer);
-                pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                             pFpComponent->callbackData, OMX_EventError,
-                                                             OUTPUT_PORT_INDEX,
-                                                             OMX_IndexParamPortDefinition, NULL);
+                FP_OMX_PostEvent(pOMXComponent,
+                                 OMX_EventError,
+                                 OUTPUT_PORT_INDEX, OMX_IndexParamPortDefinition, NULL);
                 goto EXIT;
             }
 
@@ -641,10 +672,16 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
             aInput.timeUs = inputUseBuffer->timeStamp;
         } else {
             OMX_BUFFERHEADERTYPE* pInputBuffer = inputUseBuffer->bufferHeader;
-            if (pInputBuffer->nFilledLen == 4) {
+            if (CHECK_PORT_TUNNELED(fpInputPort) && pInputBuffer->pPlatformPrivate != NULL) {
+                /* frame from a tunneled decoder, already in vpu memory */
+                aInput.bufPhyAddr = ((VPUMemLinear_t *)pInputBuffer->pPlatformPrivate)->phy_addr;
+                aInput.buf = NULL;
+            } else if (pInputBuffer->nFilledLen == 4) {
                 aInput.bufPhyAddr = *(int32_t*)((uint8_t*)pInputBuffer->pBuffer + pInputBuffer->nOffset);
                 mpp_trace("rk camera metadata 0x%x", aInput.bufPhyAddr);
                 aInput.buf = NULL;
+            } else if (FP_Enc_InputInPlace(fpInputPort, inputUseBuffer, &aInput) == OMX_TRUE) {
+                ;
             } else {
                 aInput.buf =  inputUseBuffer->bufferHeader->pBuffer + inputUseBuffer->usedDataLen;
                 aInput.bufPhyAddr = 0x80000000;
@@ -661,10 +698,16 @@ OMX_BOOL FP_SendInputData(OMX_COMPONENTTYPE *pOMXComponent)
 #else
         {
             OMX_BUFFERHEADERTYPE* pInputBuffer = inputUseBuffer->bufferHeader;
-            if (pInputBuffer->nFilledLen == 4) {
+            if (CHECK_PORT_TUNNELED(fpInputPort) && pInputBuffer->pPlatformPrivate != NULL) {
+                /* frame from a tunneled decoder, already in vpu memory */
+                aInput.bufPhyAddr = ((VPUMemLinear_t *)pInputBuffer->pPlatformPrivate)->phy_addr;
+                aInput.buf = NULL;
+            } else if (pInputBuffer->nFilledLen == 4) {
                 aInput.bufPhyAddr = *(int32_t*)((uint8_t*)pInputBuffer->pBuffer + pInputBuffer->nOffset);
                 mpp_trace("rk camera metadata 0x%x", aInput.bufPhyAddr);
                 aInput.buf = NULL;
+            } else if (FP_Enc_InputInPlace(fpInputPort, inputUseBuffer, &aInput) == OMX_TRUE) {
+                ;
             } else {
                 aInput.buf =  inputUseBuffer->bufferHeader->pBuffer + inputUseBuffer->usedDataLen;
                 aInput.bufPhyAddr = 0x80000000;
@@ -730,6 +773,45 @@ EXIT:
     return ret;
 }
 
+/*
+ * Lays out [SPS/PPS] [start code] payload straight at their final offsets
+ * in the client buffer. The legacy encoder strips the AVC start code and
+ * returns the payload in its own allocation, so the payload copy stays
+ * until the encoder moves to the mpp task interface.
+ */
+static OMX_ERRORTYPE FP_Enc_ComposeStream(FP_OMX_VIDEOENC_COMPONENT *pVideoEnc, FP_OMX_DATABUFFER *outputUseBuffer,
+                                          EncoderOut_t *pOutput)
+{
+    static const OMX_U8 startCode[4] = { 0x00, 0x00, 0x00, 0x01 };
+    OMX_U8 *aOut_buf = outputUseBuffer->bufferHeader->pBuffer;
+    OMX_U32 nHeaderLen = 0;
+    OMX_U32 nPrefixLen = 0;
+
+    if (pVideoEnc->codecId == OMX_VIDEO_CodingAVC) {
+        if (pVideoEnc->bPrependSpsPpsToIdr && pOutput->keyFrame)
+            nHeaderLen = pVideoEnc->bSpsPpsLen;
+        nPrefixLen = nHeaderLen + sizeof(startCode);
+    }
+
+    if (nPrefixLen + (OMX_U32)pOutput->size > outputUseBuffer->allocSize) {
+        mpp_err("stream %d bytes does not fit output buffer %d", nPrefixLen + pOutput->size,
+                outputUseBuffer->allocSize);
+        outputUseBuffer->remainDataLen = 0;
+        outputUseBuffer->nFlags |= OMX_BUFFERFLAG_DATACORRUPT;
+        return OMX_ErrorOverflow;
+    }
+
+    if (nHeaderLen > 0)
+        memcpy(aOut_buf, pVideoEnc->bSpsPpsbuf, nHeaderLen);
+    if (nPrefixLen > 0)
+        memcpy(aOut_buf + nHeaderLen, startCode, sizeof(startCode));
+    memcpy(aOut_buf + nPrefixLen, pOutput->data, pOutput->size);
+
+    outputUseBuffer->remainDataLen = nPrefixLen + pOutput->size;
+    outputUseBuffer->usedDataLen = outputUseBuffer->remainDataLen;
+    return OMX_ErrorNone;
+}
+
 OMX_BOOL FP_Post_OutputStream(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_BOOL               ret = OMX_FALSE;
@@ -795,30 +877,9 @@ OMX_BOOL FP_Post_OutputStream(OMX_COMPONENTTYPE *pOMXComponent)
             } else
                 lastEncodeTime = currentEncodeTime;
 #endif
-            if (pVideoEnc->codecId == OMX_VIDEO_CodingAVC) {
-                if (pVideoEnc->bPrependSpsPpsToIdr && pOutput.keyFrame) {
-                    mpp_log("IDR outputUseBuffer->remainDataLen  %d spslen %d size %d", outputUseBuffer->remainDataLen
-                             , pVideoEnc->bSpsPpsLen, outputUseBuffer->allocSize);
-                    memcpy(aOut_buf, pVideoEnc->bSpsPpsbuf, pVideoEnc->bSpsPpsLen);
-                    memcpy(aOut_buf + pVideoEnc->bSpsPpsLen, "\x00\x00\x00\x01", 4);
-                    memcpy(aOut_buf + pVideoEnc->bSpsPpsLen + 4, pOutput.data, pOutput.size);
-                    outputUseBuffer->remainDataLen = pVideoEnc->bSpsPpsLen + pOutput.size + 4;
-                    outputUseBuffer->usedDataLen += pVideoEnc->bSpsPpsLen;
-                    outputUseBuffer->usedDataLen += 4;
-                    outputUseBuffer->usedDataLen += pOutput.size;
-                    mpp_log("IDR outputUseBuffer->remainDataLen 1 %d spslen %d size %d", outputUseBuffer->remainDataLen
-                             , pVideoEnc->bSpsPpsLen, outputUseBuffer->allocSize);
-                } else {
-                    memcpy(aOut_buf, "\x00\x00\x00\x01", 4);
-                    memcpy(aOut_buf + 4, pOutput.data, pOutput.size);
-                    outputUseBuffer->remainDataLen = pOutput.size + 4;
-                    outputUseBuffer->usedDataLen += 4;
-                    outputUseBuffer->usedDataLen += pOutput.size;
-                }
-            } else {
-                memcpy(aOut_buf, pOutput.data, pOutput.size);
-                outputUseBuffer->remainDataLen = pOutput.size;
-                outputUseBuffer->usedDataLen = pOutput.size;
+            if (FP_Enc_ComposeStream(pVideoEnc, outputUseBuffer, &pOutput) != OMX_ErrorNone) {
+                /* the frame is lost, the client gets the empty buffer back flagged corrupt */
+                FP_OMX_PostEvent(pOMXComponent, OMX_EventError, OMX_ErrorOverflow, 0, NULL);
             }
             if (pVideoEnc->fp_enc_out != NULL) {
                 fwrite(aOut_buf, 1, outputUseBuffer->remainDataLen , pVideoEnc->fp_enc_out);
@@ -834,7 +895,7 @@ OMX_BOOL FP_Post_OutputStream(OMX_COMPONENTTYPE *pOMXComponent)
                 pOutput.data = NULL;
             }
             if ((outputUseBuffer->remainDataLen > 0) ||
-                ((outputUseBuffer->nFlags & OMX_BUFFERFLAG_EOS) == OMX_BUFFERFLAG_EOS) ||
+                ((outputUseBuffer->nFlags & (OMX_BUFFERFLAG_EOS | OMX_BUFFERFLAG_DATACORRUPT)) != 0) ||
                 (CHECK_PORT_BEING_FLUSHED(pOutputPort))) {
                 mpp_trace("FP_OutputBufferReturn");
                 FP_OutputBufferReturn(pOMXComponent, outputUseBuffer);
@@ -881,19 +942,18 @@ OMX_ERRORTYPE FP_OMX_InputBufferProcess(OMX_HANDLETYPE hComponent)
 
     FunctionIn();
 
-    while (!pVideoEnc->bExitBufferProcessThread) {
-        usleep(0);
+    while (!FP_OMX_LOAD(pVideoEnc->bExitBufferProcessThread)) {
         FP_Wait_ProcessPause(pFpComponent, INPUT_PORT_INDEX);
         mpp_trace("FP_Check_BufferProcess_State in");
         while ((FP_Check_BufferProcess_State(pFpComponent, INPUT_PORT_INDEX)) &&
-               (!pVideoEnc->bExitBufferProcessThread)) {
+               (!FP_OMX_LOAD(pVideoEnc->bExitBufferProcessThread))) {
 
 
             if ((CHECK_PORT_BEING_FLUSHED(fpInputPort)) ||
                 (((FP_OMX_EXCEPTION_STATE)fpOutputPort->exceptionFlag != GENERAL_STATE) && ((FP_OMX_ERRORTYPE)ret == OMX_ErrorInputDataDecodeYet)))
                 break;
 
-            if (fpInputPort->portState != OMX_StateIdle)
+            if (FP_OMX_LOAD(fpInputPort->portState) != OMX_StateIdle)
                 break;
 
             MUTEX_LOCK(srcInputUseBuffer->bufferMutex);
@@ -910,7 +970,9 @@ OMX_ERRORTYPE FP_OMX_InputBufferProcess(OMX_HANDLETYPE hComponent)
 
                 if (srcInputUseBuffer->dataValid == OMX_TRUE) {
                     if (FP_SendInputData((OMX_COMPONENTTYPE *)hComponent) != OMX_TRUE) {
-                        usleep(5 * 1000);
+                        OSAL_SignalWaitReset(fpInputPort->hCodecReadyEvent, CODEC_WAIT_TIME_MS);
+                    } else {
+                        OSAL_SignalSet(fpOutputPort->hCodecReadyEvent);
                     }
                 }
                 if (CHECK_PORT_BEING_FLUSHED(fpInputPort)) {
@@ -920,8 +982,12 @@ OMX_ERRORTYPE FP_OMX_InputBufferProcess(OMX_HANDLETYPE hComponent)
             }
             MUTEX_UNLOCK(srcInputUseBuffer->bufferMutex);
             if ((FP_OMX_ERRORTYPE)ret == OMX_ErrorCodecInit)
-                pVideoEnc->bExitBufferProcessThread = OMX_TRUE;
+                FP_OMX_STORE(pVideoEnc->bExitBufferProcessThread, OMX_TRUE);
         }
+
+        /* flush done and exit set hCodecReadyEvent, the rest ends on timeout */
+        if (!FP_OMX_LOAD(pVideoEnc->bExitBufferProcessThread))
+            OSAL_SignalWaitReset(fpInputPort->hCodecReadyEvent, CODEC_WAIT_TIME_MS);
     }
 
 EXIT:
@@ -938,18 +1004,18 @@ OMX_ERRORTYPE FP_OMX_OutputBufferProcess(OMX_HANDLETYPE hComponent)
     OMX_COMPONENTTYPE     *pOMXComponent = (OMX_COMPONENTTYPE *)hComponent;
     FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     FP_OMX_VIDEOENC_COMPONENT *pVideoEnc = (FP_OMX_VIDEOENC_COMPONENT *)pFpComponent->hComponentHandle;
+    FP_OMX_BASEPORT      *fpInputPort = &pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX];
     FP_OMX_BASEPORT      *fpOutputPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
     FP_OMX_DATABUFFER    *dstOutputUseBuffer = &fpOutputPort->way.port2WayDataBuffer.outputDataBuffer;
     VpuCodecContext_t    *p_vpu_ctx = pVideoEnc->vpu_ctx;
 
     FunctionIn();
 
-    while (!pVideoEnc->bExitBufferProcessThread) {
-        usleep(0);
+    while (!FP_OMX_LOAD(pVideoEnc->bExitBufferProcessThread)) {
         FP_Wait_ProcessPause(pFpComponent, OUTPUT_PORT_INDEX);
 
         while ((FP_Check_BufferProcess_State(pFpComponent, OUTPUT_PORT_INDEX)) &&
-               (!pVideoEnc->bExitBufferProcessThread)) {
+               (!FP_OMX_LOAD(pVideoEnc->bExitBufferProcessThread))) {
 
             if (CHECK_PORT_BEING_FLUSHED(fpOutputPort))
                 break;
@@ -972,11 +1038,16 @@ OMX_ERRORTYPE FP_OMX_OutputBufferProcess(OMX_HANDLETYPE hComponent)
                 ret = (OMX_ERRORTYPE)FP_Post_OutputStream(pOMXComponent);
                 MUTEX_UNLOCK(pVideoEnc->bRecofig_Mutex);
                 if (ret != (OMX_ERRORTYPE)OMX_TRUE) {
-                    usleep(5 * 1000);
+                    OSAL_SignalWaitReset(fpOutputPort->hCodecReadyEvent, OUTPUT_POLL_TIME_MS);
+                } else {
+                    OSAL_SignalSet(fpInputPort->hCodecReadyEvent);
                 }
             }
             MUTEX_UNLOCK(dstOutputUseBuffer->bufferMutex);
         }
+
+        if (!FP_OMX_LOAD(pVideoEnc->bExitBufferProcessThread))
+            OSAL_SignalWaitReset(fpOutputPort->hCodecReadyEvent, CODEC_WAIT_TIME_MS);
     }
 
 EXIT:
@@ -986,65 +1057,41 @@ EXIT:
     return ret;
 }
 
-static OMX_ERRORTYPE FP_OMX_InputProcessThread(OMX_PTR threadData)
+static void FP_OMX_InputProcessTask(OMX_PTR pTaskData)
 {
-    OMX_ERRORTYPE          ret = OMX_ErrorNone;
-    OMX_COMPONENTTYPE     *pOMXComponent = NULL;
-    FP_OMX_BASECOMPONENT *pFpComponent = NULL;
-    FP_OMX_MESSAGE       *message = NULL;
+    OMX_COMPONENTTYPE *pOMXComponent = (OMX_COMPONENTTYPE *)pTaskData;
 
     FunctionIn();
 
-    if (threadData == NULL) {
-        ret = OMX_ErrorBadParameter;
-        goto EXIT;
-    }
-    pOMXComponent = (OMX_COMPONENTTYPE *)threadData;
-    ret = FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE));
-    if (ret != OMX_ErrorNone) {
+    if (FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE)) != OMX_ErrorNone)
         goto EXIT;
-    }
-    pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    FP_OMX_InputBufferProcess(pOMXComponent);
 
-    pthread_exit(NULL);
+    FP_OMX_CodecThreadEnter(pOMXComponent, INPUT_PORT_INDEX);
+    FP_OMX_InputBufferProcess(pOMXComponent);
+    FP_OMX_CodecThreadLeave(pOMXComponent, INPUT_PORT_INDEX);
 
 EXIT:
     FunctionOut();
-
-    return ret;
 }
 
-static OMX_ERRORTYPE FP_OMX_OutputProcessThread(OMX_PTR threadData)
+static void FP_OMX_OutputProcessTask(OMX_PTR pTaskData)
 {
-    OMX_ERRORTYPE          ret = OMX_ErrorNone;
-    OMX_COMPONENTTYPE     *pOMXComponent = NULL;
-    FP_OMX_BASECOMPONENT *pFpComponent = NULL;
-    FP_OMX_MESSAGE       *message = NULL;
+    OMX_COMPONENTTYPE *pOMXComponent = (OMX_COMPONENTTYPE *)pTaskData;
 
     FunctionIn();
 
-    if (threadData == NULL) {
-        ret = OMX_ErrorBadParameter;
-        goto EXIT;
-    }
-    pOMXComponent = (OMX_COMPONENTTYPE *)threadData;
-    ret = FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE));
-    if (ret != OMX_ErrorNone) {
+    if (FP_OMX_Check_SizeVersion(pOMXComponent, sizeof(OMX_COMPONENTTYPE)) != OMX_ErrorNone)
         goto EXIT;
-    }
-    pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
-    FP_OMX_OutputBufferProcess(pOMXComponent);
 
-    pthread_exit(NULL);
+    FP_OMX_CodecThreadEnter(pOMXComponent, OUTPUT_PORT_INDEX);
+    FP_OMX_OutputBufferProcess(pOMXComponent);
+    FP_OMX_CodecThreadLeave(pOMXComponent, OUTPUT_PORT_INDEX);
 
 EXIT:
     FunctionOut();
-
-    return ret;
 }
 
-OMX_ERRORTYPE FP_OMX_BufferProcess_Create( OMX_COMPONENTTYPE *pOMXComponent)
+OMX_ERRORTYPE FP_OMX_BufferProcess_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
     FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
@@ -1052,55 +1099,66 @@ OMX_ERRORTYPE FP_OMX_BufferProcess_Create( OMX_COMPONENTTYPE *pOMXComponent)
 
     FunctionIn();
 
-    pVideoEnc->bExitBufferProcessThread = OMX_FALSE;
+    FP_OMX_STORE(pVideoEnc->bExitBufferProcessThread, OMX_TRUE);
 
-    pVideoEnc->hOutputThread = new MppThread((MppThreadFunc)FP_OMX_OutputProcessThread, pOMXComponent);
+    OSAL_QueueWake(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].bufferQ);
+    OSAL_SignalSet(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].pauseEvent);
+    OSAL_SignalSet(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].hCodecReadyEvent);
 
-    pVideoEnc->hInputThread = new MppThread((MppThreadFunc)FP_OMX_InputProcessThread, pOMXComponent);
+    OSAL_QueueWake(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].bufferQ);
+    OSAL_SignalSet(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].pauseEvent);
+    OSAL_SignalSet(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].hCodecReadyEvent);
+
+    /* returns once the loop has, the caller frees the port mutexes it uses next */
+    if (pVideoEnc->hInputQueue != NULL) {
+        OSAL_SerialQueueTerminate(pVideoEnc->hInputQueue);
+        pVideoEnc->hInputQueue = NULL;
+    }
+    if (pVideoEnc->hOutputQueue != NULL) {
+        OSAL_SerialQueueTerminate(pVideoEnc->hOutputQueue);
+        pVideoEnc->hOutputQueue = NULL;
+    }
+
+    pFpComponent->checkTimeStamp.needSetStartTimeStamp = OMX_FALSE;
+    pFpComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
 
-EXIT:
     FunctionOut();
 
     return ret;
 }
 
-OMX_ERRORTYPE FP_OMX_BufferProcess_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
+/*
+ * The input and output loops run on the codec pool, each on a serial queue
+ * of its own. A loop holds its worker until FP_OMX_BufferProcess_Terminate.
+ */
+OMX_ERRORTYPE FP_OMX_BufferProcess_Create(OMX_COMPONENTTYPE *pOMXComponent)
 {
     OMX_ERRORTYPE          ret = OMX_ErrorNone;
     FP_OMX_BASECOMPONENT *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
     FP_OMX_VIDEOENC_COMPONENT *pVideoEnc = (FP_OMX_VIDEOENC_COMPONENT *)pFpComponent->hComponentHandle;
-    OMX_S32                countValue = 0;
-    unsigned int           i = 0;
 
     FunctionIn();
 
-    pVideoEnc->bExitBufferProcessThread = OMX_TRUE;
-
-    OSAL_Get_SemaphoreCount(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].bufferSemID, &countValue);
-    if (countValue == 0)
-        OSAL_SemaphorePost(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].bufferSemID);
-
-    OSAL_SignalSet(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].pauseEvent);
-
-    delete (MppThread *)pVideoEnc->hInputThread;
-    pVideoEnc->hInputThread = NULL;
-
-    OSAL_Get_SemaphoreCount(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].bufferSemID, &countValue);
-    if (countValue == 0)
-        OSAL_SemaphorePost(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].bufferSemID);
-
-
-    OSAL_SignalSet(pFpComponent->pFoilplanetPort[INPUT_PORT_INDEX].pauseEvent);
-
-    OSAL_SignalSet(pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX].pauseEvent);
+    FP_OMX_STORE(pVideoEnc->bExitBufferProcessThread, OMX_FALSE);
 
-    delete (MppThread *)pVideoEnc->hOutputThread;
-    pVideoEnc->hOutputThread = NULL;
+    ret = OSAL_SerialQueueCreate(&pVideoEnc->hOutputQueue, OSAL_TASK_POOL_CODEC, 1);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+    ret = OSAL_SerialQueueCreate(&pVideoEnc->hInputQueue, OSAL_TASK_POOL_CODEC, 1);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
 
-    pFpComponent->checkTimeStamp.needSetStartTimeStamp = OMX_FALSE;
-    pFpComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
+    ret = OSAL_SerialQueueSubmit(pVideoEnc->hOutputQueue, FP_OMX_OutputProcessTask, pOMXComponent);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+    ret = OSAL_SerialQueueSubmit(pVideoEnc->hInputQueue, FP_OMX_InputProcessTask, pOMXComponent);
 
 EXIT:
+    if (ret != OMX_ErrorNone) {
+        mpp_err("start codec loops failed, ret 0x%x", ret);
+        FP_OMX_BufferProcess_Terminate(pOMXComponent);
+        ret = OMX_ErrorInsufficientResources;
+    }
     FunctionOut();
 
     return ret;
@@ -1394,12 +1452,10 @@ OMX_ERRORTYPE FP_Enc_ComponentInit(OMX_COMPONENTTYPE *pOMXComponent)
     }
     pVideoEnc->bEncSendEos = OMX_FALSE;
     pVideoEnc->enc_vpumem = NULL;
-    pVideoEnc->enc_vpumem = mpp_malloc(VPUMemLinear_t, 1);
-    ret = (OMX_ERRORTYPE)VPUMallocLinear(pVideoEnc->enc_vpumem, 
-        ((EncParam->width + 15) & 0xfff0) * EncParam->height * 4);
-    if (ret) {
-
-        mpp_err("err  %dtemp->phy_addr %x mWidth %d mHeight %d", ret, pVideoEnc->enc_vpumem->phy_addr,
+    ret = OSAL_VpumemAcquire(((EncParam->width + 15) & 0xfff0) * EncParam->height * 4,
+                             &pVideoEnc->enc_vpumem);
+    if (ret != OMX_ErrorNone) {
+        mpp_err("err %d staging vpumem mWidth %d mHeight %d", ret,
                 EncParam->width, EncParam->height);
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
@@ -1597,8 +1653,7 @@ OMX_ERRORTYPE FP_Enc_Terminate(OMX_COMPONENTTYPE *pOMXComponent)
     }
 
     if (pVideoEnc->enc_vpumem) {
-        VPUFreeLinear(pVideoEnc->enc_vpumem);
-        mpp_free(pVideoEnc->enc_vpumem);
+        OSAL_VpumemRelease(pVideoEnc->enc_vpumem);
         pVideoEnc->enc_vpumem = NULL;
     }
 
@@ -1787,6 +1842,10 @@ OMX_ERRORTYPE FP_OMX_ComponentConstructor(OMX_HANDLETYPE hComponent, OMX_STRING
     pFpComponent->fp_BufferProcessTerminate = &FP_OMX_BufferProcess_Terminate;
     pFpComponent->fp_BufferFlush            = &FP_OMX_BufferFlush;
 
+    /* the input thread converts and copies source frames, keep it on the fast cores */
+    pFpComponent->codecThreadRole[INPUT_PORT_INDEX]  = OSAL_THREAD_ROLE_COPY;
+    pFpComponent->codecThreadRole[OUTPUT_PORT_INDEX] = OSAL_THREAD_ROLE_CONTROL;
+
     if (!strcmp(componentName, RK_OMX_COMPONENT_H264_ENC)) {
         int i = 0;
         memset(pFoilplanetPort->portDefinition.format.video.cMIMEType, 0, MAX_OMX_MIMETYPE_SIZE);
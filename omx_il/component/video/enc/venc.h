@@ -56,8 +56,8 @@ typedef struct _FP_OMX_VIDEOENC_COMPONENT {
 
     /* Buffer Process */
     OMX_BOOL       bExitBufferProcessThread;
-    OMX_HANDLETYPE hInputThread;
-    OMX_HANDLETYPE hOutputThread;
+    OMX_HANDLETYPE hInputQueue;        /* codec pool serial queues running the loops */
+    OMX_HANDLETYPE hOutputQueue;
 
     OMX_VIDEO_CODINGTYPE codecId;
 
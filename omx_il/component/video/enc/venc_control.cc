@@ -24,6 +24,7 @@
 #include "OMX_Def.h"
 #include "OMX_IndexExt.h"
 #include "Foilplanet_OMX_Basecomponent.h"
+#include "Foilplanet_OMX_Tunnel.h"
 
 #include "venc.h"
 #include "venc_control.h"
@@ -40,6 +41,8 @@
 #endif
 
 #include "osal_event.h"
+#include "osal_queue.h"
+#include "osal_vpumem.h"
 #include "osal/mpp_list.h"
 #include "osal/mpp_log.h"
 #include "osal/mpp_mem.h"
@@ -174,7 +177,7 @@ OMX_ERRORTYPE FP_OMX_UseBuffer(
         ret = OMX_ErrorBadPortIndex;
         goto EXIT;
     }
-    if (pFoilplanetPort->portState != OMX_StateIdle) {
+    if (FP_OMX_TunnelAcceptsBuffer(pFpComponent, pFoilplanetPort) != OMX_TRUE) {
         ret = OMX_ErrorIncorrectStateOperation;
         goto EXIT;
     }
@@ -184,6 +187,10 @@ OMX_ERRORTYPE FP_OMX_UseBuffer(
         goto EXIT;
     }
 
+    ret = FP_OMX_PortReserveBuffers(pFoilplanetPort);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
     temp_bufferHeader = mpp_malloc(OMX_BUFFERHEADERTYPE, 1);
     if (temp_bufferHeader == NULL) {
         ret = OMX_ErrorInsufficientResources;
@@ -204,6 +211,8 @@ OMX_ERRORTYPE FP_OMX_UseBuffer(
             else
                 temp_bufferHeader->nOutputPortIndex = OUTPUT_PORT_INDEX;
 
+            FP_OMX_StampBufferHeader(pFoilplanetPort, i);
+
             pFoilplanetPort->assignedBufferNum++;
             if (pFoilplanetPort->assignedBufferNum == pFoilplanetPort->portDefinition.nBufferCountActual) {
                 pFoilplanetPort->portDefinition.bPopulated = OMX_TRUE;
@@ -240,6 +249,7 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
     FP_OMX_VIDEOENC_COMPONENT *pVideoEnc = NULL;
     OMX_BUFFERHEADERTYPE  *temp_bufferHeader = NULL;
     OMX_U8                *temp_buffer = NULL;
+    VPUMemLinear_t        *temp_vpumem = NULL;
     int                    temp_buffer_fd = -1;
     OMX_U32                i = 0;
 
@@ -269,7 +279,7 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
         goto EXIT;
     }
     /*
-        if (pFoilplanetPort->portState != OMX_StateIdle ) {
+        if (FP_OMX_LOAD(pFoilplanetPort->portState) != OMX_StateIdle ) {
             ret = OMX_ErrorIncorrectStateOperation;
             goto EXIT;
         }
@@ -279,6 +289,10 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
         goto EXIT;
     }
 
+    ret = FP_OMX_PortReserveBuffers(pFoilplanetPort);
+    if (ret != OMX_ErrorNone)
+        goto EXIT;
+
     temp_bufferHeader = mpp_malloc(OMX_BUFFERHEADERTYPE, 1);
     if (temp_bufferHeader == NULL) {
         ret = OMX_ErrorInsufficientResources;
@@ -287,7 +301,18 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
 
     memset(temp_bufferHeader, 0, sizeof(OMX_BUFFERHEADERTYPE));
 
-    temp_buffer = mpp_malloc(OMX_U8, nSizeBytes);
+    /*
+     * input frames are encoded in place from vpu memory; the stream is
+     * copied out of the encoder's own buffer by the cpu, heap is enough
+     */
+    if (nPortIndex == INPUT_PORT_INDEX) {
+        ret = OSAL_VpumemAcquire(nSizeBytes, &temp_vpumem);
+        if (ret != OMX_ErrorNone)
+            goto EXIT;
+        temp_buffer = (OMX_U8 *)temp_vpumem->vir_addr;
+    } else {
+        temp_buffer = mpp_malloc(OMX_U8, nSizeBytes);
+    }
     if (temp_buffer == NULL) {
         ret = OMX_ErrorInsufficientResources;
         goto EXIT;
@@ -297,7 +322,7 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
     for (i = 0; i < pFoilplanetPort->portDefinition.nBufferCountActual; i++) {
         if (pFoilplanetPort->bufferStateAllocate[i] == BUFFER_STATE_FREE) {
             pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader = temp_bufferHeader;
-            pFoilplanetPort->extendBufferHeader[i].buf_fd[0] = temp_buffer_fd;
+            FP_OMX_SetBufferFd(pFoilplanetPort, i, temp_buffer_fd);
             pFoilplanetPort->bufferStateAllocate[i] = (BUFFER_STATE_ALLOCATED | HEADER_STATE_ALLOCATED);
             INIT_SET_SIZE_VERSION(temp_bufferHeader, OMX_BUFFERHEADERTYPE);
         #if 0
@@ -307,10 +332,13 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
             temp_bufferHeader->pBuffer     = temp_buffer;
             temp_bufferHeader->nAllocLen   = nSizeBytes;
             temp_bufferHeader->pAppPrivate = pAppPrivate;
+            temp_bufferHeader->pPlatformPrivate = (OMX_PTR)temp_vpumem;
+            pFoilplanetPort->extendBufferHeader[i].pVpumem = (OMX_PTR)temp_vpumem;
             if (nPortIndex == INPUT_PORT_INDEX)
                 temp_bufferHeader->nInputPortIndex = INPUT_PORT_INDEX;
             else
                 temp_bufferHeader->nOutputPortIndex = OUTPUT_PORT_INDEX;
+            FP_OMX_StampBufferHeader(pFoilplanetPort, i);
             pFoilplanetPort->assignedBufferNum++;
             if (pFoilplanetPort->assignedBufferNum == pFoilplanetPort->portDefinition.nBufferCountActual) {
                 pFoilplanetPort->portDefinition.bPopulated = OMX_TRUE;
@@ -324,12 +352,17 @@ OMX_ERRORTYPE FP_OMX_AllocateBuffer(
         }
     }
 
-    mpp_free(temp_bufferHeader);
-    mpp_free(temp_buffer);
-
     ret = OMX_ErrorInsufficientResources;
 
 EXIT:
+    if (ret != OMX_ErrorNone) {
+        mpp_free(temp_bufferHeader);
+        if (temp_vpumem != NULL)
+            OSAL_VpumemRelease(temp_vpumem);
+        else
+            mpp_free(temp_buffer);
+    }
+
     FunctionOut();
 
     mpp_err("FP_OMX_AllocateBuffer in ret = 0x%x", ret);
@@ -375,19 +408,22 @@ OMX_ERRORTYPE FP_OMX_FreeBuffer(
         goto EXIT;
     }
 
-    if ((pFoilplanetPort->portState != OMX_StateLoaded) && (pFoilplanetPort->portState != OMX_StateInvalid)) {
-        (*(pFpComponent->pCallbacks->EventHandler))(pOMXComponent,
-                                                    pFpComponent->callbackData,
-                                                    (OMX_EVENTTYPE)OMX_EventError,
-                                                    (OMX_U32)OMX_ErrorPortUnpopulated,
-                                                    nPortIndex, NULL);
+    if ((FP_OMX_LOAD(pFoilplanetPort->portState) != OMX_StateLoaded) && (FP_OMX_LOAD(pFoilplanetPort->portState) != OMX_StateInvalid)) {
+        FP_OMX_PostEvent(pOMXComponent,
+                         (OMX_EVENTTYPE)OMX_EventError,
+                         (OMX_U32)OMX_ErrorPortUnpopulated, nPortIndex, NULL);
     }
 
-    for (i = 0; i < /*pFoilplanetPort->portDefinition.nBufferCountActual*/MAX_BUFFER_NUM; i++) {
+    for (i = 0; i < pFoilplanetPort->nBufferSlots; i++) {
         if (((pFoilplanetPort->bufferStateAllocate[i] | BUFFER_STATE_FREE) != 0) && (pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader != NULL)) {
             if (pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader->pBuffer == pBufferHdr->pBuffer) {
                 if (pFoilplanetPort->bufferStateAllocate[i] & BUFFER_STATE_ALLOCATED) {
-                    mpp_free(pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader->pBuffer);
+                    if (pFoilplanetPort->extendBufferHeader[i].pVpumem != NULL) {
+                        OSAL_VpumemRelease((VPUMemLinear_t *)pFoilplanetPort->extendBufferHeader[i].pVpumem);
+                        pFoilplanetPort->extendBufferHeader[i].pVpumem = NULL;
+                    } else {
+                        mpp_free(pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader->pBuffer);
+                    }
                     pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader->pBuffer = NULL;
                     pBufferHdr->pBuffer = NULL;
                 } else if (pFoilplanetPort->bufferStateAllocate[i] & BUFFER_STATE_ASSIGNED) {
@@ -399,6 +435,8 @@ OMX_ERRORTYPE FP_OMX_FreeBuffer(
                     pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader = NULL;
                     pBufferHdr = NULL;
                 }
+                pFoilplanetPort->extendBufferHeader[i].nGeneration = 0;
+                FP_OMX_SetBufferFd(pFoilplanetPort, i, 0);
                 pFoilplanetPort->bufferStateAllocate[i] = BUFFER_STATE_FREE;
                 ret = OMX_ErrorNone;
                 goto EXIT;
@@ -424,23 +462,14 @@ EXIT:
 
 OMX_ERRORTYPE FP_OMX_AllocateTunnelBuffer(FP_OMX_BASEPORT *pOMXBasePort, OMX_U32 nPortIndex)
 {
-    OMX_ERRORTYPE                 ret = OMX_ErrorNone;
-    (void)pOMXBasePort;
-    (void)nPortIndex;
-    ret = OMX_ErrorTunnelingUnsupported;
-EXIT:
-    return ret;
+    return FP_OMX_TunnelAllocateBuffer(pOMXBasePort, nPortIndex);
 }
 
 OMX_ERRORTYPE FP_OMX_FreeTunnelBuffer(FP_OMX_BASEPORT *pOMXBasePort, OMX_U32 nPortIndex)
 {
-    OMX_ERRORTYPE ret = OMX_ErrorNone;
-    (void)pOMXBasePort;
-    (void)nPortIndex;
-    ret = OMX_ErrorTunnelingUnsupported;
-EXIT:
-    return ret;
+    return FP_OMX_TunnelFreeBuffer(pOMXBasePort, nPortIndex);
 }
+
 OMX_ERRORTYPE FP_OMX_ComponentTunnelRequest(
     OMX_IN OMX_HANDLETYPE hComp,
     OMX_IN OMX_U32        nPort,
@@ -448,15 +477,7 @@ OMX_ERRORTYPE FP_OMX_ComponentTunnelRequest(
     OMX_IN OMX_U32        nTunneledPort,
     OMX_INOUT OMX_TUNNELSETUPTYPE *pTunnelSetup)
 {
-    OMX_ERRORTYPE ret = OMX_ErrorNone;
-    (void)hComp;
-    (void)nPort;
-    (void)hTunneledComp;
-    (void)nTunneledPort;
-    (void)pTunnelSetup;
-    ret = OMX_ErrorTunnelingUnsupported;
-EXIT:
-    return ret;
+    return FP_OMX_TunnelRequest(hComp, nPort, hTunneledComp, nTunneledPort, pTunnelSetup);
 }
 
 OMX_ERRORTYPE FP_OMX_GetFlushBuffer(FP_OMX_BASEPORT *pFoilplanetPort, FP_OMX_DATABUFFER *pDataBuffer[])
@@ -490,20 +511,14 @@ OMX_ERRORTYPE FP_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portInd
     FP_OMX_DATABUFFER    *pDataPortBuffer[2] = {NULL, NULL};
     FP_OMX_MESSAGE       *message = NULL;
     OMX_U32               flushNum = 0;
-    OMX_S32               semValue = 0;
     int i = 0, maxBufferNum = 0;
     FunctionIn();
 
     pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
 
-    while (GET_MPPLIST(pFoilplanetPort->bufferQ)->list_size() > 0) {
-        OSAL_Get_SemaphoreCount(pFpComponent->pFoilplanetPort[portIndex].bufferSemID, &semValue);
-        if (semValue == 0)
-            OSAL_SemaphorePost(pFpComponent->pFoilplanetPort[portIndex].bufferSemID);
-
-        OSAL_SemaphoreWait(pFpComponent->pFoilplanetPort[portIndex].bufferSemID);
-        GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE));
-        if ((message != NULL) && (message->messageType != FP_OMX_CommandFakeBuffer)) {
+    /* the codec thread is parked on the port buffer mutexes, drain the queue directly */
+    while ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) != NULL) {
+        if (message->messageType != FP_OMX_CommandFakeBuffer) {
             bufferHeader = (OMX_BUFFERHEADERTYPE *)message->pCmdData;
             bufferHeader->nFilledLen = 0;
 
@@ -513,7 +528,7 @@ OMX_ERRORTYPE FP_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portInd
                 FP_OMX_InputBufferReturn(pOMXComponent, bufferHeader);
             }
         }
-        mpp_free(message);
+        FP_OMX_PortMessageFree(pFoilplanetPort, message);
         message = NULL;
     }
 
@@ -541,7 +556,7 @@ OMX_ERRORTYPE FP_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portInd
             }
             FP_ResetCodecData(&pFoilplanetPort->processData);
 
-            maxBufferNum = pFoilplanetPort->portDefinition.nBufferCountActual;
+            maxBufferNum = pFoilplanetPort->nBufferSlots;
             for (i = 0; i < maxBufferNum; i++) {
                 if (pFoilplanetPort->extendBufferHeader[i].bBufferInOMX == OMX_TRUE) {
                     if (portIndex == OUTPUT_PORT_INDEX) {
@@ -568,16 +583,6 @@ OMX_ERRORTYPE FP_OMX_FlushPort(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 portInd
         pVideoEnc = (FP_OMX_VIDEOENC_COMPONENT *)pFpComponent->hComponentHandle;
     }
 
-    while (1) {
-        OMX_S32 cnt = 0;
-        OSAL_Get_SemaphoreCount(pFpComponent->pFoilplanetPort[portIndex].bufferSemID, &cnt);
-        if (cnt <= 0)
-            break;
-        OSAL_SemaphoreWait(pFpComponent->pFoilplanetPort[portIndex].bufferSemID);
-    }
-
-    // todo free node
-    GET_MPPLIST(pFoilplanetPort->bufferQ)->flush();
 
 EXIT:
     FunctionOut();
@@ -614,7 +619,7 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
 
     mpp_trace("OMX_CommandFlush start, port:%d", nPortIndex);
 
-    pFpComponent->pFoilplanetPort[nPortIndex].bIsPortFlushed = OMX_TRUE;
+    FP_OMX_STORE(pFpComponent->pFoilplanetPort[nPortIndex].bIsPortFlushed, OMX_TRUE);
 
     if (pFpComponent->bMultiThreadProcess == OMX_FALSE) {
         OSAL_SignalSet(pFpComponent->pauseEvent);
@@ -626,7 +631,7 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
     FP_OMX_GetFlushBuffer(pFoilplanetPort, flushPortBuffer);
 
 
-    OSAL_SemaphorePost(pFoilplanetPort->bufferSemID);
+    OSAL_QueueWake(pFoilplanetPort->bufferQ);
 
     MUTEX_LOCK(flushPortBuffer[0]->bufferMutex);
     MUTEX_LOCK(flushPortBuffer[1]->bufferMutex);
@@ -639,21 +644,18 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
         if (nPortIndex == INPUT_PORT_INDEX) {
             pFpComponent->checkTimeStamp.needSetStartTimeStamp = OMX_TRUE;
             pFpComponent->checkTimeStamp.needCheckStartTimeStamp = OMX_FALSE;
-            memset(pFpComponent->timeStamp, -19771003, sizeof(OMX_TICKS) * MAX_TIMESTAMP);
-            memset(pFpComponent->nFlags, 0, sizeof(OMX_U32) * MAX_FLAGS);
+            OSAL_ReorderReset(pFpComponent->hReorderMap);
             pFpComponent->getAllDelayBuffer = OMX_FALSE;
             pFpComponent->bSaveFlagEOS = OMX_FALSE;
             pFpComponent->bBehaviorEOS = OMX_FALSE;
             pFpComponent->reInputData = OMX_FALSE;
         }
 
-        pFpComponent->pFoilplanetPort[nPortIndex].bIsPortFlushed = OMX_FALSE;
+        FP_OMX_STORE(pFpComponent->pFoilplanetPort[nPortIndex].bIsPortFlushed, OMX_FALSE);
+        OSAL_SignalSet(pFpComponent->pFoilplanetPort[nPortIndex].hCodecReadyEvent);
         mpp_trace("OMX_CommandFlush EventCmdComplete, port:%d", nPortIndex);
         if (bEvent == OMX_TRUE)
-            pFpComponent->pCallbacks->EventHandler((OMX_HANDLETYPE)pOMXComponent,
-                                                         pFpComponent->callbackData,
-                                                         OMX_EventCmdComplete,
-                                                         OMX_CommandFlush, nPortIndex, NULL);
+            FP_OMX_PostEvent(pOMXComponent, OMX_EventCmdComplete, OMX_CommandFlush, nPortIndex, NULL);
     }
     MUTEX_UNLOCK(flushPortBuffer[1]->bufferMutex);
     MUTEX_UNLOCK(flushPortBuffer[0]->bufferMutex);
@@ -661,10 +663,7 @@ OMX_ERRORTYPE FP_OMX_BufferFlush(OMX_COMPONENTTYPE *pOMXComponent, OMX_S32 nPort
 EXIT:
     if ((ret != OMX_ErrorNone) && (pOMXComponent != NULL) && (pFpComponent != NULL)) {
         mpp_err("ERROR");
-        pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                     pFpComponent->callbackData,
-                                                     OMX_EventError,
-                                                     ret, 0, NULL);
+        FP_OMX_PostEvent(pOMXComponent, OMX_EventError, ret, 0, NULL);
     }
 
     FunctionOut();
@@ -719,10 +718,7 @@ OMX_ERRORTYPE FP_InputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent, FP_OMX_DATA
 
         if (bufferHeader->hMarkTargetComponent != NULL) {
             if (bufferHeader->hMarkTargetComponent == pOMXComponent) {
-                pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                             pFpComponent->callbackData,
-                                                             OMX_EventMark,
-                                                             0, 0, bufferHeader->pMarkData);
+                FP_OMX_PostEvent(pOMXComponent, OMX_EventMark, 0, 0, bufferHeader->pMarkData);
             } else {
                 pFpComponent->propagateMarkType.hMarkTargetComponent = bufferHeader->hMarkTargetComponent;
                 pFpComponent->propagateMarkType.pMarkData = bufferHeader->pMarkData;
@@ -754,19 +750,19 @@ OMX_ERRORTYPE FP_InputBufferGetQueue(FP_OMX_BASECOMPONENT *pFpComponent)
 
     inputUseBuffer = &(pFoilplanetPort->way.port2WayDataBuffer.inputDataBuffer);
 
-    if (pFpComponent->currentState != OMX_StateExecuting) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateExecuting) {
         ret = OMX_ErrorUndefined;
         goto EXIT;
-    } else if ((pFpComponent->transientState != FP_OMX_TransStateExecutingToIdle) &&
+    } else if ((FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateExecutingToIdle) &&
                (!CHECK_PORT_BEING_FLUSHED(pFoilplanetPort))) {
-        OSAL_SemaphoreWait(pFoilplanetPort->bufferSemID);
+        OSAL_QueueWait(pFoilplanetPort->bufferQ, DEF_MAX_WAIT_TIME);
         if (inputUseBuffer->dataValid != OMX_TRUE) {
-            if (GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE)) || message == NULL) {
+            if ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) == NULL) {
                 ret = OMX_ErrorUndefined;
                 goto EXIT;
             }
             if (message->messageType == FP_OMX_CommandFakeBuffer) {
-                mpp_free(message);
+                FP_OMX_PortMessageFree(pFoilplanetPort, message);
                 ret = (OMX_ERRORTYPE)OMX_ErrorCodecFlush;
                 goto EXIT;
             }
@@ -780,7 +776,7 @@ OMX_ERRORTYPE FP_InputBufferGetQueue(FP_OMX_BASECOMPONENT *pFpComponent)
             inputUseBuffer->nFlags        = inputUseBuffer->bufferHeader->nFlags;
             inputUseBuffer->timeStamp     = inputUseBuffer->bufferHeader->nTimeStamp;
 
-            mpp_free(message);
+            FP_OMX_PortMessageFree(pFoilplanetPort, message);
 
             if (inputUseBuffer->allocSize <= inputUseBuffer->dataLen)
                 mpp_warn("Input Buffer Full, Check input buffer size! allocSize:%d, dataLen:%d", inputUseBuffer->allocSize, inputUseBuffer->dataLen);
@@ -822,11 +818,9 @@ OMX_ERRORTYPE FP_OutputBufferReturn(OMX_COMPONENTTYPE *pOMXComponent, FP_OMX_DAT
 
         if ((bufferHeader->nFlags & OMX_BUFFERFLAG_EOS) == OMX_BUFFERFLAG_EOS) {
             mpp_trace("event OMX_BUFFERFLAG_EOS!!!");
-            pFpComponent->pCallbacks->EventHandler(pOMXComponent,
-                                                         pFpComponent->callbackData,
-                                                         OMX_EventBufferFlag,
-                                                         OUTPUT_PORT_INDEX,
-                                                         bufferHeader->nFlags, NULL);
+            FP_OMX_PostEvent(pOMXComponent,
+                             OMX_EventBufferFlag,
+                             OUTPUT_PORT_INDEX, bufferHeader->nFlags, NULL);
         }
 
         FP_OMX_OutputBufferReturn(pOMXComponent, bufferHeader);
@@ -852,19 +846,19 @@ OMX_ERRORTYPE FP_OutputBufferGetQueue(FP_OMX_BASECOMPONENT *pFpComponent)
 
     outputUseBuffer = &(pFoilplanetPort->way.port2WayDataBuffer.outputDataBuffer);
 
-    if (pFpComponent->currentState != OMX_StateExecuting) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateExecuting) {
         ret = OMX_ErrorUndefined;
         goto EXIT;
-    } else if ((pFpComponent->transientState != FP_OMX_TransStateExecutingToIdle) &&
+    } else if ((FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateExecutingToIdle) &&
                (!CHECK_PORT_BEING_FLUSHED(pFoilplanetPort))) {
-        OSAL_SemaphoreWait(pFoilplanetPort->bufferSemID);
+        OSAL_QueueWait(pFoilplanetPort->bufferQ, DEF_MAX_WAIT_TIME);
         if (outputUseBuffer->dataValid != OMX_TRUE) {
-            if (GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE)) || message == NULL) {
+            if ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) == NULL) {
                 ret = OMX_ErrorUndefined;
                 goto EXIT;
             }
             if (message->messageType == FP_OMX_CommandFakeBuffer) {
-                mpp_free(message);
+                FP_OMX_PortMessageFree(pFoilplanetPort, message);
                 ret = (OMX_ERRORTYPE)OMX_ErrorCodecFlush;
                 goto EXIT;
             }
@@ -875,7 +869,7 @@ OMX_ERRORTYPE FP_OutputBufferGetQueue(FP_OMX_BASECOMPONENT *pFpComponent)
             outputUseBuffer->remainDataLen = outputUseBuffer->dataLen;
             outputUseBuffer->usedDataLen   = 0; //dataBuffer->bufferHeader->nOffset;
             outputUseBuffer->dataValid     = OMX_TRUE;
-            mpp_free(message);
+            FP_OMX_PortMessageFree(pFoilplanetPort, message);
         }
         ret = OMX_ErrorNone;
     }
@@ -894,25 +888,25 @@ OMX_BUFFERHEADERTYPE *FP_OutputBufferGetQueue_Direct(FP_OMX_BASECOMPONENT *pFpCo
 
     FunctionIn();
 
-    if (pFpComponent->currentState != OMX_StateExecuting) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateExecuting) {
         retBuffer = NULL;
         goto EXIT;
-    } else if ((pFpComponent->transientState != FP_OMX_TransStateExecutingToIdle) &&
+    } else if ((FP_OMX_LOAD(pFpComponent->transientState) != FP_OMX_TransStateExecutingToIdle) &&
                (!CHECK_PORT_BEING_FLUSHED(pFoilplanetPort))) {
-        OSAL_SemaphoreWait(pFoilplanetPort->bufferSemID);
+        OSAL_QueueWait(pFoilplanetPort->bufferQ, DEF_MAX_WAIT_TIME);
 
-        if (GET_MPPLIST(pFoilplanetPort->bufferQ)->del_at_head(&message, sizeof(FP_OMX_MESSAGE)) || message == NULL) {
+        if ((message = FP_OMX_PortMessageDequeue(pFoilplanetPort)) == NULL) {
             retBuffer = NULL;
             goto EXIT;
         }
         if (message->messageType == FP_OMX_CommandFakeBuffer) {
-            mpp_free(message);
+            FP_OMX_PortMessageFree(pFoilplanetPort, message);
             retBuffer = NULL;
             goto EXIT;
         }
 
         retBuffer  = (OMX_BUFFERHEADERTYPE *)(message->pCmdData);
-        mpp_free(message);
+        FP_OMX_PortMessageFree(pFoilplanetPort, message);
     }
 
 EXIT:
@@ -980,7 +974,7 @@ OMX_ERRORTYPE FPV_OMX_GetParameter(
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    if (pFpComponent->currentState == OMX_StateInvalid ) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid ) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -1288,7 +1282,7 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
     }
     pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
 
-    if (pFpComponent->currentState == OMX_StateInvalid ) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid ) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -1386,13 +1380,14 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
 
         pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
 
-        if ((pFpComponent->currentState != OMX_StateLoaded) && (pFpComponent->currentState != OMX_StateWaitForResources)) {
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) && (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateWaitForResources)) {
             if (pFoilplanetPort->portDefinition.bEnabled == OMX_TRUE) {
                 ret = OMX_ErrorIncorrectStateOperation;
                 goto EXIT;
             }
         }
-        if (pPortDefinition->nBufferCountActual < pFoilplanetPort->portDefinition.nBufferCountMin) {
+        if ((pPortDefinition->nBufferCountActual < pFoilplanetPort->portDefinition.nBufferCountMin) ||
+            (pPortDefinition->nBufferCountActual > PORT_BUFFER_NUM_MAX)) {
             ret = OMX_ErrorBadParameter;
             goto EXIT;
         }
@@ -1474,7 +1469,7 @@ OMX_ERRORTYPE FPV_OMX_SetParameter(
             goto EXIT;
         }
 
-        if ((pFpComponent->currentState != OMX_StateLoaded) && (pFpComponent->currentState != OMX_StateWaitForResources)) {
+        if ((FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateLoaded) && (FP_OMX_LOAD(pFpComponent->currentState) != OMX_StateWaitForResources)) {
             ret = OMX_ErrorIncorrectStateOperation;
             goto EXIT;
         }
@@ -1586,7 +1581,7 @@ OMX_ERRORTYPE FPV_OMX_GetConfig(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -1706,7 +1701,7 @@ OMX_ERRORTYPE FPV_OMX_SetConfig(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -1883,7 +1878,7 @@ OMX_ERRORTYPE FPV_OMX_GetExtensionIndex(
         ret = OMX_ErrorBadParameter;
         goto EXIT;
     }
-    if (pFpComponent->currentState == OMX_StateInvalid) {
+    if (FP_OMX_LOAD(pFpComponent->currentState) == OMX_StateInvalid) {
         ret = OMX_ErrorInvalidState;
         goto EXIT;
     }
@@ -26,6 +26,7 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
     Foilplanet_OMX_Component_Register.cc \
+    Foilplanet_OMX_ContentPipe.cc \
     Foilplanet_OMX_Core.cc
 
 LOCAL_PRELINK_MODULE := false
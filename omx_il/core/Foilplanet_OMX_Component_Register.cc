@@ -157,7 +157,11 @@ OMX_ERRORTYPE Foilplanet_OMX_ComponentLoad(FOILPLANET_OMX_COMPONENT *rockchip_co
 
     OMX_ERRORTYPE (*Foilplanet_OMX_ComponentConstructor)(OMX_HANDLETYPE hComponent, OMX_STRING componentName);
 
-    libHandle = dlopen((OMX_STRING)rockchip_component->libName, RTLD_NOW);
+    /*
+     * component libraries link their own copy of the OSAL pools and caches,
+     * keep them mapped after dlclose in case a worker is still on its way out
+     */
+    libHandle = dlopen((OMX_STRING)rockchip_component->libName, RTLD_NOW | RTLD_NODELETE);
     if (!libHandle) {
         ret = OMX_ErrorInvalidComponentName;
         mpp_err("OMX_ErrorInvalidComponentName, Line:%d", __LINE__);
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Foilplanet_OMX_ContentPipe.h"
+
+#include "osal/mpp_log.h"
+#include "osal/mpp_mem.h"
+
+#ifdef MODULE_TAG
+# undef MODULE_TAG
+# define MODULE_TAG     "FP_OMX_PIPE"
+#endif
+
+typedef struct _FP_OMX_CONTENTPIPE_FILE {
+    CPbyte  *pMap;          /* NULL for an empty file */
+    CPuint   nSize;
+    CPuint   nPos;
+    CPuint   nAdvised;      /* end of the range already passed to madvise */
+    CPuint   nPageSize;
+    CPresult (*ClientCallback)(CP_EVENTTYPE eEvent, CPuint iParam);
+} FP_OMX_CONTENTPIPE_FILE;
+
+static const char *FP_OMX_ContentPipe_Path(const char *szURI)
+{
+    size_t prefix = strlen(FP_OMX_CONTENTPIPE_URI_PREFIX);
+
+    if (szURI == NULL)
+        return NULL;
+    if (strncmp(szURI, FP_OMX_CONTENTPIPE_URI_PREFIX, prefix) == 0)
+        szURI += prefix;
+
+    return (szURI[0] == '/') ? szURI : NULL;
+}
+
+/* keeps FP_OMX_CONTENTPIPE_READAHEAD bytes ahead of the read position in flight */
+static void FP_OMX_ContentPipe_Readahead(FP_OMX_CONTENTPIPE_FILE *pFile)
+{
+    CPuint start, end;
+
+    if (pFile->pMap == NULL)
+        return;
+    if (pFile->nAdvised >= pFile->nSize ||
+        pFile->nPos + FP_OMX_CONTENTPIPE_READAHEAD / 2 < pFile->nAdvised)
+        return;
+
+    start = pFile->nAdvised & ~(pFile->nPageSize - 1);
+    if (start < (pFile->nPos & ~(pFile->nPageSize - 1)))
+        start = pFile->nPos & ~(pFile->nPageSize - 1);
+    end = pFile->nPos + FP_OMX_CONTENTPIPE_READAHEAD;
+    if (end > pFile->nSize || end < pFile->nPos)
+        end = pFile->nSize;
+
+    madvise(pFile->pMap + start, end - start, MADV_WILLNEED);
+    pFile->nAdvised = end;
+}
+
+static CPresult FP_OMX_ContentPipe_Open(CPhandle *hContent, CPstring szURI, CP_ACCESSTYPE eAccess)
+{
+    FP_OMX_CONTENTPIPE_FILE *pFile = NULL;
+    const char *path = FP_OMX_ContentPipe_Path(szURI);
+    struct stat st;
+    int fd = -1;
+    CPresult ret = 0;
+
+    if (hContent == NULL || path == NULL)
+        return KD_EINVAL;
+    if (eAccess != CP_AccessRead)
+        return KD_EACCES;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        mpp_err("open %s failed, %s", path, strerror(errno));
+        return (errno == ENOENT) ? KD_ENOENT : KD_EIO;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ret = KD_EINVAL;
+        goto EXIT;
+    }
+    /* SetPosition takes a CPint offset, every position must be reachable from the start */
+    if ((unsigned long long)st.st_size > INT_MAX) {
+        ret = KD_EFBIG;
+        goto EXIT;
+    }
+
+    pFile = mpp_calloc(FP_OMX_CONTENTPIPE_FILE, 1);
+    if (pFile == NULL) {
+        ret = KD_ENOMEM;
+        goto EXIT;
+    }
+    pFile->nSize = (CPuint)st.st_size;
+    pFile->nPageSize = (CPuint)sysconf(_SC_PAGESIZE);
+
+    if (pFile->nSize > 0) {
+        void *map = mmap(NULL, pFile->nSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            mpp_err("mmap %s failed, %s", path, strerror(errno));
+            mpp_free(pFile);
+            pFile = NULL;
+            ret = KD_ENOMEM;
+            goto EXIT;
+        }
+        pFile->pMap = (CPbyte *)map;
+        /* bitstreams are consumed front to back, let the kernel read ahead wider */
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        madvise(pFile->pMap, pFile->nSize, MADV_SEQUENTIAL);
+        FP_OMX_ContentPipe_Readahead(pFile);
+    }
+
+    *hContent = (CPhandle)pFile;
+
+EXIT:
+    /* the mapping keeps the file referenced */
+    close(fd);
+    return ret;
+}
+
+static CPresult FP_OMX_ContentPipe_Close(CPhandle hContent)
+{
+    FP_OMX_CONTENTPIPE_FILE *pFile = (FP_OMX_CONTENTPIPE_FILE *)hContent;
+
+    if (pFile == NULL)
+        return KD_EINVAL;
+
+    if (pFile->pMap != NULL)
+        munmap(pFile->pMap, pFile->nSize);
+    mpp_free(pFile);
+
+    return 0;
+}
+
+static CPresult FP_OMX_ContentPipe_Create(CPhandle *hContent, CPstring szURI)
+{
+    (void)hContent;
+    (void)szURI;
+    return KD_ENOSYS;
+}
+
+static CPresult FP_OMX_ContentPipe_CheckAvailableBytes(CPhandle hContent, CPuint nBytesRequested,
+                                                       CP_CHECKBYTESRESULTTYPE *eResult)
+{
+    FP_OMX_CONTENTPIPE_FILE *pFile = (FP_OMX_CONTENTPIPE_FILE *)hContent;
+    CPuint nLeft;
+
+    if (pFile == NULL || eResult == NULL)
+        return KD_EINVAL;
+
+    /* everything is mapped, bytes are never "not ready" */
+    nLeft = pFile->nSize - pFile->nPos;
+    if (nLeft == 0)
+        *eResult = CP_CheckBytesAtEndOfStream;
+    else if (nLeft < nBytesRequested)
+        *eResult = CP_CheckBytesInsufficientBytes;
+    else
+        *eResult = CP_CheckBytesOk;
+
+    return 0;
+}
+
+static CPresult FP_OMX_ContentPipe_SetPosition(CPhandle hContent, CPint nOffset, CP_ORIGINTYPE eOrigin)
+{
+    FP_OMX_CONTENTPIPE_FILE *pFile = (FP_OMX_CONTENTPIPE_FILE *)hContent;
+    long long pos;
+
+    if (pFile == NULL)
+        return KD_EINVAL;
+
+    switch (eOrigin) {
+    case CP_OriginBegin:
+        pos = nOffset;
+        break;
+    case CP_OriginCur:
+        pos = (long long)pFile->nPos + nOffset;
+        break;
+    case CP_OriginEnd:
+        pos = (long long)pFile->nSize + nOffset;
+        break;
+    default:
+        return KD_EINVAL;
+    }
+    if (pos < 0 || pos > (long long)pFile->nSize)
+        return KD_ERANGE;
+
+    /* a seek breaks the sequential window, prefetch again from the new spot */
+    if ((CPuint)pos < pFile->nPos || (CPuint)pos > pFile->nAdvised)
+        pFile->nAdvised = (CPuint)pos;
+    pFile->nPos = (CPuint)pos;
+    FP_OMX_ContentPipe_Readahead(pFile);
+
+    return 0;
+}
+
+static CPresult FP_OMX_ContentPipe_GetPosition(CPhandle hContent, CPuint *pPosition)
+{
+    FP_OMX_CONTENTPIPE_FILE *pFile = (FP_OMX_CONTENTPIPE_FILE *)hContent;
+
+    if (pFile == NULL || pPosition == NULL)
+        return KD_EINVAL;
+
+    *pPosition = pFile->nPos;
+    return 0;
+}
+
+static CPresult FP_OMX_ContentPipe_Read(CPhandle hContent, CPbyte *pData, CPuint nSize)
+{
+    FP_OMX_CONTENTPIPE_FILE *pFile = (FP_OMX_CONTENTPIPE_FILE *)hContent;
+
+    if (pFile == NULL || (pData == NULL && nSize > 0))
+        return KD_EINVAL;
+    if (nSize > pFile->nSize - pFile->nPos)
+        return KD_ERANGE;
+
+    if (nSize > 0) {
+        memcpy(pData, pFile->pMap + pFile->nPos, nSize);
+        pFile->nPos += nSize;
+        FP_OMX_ContentPipe_Readahead(pFile);
+    }
+
+    return 0;
+}
+
+static CPresult FP_OMX_ContentPipe_ReadBuffer(CPhandle hContent, CPbyte **ppBuffer, CPuint *nSize,
+                                              CPbool bForbidCopy)
+{
+    FP_OMX_CONTENTPIPE_FILE *pFile = (FP_OMX_CONTENTPIPE_FILE *)hContent;
+    CPuint nLeft;
+
+    /* the mapping is contiguous, no request ever needs a copy */
+    (void)bForbidCopy;
+
+    if (pFile == NULL || ppBuffer == NULL || nSize == NULL)
+        return KD_EINVAL;
+
+    nLeft = pFile->nSize - pFile->nPos;
+    if (*nSize > nLeft)
+        *nSize = nLeft;
+
+    *ppBuffer = (*nSize > 0) ? pFile->pMap + pFile->nPos : NULL;
+    pFile->nPos += *nSize;
+    FP_OMX_ContentPipe_Readahead(pFile);
+
+    return 0;
+}
+
+static CPresult FP_OMX_ContentPipe_ReleaseReadBuffer(CPhandle hContent, CPbyte *pBuffer)
+{
+    FP_OMX_CONTENTPIPE_FILE *pFile = (FP_OMX_CONTENTPIPE_FILE *)hContent;
+
+    if (pFile == NULL)
+        return KD_EINVAL;
+    if (pBuffer != NULL &&
+        (pBuffer < pFile->pMap || pBuffer >= pFile->pMap + pFile->nSize))
+        return KD_EINVAL;
+
+    /* pages stay in the page cache, nothing to give back */
+    return 0;
+}
+
+static CPresult FP_OMX_ContentPipe_Write(CPhandle hContent, CPbyte *data, CPuint nSize)
+{
+    (void)hContent;
+    (void)data;
+    (void)nSize;
+    return KD_ENOSYS;
+}
+
+static CPresult FP_OMX_ContentPipe_GetWriteBuffer(CPhandle hContent, CPbyte **ppBuffer, CPuint nSize)
+{
+    (void)hContent;
+    (void)ppBuffer;
+    (void)nSize;
+    return KD_ENOSYS;
+}
+
+static CPresult FP_OMX_ContentPipe_WriteBuffer(CPhandle hContent, CPbyte *pBuffer, CPuint nFilledSize)
+{
+    (void)hContent;
+    (void)pBuffer;
+    (void)nFilledSize;
+    return KD_ENOSYS;
+}
+
+static CPresult FP_OMX_ContentPipe_RegisterCallback(CPhandle hContent,
+                                                    CPresult (*ClientCallback)(CP_EVENTTYPE eEvent, CPuint iParam))
+{
+    FP_OMX_CONTENTPIPE_FILE *pFile = (FP_OMX_CONTENTPIPE_FILE *)hContent;
+
+    if (pFile == NULL)
+        return KD_EINVAL;
+
+    /* kept for completeness, a mapped file never raises CP_BytesAvailable */
+    pFile->ClientCallback = ClientCallback;
+    return 0;
+}
+
+static CP_PIPETYPE gFileContentPipe = {
+    FP_OMX_ContentPipe_Open,
+    FP_OMX_ContentPipe_Close,
+    FP_OMX_ContentPipe_Create,
+    FP_OMX_ContentPipe_CheckAvailableBytes,
+    FP_OMX_ContentPipe_SetPosition,
+    FP_OMX_ContentPipe_GetPosition,
+    FP_OMX_ContentPipe_Read,
+    FP_OMX_ContentPipe_ReadBuffer,
+    FP_OMX_ContentPipe_ReleaseReadBuffer,
+    FP_OMX_ContentPipe_Write,
+    FP_OMX_ContentPipe_GetWriteBuffer,
+    FP_OMX_ContentPipe_WriteBuffer,
+    FP_OMX_ContentPipe_RegisterCallback,
+};
+
+CP_PIPETYPE *FP_OMX_ContentPipe_Get(const char *szURI)
+{
+    return (FP_OMX_ContentPipe_Path(szURI) != NULL) ? &gFileContentPipe : NULL;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FOILPLANET_OMX_CONTENTPIPE_H_
+#define _FOILPLANET_OMX_CONTENTPIPE_H_
+
+#include "OMX_Types.h"
+#include "OMX_ContentPipe.h"
+
+/*
+ * Read only pipe over local files, "file://" URIs and absolute paths.
+ * The whole file is mapped at Open, ReadBuffer hands out pointers into
+ * the page cache and the window ahead of the read position is prefetched
+ * with madvise, so a decoder can be fed without a copy through the client.
+ * Files above INT_MAX bytes are refused with KD_EFBIG, past that the CPint
+ * offset of SetPosition could not reach every position.
+ */
+#define FP_OMX_CONTENTPIPE_URI_PREFIX   "file://"
+#define FP_OMX_CONTENTPIPE_READAHEAD    (2 << 20)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the pipe for szURI, NULL when the scheme is not served locally */
+CP_PIPETYPE *FP_OMX_ContentPipe_Get(const char *szURI);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FOILPLANET_OMX_CONTENTPIPE_H_ */
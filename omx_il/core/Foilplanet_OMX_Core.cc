@@ -21,6 +21,7 @@
 
 #include "Foilplanet_OMX_Core.h"
 #include "Foilplanet_OMX_Component_Register.h"
+#include "Foilplanet_OMX_ContentPipe.h"
 #include "Foilplanet_OMX_Resourcemanager.h"
 
 #include "osal_event.h"
@@ -260,12 +261,42 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY FP_OMX_SetupTunnel(
     OMX_IN OMX_HANDLETYPE hInput,
     OMX_IN OMX_U32 nPortInput)
 {
-    OMX_ERRORTYPE ret = OMX_ErrorNotImplemented;
-    (void)hOutput;
-    (void)nPortOutput;
-    (void)hInput;
-    (void)nPortInput;
+    OMX_ERRORTYPE        ret = OMX_ErrorNone;
+    OMX_COMPONENTTYPE   *pOutput = (OMX_COMPONENTTYPE *)hOutput;
+    OMX_COMPONENTTYPE   *pInput = (OMX_COMPONENTTYPE *)hInput;
+    OMX_TUNNELSETUPTYPE  tunnelSetup;
+
+    FunctionIn();
+
+    if (gInitialized != 1) {
+        ret = OMX_ErrorNotReady;
+        goto EXIT;
+    }
+    if (pOutput == NULL && pInput == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+
+    tunnelSetup.nTunnelFlags = 0;
+    tunnelSetup.eSupplier = OMX_BufferSupplyUnspecified;
+
+    /* the output proposes, the input decides and tells the output the supplier */
+    if (pOutput != NULL) {
+        ret = pOutput->ComponentTunnelRequest(hOutput, nPortOutput, hInput, nPortInput, &tunnelSetup);
+        if (ret != OMX_ErrorNone)
+            goto EXIT;
+    }
+    if (pInput != NULL) {
+        ret = pInput->ComponentTunnelRequest(hInput, nPortInput, hOutput, nPortOutput, &tunnelSetup);
+        if (ret != OMX_ErrorNone && pOutput != NULL) {
+            /* undo the half made tunnel */
+            pOutput->ComponentTunnelRequest(hOutput, nPortOutput, NULL, 0, NULL);
+        }
+    }
+
 EXIT:
+    FunctionOut();
+
     return ret;
 }
 
@@ -273,10 +304,27 @@ OMX_API OMX_ERRORTYPE FP_OMX_GetContentPipe(
     OMX_OUT OMX_HANDLETYPE *hPipe,
     OMX_IN  OMX_STRING szURI)
 {
-    OMX_ERRORTYPE ret = OMX_ErrorNotImplemented;
-    (void)hPipe;
-    (void)szURI;
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+    CP_PIPETYPE *pPipe = NULL;
+
+    FunctionIn();
+
+    if (hPipe == NULL || szURI == NULL) {
+        ret = OMX_ErrorBadParameter;
+        goto EXIT;
+    }
+
+    pPipe = FP_OMX_ContentPipe_Get(szURI);
+    if (pPipe == NULL) {
+        mpp_err("no content pipe for %s", szURI);
+        ret = OMX_ErrorContentPipeCreationFailed;
+        goto EXIT;
+    }
+    *hPipe = (OMX_HANDLETYPE)pPipe;
+
 EXIT:
+    FunctionOut();
+
     return ret;
 }
 
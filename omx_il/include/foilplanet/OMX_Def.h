@@ -38,9 +38,9 @@
 #define MAX_OMX_COMPONENT_LIBNAME_SIZE  (OMX_MAX_STRINGNAME_SIZE * 2)
 #define MAX_OMX_MIMETYPE_SIZE           OMX_MAX_STRINGNAME_SIZE
 
-#define MAX_TIMESTAMP                   40
-#define MAX_FLAGS                       40
+#define MAX_REORDER_DEPTH               128
 #define MAX_BUFFER_REF                  40
+#define MAX_COMMAND_TASKS               8   /* preallocated message handler task nodes */
 
 #define MAX_BUFFER_PLANE                1
 
@@ -75,6 +75,17 @@ typedef struct _FP_OMX_WFD {
     OMX_BOOL bEnable;
 } FP_OMX_WFD;
 
+/* placement of the codec threads of one role, see osal_thread.h */
+typedef struct _FP_OMX_CONFIG_THREADPOLICY {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 eRole;              // OSAL_THREAD_ROLE
+    OMX_U32 nCpuMask;           // 0: any cpu
+    OMX_S32 nNice;
+    OMX_U32 nFifoPriority;      // nonzero selects SCHED_FIFO, see OSAL_THREAD_FIFO_CONFIG_MAX
+    char    cCgroup[64];        // cgroup from properties, read only
+} FP_OMX_CONFIG_THREADPOLICY;
+
 typedef struct _OMX_VIDEO_PARAMS_EXTENDED {
     OMX_U32 nSize;
     OMX_VERSIONTYPE nVersion;
@@ -128,6 +139,13 @@ typedef enum _FP_OMX_INDEXTYPE {
 #define FOILPLANET_INDEX_PARAM_EXTENDED_VIDEO "OMX.Topaz.index.param.extended_video"
     OMX_IndexParamRkEncExtendedVideo        = 0x7F050003,
 
+#define FOILPLANET_INDEX_CONFIG_THREAD_POLICY "OMX.fp.index.config.threadPolicy"
+    OMX_IndexConfigFpThreadPolicy           = 0x7F050004,
+
+    /* OMX_BOOL, immediate output without reorder and throttling, set before the first frame */
+#define FOILPLANET_INDEX_PARAM_ROCKCHIP_DEC_EXTENSION_LOW_LATENCY "OMX.fp.index.decoder.extension.lowLatency"
+    OMX_IndexParamRkDecoderExtensionLowLatency  = 0x7F050005,
+
 #define FOILPLANET_INDEX_PARAM_DSECRIBECOLORASPECTS "OMX.google.android.index.describeColorAspects"
     OMX_IndexParamRkDescribeColorAspects    = 0x7F000062,
 
@@ -42,15 +42,22 @@
         (_struct_)->nVersion.s.nStep = STEP_NUMBER;                 \
     } while (0)
 
+/*
+ * Component and port states are written by the command handler and read
+ * without locks by the buffer path and the codec threads
+ */
+#define FP_OMX_LOAD(field)          __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define FP_OMX_STORE(field, value)  __atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+
 /*
  * Port Specific
  */
 #define FOILPLANET_TUNNEL_ESTABLISHED 0x0001
 #define FOILPLANET_TUNNEL_IS_SUPPLIER 0x0002
 
-#define CHECK_PORT_BEING_FLUSHED(port)              (port->bIsPortFlushed == OMX_TRUE)
-#define CHECK_PORT_BEING_DISABLED(port)             (port->bIsPortDisabled == OMX_TRUE)
-#define CHECK_PORT_BEING_FLUSHED_OR_DISABLED(port)  ((port->bIsPortFlushed == OMX_TRUE) || (port->bIsPortDisabled == OMX_TRUE))
+#define CHECK_PORT_BEING_FLUSHED(port)              (FP_OMX_LOAD(port->bIsPortFlushed) == OMX_TRUE)
+#define CHECK_PORT_BEING_DISABLED(port)             (FP_OMX_LOAD(port->bIsPortDisabled) == OMX_TRUE)
+#define CHECK_PORT_BEING_FLUSHED_OR_DISABLED(port)  (CHECK_PORT_BEING_FLUSHED(port) || CHECK_PORT_BEING_DISABLED(port))
 #define CHECK_PORT_ENABLED(port)                    (port->portDefinition.bEnabled == OMX_TRUE)
 #define CHECK_PORT_POPULATED(port)                  (port->portDefinition.bPopulated == OMX_TRUE)
 #define CHECK_PORT_TUNNELED(port)                   (port->tunnelFlags & FOILPLANET_TUNNEL_ESTABLISHED)
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HOST_CUTILS_PROPERTIES_H_
+#define _HOST_CUTILS_PROPERTIES_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+/* host stand-in for the Android property store, values come from the environment */
+#define PROPERTY_KEY_MAX    32
+#define PROPERTY_VALUE_MAX  92
+
+static inline int property_get(const char *key, char *value, const char *default_value)
+{
+    const char *v = getenv(key);
+
+    if (v == NULL)
+        v = default_value;
+    if (v == NULL) {
+        value[0] = '\0';
+        return 0;
+    }
+    strncpy(value, v, PROPERTY_VALUE_MAX - 1);
+    value[PROPERTY_VALUE_MAX - 1] = '\0';
+    return (int)strlen(value);
+}
+
+static inline int property_set(const char *key, const char *value)
+{
+    return setenv(key, value, 1);
+}
+
+#endif /* _HOST_CUTILS_PROPERTIES_H_ */
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-ins for the parts of osal_android.cc the decoder links: the
+ * gralloc lookups work on HOST_ANB, enabling native buffers follows the
+ * device code. Pool and import decisions are the real osal_vpupool.cc.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "OMX_Def.h"
+#include "osal_android.h"
+#include "video/dec/vdec.h"
+#include "host_android.h"
+
+OMX_S32 get_gralloc_private(uint32_t *handle, gralloc_handle_t *private_hnd)
+{
+    if (handle == NULL)
+        return -1;
+    *private_hnd = ((HOST_ANB *)handle)->priv;
+    return 0;
+}
+
+OMX_COLOR_FORMATTYPE OSAL_GetANBColorFormat(OMX_IN OMX_PTR handle)
+{
+    gralloc_handle_t priv_hnd;
+
+    memset(&priv_hnd, 0, sizeof(priv_hnd));
+    get_gralloc_private((uint32_t *)handle, &priv_hnd);
+    if (priv_hnd.format == HAL_PIXEL_FORMAT_YCrCb_NV12)
+        return OMX_COLOR_FormatYUV420SemiPlanar;
+    return OMX_COLOR_FormatUnused;
+}
+
+unsigned int OSAL_OMX2HalPixelFormat(OMX_COLOR_FORMATTYPE omx_format)
+{
+    return (omx_format == OMX_COLOR_FormatYUV420SemiPlanar) ? HAL_PIXEL_FORMAT_YCrCb_NV12 : 0;
+}
+
+OMX_ERRORTYPE OSAL_LockANB(OMX_IN OMX_PTR pBuffer, OMX_IN OMX_U32 width, OMX_IN OMX_U32 height,
+                           OMX_IN OMX_COLOR_FORMATTYPE format, OMX_OUT OMX_PTR planes)
+{
+    HOST_ANB             *anb = (HOST_ANB *)pBuffer;
+    FoilplanetVideoPlane *vplanes = (FoilplanetVideoPlane *)planes;
+
+    (void)width;
+    (void)height;
+    (void)format;
+    if (anb == NULL)
+        return OMX_ErrorBadParameter;
+    vplanes[0].fd = anb->priv.share_fd;
+    vplanes[0].offset = 0;
+    vplanes[0].addr = anb->pData;
+    vplanes[0].type = anb->priv.type;
+    vplanes[0].stride = anb->priv.stride;
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_UnlockANB(OMX_IN OMX_PTR pBuffer)
+{
+    (void)pBuffer;
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OSAL_GetInfoFromMetaData(OMX_IN OMX_BYTE pBuffer, OMX_OUT OMX_PTR *ppBuf)
+{
+    (void)pBuffer;
+    *ppBuf = NULL;
+    return OMX_ErrorNotImplemented;
+}
+
+OMX_COLOR_FORMATTYPE OSAL_CheckFormat(FP_OMX_BASECOMPONENT *pFpComponent, OMX_IN OMX_PTR pVpuframe)
+{
+    (void)pFpComponent;
+    (void)pVpuframe;
+    return (OMX_COLOR_FORMATTYPE)HAL_PIXEL_FORMAT_YCrCb_NV12;
+}
+
+OMX_ERRORTYPE OSAL_PowerControl(FP_OMX_BASECOMPONENT *pFpComponent, int32_t width, int32_t height,
+                                int32_t mHevc, int32_t frameRate, OMX_BOOL mFlag, int bitDepth)
+{
+    (void)pFpComponent;
+    (void)width;
+    (void)height;
+    (void)mHevc;
+    (void)frameRate;
+    (void)mFlag;
+    (void)bitDepth;
+    return OMX_ErrorUndefined;
+}
+
+OMX_ERRORTYPE OSAL_GetANBParameter(OMX_IN OMX_HANDLETYPE hComponent, OMX_IN OMX_INDEXTYPE nIndex,
+                                   OMX_INOUT OMX_PTR ComponentParameterStructure)
+{
+    (void)hComponent;
+    (void)nIndex;
+    (void)ComponentParameterStructure;
+    return OMX_ErrorUnsupportedIndex;
+}
+
+/* OMX_IndexParamEnableAndroidBuffers as on the device, other indexes are not on the host */
+OMX_ERRORTYPE OSAL_SetANBParameter(OMX_IN OMX_HANDLETYPE hComponent, OMX_IN OMX_INDEXTYPE nIndex,
+                                   OMX_IN OMX_PTR ComponentParameterStructure)
+{
+    OMX_COMPONENTTYPE         *pOMXComponent = (OMX_COMPONENTTYPE *)hComponent;
+    FP_OMX_BASECOMPONENT      *pFpComponent = (FP_OMX_BASECOMPONENT *)pOMXComponent->pComponentPrivate;
+    FP_OMX_VIDEODEC_COMPONENT *pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    HOST_ENABLE_ANB_PARAMS    *pANBParams = (HOST_ENABLE_ANB_PARAMS *)ComponentParameterStructure;
+    FP_OMX_BASEPORT           *pFoilplanetPort = NULL;
+    OMX_U32                    portIndex = 0;
+
+    if ((FP_OMX_INDEXTYPE)nIndex != OMX_IndexParamEnableAndroidBuffers)
+        return OMX_ErrorUnsupportedIndex;
+    if (pANBParams->nPortIndex >= pFpComponent->portParam.nPorts)
+        return OMX_ErrorBadPortIndex;
+    portIndex = pANBParams->nPortIndex;
+    pFoilplanetPort = &pFpComponent->pFoilplanetPort[portIndex];
+
+    pVideoDec->bIsANBEnabled = pANBParams->enable;
+    pFoilplanetPort->portDefinition.nBufferCountActual = 20;
+    if (portIndex == OUTPUT_PORT_INDEX)
+        pFoilplanetPort->portDefinition.format.video.eColorFormat = (OMX_COLOR_FORMATTYPE)HAL_PIXEL_FORMAT_YCrCb_NV12;
+    if (pFoilplanetPort->bufferProcessType == BUFFER_COPY) {
+        if ((pVideoDec->codecId != OMX_VIDEO_CodingH263) && (pFoilplanetPort->portDefinition.format.video.nFrameWidth >= 176))
+            pFoilplanetPort->bufferProcessType = BUFFER_ANBSHARE;
+    }
+
+    if ((portIndex == OUTPUT_PORT_INDEX) &&
+        ((pFoilplanetPort->bufferProcessType & BUFFER_ANBSHARE) == BUFFER_ANBSHARE)) {
+        if (pVideoDec->bIsANBEnabled == OMX_TRUE) {
+            pFoilplanetPort->bufferProcessType = BUFFER_SHARE;
+            pFoilplanetPort->portDefinition.nBufferCountActual = 24;
+            if (pFoilplanetPort->portDefinition.format.video.nFrameWidth
+                * pFoilplanetPort->portDefinition.format.video.nFrameHeight > 1920 * 1088)
+                pFoilplanetPort->portDefinition.nBufferCountActual = 14;
+            if (pFoilplanetPort->portDefinition.format.video.nFrameWidth <= 1280)
+                pFoilplanetPort->portDefinition.nBufferCountActual = 25;
+        }
+        OSAL_Openvpumempool(pFpComponent, portIndex);
+    }
+
+    if ((portIndex == OUTPUT_PORT_INDEX) && !pVideoDec->bIsANBEnabled) {
+        /* drop the pool opened above or by an earlier enable before the copy one */
+        OSAL_Closevpumempool(pFpComponent);
+        pFoilplanetPort->bufferProcessType = BUFFER_COPY;
+        OSAL_Openvpumempool(pFpComponent, portIndex);
+    }
+
+    if (portIndex == INPUT_PORT_INDEX)
+        pFoilplanetPort->portDefinition.nBufferCountActual = 4;
+
+    return OMX_ErrorNone;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HOST_ANDROID_H_
+#define _HOST_ANDROID_H_
+
+#include "OMX_Types.h"
+#include "osal_vpupool.h"
+
+/*
+ * Host stand-ins for the gralloc side of osal_android.cc. A native window
+ * buffer is a HOST_ANB, its buffer handle is a pointer to it.
+ */
+typedef struct _HOST_ANB {
+    gralloc_handle_t  priv;
+    void             *pData;     /* what a lock maps */
+} HOST_ANB;
+
+/* same layout as EnableAndroidNativeBuffersParams */
+typedef struct _HOST_ENABLE_ANB_PARAMS {
+    OMX_U32         nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32         nPortIndex;
+    OMX_BOOL        enable;
+} HOST_ENABLE_ANB_PARAMS;
+
+#endif /* _HOST_ANDROID_H_ */
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-ins for what the device build links from libmpp and libvpu:
+ * the mpp log and memory functions, lists, and malloc backed linear vpu
+ * memory. Frames of the mock decoder (host_vpu.cc) go back to it through
+ * VPUFreeLinear.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osal/mpp_log.h"
+#include "osal/mpp_mem.h"
+#include "osal/mpp_list.h"
+#include "osal/mpp_thread.h"
+#include "mpp_buffer.h"
+#include "vpu_api.h"
+#include "host_vpu.h"
+
+RK_U32 mpp_debug = 0;
+
+static void host_log(FILE *out, const char *tag, const char *fmt, const char *func, va_list args)
+{
+    if (getenv("FP_TEST_QUIET") != NULL && out == stdout)
+        return;
+    fprintf(out, "%s: ", tag ? tag : "");
+    if (func)
+        fprintf(out, "%s: ", func);
+    vfprintf(out, fmt, args);
+    if (fmt[0] == '\0' || fmt[strlen(fmt) - 1] != '\n')
+        fputc('\n', out);
+}
+
+void _mpp_log(const char *tag, const char *fmt, const char *func, ...)
+{
+    va_list args;
+
+    va_start(args, func);
+    host_log(stdout, tag, fmt, func, args);
+    va_end(args);
+}
+
+void _mpp_err(const char *tag, const char *fmt, const char *func, ...)
+{
+    va_list args;
+
+    va_start(args, func);
+    host_log(stderr, tag, fmt, func, args);
+    va_end(args);
+}
+
+void mpp_log_set_flag(RK_U32 flag)
+{
+    mpp_debug = flag;
+}
+
+RK_U32 mpp_log_get_flag(void)
+{
+    return mpp_debug;
+}
+
+void *mpp_osal_malloc(const char *caller, size_t size)
+{
+    (void)caller;
+    return malloc(size);
+}
+
+void *mpp_osal_calloc(const char *caller, size_t size)
+{
+    (void)caller;
+    return calloc(1, size);
+}
+
+void mpp_osal_free(const char *caller, void *ptr)
+{
+    (void)caller;
+    free(ptr);
+}
+
+/* outstanding linear buffers, checked by the vpumem tests */
+int host_vpumem_live = 0;
+
+RK_S32 VPUMallocLinear(VPUMemLinear_t *p, RK_U32 size)
+{
+    p->vir_addr = (RK_U32 *)calloc(1, size);
+    if (p->vir_addr == NULL)
+        return -1;
+    p->phy_addr = 0x10000000;
+    p->size = size;
+    p->offset = NULL;
+    __sync_fetch_and_add(&host_vpumem_live, 1);
+    return 0;
+}
+
+RK_S32 VPUFreeLinear(VPUMemLinear_t *p)
+{
+    if (p->offset != NULL) {
+        HOST_VPU_BLOCK *block = (HOST_VPU_BLOCK *)p->offset;
+
+        block->release(block);
+    } else if (p->vir_addr != NULL) {
+        free(p->vir_addr);
+        __sync_fetch_and_sub(&host_vpumem_live, 1);
+    }
+    p->vir_addr = NULL;
+    p->phy_addr = 0;
+    p->offset = NULL;
+    return 0;
+}
+
+RK_S32 VPUMemLink(VPUMemLinear_t *p)
+{
+    (void)p;
+    return 0;
+}
+
+RK_S32 VPUMemClean(VPUMemLinear_t *p)
+{
+    (void)p;
+    return 0;
+}
+
+RK_S32 VPUMemInvalidate(VPUMemLinear_t *p)
+{
+    (void)p;
+    return 0;
+}
+
+RK_S32 VPUMemGetFD(VPUMemLinear_t *p)
+{
+    if (p->offset == NULL)
+        return -1;
+    return ((HOST_VPU_BLOCK *)p->offset)->fd;
+}
+
+/* no drm buffers on the host, callers fall back to heap memory */
+MPP_RET mpp_buffer_get_with_tag(MppBufferGroup group, MppBuffer *buffer, size_t size,
+                                const char *tag, const char *caller)
+{
+    (void)group;
+    (void)size;
+    (void)tag;
+    (void)caller;
+    *buffer = NULL;
+    return MPP_NOK;
+}
+
+void *mpp_buffer_get_ptr_with_caller(MppBuffer buffer, const char *caller)
+{
+    (void)buffer;
+    (void)caller;
+    return NULL;
+}
+
+struct mpp_list_node {
+    struct mpp_list_node *next;
+    RK_S32                size;
+    /* data follows */
+};
+
+RK_U32 mpp_list::keys = 0;
+
+mpp_list::mpp_list(node_destructor func)
+    : destroy(func),
+      head(NULL),
+      count(0)
+{
+}
+
+mpp_list::~mpp_list()
+{
+    flush();
+}
+
+RK_S32 mpp_list::add_at_tail(void *data, RK_S32 size)
+{
+    struct mpp_list_node *node = (struct mpp_list_node *)malloc(sizeof(*node) + size);
+    struct mpp_list_node **tail = &head;
+
+    if (node == NULL)
+        return -1;
+    node->next = NULL;
+    node->size = size;
+    memcpy(node + 1, data, size);
+    while (*tail != NULL)
+        tail = &(*tail)->next;
+    *tail = node;
+    count++;
+    return 0;
+}
+
+RK_S32 mpp_list::del_at_head(void *data, RK_S32 size)
+{
+    struct mpp_list_node *node = head;
+
+    if (node == NULL)
+        return -1;
+    if (data != NULL)
+        memcpy(data, node + 1, size < node->size ? size : node->size);
+    head = node->next;
+    count--;
+    free(node);
+    return 0;
+}
+
+RK_S32 mpp_list::list_size()
+{
+    return count;
+}
+
+RK_S32 mpp_list::flush()
+{
+    while (head != NULL) {
+        struct mpp_list_node *node = head;
+
+        head = node->next;
+        if (destroy != NULL)
+            destroy(node + 1);
+        free(node);
+    }
+    count = 0;
+    return 0;
+}
+
+void mpp_list::lock()
+{
+    mMutex.lock();
+}
+
+void mpp_list::unlock()
+{
+    mMutex.unlock();
+}
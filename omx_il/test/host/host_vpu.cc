@@ -0,0 +1,433 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for libvpu: the decoder context the component dlopens and
+ * the memory pools frames are decoded into. See host_vpu.h.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "OMX_Core.h"
+#include "vpu_api.h"
+#include "vpu.h"
+#include "host_vpu.h"
+
+#define HOST_VPU_STREAM_SLOTS   4
+#define HOST_VPU_POOL_MAX       64
+#define HOST_VPU_PHY_ADDR       0x20000000
+
+struct _HOST_VPU_POOL;
+
+typedef struct _HOST_VPU_SLOT {
+    HOST_VPU_BLOCK          block;      /* first, the block pointer is the slot */
+    struct _HOST_VPU_POOL  *pool;       /* NULL once the pool dropped it */
+    int                     bImported;
+    int                     bUsed;
+} HOST_VPU_SLOT;
+
+typedef struct _HOST_VPU_POOL {
+    vpu_display_mem_pool    base;       /* first, handed out as the pool */
+    int                     bImport;
+    int                     nMax;
+    size_t                  nBlockSize;
+    int                     nSlots;
+    HOST_VPU_SLOT          *slots[HOST_VPU_POOL_MAX];
+} HOST_VPU_POOL;
+
+typedef struct _HOST_VPU_PACKET {
+    RK_S64  pts;
+    int     bEos;
+} HOST_VPU_PACKET;
+
+typedef struct _HOST_VPU_DECODER {
+    HOST_VPU_POOL   *pool;
+    HOST_VPU_PACKET  packets[HOST_VPU_STREAM_SLOTS];
+    int              nHead;
+    int              nCount;
+    long             nFrame;
+} HOST_VPU_DECODER;
+
+/* blocks come back from any thread through VPUFreeLinear */
+static pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+static HOST_VPU_STATS  gStats;
+
+static void SlotDestroy(HOST_VPU_SLOT *slot)
+{
+    if (slot->bImported) {
+        munmap(slot->block.pData, slot->block.nSize);
+        close(slot->block.fd);
+    } else {
+        free(slot->block.pData);
+    }
+    free(slot);
+    gStats.nLiveBlocks--;
+}
+
+static void SlotRelease(HOST_VPU_BLOCK *block)
+{
+    HOST_VPU_SLOT *slot = (HOST_VPU_SLOT *)block;
+
+    pthread_mutex_lock(&gLock);
+    slot->bUsed = 0;
+    if (slot->pool == NULL)
+        SlotDestroy(slot);
+    pthread_mutex_unlock(&gLock);
+}
+
+static HOST_VPU_SLOT *SlotCreate(HOST_VPU_POOL *pool, int fd, void *pData, size_t nSize)
+{
+    HOST_VPU_SLOT *slot = (HOST_VPU_SLOT *)calloc(1, sizeof(HOST_VPU_SLOT));
+
+    if (slot == NULL)
+        return NULL;
+    slot->block.fd = fd;
+    slot->block.pData = pData;
+    slot->block.nSize = nSize;
+    slot->block.release = SlotRelease;
+    slot->pool = pool;
+    slot->bImported = (fd >= 0);
+    if (pool != NULL)
+        pool->slots[pool->nSlots++] = slot;
+    gStats.nLiveBlocks++;
+    return slot;
+}
+
+/* blocks still decoded into are destroyed when they come back */
+static void PoolDrop(HOST_VPU_POOL *pool)
+{
+    int i;
+
+    for (i = 0; i < pool->nSlots; i++) {
+        HOST_VPU_SLOT *slot = pool->slots[i];
+
+        slot->pool = NULL;
+        if (!slot->bUsed)
+            SlotDestroy(slot);
+        pool->slots[i] = NULL;
+    }
+    pool->nSlots = 0;
+}
+
+static HOST_VPU_SLOT *PoolGet(HOST_VPU_POOL *pool, size_t nSize)
+{
+    HOST_VPU_SLOT *slot = NULL;
+    int            i;
+
+    if (pool == NULL)
+        return SlotCreate(NULL, -1, malloc(nSize), nSize);
+
+    for (i = 0; i < pool->nSlots; i++) {
+        if (!pool->slots[i]->bUsed && pool->slots[i]->block.nSize >= nSize)
+            return pool->slots[i];
+    }
+    if (!pool->bImport && pool->nSlots < pool->nMax && pool->nSlots < HOST_VPU_POOL_MAX &&
+        nSize <= pool->nBlockSize) {
+        void *pData = malloc(pool->nBlockSize);
+
+        if (pData != NULL)
+            slot = SlotCreate(pool, -1, pData, pool->nBlockSize);
+    }
+    return slot;
+}
+
+static RK_S32 PoolCommit(vpu_display_mem_pool *p, RK_S32 hdl, RK_S32 size)
+{
+    HOST_VPU_POOL *pool = (HOST_VPU_POOL *)p;
+    struct stat    st;
+    void          *pData;
+    int            fd;
+
+    /* the secure flag in bit 10 is not a part of the fd */
+    fd = dup(hdl & ~(1 << 10));
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size < size)
+        size = (RK_S32)st.st_size;
+    pData = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (pData == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    pthread_mutex_lock(&gLock);
+    if (pool->nSlots >= HOST_VPU_POOL_MAX || SlotCreate(pool, fd, pData, size) == NULL) {
+        pthread_mutex_unlock(&gLock);
+        munmap(pData, size);
+        close(fd);
+        return -1;
+    }
+    gStats.nCommitted++;
+    pthread_mutex_unlock(&gLock);
+    return fd;
+}
+
+static void *PoolGetFree(vpu_display_mem_pool *p)
+{
+    (void)p;
+    return NULL;
+}
+
+static RK_S32 PoolIncUsed(vpu_display_mem_pool *p, void *hdl)
+{
+    (void)p;
+    (void)hdl;
+    return 0;
+}
+
+static RK_S32 PoolPutUsed(vpu_display_mem_pool *p, void *hdl)
+{
+    (void)p;
+    (void)hdl;
+    return 0;
+}
+
+static RK_S32 PoolReset(vpu_display_mem_pool *p)
+{
+    pthread_mutex_lock(&gLock);
+    PoolDrop((HOST_VPU_POOL *)p);
+    pthread_mutex_unlock(&gLock);
+    return 0;
+}
+
+static RK_S32 PoolUnusedNum(vpu_display_mem_pool *p)
+{
+    HOST_VPU_POOL *pool = (HOST_VPU_POOL *)p;
+    RK_S32         n = 0;
+    int            i;
+
+    pthread_mutex_lock(&gLock);
+    for (i = 0; i < pool->nSlots; i++)
+        n += !pool->slots[i]->bUsed;
+    pthread_mutex_unlock(&gLock);
+    return n;
+}
+
+static HOST_VPU_POOL *PoolCreate(int bImport, int nMax, size_t nBlockSize)
+{
+    HOST_VPU_POOL *pool = (HOST_VPU_POOL *)calloc(1, sizeof(HOST_VPU_POOL));
+
+    if (pool == NULL)
+        return NULL;
+    pool->base.commit_hdl = PoolCommit;
+    pool->base.get_free = PoolGetFree;
+    pool->base.inc_used = PoolIncUsed;
+    pool->base.put_used = PoolPutUsed;
+    pool->base.reset = PoolReset;
+    pool->base.get_unused_num = PoolUnusedNum;
+    pool->base.buff_size = (RK_S32)nBlockSize;
+    pool->bImport = bImport;
+    pool->nMax = nMax;
+    pool->nBlockSize = nBlockSize;
+    return pool;
+}
+
+static void PoolDestroy(HOST_VPU_POOL *pool)
+{
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&gLock);
+    PoolDrop(pool);
+    pthread_mutex_unlock(&gLock);
+    free(pool);
+}
+
+vpu_display_mem_pool *open_vpu_memory_pool(void)
+{
+    return (vpu_display_mem_pool *)PoolCreate(1, HOST_VPU_POOL_MAX, 0);
+}
+
+void close_vpu_memory_pool(vpu_display_mem_pool *p)
+{
+    PoolDestroy((HOST_VPU_POOL *)p);
+}
+
+int create_vpu_memory_pool_allocator(vpu_display_mem_pool **ipool, int num, int size)
+{
+    *ipool = (vpu_display_mem_pool *)PoolCreate(0, num, (size_t)size);
+    return (*ipool != NULL) ? 0 : -1;
+}
+
+void release_vpu_memory_pool_allocator(vpu_display_mem_pool *ipool)
+{
+    PoolDestroy((HOST_VPU_POOL *)ipool);
+}
+
+RK_S32 VPUMemJudgeIommu(void)
+{
+    return 1;
+}
+
+RK_U32 VPUCheckSupportWidth()
+{
+    return 4096;
+}
+
+static RK_S32 DecInit(VpuCodecContext_t *ctx, RK_U8 *extraData, RK_U32 extra_size)
+{
+    (void)ctx;
+    (void)extraData;
+    (void)extra_size;
+    return 0;
+}
+
+static RK_S32 DecDecode(VpuCodecContext_t *ctx, VideoPacket_t *pkt, DecoderOut_t *aDecOut)
+{
+    (void)ctx;
+    (void)pkt;
+    (void)aDecOut;
+    return -1;
+}
+
+static RK_S32 DecFlush(VpuCodecContext_t *ctx)
+{
+    HOST_VPU_DECODER *dec = (HOST_VPU_DECODER *)ctx->vpuApiObj;
+
+    pthread_mutex_lock(&gLock);
+    dec->nHead = 0;
+    dec->nCount = 0;
+    pthread_mutex_unlock(&gLock);
+    return 0;
+}
+
+static RK_S32 DecControl(VpuCodecContext_t *ctx, VPU_API_CMD cmdType, void *param)
+{
+    HOST_VPU_DECODER *dec = (HOST_VPU_DECODER *)ctx->vpuApiObj;
+
+    if (cmdType == VPU_API_SET_VPUMEM_CONTEXT) {
+        pthread_mutex_lock(&gLock);
+        dec->pool = (HOST_VPU_POOL *)param;
+        pthread_mutex_unlock(&gLock);
+    }
+    return 0;
+}
+
+/* one packet is one frame, a full stream list leaves pkt->size set */
+static RK_S32 DecSendStream(VpuCodecContext_t *ctx, VideoPacket_t *pkt)
+{
+    HOST_VPU_DECODER *dec = (HOST_VPU_DECODER *)ctx->vpuApiObj;
+    HOST_VPU_PACKET  *packet;
+
+    pthread_mutex_lock(&gLock);
+    if (dec->nCount < HOST_VPU_STREAM_SLOTS) {
+        packet = &dec->packets[(dec->nHead + dec->nCount) % HOST_VPU_STREAM_SLOTS];
+        packet->pts = pkt->pts;
+        packet->bEos = (pkt->nFlags & OMX_BUFFERFLAG_EOS) ? 1 : 0;
+        dec->nCount++;
+        pkt->size = 0;
+    }
+    pthread_mutex_unlock(&gLock);
+    return 0;
+}
+
+static RK_S32 DecGetFrame(VpuCodecContext_t *ctx, DecoderOut_t *aDecOut)
+{
+    HOST_VPU_DECODER *dec = (HOST_VPU_DECODER *)ctx->vpuApiObj;
+    VPU_FRAME        *frame = (VPU_FRAME *)aDecOut->data;
+    RK_U32            nStride = (ctx->width + 15) & ~15;
+    RK_U32            nSlice = (ctx->height + 15) & ~15;
+    size_t            nSize = (size_t)nStride * nSlice * 3 / 2;
+    HOST_VPU_PACKET   packet;
+    HOST_VPU_SLOT    *slot;
+    RK_U8            *pData;
+    RK_U32            x, y;
+
+    aDecOut->size = 0;
+    pthread_mutex_lock(&gLock);
+    if (dec->nCount == 0 || (slot = PoolGet(dec->pool, nSize)) == NULL) {
+        pthread_mutex_unlock(&gLock);
+        return 0;
+    }
+    slot->bUsed = 1;
+    /* copied, the slot takes the next packet as soon as the lock drops */
+    packet = dec->packets[dec->nHead];
+    dec->nHead = (dec->nHead + 1) % HOST_VPU_STREAM_SLOTS;
+    dec->nCount--;
+    gStats.nFrames++;
+    if (slot->bImported)
+        gStats.nImported++;
+    pthread_mutex_unlock(&gLock);
+
+    pData = (RK_U8 *)slot->block.pData;
+    for (y = 0; y < nSlice * 3 / 2; y++)
+        for (x = 0; x < nStride; x++)
+            pData[(size_t)y * nStride + x] = HOST_VPU_PIXEL(x, y, dec->nFrame);
+    dec->nFrame++;
+
+    memset(frame, 0, sizeof(VPU_FRAME));
+    frame->FrameBusAddr[0] = HOST_VPU_PHY_ADDR;
+    frame->FrameBusAddr[1] = HOST_VPU_PHY_ADDR + nStride * nSlice;
+    frame->FrameWidth = nStride;
+    frame->FrameHeight = nSlice;
+    frame->DisplayWidth = ctx->width;
+    frame->DisplayHeight = ctx->height;
+    frame->ColorType = VPU_OUTPUT_FORMAT_YUV420_SEMIPLANAR;
+    frame->vpumem.phy_addr = HOST_VPU_PHY_ADDR;
+    frame->vpumem.vir_addr = (RK_U32 *)pData;
+    frame->vpumem.size = (RK_U32)nSize;
+    frame->vpumem.offset = (RK_U32 *)&slot->block;
+
+    aDecOut->size = sizeof(VPU_FRAME);
+    aDecOut->timeUs = packet.pts;
+    aDecOut->nFlags = packet.bEos ? VPU_API_EOS_STREAM_REACHED : 0;
+    return 0;
+}
+
+RK_S32 vpu_open_context(struct VpuCodecContext **ctx)
+{
+    VpuCodecContext_t *p = *ctx;
+
+    if (p == NULL)
+        p = (VpuCodecContext_t *)calloc(1, sizeof(VpuCodecContext_t));
+    if (p == NULL)
+        return -1;
+    p->vpuApiObj = calloc(1, sizeof(HOST_VPU_DECODER));
+    if (p->vpuApiObj == NULL) {
+        if (*ctx == NULL)
+            free(p);
+        return -1;
+    }
+    p->init = DecInit;
+    p->decode = DecDecode;
+    p->flush = DecFlush;
+    p->control = DecControl;
+    p->decode_sendstream = DecSendStream;
+    p->decode_getframe = DecGetFrame;
+    *ctx = p;
+    return 0;
+}
+
+RK_S32 vpu_close_context(struct VpuCodecContext **ctx)
+{
+    if (*ctx == NULL)
+        return 0;
+    free((*ctx)->vpuApiObj);
+    free(*ctx);
+    *ctx = NULL;
+    return 0;
+}
+
+void host_vpu_get_stats(HOST_VPU_STATS *stats)
+{
+    pthread_mutex_lock(&gLock);
+    *stats = gStats;
+    pthread_mutex_unlock(&gLock);
+}
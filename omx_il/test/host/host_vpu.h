@@ -0,0 +1,56 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _HOST_VPU_H_
+#define _HOST_VPU_H_
+
+#include <stddef.h>
+
+/*
+ * Mock decoder built as libvpu.so, the component dlopens it like the
+ * device library. It takes any packet as one frame and writes frame n as
+ * HOST_VPU_PIXEL(x, y, n) over stride x slice rows of NV12, in the order
+ * the packets came. Frames go to a committed native buffer when an import
+ * pool is set, to a copy pool block otherwise.
+ */
+#define HOST_VPU_PIXEL(x, y, n)     ((unsigned char)((x) * 7 + (y) * 13 + (n)))
+
+/* decoder frame memory, set as VPUMemLinear_t.offset so VPUFreeLinear can hand it back */
+typedef struct _HOST_VPU_BLOCK {
+    int     fd;
+    void   *pData;
+    size_t  nSize;
+    void  (*release)(struct _HOST_VPU_BLOCK *block);
+} HOST_VPU_BLOCK;
+
+typedef struct _HOST_VPU_STATS {
+    long    nFrames;        /* frames handed out by decode_getframe */
+    long    nImported;      /* of them decoded into committed native buffers */
+    long    nCommitted;     /* native buffers committed to the import pool */
+    long    nLiveBlocks;    /* blocks not released yet */
+} HOST_VPU_STATS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void host_vpu_get_stats(HOST_VPU_STATS *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _HOST_VPU_H_ */
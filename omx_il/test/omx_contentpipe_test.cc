@@ -0,0 +1,139 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <limits.h>
+#include <fcntl.h>
+
+#include "fp_test.h"
+#include "Foilplanet_OMX_ContentPipe.h"
+
+#define FILE_SIZE   (5 * 1000 * 1000 + 7)
+
+static char gPath[64];
+static char gURI[80];
+
+static void WriteFile(void)
+{
+    FILE *f;
+    long  i;
+
+    strcpy(gPath, "/tmp/fpomx_pipe_XXXXXX");
+    FP_CHECK(close(mkstemp(gPath)) == 0);
+    snprintf(gURI, sizeof(gURI), "file://%s", gPath);
+
+    f = fopen(gPath, "wb");
+    FP_CHECK(f != NULL);
+    for (i = 0; i < FILE_SIZE; i++)
+        fputc(i & 255, f);
+    fclose(f);
+}
+
+/* ReadBuffer walks the whole file without a copy, across readahead windows */
+static void TestReadBuffer(CP_PIPETYPE *pipe, CPhandle h)
+{
+    CPbyte *pData = NULL;
+    CPuint  nTotal = 0, nPos = 0, n, i;
+
+    for (;;) {
+        n = 65536 + 13;
+        FP_CHECK(pipe->ReadBuffer(h, &pData, &n, OMX_FALSE) == 0);
+        if (n == 0)
+            break;
+        for (i = 0; i < n; i++)
+            FP_CHECK((CPbyte)((nTotal + i) & 255) == pData[i]);
+        FP_CHECK(pipe->ReleaseReadBuffer(h, pData) == 0);
+        nTotal += n;
+    }
+    FP_CHECK(nTotal == FILE_SIZE);
+    FP_CHECK(pipe->GetPosition(h, &nPos) == 0 && nPos == FILE_SIZE);
+}
+
+static void TestSeek(CP_PIPETYPE *pipe, CPhandle h)
+{
+    CP_CHECKBYTESRESULTTYPE result;
+    CPbyte                  data[16];
+    CPuint                  nPos = 0;
+
+    FP_CHECK(pipe->SetPosition(h, -10, CP_OriginEnd) == 0);
+    FP_CHECK(pipe->Read(h, data, 10) == 0);
+    FP_CHECK(data[0] == (CPbyte)((FILE_SIZE - 10) & 255) && data[9] == (CPbyte)((FILE_SIZE - 1) & 255));
+    FP_CHECK(pipe->Read(h, data, 1) != 0);
+    FP_CHECK(pipe->CheckAvailableBytes(h, 1, &result) == 0 && result == CP_CheckBytesAtEndOfStream);
+
+    FP_CHECK(pipe->SetPosition(h, 1000, CP_OriginBegin) == 0);
+    FP_CHECK(pipe->SetPosition(h, -500, CP_OriginCur) == 0);
+    FP_CHECK(pipe->GetPosition(h, &nPos) == 0 && nPos == 500);
+    FP_CHECK(pipe->Read(h, data, 4) == 0 && data[0] == (CPbyte)(500 & 255));
+    FP_CHECK(pipe->CheckAvailableBytes(h, FILE_SIZE, &result) == 0 && result == CP_CheckBytesInsufficientBytes);
+    FP_CHECK(pipe->CheckAvailableBytes(h, 16, &result) == 0 && result == CP_CheckBytesOk);
+
+    FP_CHECK(pipe->SetPosition(h, -1, CP_OriginBegin) == KD_ERANGE);
+    FP_CHECK(pipe->SetPosition(h, 1, CP_OriginEnd) == KD_ERANGE);
+    FP_CHECK(pipe->GetPosition(h, &nPos) == 0 && nPos == 504);
+}
+
+/* past INT_MAX bytes a CPint offset cannot reach every position */
+static void TestTooLarge(CP_PIPETYPE *pipe)
+{
+    char     path[64];
+    char     uri[80];
+    CPhandle h = NULL;
+    int      fd;
+
+    strcpy(path, "/tmp/fpomx_pipe_big_XXXXXX");
+    fd = mkstemp(path);
+    FP_CHECK(fd >= 0);
+    snprintf(uri, sizeof(uri), "file://%s", path);
+
+    /* sparse, nothing is written */
+    FP_CHECK(ftruncate(fd, (off_t)INT_MAX) == 0);
+    FP_CHECK(pipe->Open(&h, (CPstring)uri, CP_AccessRead) == 0);
+    FP_CHECK(pipe->SetPosition(h, INT_MAX, CP_OriginBegin) == 0);
+    FP_CHECK(pipe->Close(h) == 0);
+
+    FP_CHECK(ftruncate(fd, (off_t)INT_MAX + 1) == 0);
+    FP_CHECK(pipe->Open(&h, (CPstring)uri, CP_AccessRead) == KD_EFBIG);
+
+    close(fd);
+    unlink(path);
+}
+
+int main(void)
+{
+    CP_PIPETYPE *pipe;
+    CPhandle     h = NULL;
+
+    WriteFile();
+
+    pipe = FP_OMX_ContentPipe_Get(gURI);
+    FP_CHECK(pipe != NULL);
+    FP_CHECK(FP_OMX_ContentPipe_Get(gPath) == pipe);
+    FP_CHECK(FP_OMX_ContentPipe_Get("http://localhost/a.h264") == NULL);
+
+    FP_CHECK(pipe->Open(&h, (CPstring)gURI, CP_AccessWrite) == KD_EACCES);
+    FP_CHECK(pipe->Open(&h, (CPstring)"file:///tmp/fpomx_pipe_missing", CP_AccessRead) == KD_ENOENT);
+
+    FP_CHECK(pipe->Open(&h, (CPstring)gURI, CP_AccessRead) == 0);
+    TestReadBuffer(pipe, h);
+    TestSeek(pipe, h);
+    FP_CHECK(pipe->Close(h) == 0);
+    unlink(gPath);
+
+    TestTooLarge(pipe);
+
+    printf("omx_contentpipe_test passed\n");
+    return 0;
+}
@@ -0,0 +1,381 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Decoder output to encoder input loopback through the real port and
+ * tunnel code. The two components only have the OMX entry points the
+ * tunnel uses, two threads stand in for the codecs.
+ */
+
+#include <pthread.h>
+
+#include "fp_test.h"
+#include "OMX_Def.h"
+#include "OMX_Macros.h"
+#include "Foilplanet_OMX_Basecomponent.h"
+#include "Foilplanet_OMX_Baseport.h"
+#include "Foilplanet_OMX_Tunnel.h"
+#include "osal_event.h"
+#include "osal_queue.h"
+#include "osal_vpumem.h"
+#include "osal/mpp_thread.h"
+
+#define BUFFER_NUM      6
+#define BUFFER_SIZE     (320 * 240 * 3 / 2)
+#define FRAME_NUM       20000
+
+extern int host_vpumem_live;
+
+typedef struct _TEST_COMPONENT {
+    OMX_COMPONENTTYPE       omx;
+    FP_OMX_BASECOMPONENT    base;
+    const char             *name;
+    pthread_t               thread;
+    OMX_BOOL                bStop;
+    OMX_U32                 nFrames;
+    OMX_U32                 nBadFrames;
+} TEST_COMPONENT;
+
+static TEST_COMPONENT gDec;
+static TEST_COMPONENT gEnc;
+
+/* the pieces of the base component the port code calls back into */
+OMX_ERRORTYPE FP_OMX_Check_SizeVersion(OMX_PTR header, OMX_U32 size)
+{
+    OMX_VERSIONTYPE *version = (OMX_VERSIONTYPE *)((char *)header + sizeof(OMX_U32));
+
+    if (header == NULL || *((OMX_U32 *)header) != size)
+        return OMX_ErrorBadParameter;
+    if (version->s.nVersionMajor != VERSIONMAJOR_NUMBER || version->s.nVersionMinor != VERSIONMINOR_NUMBER)
+        return OMX_ErrorVersionMismatch;
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE FP_OMX_PostEvent(OMX_COMPONENTTYPE *, OMX_EVENTTYPE, OMX_U32, OMX_U32, OMX_PTR)
+{
+    return OMX_ErrorNone;
+}
+
+/* a tunneled port never calls the client */
+OMX_ERRORTYPE FP_OMX_PostEmptyBufferDone(OMX_COMPONENTTYPE *, OMX_BUFFERHEADERTYPE *)
+{
+    FP_CHECK(!"EmptyBufferDone on a tunneled port");
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE FP_OMX_PostFillBufferDone(OMX_COMPONENTTYPE *, OMX_BUFFERHEADERTYPE *)
+{
+    FP_CHECK(!"FillBufferDone on a tunneled port");
+    return OMX_ErrorNone;
+}
+
+static TEST_COMPONENT *Test(OMX_HANDLETYPE hComponent)
+{
+    return (hComponent == (OMX_HANDLETYPE)&gDec.omx) ? &gDec : &gEnc;
+}
+
+static OMX_ERRORTYPE TestGetComponentVersion(OMX_HANDLETYPE hComponent, OMX_STRING pComponentName,
+                                             OMX_VERSIONTYPE *, OMX_VERSIONTYPE *, OMX_UUIDTYPE *)
+{
+    strcpy(pComponentName, Test(hComponent)->name);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE TestGetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pParam)
+{
+    OMX_PARAM_PORTDEFINITIONTYPE *pDefinition = (OMX_PARAM_PORTDEFINITIONTYPE *)pParam;
+
+    FP_CHECK(nIndex == OMX_IndexParamPortDefinition && pDefinition->nPortIndex < ALL_PORT_NUM);
+    memcpy(pDefinition, &Test(hComponent)->base.pFoilplanetPort[pDefinition->nPortIndex].portDefinition,
+           sizeof(*pDefinition));
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE TestSetParameter(OMX_HANDLETYPE hComponent, OMX_INDEXTYPE nIndex, OMX_PTR pParam)
+{
+    FP_OMX_BASECOMPONENT *pFpComponent = &Test(hComponent)->base;
+
+    if (nIndex == OMX_IndexParamPortDefinition) {
+        OMX_PARAM_PORTDEFINITIONTYPE *pDefinition = (OMX_PARAM_PORTDEFINITIONTYPE *)pParam;
+        pFpComponent->pFoilplanetPort[pDefinition->nPortIndex].portDefinition.nBufferCountActual =
+            pDefinition->nBufferCountActual;
+    } else {
+        /* the output side of FP_OMX_SetParameter for OMX_IndexParamCompBufferSupplier */
+        OMX_PARAM_BUFFERSUPPLIERTYPE *pSupplier = (OMX_PARAM_BUFFERSUPPLIERTYPE *)pParam;
+        FP_OMX_BASEPORT              *pFoilplanetPort = &pFpComponent->pFoilplanetPort[pSupplier->nPortIndex];
+        FP_CHECK(nIndex == OMX_IndexParamCompBufferSupplier);
+        if (pSupplier->eBufferSupplier == OMX_BufferSupplyOutput)
+            pFoilplanetPort->tunnelFlags |= FOILPLANET_TUNNEL_IS_SUPPLIER;
+        else
+            pFoilplanetPort->tunnelFlags &= ~FOILPLANET_TUNNEL_IS_SUPPLIER;
+    }
+    return OMX_ErrorNone;
+}
+
+/* the slot handling of the codec UseBuffer implementations */
+static OMX_ERRORTYPE TestUseBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERHEADERTYPE **ppBufferHdr, OMX_U32 nPortIndex,
+                                   OMX_PTR pAppPrivate, OMX_U32 nSizeBytes, OMX_U8 *pBuffer)
+{
+    FP_OMX_BASECOMPONENT *pFpComponent = &Test(hComponent)->base;
+    FP_OMX_BASEPORT      *pFoilplanetPort = &pFpComponent->pFoilplanetPort[nPortIndex];
+    OMX_BUFFERHEADERTYPE *pBufferHdr = NULL;
+    OMX_U32               i;
+
+    if (FP_OMX_TunnelAcceptsBuffer(pFpComponent, pFoilplanetPort) != OMX_TRUE)
+        return OMX_ErrorIncorrectStateOperation;
+    FP_CHECK(FP_OMX_PortReserveBuffers(pFoilplanetPort) == OMX_ErrorNone);
+
+    for (i = 0; i < pFoilplanetPort->portDefinition.nBufferCountActual; i++) {
+        if (pFoilplanetPort->bufferStateAllocate[i] != BUFFER_STATE_FREE)
+            continue;
+        pBufferHdr = (OMX_BUFFERHEADERTYPE *)calloc(1, sizeof(OMX_BUFFERHEADERTYPE));
+        INIT_SET_SIZE_VERSION(pBufferHdr, OMX_BUFFERHEADERTYPE);
+        pBufferHdr->pBuffer = pBuffer;
+        pBufferHdr->nAllocLen = nSizeBytes;
+        pBufferHdr->pAppPrivate = pAppPrivate;
+        pBufferHdr->nInputPortIndex = nPortIndex;
+        pFoilplanetPort->extendBufferHeader[i].OMXBufferHeader = pBufferHdr;
+        pFoilplanetPort->bufferStateAllocate[i] = (BUFFER_STATE_ASSIGNED | HEADER_STATE_ALLOCATED);
+        FP_OMX_StampBufferHeader(pFoilplanetPort, i);
+        pFoilplanetPort->assignedBufferNum++;
+        if (pFoilplanetPort->assignedBufferNum == pFoilplanetPort->portDefinition.nBufferCountActual) {
+            pFoilplanetPort->portDefinition.bPopulated = OMX_TRUE;
+            OSAL_SemaphorePost(pFoilplanetPort->loadedResource);
+        }
+        *ppBufferHdr = pBufferHdr;
+        return OMX_ErrorNone;
+    }
+    return OMX_ErrorInsufficientResources;
+}
+
+static OMX_ERRORTYPE TestFreeBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nPortIndex, OMX_BUFFERHEADERTYPE *pBufferHdr)
+{
+    FP_OMX_BASEPORT *pFoilplanetPort = &Test(hComponent)->base.pFoilplanetPort[nPortIndex];
+    OMX_S32          slot = FP_OMX_LookupBufferHeader(pFoilplanetPort, pBufferHdr);
+
+    FP_CHECK(slot >= 0);
+    free(pBufferHdr);
+    pFoilplanetPort->extendBufferHeader[slot].OMXBufferHeader = NULL;
+    pFoilplanetPort->extendBufferHeader[slot].nGeneration = 0;
+    pFoilplanetPort->bufferStateAllocate[slot] = BUFFER_STATE_FREE;
+    if (--pFoilplanetPort->assignedBufferNum == 0) {
+        pFoilplanetPort->portDefinition.bPopulated = OMX_FALSE;
+        OSAL_SemaphorePost(pFoilplanetPort->unloadedResource);
+    }
+    return OMX_ErrorNone;
+}
+
+static void TestInit(TEST_COMPONENT *pTest, const char *name)
+{
+    OMX_U32 i;
+
+    memset(pTest, 0, sizeof(*pTest));
+    pTest->name = name;
+    INIT_SET_SIZE_VERSION(&pTest->omx, OMX_COMPONENTTYPE);
+    pTest->omx.pComponentPrivate = &pTest->base;
+    FP_CHECK(FP_OMX_Port_Constructor(&pTest->omx) == OMX_ErrorNone);
+    pTest->omx.GetComponentVersion = TestGetComponentVersion;
+    pTest->omx.GetParameter = TestGetParameter;
+    pTest->omx.SetParameter = TestSetParameter;
+    pTest->omx.UseBuffer = TestUseBuffer;
+    pTest->omx.FreeBuffer = TestFreeBuffer;
+
+    for (i = 0; i < ALL_PORT_NUM; i++) {
+        FP_OMX_BASEPORT *pFoilplanetPort = &pTest->base.pFoilplanetPort[i];
+        pFoilplanetPort->hPortMutex = MUTEX_CREATE();
+        pFoilplanetPort->portDefinition.bEnabled = OMX_TRUE;
+        pFoilplanetPort->portDefinition.eDomain = OMX_PortDomainVideo;
+        pFoilplanetPort->portDefinition.format.video.eCompressionFormat = OMX_VIDEO_CodingUnused;
+        pFoilplanetPort->portDefinition.nBufferCountActual = BUFFER_NUM - 2 * i;
+        pFoilplanetPort->portDefinition.nBufferSize = BUFFER_SIZE;
+    }
+    FP_OMX_STORE(pTest->base.currentState, OMX_StateLoaded);
+    FP_OMX_STORE(pTest->base.transientState, FP_OMX_TransStateMax);
+}
+
+static void TestSetState(TEST_COMPONENT *pTest, OMX_STATETYPE state)
+{
+    OMX_U32 i;
+
+    for (i = 0; i < ALL_PORT_NUM; i++)
+        FP_OMX_STORE(pTest->base.pFoilplanetPort[i].portState, (state == OMX_StateLoaded) ? OMX_StateLoaded : OMX_StateIdle);
+    FP_OMX_STORE(pTest->base.currentState, state);
+    FP_OMX_STORE(pTest->base.transientState, FP_OMX_TransStateMax);
+}
+
+static void TestRelease(TEST_COMPONENT *pTest)
+{
+    OMX_U32 i;
+
+    for (i = 0; i < ALL_PORT_NUM; i++)
+        MUTEX_FREE(pTest->base.pFoilplanetPort[i].hPortMutex);
+    FP_CHECK(FP_OMX_Port_Destructor(&pTest->omx) == OMX_ErrorNone);
+}
+
+/* the decoder writes a frame counter, the encoder checks the counters arrive in order */
+static void *TestCodecThread(void *pData)
+{
+    TEST_COMPONENT  *pTest = (TEST_COMPONENT *)pData;
+    OMX_U32          nPort = (pTest == &gDec) ? OUTPUT_PORT_INDEX : INPUT_PORT_INDEX;
+    FP_OMX_BASEPORT *pFoilplanetPort = &pTest->base.pFoilplanetPort[nPort];
+    OMX_U32          nLast = 0;
+
+    while (FP_OMX_LOAD(pTest->bStop) != OMX_TRUE) {
+        FP_OMX_MESSAGE       *message;
+        OMX_BUFFERHEADERTYPE *pBufferHdr;
+
+        OSAL_QueueWait(pFoilplanetPort->bufferQ, 10);
+        message = FP_OMX_PortMessageDequeue(pFoilplanetPort);
+        if (message == NULL)
+            continue;
+        pBufferHdr = (OMX_BUFFERHEADERTYPE *)message->pCmdData;
+        FP_OMX_PortMessageFree(pFoilplanetPort, message);
+
+        /* the peer was handed the supplier's vpu memory, not a copy */
+        FP_CHECK(pBufferHdr->pPlatformPrivate != NULL);
+        FP_CHECK(pBufferHdr->pBuffer == (OMX_U8 *)((VPUMemLinear_t *)pBufferHdr->pPlatformPrivate)->vir_addr);
+
+        if (nPort == OUTPUT_PORT_INDEX) {
+            *(OMX_U32 *)pBufferHdr->pBuffer = ++pTest->nFrames;
+            pBufferHdr->nFilledLen = BUFFER_SIZE;
+            FP_OMX_OutputBufferReturn(&pTest->omx, pBufferHdr);
+        } else {
+            /* frames held by a stopping supplier are dropped, the rest stay in order */
+            if (*(OMX_U32 *)pBufferHdr->pBuffer <= nLast || pBufferHdr->nFilledLen != BUFFER_SIZE)
+                pTest->nBadFrames++;
+            nLast = *(OMX_U32 *)pBufferHdr->pBuffer;
+            FP_OMX_STORE(pTest->nFrames, pTest->nFrames + 1);
+            FP_OMX_InputBufferReturn(&pTest->omx, pBufferHdr);
+        }
+    }
+
+    return NULL;
+}
+
+static OMX_U32 TestHeldNum(FP_OMX_BASEPORT *pFoilplanetPort)
+{
+    OMX_U32 i, n = 0;
+
+    MUTEX_LOCK(pFoilplanetPort->hPortMutex);
+    for (i = 0; i < pFoilplanetPort->nBufferSlots; i++)
+        n += (pFoilplanetPort->extendBufferHeader[i].bTunnelHeld == OMX_TRUE);
+    MUTEX_UNLOCK(pFoilplanetPort->hPortMutex);
+
+    return n;
+}
+
+static int TestWaitHeld(FP_OMX_BASEPORT *pFoilplanetPort, OMX_U32 nHeld)
+{
+    OMX_U64 start = FP_TestNowUs();
+
+    while (TestHeldNum(pFoilplanetPort) != nHeld) {
+        if (FP_TestNowUs() - start > 5000000)
+            return 0;
+        usleep(1000);
+    }
+    return 1;
+}
+
+int main(void)
+{
+    FP_OMX_BASEPORT    *pDecOut;
+    FP_OMX_BASEPORT    *pEncIn;
+    OMX_TUNNELSETUPTYPE setup;
+    OMX_U64             start;
+    OMX_U32             i;
+
+    TestInit(&gDec, "OMX.fp.video.decoder.avc");
+    TestInit(&gEnc, "OMX.fp.video.encoder.avc");
+    pDecOut = &gDec.base.pFoilplanetPort[OUTPUT_PORT_INDEX];
+    pEncIn = &gEnc.base.pFoilplanetPort[INPUT_PORT_INDEX];
+
+    /* OMX_SetupTunnel order: output proposes, input decides */
+    memset(&setup, 0, sizeof(setup));
+    FP_CHECK(FP_OMX_TunnelRequest(&gDec.omx, OUTPUT_PORT_INDEX, &gEnc.omx, INPUT_PORT_INDEX, &setup) == OMX_ErrorNone);
+    FP_CHECK(setup.eSupplier == OMX_BufferSupplyOutput);
+    FP_CHECK(FP_OMX_TunnelRequest(&gEnc.omx, INPUT_PORT_INDEX, &gDec.omx, OUTPUT_PORT_INDEX, &setup) == OMX_ErrorNone);
+    FP_CHECK(CHECK_PORT_TUNNELED(pDecOut) && CHECK_PORT_BUFFER_SUPPLIER(pDecOut));
+    FP_CHECK(CHECK_PORT_TUNNELED(pEncIn) && !CHECK_PORT_BUFFER_SUPPLIER(pEncIn));
+
+    /* only the tunneled non supplier takes buffers before its idle transition */
+    FP_CHECK(FP_OMX_TunnelAcceptsBuffer(&gEnc.base, pEncIn) == OMX_TRUE);
+    FP_CHECK(FP_OMX_TunnelAcceptsBuffer(&gEnc.base, &gEnc.base.pFoilplanetPort[OUTPUT_PORT_INDEX]) == OMX_FALSE);
+    FP_CHECK(FP_OMX_TunnelAcceptsBuffer(&gDec.base, pDecOut) == OMX_FALSE);
+
+    /* the decoder goes idle first, the encoder is still loaded and nothing waits */
+    FP_OMX_STORE(gDec.base.transientState, FP_OMX_TransStateLoadedToIdle);
+    start = FP_TestNowUs();
+    FP_CHECK(FP_OMX_TunnelAllocateBuffer(pDecOut, OUTPUT_PORT_INDEX) == OMX_ErrorNone);
+    FP_CHECK(FP_TestNowUs() - start < 100000);
+    FP_CHECK(pDecOut->portDefinition.nBufferCountActual == BUFFER_NUM);
+    FP_CHECK(pEncIn->portDefinition.nBufferCountActual == BUFFER_NUM);
+    FP_CHECK(pDecOut->tunnelBufferNum == BUFFER_NUM && pEncIn->assignedBufferNum == BUFFER_NUM);
+    FP_CHECK(host_vpumem_live == BUFFER_NUM);
+    /* the encoder's own transition finds its port populated */
+    FP_CHECK(OSAL_SemaphoreWait(pEncIn->loadedResource) == OMX_ErrorNone);
+    FP_CHECK(pEncIn->portDefinition.bPopulated == OMX_TRUE);
+
+    TestSetState(&gDec, OMX_StateExecuting);
+    TestSetState(&gEnc, OMX_StateExecuting);
+    FP_CHECK(pthread_create(&gDec.thread, NULL, TestCodecThread, &gDec) == 0);
+    FP_CHECK(pthread_create(&gEnc.thread, NULL, TestCodecThread, &gEnc) == 0);
+
+    /* the supplier starts the loop by sending every buffer to be filled */
+    FP_CHECK(TestHeldNum(pDecOut) == BUFFER_NUM);
+    FP_OMX_TunnelResume(&gDec.omx, OUTPUT_PORT_INDEX);
+    start = FP_TestNowUs();
+    while (FP_OMX_LOAD(gEnc.nFrames) < FRAME_NUM && FP_TestNowUs() - start < 30000000)
+        usleep(1000);
+    FP_CHECK(FP_OMX_LOAD(gEnc.nFrames) >= FRAME_NUM);
+
+    /* a supplier leaving executing keeps every buffer that comes home */
+    FP_OMX_STORE(gDec.base.transientState, FP_OMX_TransStateExecutingToIdle);
+    FP_CHECK(TestWaitHeld(pDecOut, BUFFER_NUM));
+    FP_CHECK(OSAL_GetElemNum(pDecOut->bufferQ) == 0 && OSAL_GetElemNum(pEncIn->bufferQ) == 0);
+
+    /* and sends them on again when it executes */
+    FP_OMX_STORE(gDec.base.transientState, FP_OMX_TransStateMax);
+    i = FP_OMX_LOAD(gEnc.nFrames);
+    FP_OMX_TunnelResume(&gDec.omx, OUTPUT_PORT_INDEX);
+    start = FP_TestNowUs();
+    while (FP_OMX_LOAD(gEnc.nFrames) < i + 1000 && FP_TestNowUs() - start < 30000000)
+        usleep(1000);
+    FP_CHECK(FP_OMX_LOAD(gEnc.nFrames) >= i + 1000);
+
+    FP_OMX_STORE(gDec.base.transientState, FP_OMX_TransStateExecutingToIdle);
+    FP_CHECK(TestWaitHeld(pDecOut, BUFFER_NUM));
+    FP_OMX_STORE(gDec.bStop, OMX_TRUE);
+    FP_OMX_STORE(gEnc.bStop, OMX_TRUE);
+    pthread_join(gDec.thread, NULL);
+    pthread_join(gEnc.thread, NULL);
+    FP_CHECK(gEnc.nBadFrames == 0);
+    printf("%u frames looped through %d tunnel buffers\n", (unsigned)gEnc.nFrames, BUFFER_NUM);
+
+    /* idle to loaded, the supplier frees the peer headers and keeps the memory cached */
+    TestSetState(&gDec, OMX_StateIdle);
+    TestSetState(&gEnc, OMX_StateIdle);
+    FP_CHECK(FP_OMX_TunnelFreeBuffer(pDecOut, OUTPUT_PORT_INDEX) == OMX_ErrorNone);
+    FP_CHECK(pEncIn->assignedBufferNum == 0 && pDecOut->assignedBufferNum == 0);
+    FP_CHECK(OSAL_SemaphoreWait(pEncIn->unloadedResource) == OMX_ErrorNone);
+    OSAL_VpumemTrim(0);
+    FP_CHECK(host_vpumem_live == 0);
+
+    TestRelease(&gDec);
+    TestRelease(&gEnc);
+
+    printf("omx_tunnel_test passed\n");
+    return 0;
+}
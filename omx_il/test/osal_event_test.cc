@@ -0,0 +1,188 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+
+#include "fp_test.h"
+#include "OMX_Def.h"
+#include "osal_event.h"
+#include "osal_queue.h"
+
+#define SEMA_LOOPS  100000
+
+static OMX_HANDLETYPE gSema;
+static long           gConsumed;
+static long           gWallOffset;
+
+/*
+ * Wall clock reads for the whole process come through here, shifted by
+ * gWallOffset seconds. A deadline taken from CLOCK_REALTIME is then that
+ * far off the time the kernel waits on, as after an NTP step.
+ */
+extern "C" int clock_gettime(clockid_t clk, struct timespec *ts)
+{
+    int ret = (int)syscall(SYS_clock_gettime, clk, ts);
+
+    if (ret == 0 && (clk == CLOCK_REALTIME || clk == CLOCK_REALTIME_COARSE))
+        ts->tv_sec += gWallOffset;
+    return ret;
+}
+
+static void TestSignal(void)
+{
+    OMX_HANDLETYPE event;
+    OMX_U64        start;
+
+    FP_CHECK(OSAL_SignalCreate(&event) == OMX_ErrorNone);
+
+    start = FP_TestNowUs();
+    FP_CHECK(OSAL_SignalWait(event, 50) == OMX_ErrorTimeout);
+    FP_CHECK(FP_TestNowUs() - start >= 50000);
+
+    /* a set event stays set for plain waits, WaitReset consumes it */
+    OSAL_SignalSet(event);
+    FP_CHECK(OSAL_SignalWait(event, 10) == OMX_ErrorNone);
+    FP_CHECK(OSAL_SignalWaitReset(event, 10) == OMX_ErrorNone);
+    FP_CHECK(OSAL_SignalWaitReset(event, 10) == OMX_ErrorTimeout);
+
+    OSAL_SignalTerminate(event);
+}
+
+static void WaitsAcrossJump(long nOffset)
+{
+    OMX_HANDLETYPE event, queue;
+    OMX_U64        start;
+
+    FP_CHECK(OSAL_SignalCreate(&event) == OMX_ErrorNone);
+    FP_CHECK(OSAL_QueueCreate(&queue, 4, OMX_FALSE) == OMX_ErrorNone);
+    gWallOffset = nOffset;
+
+    start = FP_TestNowUs();
+    FP_CHECK(OSAL_SignalWait(event, 50) == OMX_ErrorTimeout);
+    FP_CHECK(OSAL_SignalWaitReset(event, 50) == OMX_ErrorTimeout);
+    FP_CHECK(OSAL_QueueWait(queue, 50) == OMX_ErrorTimeout);
+    FP_CHECK(FP_TestNowUs() - start >= 150000);
+    FP_CHECK(FP_TestNowUs() - start < 2000000);
+
+    gWallOffset = 0;
+    OSAL_QueueTerminate(queue);
+    OSAL_SignalTerminate(event);
+}
+
+/*
+ * Timeouts keep their length whichever way the wall clock is off: an hour
+ * ahead would make a realtime wait last an hour, behind would end it at
+ * once. The alarm ends a wait that hangs.
+ */
+static void TestClockJump(void)
+{
+    struct timespec wall, real;
+
+    clock_gettime(CLOCK_REALTIME, &real);
+    gWallOffset = 3600;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    gWallOffset = 0;
+    FP_CHECK(wall.tv_sec - real.tv_sec >= 3599);
+
+    alarm(10);
+    WaitsAcrossJump(3600);
+    WaitsAcrossJump(-3600);
+    alarm(0);
+}
+
+static void *Consumer(void *)
+{
+    int i;
+
+    for (i = 0; i < SEMA_LOOPS; i++) {
+        FP_CHECK(OSAL_SemaphoreWait(gSema) == OMX_ErrorNone);
+        __atomic_add_fetch(&gConsumed, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void *Producer(void *)
+{
+    int i;
+
+    for (i = 0; i < SEMA_LOOPS; i++)
+        OSAL_SemaphorePost(gSema);
+    return NULL;
+}
+
+static void TestSemaphore(void)
+{
+    pthread_t thread[4];
+    OMX_S32   count;
+    int       i;
+
+    FP_CHECK(OSAL_SemaphoreCreate(&gSema) == OMX_ErrorNone);
+    for (i = 0; i < 2; i++) {
+        pthread_create(&thread[i], NULL, Consumer, NULL);
+        pthread_create(&thread[i + 2], NULL, Producer, NULL);
+    }
+    for (i = 0; i < 4; i++)
+        pthread_join(thread[i], NULL);
+
+    OSAL_Get_SemaphoreCount(gSema, &count);
+    FP_CHECK(gConsumed == 2 * SEMA_LOOPS && count == 0);
+
+    OSAL_Set_SemaphoreCount(gSema, 3);
+    OSAL_Get_SemaphoreCount(gSema, &count);
+    FP_CHECK(count == 3);
+    FP_CHECK(OSAL_Set_SemaphoreCount(gSema, -1) == OMX_ErrorBadParameter);
+
+    FP_CHECK(OSAL_SemaphoreTerminate(gSema) == OMX_ErrorNone);
+}
+
+static void *BlockedWaiter(void *arg)
+{
+    *(OMX_ERRORTYPE *)arg = OSAL_SemaphoreWait(gSema);
+    return NULL;
+}
+
+/* terminate with blocked waiters fails their waits instead of leaving them on freed memory */
+static void TestTerminateWaiters(void)
+{
+    pthread_t     thread[3];
+    OMX_ERRORTYPE result[3];
+    int           i;
+
+    FP_CHECK(OSAL_SemaphoreCreate(&gSema) == OMX_ErrorNone);
+    for (i = 0; i < 3; i++) {
+        result[i] = OMX_ErrorNone;
+        pthread_create(&thread[i], NULL, BlockedWaiter, &result[i]);
+    }
+    usleep(50000);
+
+    FP_CHECK(OSAL_SemaphoreTerminate(gSema) == OMX_ErrorNone);
+    for (i = 0; i < 3; i++) {
+        pthread_join(thread[i], NULL);
+        FP_CHECK(result[i] == OMX_ErrorInvalidState);
+    }
+}
+
+int main(void)
+{
+    TestSignal();
+    TestClockJump();
+    TestSemaphore();
+    TestTerminateWaiters();
+    printf("osal_event_test passed\n");
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Per buffer cost of handing a port message to the codec thread.
+ *
+ * "list" is the path bufferQ had before the ring queue: the port mutex,
+ * an mpp_list style locked list with a malloc'd node and a copy of the
+ * message, and a semaphore the consumer sleeps on. "ring" is the
+ * OSAL_Queue path: a slot token in the lock-free ring and OSAL_QueueWait.
+ */
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+
+#include "fp_test.h"
+#include "OMX_Def.h"
+#include "osal_event.h"
+#include "osal_queue.h"
+
+typedef struct {
+    OMX_U32 messageType;
+    OMX_U32 messageParam;
+    OMX_PTR pCmdData;
+} BENCH_MESSAGE;
+
+typedef struct _BENCH_NODE {
+    BENCH_MESSAGE       msg;
+    struct _BENCH_NODE *next;
+} BENCH_NODE;
+
+typedef struct {
+    pthread_mutex_t portMutex;
+    pthread_mutex_t listMutex;
+    BENCH_NODE     *head;
+    BENCH_NODE     *tail;
+    sem_t           sem;
+} BENCH_LIST;
+
+static void ListPut(BENCH_LIST *list, const BENCH_MESSAGE *msg)
+{
+    pthread_mutex_lock(&list->portMutex);
+    BENCH_NODE *node = (BENCH_NODE *)malloc(sizeof(BENCH_NODE));
+    memcpy(&node->msg, msg, sizeof(BENCH_MESSAGE));
+    node->next = NULL;
+    pthread_mutex_lock(&list->listMutex);
+    if (list->tail)
+        list->tail->next = node;
+    else
+        list->head = node;
+    list->tail = node;
+    pthread_mutex_unlock(&list->listMutex);
+    sem_post(&list->sem);
+    pthread_mutex_unlock(&list->portMutex);
+}
+
+static void ListGet(BENCH_LIST *list, BENCH_MESSAGE *msg)
+{
+    sem_wait(&list->sem);
+    pthread_mutex_lock(&list->listMutex);
+    BENCH_NODE *node = list->head;
+    list->head = node->next;
+    if (list->head == NULL)
+        list->tail = NULL;
+    pthread_mutex_unlock(&list->listMutex);
+    memcpy(msg, &node->msg, sizeof(BENCH_MESSAGE));
+    free(node);
+}
+
+static BENCH_MESSAGE gSlab[64];
+static long          gCount;
+
+static void RingPut(OMX_HANDLETYPE queue, OMX_U32 slot)
+{
+    gSlab[slot].messageType = 1;
+    gSlab[slot].messageParam = slot;
+    while (OSAL_Queue(queue, (OMX_PTR)(intptr_t)(slot + 1)) != OMX_ErrorNone)
+        sched_yield();
+}
+
+static OMX_U32 RingGet(OMX_HANDLETYPE queue)
+{
+    OMX_PTR token;
+
+    while ((token = OSAL_Dequeue(queue)) == NULL)
+        OSAL_QueueWait(queue, DEF_MAX_WAIT_TIME);
+    return (OMX_U32)(intptr_t)token - 1;
+}
+
+static void *ListConsumer(void *arg)
+{
+    BENCH_MESSAGE msg;
+    long          i;
+
+    for (i = 0; i < gCount; i++)
+        ListGet((BENCH_LIST *)arg, &msg);
+    return NULL;
+}
+
+static void *RingConsumer(void *arg)
+{
+    long i;
+
+    for (i = 0; i < gCount; i++)
+        RingGet((OMX_HANDLETYPE)arg);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    BENCH_LIST     list;
+    OMX_HANDLETYPE queue;
+    BENCH_MESSAGE  msg = {1, 0, NULL};
+    pthread_t      thread;
+    OMX_U64        start;
+    double         listSame, ringSame, listCross, ringCross;
+    long           i;
+
+    gCount = FP_TestQuick(argc, argv) ? 20000 : 2000000;
+
+    memset(&list, 0, sizeof(list));
+    pthread_mutex_init(&list.portMutex, NULL);
+    pthread_mutex_init(&list.listMutex, NULL);
+    sem_init(&list.sem, 0, 0);
+    FP_CHECK(OSAL_QueueCreate(&queue, 64, OMX_FALSE) == OMX_ErrorNone);
+
+    /* put and get on one thread: the uncontended cost of each path */
+    start = FP_TestNowUs();
+    for (i = 0; i < gCount; i++) {
+        ListPut(&list, &msg);
+        ListGet(&list, &msg);
+    }
+    listSame = (FP_TestNowUs() - start) * 1000.0 / gCount;
+
+    start = FP_TestNowUs();
+    for (i = 0; i < gCount; i++) {
+        RingPut(queue, i & 63);
+        FP_CHECK(RingGet(queue) == (OMX_U32)(i & 63));
+    }
+    ringSame = (FP_TestNowUs() - start) * 1000.0 / gCount;
+
+    /* client thread to codec thread, the consumer sleeps when it runs dry */
+    start = FP_TestNowUs();
+    pthread_create(&thread, NULL, ListConsumer, &list);
+    for (i = 0; i < gCount; i++)
+        ListPut(&list, &msg);
+    pthread_join(thread, NULL);
+    listCross = (FP_TestNowUs() - start) * 1000.0 / gCount;
+
+    start = FP_TestNowUs();
+    pthread_create(&thread, NULL, RingConsumer, queue);
+    for (i = 0; i < gCount; i++)
+        RingPut(queue, i & 63);
+    pthread_join(thread, NULL);
+    ringCross = (FP_TestNowUs() - start) * 1000.0 / gCount;
+
+    FP_CHECK(OSAL_GetElemNum(queue) == 0);
+    printf("%ld buffers, ns per buffer\n", gCount);
+    printf("  same thread    list %8.1f   ring %8.1f\n", listSame, ringSame);
+    printf("  cross thread   list %8.1f   ring %8.1f\n", listCross, ringCross);
+
+    OSAL_QueueTerminate(queue);
+    sem_destroy(&list.sem);
+    return 0;
+}
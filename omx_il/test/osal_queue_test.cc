@@ -0,0 +1,142 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "fp_test.h"
+#include "OMX_Def.h"
+#include "osal_event.h"
+#include "osal_queue.h"
+
+#define PRODUCERS   4
+#define PER_THREAD  200000
+
+static OMX_HANDLETYPE gQueue;
+
+static void *Producer(void *arg)
+{
+    intptr_t id = (intptr_t)arg;
+    intptr_t i;
+
+    for (i = 1; i <= PER_THREAD;) {
+        if (OSAL_Queue(gQueue, (OMX_PTR)((id << 24) | i)) == OMX_ErrorNone)
+            i++;
+    }
+    return NULL;
+}
+
+/* several producers, one blocking consumer, per producer order is kept */
+static void TestMpsc(void)
+{
+    pthread_t thread[PRODUCERS];
+    intptr_t  last[PRODUCERS] = {0};
+    long      got = 0;
+    intptr_t  i;
+
+    FP_CHECK(OSAL_QueueCreate(&gQueue, 40, OMX_FALSE) == OMX_ErrorNone);
+    for (i = 0; i < PRODUCERS; i++)
+        pthread_create(&thread[i], NULL, Producer, (void *)i);
+
+    while (got < (long)PRODUCERS * PER_THREAD) {
+        OMX_PTR data = OSAL_Dequeue(gQueue);
+        if (data == NULL) {
+            OSAL_QueueWait(gQueue, 100);
+            continue;
+        }
+        intptr_t v = (intptr_t)data;
+        FP_CHECK((v & 0xffffff) == last[v >> 24] + 1);
+        last[v >> 24] = v & 0xffffff;
+        got++;
+    }
+
+    for (i = 0; i < PRODUCERS; i++)
+        pthread_join(thread[i], NULL);
+    FP_CHECK(OSAL_GetElemNum(gQueue) == 0);
+    OSAL_QueueTerminate(gQueue);
+}
+
+static void TestBounds(void)
+{
+    OMX_HANDLETYPE queue;
+    intptr_t       i;
+
+    /* rounded up to a power of two */
+    FP_CHECK(OSAL_QueueCreate(&queue, 5, OMX_TRUE) == OMX_ErrorNone);
+    for (i = 1; i <= 8; i++)
+        FP_CHECK(OSAL_Queue(queue, (OMX_PTR)i) == OMX_ErrorNone);
+    FP_CHECK(OSAL_Queue(queue, (OMX_PTR)9) == OMX_ErrorInsufficientResources);
+    FP_CHECK(OSAL_GetElemNum(queue) == 8);
+    for (i = 1; i <= 8; i++)
+        FP_CHECK(OSAL_Dequeue(queue) == (OMX_PTR)i);
+    FP_CHECK(OSAL_Dequeue(queue) == NULL);
+    OSAL_QueueTerminate(queue);
+}
+
+static void *WakeLater(void *arg)
+{
+    usleep(20000);
+    OSAL_QueueWake((OMX_HANDLETYPE)arg);
+    return NULL;
+}
+
+static void *QueueLater(void *arg)
+{
+    usleep(20000);
+    OSAL_Queue((OMX_HANDLETYPE)arg, (OMX_PTR)1);
+    return NULL;
+}
+
+static void TestWait(void)
+{
+    OMX_HANDLETYPE queue;
+    pthread_t      thread;
+    OMX_U64        start;
+
+    FP_CHECK(OSAL_QueueCreate(&queue, 4, OMX_FALSE) == OMX_ErrorNone);
+
+    start = FP_TestNowUs();
+    FP_CHECK(OSAL_QueueWait(queue, 30) == OMX_ErrorTimeout);
+    FP_CHECK(FP_TestNowUs() - start >= 30000);
+
+    /* an element ends the wait */
+    pthread_create(&thread, NULL, QueueLater, queue);
+    FP_CHECK(OSAL_QueueWait(queue, DEF_MAX_WAIT_TIME) == OMX_ErrorNone);
+    pthread_join(thread, NULL);
+    FP_CHECK(OSAL_Dequeue(queue) == (OMX_PTR)1);
+
+    /* so does a wake, without an element */
+    pthread_create(&thread, NULL, WakeLater, queue);
+    FP_CHECK(OSAL_QueueWait(queue, DEF_MAX_WAIT_TIME) == OMX_ErrorNone);
+    pthread_join(thread, NULL);
+    FP_CHECK(OSAL_Dequeue(queue) == NULL);
+
+    /* a wake nobody waited for ends the next wait once */
+    OSAL_QueueWake(queue);
+    FP_CHECK(OSAL_QueueWait(queue, 1000) == OMX_ErrorNone);
+    FP_CHECK(OSAL_QueueWait(queue, 10) == OMX_ErrorTimeout);
+
+    OSAL_QueueTerminate(queue);
+}
+
+int main(void)
+{
+    TestBounds();
+    TestWait();
+    TestMpsc();
+    printf("osal_queue_test passed\n");
+    return 0;
+}
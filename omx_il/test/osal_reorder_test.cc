@@ -0,0 +1,117 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fp_test.h"
+#include "OMX_Def.h"
+#include "osal_reorder.h"
+
+#define DEPTH       16
+#define FRAME_US    33333
+
+static void Put(OMX_HANDLETYPE reorder, OMX_TICKS nTimeStamp, OMX_U32 nFlags, OMX_PTR pMarkData)
+{
+    OSAL_REORDER_ENTRY entry;
+
+    memset(&entry, 0, sizeof(entry));
+    entry.nTimeStamp = nTimeStamp;
+    entry.nFlags = nFlags;
+    entry.hMarkTargetComponent = pMarkData ? (OMX_HANDLETYPE)&entry : NULL;
+    entry.pMarkData = pMarkData;
+    FP_CHECK(OSAL_ReorderPut(reorder, &entry) == OMX_ErrorNone);
+}
+
+/* B-frame style output order: groups of four come out reversed */
+static void TestReorder(OMX_HANDLETYPE reorder)
+{
+    OSAL_REORDER_ENTRY entry;
+    long               g, i;
+
+    for (g = 0; g < 250; g++) {
+        for (i = 0; i < 4; i++)
+            Put(reorder, (g * 4 + i) * FRAME_US, g * 4 + i, (OMX_PTR)(g * 4 + i + 1));
+        for (i = 3; i >= 0; i--) {
+            FP_CHECK(OSAL_ReorderTake(reorder, (g * 4 + i) * FRAME_US, &entry) == OMX_TRUE);
+            FP_CHECK(entry.nFlags == (OMX_U32)(g * 4 + i));
+            FP_CHECK(entry.pMarkData == (OMX_PTR)(g * 4 + i + 1));
+        }
+    }
+    FP_CHECK(OSAL_ReorderTake(reorder, 0, &entry) == OMX_FALSE);
+}
+
+/* equal timestamps are taken first in, first out with their own flags and marks */
+static void TestSameTimestamp(OMX_HANDLETYPE reorder)
+{
+    OSAL_REORDER_ENTRY entry;
+
+    Put(reorder, 5000, OMX_BUFFERFLAG_SYNCFRAME, (OMX_PTR)1);
+    Put(reorder, 6000, 0, NULL);
+    Put(reorder, 5000, OMX_BUFFERFLAG_EOS, (OMX_PTR)2);
+    Put(reorder, 5000, 0, NULL);
+
+    FP_CHECK(OSAL_ReorderTake(reorder, 5000, &entry) == OMX_TRUE);
+    FP_CHECK(entry.nFlags == OMX_BUFFERFLAG_SYNCFRAME && entry.pMarkData == (OMX_PTR)1);
+    FP_CHECK(OSAL_ReorderTake(reorder, 5000, &entry) == OMX_TRUE);
+    FP_CHECK(entry.nFlags == OMX_BUFFERFLAG_EOS && entry.pMarkData == (OMX_PTR)2);
+    FP_CHECK(OSAL_ReorderTake(reorder, 6000, &entry) == OMX_TRUE);
+    FP_CHECK(OSAL_ReorderTake(reorder, 5000, &entry) == OMX_TRUE);
+    FP_CHECK(entry.nFlags == 0 && entry.pMarkData == NULL);
+    FP_CHECK(OSAL_ReorderTake(reorder, 5000, &entry) == OMX_FALSE);
+}
+
+/* frames never output expire oldest first, also between equal timestamps */
+static void TestExpire(OMX_HANDLETYPE reorder)
+{
+    OSAL_REORDER_ENTRY entry;
+    int                found = 0;
+    long               i;
+
+    for (i = 0; i < 100; i++)
+        Put(reorder, 1000000 + i, i, NULL);
+    for (i = 0; i < 100; i++) {
+        if (OSAL_ReorderTake(reorder, 1000000 + i, &entry)) {
+            FP_CHECK(i >= 100 - DEPTH);
+            found++;
+        }
+    }
+    FP_CHECK(found == DEPTH);
+
+    for (i = 0; i < DEPTH + 4; i++)
+        Put(reorder, 7000, i, NULL);
+    for (i = 4; i < DEPTH + 4; i++) {
+        FP_CHECK(OSAL_ReorderTake(reorder, 7000, &entry) == OMX_TRUE);
+        FP_CHECK(entry.nFlags == (OMX_U32)i);
+    }
+    FP_CHECK(OSAL_ReorderTake(reorder, 7000, &entry) == OMX_FALSE);
+}
+
+int main(void)
+{
+    OMX_HANDLETYPE reorder;
+
+    FP_CHECK(OSAL_ReorderCreate(&reorder, DEPTH) == OMX_ErrorNone);
+    TestReorder(reorder);
+    TestSameTimestamp(reorder);
+    TestExpire(reorder);
+
+    Put(reorder, 1, 0, NULL);
+    OSAL_ReorderReset(reorder);
+    OSAL_REORDER_ENTRY entry;
+    FP_CHECK(OSAL_ReorderTake(reorder, 1, &entry) == OMX_FALSE);
+
+    OSAL_ReorderTerminate(reorder);
+    printf("osal_reorder_test passed\n");
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+
+#include "fp_test.h"
+#include "osal_repack.h"
+
+typedef struct {
+    OMX_U32 nWidth;
+    OMX_U32 nHeight;
+    OMX_U32 nStride;
+} BENCH_CASE;
+
+typedef struct {
+    const BENCH_CASE *c;
+    OMX_HANDLETYPE    repack;
+    OMX_U8           *src;
+    OMX_U8           *dst;
+    long              nFrames;
+    double            msPerFrame;
+} BENCH_RUN;
+
+/* what FP_Frame2Outbuf did before: one memcpy per row on the output thread */
+static void RowLoop(OMX_U8 *dst, OMX_U32 nDstStride, const OMX_U8 *src, OMX_U32 nSrcStride,
+                    OMX_U32 nWidth, OMX_U32 nRows)
+{
+    OMX_U32 i;
+
+    for (i = 0; i < nRows; i++)
+        memcpy(dst + (size_t)i * nDstStride, src + (size_t)i * nSrcStride, nWidth);
+}
+
+static OMX_U32 SliceRows(const BENCH_CASE *c)
+{
+    return (c->nHeight + 15) & ~15;
+}
+
+/* decoder NV12 at its stride into a packed output buffer, like the copy mode output */
+static void *RunFrames(void *arg)
+{
+    BENCH_RUN        *run = (BENCH_RUN *)arg;
+    const BENCH_CASE *c = run->c;
+    OMX_U8           *uvSrc = run->src + (size_t)c->nStride * SliceRows(c);
+    OMX_U8           *uvDst = run->dst + (size_t)c->nWidth * c->nHeight;
+    OMX_U64           start;
+    long              n;
+
+    start = FP_TestNowUs();
+    for (n = 0; n < run->nFrames; n++) {
+        OSAL_RepackPlane(run->repack, run->dst, c->nWidth, run->src, c->nStride, c->nWidth, c->nHeight);
+        OSAL_RepackPlane(run->repack, uvDst, c->nWidth, uvSrc, c->nStride, c->nWidth, c->nHeight / 2);
+    }
+    run->msPerFrame = (FP_TestNowUs() - start) / 1000.0 / run->nFrames;
+    return NULL;
+}
+
+static OMX_U8 *AllocSource(const BENCH_CASE *c)
+{
+    size_t  nSize = (size_t)c->nStride * SliceRows(c) * 3 / 2;
+    OMX_U8 *src = (OMX_U8 *)malloc(nSize);
+    size_t  i;
+
+    FP_CHECK(src != NULL);
+    for (i = 0; i < nSize; i++)
+        src[i] = (OMX_U8)(i * 2654435761u >> 24);
+    return src;
+}
+
+int main(int argc, char **argv)
+{
+    static const BENCH_CASE cases[] = {
+        { 1920, 1080, 1920 + 256 },
+        { 3840, 2160, 4096 + 256 },
+        { 1920, 1080, 1920 },
+    };
+    static const OMX_U32 stripes[] = { 1, 2, 4 };
+    long     nFrames = FP_TestQuick(argc, argv) ? 3 : 100;
+    unsigned i, j;
+
+    printf("%ld frames, ms per NV12 frame\n", nFrames);
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const BENCH_CASE *c = &cases[i];
+        size_t            nOut = (size_t)c->nWidth * c->nHeight * 3 / 2;
+        OMX_U8           *src = AllocSource(c);
+        OMX_U8           *ref = (OMX_U8 *)malloc(nOut);
+        OMX_U8           *dst[2];
+        BENCH_RUN         run[2];
+        pthread_t         thread;
+        OMX_U64           start;
+        long              n;
+
+        dst[0] = (OMX_U8 *)malloc(nOut);
+        dst[1] = (OMX_U8 *)malloc(nOut);
+        FP_CHECK(ref != NULL && dst[0] != NULL && dst[1] != NULL);
+
+        start = FP_TestNowUs();
+        for (n = 0; n < nFrames; n++) {
+            RowLoop(ref, c->nWidth, src, c->nStride, c->nWidth, c->nHeight);
+            RowLoop(ref + (size_t)c->nWidth * c->nHeight, c->nWidth,
+                    src + (size_t)c->nStride * SliceRows(c), c->nStride, c->nWidth, c->nHeight / 2);
+        }
+        printf("  %4ux%-4u stride %4u  row loop      %7.3f\n", (unsigned)c->nWidth, (unsigned)c->nHeight,
+               (unsigned)c->nStride, (FP_TestNowUs() - start) / 1000.0 / nFrames);
+
+        for (j = 0; j < sizeof(stripes) / sizeof(stripes[0]); j++) {
+            memset(&run[0], 0, sizeof(run[0]));
+            run[0].c = c;
+            run[0].src = src;
+            run[0].dst = dst[0];
+            run[0].nFrames = nFrames;
+            FP_CHECK(OSAL_RepackCreate(&run[0].repack, stripes[j]) == OMX_ErrorNone);
+            memset(dst[0], 0, nOut);
+            RunFrames(&run[0]);
+            FP_CHECK(memcmp(ref, dst[0], nOut) == 0);
+            printf("  %4ux%-4u stride %4u  %u stripe(s)   %7.3f\n", (unsigned)c->nWidth, (unsigned)c->nHeight,
+                   (unsigned)c->nStride, (unsigned)stripes[j], run[0].msPerFrame);
+            OSAL_RepackTerminate(run[0].repack);
+        }
+
+        /* two decoders repacking at once, each on its own stripe workers */
+        for (j = 0; j < 2; j++) {
+            memset(&run[j], 0, sizeof(run[j]));
+            run[j].c = c;
+            run[j].src = src;
+            run[j].dst = dst[j];
+            run[j].nFrames = nFrames;
+            FP_CHECK(OSAL_RepackCreate(&run[j].repack, 2) == OMX_ErrorNone);
+            memset(dst[j], 0, nOut);
+        }
+        pthread_create(&thread, NULL, RunFrames, &run[1]);
+        RunFrames(&run[0]);
+        pthread_join(thread, NULL);
+        for (j = 0; j < 2; j++) {
+            FP_CHECK(memcmp(ref, dst[j], nOut) == 0);
+            OSAL_RepackTerminate(run[j].repack);
+        }
+        printf("  %4ux%-4u stride %4u  2 x 2 stripes %7.3f %7.3f\n", (unsigned)c->nWidth, (unsigned)c->nHeight,
+               (unsigned)c->nStride, run[0].msPerFrame, run[1].msPerFrame);
+
+        free(src);
+        free(ref);
+        free(dst[0]);
+        free(dst[1]);
+    }
+
+    return 0;
+}
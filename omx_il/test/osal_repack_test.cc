@@ -0,0 +1,133 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "fp_test.h"
+#include "osal_repack.h"
+
+#define WIDTH       1920
+#define HEIGHT      1080
+#define HOR_STRIDE  1920
+#define VER_STRIDE  1088
+
+/* a gralloc buffer stood in for by a memfd, as a dma-buf it has an fd and a size */
+typedef struct {
+    int      fd;
+    OMX_U32  nStride;
+    OMX_U32  nSize;
+    OMX_U8  *pData;
+} TEST_ANB;
+
+static void AnbAlloc(TEST_ANB *anb, OMX_U32 nStride, OMX_U32 nRows)
+{
+    struct stat st;
+
+    anb->fd = (int)syscall(SYS_memfd_create, "fpomx_anb", 0);
+    FP_CHECK(anb->fd > 0);
+    FP_CHECK(ftruncate(anb->fd, (off_t)nStride * nRows * 3 / 2) == 0);
+    FP_CHECK(fstat(anb->fd, &st) == 0);
+    anb->nStride = nStride;
+    anb->nSize = (OMX_U32)st.st_size;
+    anb->pData = (OMX_U8 *)mmap(NULL, anb->nSize, PROT_READ | PROT_WRITE, MAP_SHARED, anb->fd, 0);
+    FP_CHECK(anb->pData != MAP_FAILED);
+}
+
+static void AnbFree(TEST_ANB *anb)
+{
+    munmap(anb->pData, anb->nSize);
+    close(anb->fd);
+}
+
+/* the mock decoder writes frame n in its own layout, HOR_STRIDE x VER_STRIDE */
+static void DecodeInto(OMX_U8 *dst, OMX_U32 n)
+{
+    OMX_U32 x, y;
+
+    for (y = 0; y < VER_STRIDE * 3 / 2; y++)
+        for (x = 0; x < HOR_STRIDE; x++)
+            dst[y * HOR_STRIDE + x] = (OMX_U8)(x * 7 + y * 13 + n);
+}
+
+/* what the display sees: the visible rows of both planes at the buffer stride */
+static void CheckShown(const TEST_ANB *anb, OMX_U32 nSliceRows, OMX_U32 n)
+{
+    const OMX_U8 *uv = anb->pData + (size_t)anb->nStride * nSliceRows;
+    OMX_U32       x, y;
+
+    for (y = 0; y < HEIGHT; y++)
+        for (x = 0; x < WIDTH; x++)
+            FP_CHECK(anb->pData[y * anb->nStride + x] == (OMX_U8)(x * 7 + y * 13 + n));
+    for (y = 0; y < HEIGHT / 2; y++)
+        for (x = 0; x < WIDTH; x++)
+            FP_CHECK(uv[y * anb->nStride + x] == (OMX_U8)(x * 7 + (VER_STRIDE + y) * 13 + n));
+}
+
+static void TestLayout(void)
+{
+    TEST_ANB anb;
+
+    AnbAlloc(&anb, HOR_STRIDE, VER_STRIDE);
+    FP_CHECK(OSAL_RepackLayoutMatches(anb.fd, anb.nStride, anb.nSize, HOR_STRIDE, VER_STRIDE));
+    FP_CHECK(OSAL_RepackLayoutMatches(anb.fd, anb.nStride, 0, HOR_STRIDE, VER_STRIDE));
+    FP_CHECK(!OSAL_RepackLayoutMatches(0, anb.nStride, anb.nSize, HOR_STRIDE, VER_STRIDE));
+    FP_CHECK(!OSAL_RepackLayoutMatches(-1, anb.nStride, anb.nSize, HOR_STRIDE, VER_STRIDE));
+    FP_CHECK(!OSAL_RepackLayoutMatches(anb.fd, anb.nStride, anb.nSize, HOR_STRIDE + 64, VER_STRIDE));
+    FP_CHECK(!OSAL_RepackLayoutMatches(anb.fd, anb.nStride, anb.nSize, HOR_STRIDE, VER_STRIDE + 16));
+    AnbFree(&anb);
+}
+
+/*
+ * A buffer at another stride gets a repacked copy of each frame. Buffers at
+ * the decoder layout are decoded into, vdec_decode_test covers those.
+ */
+static void TestRepack(void)
+{
+    TEST_ANB       copied;
+    OMX_HANDLETYPE repack = NULL;
+    OMX_U8        *frame = NULL;
+    OMX_U32        n;
+
+    AnbAlloc(&copied, WIDTH + 64, HEIGHT);
+    FP_CHECK(!OSAL_RepackLayoutMatches(copied.fd, copied.nStride, copied.nSize, HOR_STRIDE, VER_STRIDE));
+
+    frame = (OMX_U8 *)malloc(HOR_STRIDE * VER_STRIDE * 3 / 2);
+    FP_CHECK(frame != NULL);
+    FP_CHECK(OSAL_RepackCreate(&repack, 2) == OMX_ErrorNone);
+
+    for (n = 0; n < 4; n++) {
+        DecodeInto(frame, n);
+        OSAL_RepackPlane(repack, copied.pData, copied.nStride, frame, HOR_STRIDE, WIDTH, HEIGHT);
+        OSAL_RepackPlane(repack, copied.pData + (size_t)copied.nStride * HEIGHT, copied.nStride,
+                         frame + HOR_STRIDE * VER_STRIDE, HOR_STRIDE, WIDTH, HEIGHT / 2);
+        CheckShown(&copied, HEIGHT, n);
+    }
+
+    OSAL_RepackTerminate(repack);
+    free(frame);
+    AnbFree(&copied);
+}
+
+int main(void)
+{
+    TestLayout();
+    TestRepack();
+
+    printf("osal_repack_test passed\n");
+    return 0;
+}
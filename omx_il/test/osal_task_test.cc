@@ -0,0 +1,177 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+
+#include "fp_test.h"
+#include "OMX_Def.h"
+#include "osal_task.h"
+
+#define QUEUES      8
+#define TASKS       1000
+#define MAX_QUEUES  (OSAL_TASK_MAX_CODEC_WORKERS + 4)
+
+static pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  gCond;            /* on CLOCK_MONOTONIC, set up in main */
+static int             gArrived;
+static int             gTarget;
+static int             gRunning;
+static int             gMaxRunning;
+static long            gNext[QUEUES];
+
+static int ThreadCount(void)
+{
+    DIR           *dir = opendir("/proc/self/task");
+    struct dirent *entry;
+    int            count = 0;
+
+    FP_CHECK(dir != NULL);
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.')
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+static void OrderTask(OMX_PTR pTaskData)
+{
+    long value = (long)pTaskData;
+    int  index = value / TASKS;
+
+    /* tasks of one queue never overlap, so no lock for its own counter */
+    FP_CHECK(gNext[index] == value % TASKS);
+    gNext[index]++;
+}
+
+static void TestOrder(void)
+{
+    OMX_HANDLETYPE queue[QUEUES];
+    long           i, j;
+
+    for (i = 0; i < QUEUES; i++)
+        FP_CHECK(OSAL_SerialQueueCreate(&queue[i], OSAL_TASK_POOL_CALLBACK, 16) == OMX_ErrorNone);
+    for (j = 0; j < TASKS; j++) {
+        for (i = 0; i < QUEUES; i++)
+            FP_CHECK(OSAL_SerialQueueSubmit(queue[i], OrderTask, (OMX_PTR)(i * TASKS + j)) == OMX_ErrorNone);
+    }
+    /* terminate runs what is still pending */
+    for (i = 0; i < QUEUES; i++) {
+        OSAL_SerialQueueTerminate(queue[i]);
+        FP_CHECK(gNext[i] == TASKS);
+    }
+}
+
+/* waits until gTarget tasks are running at once, or gives up after 5s */
+static void BarrierTask(OMX_PTR)
+{
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += 5;
+
+    pthread_mutex_lock(&gLock);
+    gArrived++;
+    gRunning++;
+    if (gRunning > gMaxRunning)
+        gMaxRunning = gRunning;
+    pthread_cond_broadcast(&gCond);
+    while (gArrived < gTarget) {
+        if (pthread_cond_timedwait(&gCond, &gLock, &deadline))
+            break;
+    }
+    gRunning--;
+    pthread_mutex_unlock(&gLock);
+}
+
+static int RunBarrier(OSAL_TASK_POOL_TYPE poolType, int nQueues, int nTarget)
+{
+    OMX_HANDLETYPE queue[MAX_QUEUES];
+    int            i;
+
+    FP_CHECK(nQueues <= MAX_QUEUES);
+    gArrived = gRunning = gMaxRunning = 0;
+    gTarget = nTarget;
+    for (i = 0; i < nQueues; i++) {
+        FP_CHECK(OSAL_SerialQueueCreate(&queue[i], poolType, 1) == OMX_ErrorNone);
+        FP_CHECK(OSAL_SerialQueueSubmit(queue[i], BarrierTask, NULL) == OMX_ErrorNone);
+    }
+    for (i = 0; i < nQueues; i++)
+        OSAL_SerialQueueTerminate(queue[i]);
+    return gMaxRunning;
+}
+
+/* blocked command tasks must not keep other queues from running */
+static void TestCommandPool(void)
+{
+    FP_CHECK(RunBarrier(OSAL_TASK_POOL_COMMAND, QUEUES, QUEUES) == QUEUES);
+}
+
+/*
+ * More queues than workers: the first cap of them meet at the barrier,
+ * the others only start once those returned.
+ */
+static void TestCaps(void)
+{
+    FP_CHECK(RunBarrier(OSAL_TASK_POOL_CALLBACK, QUEUES, OSAL_TASK_MAX_WORKERS) == OSAL_TASK_MAX_WORKERS);
+    FP_CHECK(RunBarrier(OSAL_TASK_POOL_COMMAND, OSAL_TASK_MAX_COMMAND_WORKERS + 4,
+                        OSAL_TASK_MAX_COMMAND_WORKERS) == OSAL_TASK_MAX_COMMAND_WORKERS);
+    FP_CHECK(RunBarrier(OSAL_TASK_POOL_CODEC, OSAL_TASK_MAX_CODEC_WORKERS + 4,
+                        OSAL_TASK_MAX_CODEC_WORKERS) == OSAL_TASK_MAX_CODEC_WORKERS);
+}
+
+static void CountTask(OMX_PTR pTaskData)
+{
+    __atomic_add_fetch((int *)pTaskData, 1, __ATOMIC_RELAXED);
+}
+
+/* the last queue joins the workers, a new queue starts them again */
+static void TestJoin(void)
+{
+    OMX_HANDLETYPE queue[2];
+    int            base = ThreadCount();
+    int            count = 0;
+    int            round, i;
+
+    for (round = 0; round < 3; round++) {
+        for (i = 0; i < 2; i++)
+            FP_CHECK(OSAL_SerialQueueCreate(&queue[i], OSAL_TASK_POOL_CALLBACK, 1) == OMX_ErrorNone);
+        for (i = 0; i < 100; i++)
+            OSAL_SerialQueueSubmit(queue[i & 1], CountTask, &count);
+        OSAL_SerialQueueTerminate(queue[0]);
+        OSAL_SerialQueueTerminate(queue[1]);
+        FP_CHECK(count == (round + 1) * 100);
+        FP_CHECK(ThreadCount() == base);
+    }
+}
+
+int main(void)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&gCond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    TestOrder();
+    TestCommandPool();
+    TestCaps();
+    TestJoin();
+    printf("osal_task_test passed\n");
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sched.h>
+#include <cutils/properties.h>
+
+#include "fp_test.h"
+#include "osal_thread.h"
+
+static void TestCpuList(void)
+{
+    /* ranges and lists */
+    FP_CHECK(OSAL_ParseCpuList("4-5") == 0x30);
+    FP_CHECK(OSAL_ParseCpuList("0,2,3") == 0x0D);
+    FP_CHECK(OSAL_ParseCpuList("0-1,4-7") == 0xF3);
+    FP_CHECK(OSAL_ParseCpuList("3") == 0x08);
+    FP_CHECK(OSAL_ParseCpuList("0x30") == 0x30);
+    FP_CHECK(OSAL_ParseCpuList("31") == 0x80000000UL);
+    FP_CHECK(OSAL_ParseCpuList("0-31") == 0xFFFFFFFFUL);
+
+    /* cpus past the mask width are dropped, the rest of the list stays */
+    FP_CHECK(OSAL_ParseCpuList("32") == 0);
+    FP_CHECK(OSAL_ParseCpuList("30-40") == 0xC0000000UL);
+    FP_CHECK(OSAL_ParseCpuList("1,64") == 0x02);
+    FP_CHECK(OSAL_ParseCpuList("0x1ffffffff") == 0xFFFFFFFFUL);
+
+    /* malformed lists place nothing rather than half of what was meant */
+    FP_CHECK(OSAL_ParseCpuList(NULL) == 0);
+    FP_CHECK(OSAL_ParseCpuList("") == 0);
+    FP_CHECK(OSAL_ParseCpuList("5-4") == 0);
+    FP_CHECK(OSAL_ParseCpuList("4-") == 0);
+    FP_CHECK(OSAL_ParseCpuList("-4") == 0);
+    FP_CHECK(OSAL_ParseCpuList("1,,2") == 0);
+    FP_CHECK(OSAL_ParseCpuList("1,") == 0);
+    FP_CHECK(OSAL_ParseCpuList("4 5") == 0);
+    FP_CHECK(OSAL_ParseCpuList("big") == 0);
+    FP_CHECK(OSAL_ParseCpuList("0x") == 0);
+    FP_CHECK(OSAL_ParseCpuList("0x3g") == 0);
+}
+
+static void TestBigCluster(void)
+{
+    static const OMX_U32 rk3399[] = { 1416000, 1416000, 1416000, 1416000, 1800000, 1800000 };
+    static const OMX_U32 rk3588[] = { 1800000, 1800000, 1800000, 1800000,
+                                      2256000, 2256000, 2304000, 2304000 };
+    static const OMX_U32 rk3328[] = { 1296000, 1296000, 1296000, 1296000 };
+    OMX_U32 wide[40];
+    OMX_U32 i;
+
+    FP_CHECK(OSAL_BigClusterMask(rk3399, 6) == 0x30);
+    /* only the fastest cores count as big */
+    FP_CHECK(OSAL_BigClusterMask(rk3588, 8) == 0xC0);
+    /* all cores alike, no cluster to prefer */
+    FP_CHECK(OSAL_BigClusterMask(rk3328, 4) == 0);
+    FP_CHECK(OSAL_BigClusterMask(rk3328, 0) == 0);
+
+    /* the top cpu of the mask is placed, the ones past it are not looked at */
+    for (i = 0; i < 40; i++)
+        wide[i] = (i == 31 || i >= 36) ? 2000000 : 1000000;
+    FP_CHECK(OSAL_BigClusterMask(wide, 40) == 0x80000000UL);
+}
+
+static void TestDefaults(void)
+{
+    OSAL_THREAD_POLICY policy, untouched;
+
+    OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_CONTROL, &policy);
+    FP_CHECK(policy.nCpuMask == 0 && policy.nNice == -10);
+    FP_CHECK(policy.nFifoPriority == 0 && policy.cCgroup[0] == '\0');
+
+    OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_COPY, &policy);
+    FP_CHECK(policy.nNice == -10 && policy.nFifoPriority == 0);
+
+    OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_WORKER, &policy);
+    FP_CHECK(policy.nCpuMask == 0 && policy.nNice == OSAL_THREAD_NICE_UNCHANGED);
+    FP_CHECK(policy.nFifoPriority == 0 && policy.cCgroup[0] == '\0');
+
+    /* properties override each field, a malformed cpu list places nothing */
+    property_set("vendor.omx.thread.copy.cpus", "4-5");
+    property_set("vendor.omx.thread.copy.nice", "-4");
+    property_set("vendor.omx.thread.copy.fifo", "2");
+    property_set("vendor.omx.thread.copy.cgroup", "/dev/cpuset/foreground");
+    OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_COPY, &policy);
+    FP_CHECK(policy.nCpuMask == 0x30 && policy.nNice == -4 && policy.nFifoPriority == 2);
+    FP_CHECK(strcmp(policy.cCgroup, "/dev/cpuset/foreground") == 0);
+
+    property_set("vendor.omx.thread.copy.cpus", "4-5,");
+    OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_COPY, &policy);
+    FP_CHECK(policy.nCpuMask == 0);
+
+    /* roles out of range leave the policy alone */
+    memset(&policy, 0x5a, sizeof(policy));
+    untouched = policy;
+    OSAL_GetThreadPolicy(OSAL_THREAD_ROLE_NUM, &policy);
+    FP_CHECK(memcmp(&policy, &untouched, sizeof(policy)) == 0);
+}
+
+static void TestFifoClamp(void)
+{
+    OMX_U32 nMin = (OMX_U32)sched_get_priority_min(SCHED_FIFO);
+    OMX_U32 nMax = (OMX_U32)sched_get_priority_max(SCHED_FIFO);
+
+    FP_CHECK(OSAL_ClampFifoPriority(0, OSAL_THREAD_FIFO_MAX) == 0);
+    FP_CHECK(OSAL_ClampFifoPriority(nMax, OSAL_THREAD_FIFO_MAX) == nMax);
+    FP_CHECK(OSAL_ClampFifoPriority(nMax + 1, OSAL_THREAD_FIFO_MAX) == nMax);
+    FP_CHECK(OSAL_ClampFifoPriority((OMX_U32)-1, OSAL_THREAD_FIFO_MAX) == nMax);
+    FP_CHECK(OSAL_ClampFifoPriority(nMin, OSAL_THREAD_FIFO_MAX) == nMin);
+
+    /* a client config never gets past the lower cap */
+    FP_CHECK(OSAL_ClampFifoPriority(99, OSAL_THREAD_FIFO_CONFIG_MAX) == OSAL_THREAD_FIFO_CONFIG_MAX);
+    FP_CHECK(OSAL_ClampFifoPriority(1, OSAL_THREAD_FIFO_CONFIG_MAX) == 1);
+}
+
+int main(void)
+{
+    TestCpuList();
+    TestBigCluster();
+    TestDefaults();
+    TestFifoClamp();
+
+    printf("osal_thread_test passed\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fp_test.h"
+#include "OMX_Def.h"
+#include "osal_vpumem.h"
+
+#define IDLE_MS     200
+
+extern int host_vpumem_live;
+
+static int Live(void)
+{
+    return __sync_fetch_and_add(&host_vpumem_live, 0);
+}
+
+/* a released block comes back for the same size and is page rounded */
+static void TestReuse(void)
+{
+    VPUMemLinear_t *a = NULL;
+    VPUMemLinear_t *b = NULL;
+
+    FP_CHECK(OSAL_VpumemAcquire(1280 * 720 * 3 / 2, &a) == OMX_ErrorNone);
+    /* 337.5 pages */
+    FP_CHECK(a->size == 1384448);
+    FP_CHECK(Live() == 1);
+    OSAL_VpumemRelease(a);
+    FP_CHECK(OSAL_VpumemCachedBytes() == 1384448);
+
+    FP_CHECK(OSAL_VpumemAcquire(1280 * 720 * 3 / 2 - 100, &b) == OMX_ErrorNone);
+    FP_CHECK(b == a && Live() == 1);
+    FP_CHECK(OSAL_VpumemCachedBytes() == 0);
+
+    /* still referenced, the second release caches it */
+    OSAL_VpumemAddRef(b);
+    OSAL_VpumemRelease(b);
+    FP_CHECK(OSAL_VpumemCachedBytes() == 0);
+    OSAL_VpumemRelease(b);
+    FP_CHECK(OSAL_VpumemCachedBytes() == 1384448);
+
+    OSAL_VpumemTrim(0);
+    FP_CHECK(OSAL_VpumemCachedBytes() == 0 && Live() == 0);
+}
+
+/* small requests do not take a block more than a quarter larger */
+static void TestSizeWindow(void)
+{
+    VPUMemLinear_t *big = NULL;
+    VPUMemLinear_t *small = NULL;
+
+    FP_CHECK(OSAL_VpumemAcquire(1 << 20, &big) == OMX_ErrorNone);
+    OSAL_VpumemRelease(big);
+    FP_CHECK(OSAL_VpumemAcquire(4096, &small) == OMX_ErrorNone);
+    FP_CHECK(small != big && small->size == 4096 && Live() == 2);
+    OSAL_VpumemRelease(small);
+
+    OSAL_VpumemTrim(0);
+    FP_CHECK(Live() == 0);
+}
+
+/* the reaper frees idle blocks without any further acquire or release */
+static void TestIdle(void)
+{
+    VPUMemLinear_t *mem[4];
+    OMX_U64         start;
+    int             i;
+
+    for (i = 0; i < 4; i++)
+        FP_CHECK(OSAL_VpumemAcquire((i + 1) * 65536, &mem[i]) == OMX_ErrorNone);
+    for (i = 0; i < 4; i++)
+        OSAL_VpumemRelease(mem[i]);
+    FP_CHECK(Live() == 4);
+
+    start = FP_TestNowUs();
+    while (Live() != 0 && FP_TestNowUs() - start < IDLE_MS * 20 * 1000)
+        usleep(10 * 1000);
+    FP_CHECK(Live() == 0);
+    FP_CHECK(FP_TestNowUs() - start >= IDLE_MS * 1000 / 2);
+    FP_CHECK(OSAL_VpumemCachedBytes() == 0);
+
+    /* the exited reaper is joined and a new one started */
+    FP_CHECK(OSAL_VpumemAcquire(8192, &mem[0]) == OMX_ErrorNone);
+    OSAL_VpumemRelease(mem[0]);
+    start = FP_TestNowUs();
+    while (Live() != 0 && FP_TestNowUs() - start < IDLE_MS * 20 * 1000)
+        usleep(10 * 1000);
+    FP_CHECK(Live() == 0);
+}
+
+int main(void)
+{
+    char idle[16];
+
+    snprintf(idle, sizeof(idle), "%d", IDLE_MS);
+    setenv("vendor.omx.vpumem.idle_ms", idle, 1);
+
+    TestReuse();
+    TestSizeWindow();
+    TestIdle();
+
+    printf("osal_vpumem_test passed\n");
+    return 0;
+}
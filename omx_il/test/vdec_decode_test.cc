@@ -0,0 +1,370 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The real H.264 decoder component on the mock libvpu, output to native
+ * buffers. Decodes a stream end to end and checks every frame lands in the
+ * right buffer, that the VPU_FRAME descriptors stop coming from the heap
+ * once the pool has warmed up, and that no thread of the component
+ * outlives it. Native buffers in copy mode go through the import decision:
+ * memfd buffers at the decoder stride are swapped to the import pool and
+ * decoded into, others keep getting repacked copies.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+#include "fp_test.h"
+#include "OMX_Def.h"
+#include "OMX_Macros.h"
+#include "Foilplanet_OMX_Basecomponent.h"
+#include "Foilplanet_OMX_Resourcemanager.h"
+#include "osal_android.h"
+#include "video/dec/library_register.h"
+#include "video/dec/vdec.h"
+#include "host_android.h"
+#include "host_vpu.h"
+
+#define FRAME_NUM       300
+#define FRAME_WARMUP    60
+#define PACKET_SIZE     64
+#define MAX_BUFFERS     32
+
+typedef struct _TEST_CASE {
+    const char                 *name;
+    OMX_U32                     nWidth;
+    OMX_U32                     nHeight;
+    OMX_U32                     nAnbStride;     /* of the native buffers */
+    OMX_BOOL                    bCopyFirst;     /* native buffers enabled while in copy mode */
+    FP_OMX_BUFFERPROCESS_TYPE   eExpected;      /* output mode once the port is populated */
+} TEST_CASE;
+
+typedef struct _TEST_CLIENT {
+    pthread_mutex_t        lock;
+    pthread_cond_t         cond;
+    OMX_STATETYPE          state;
+    OMX_U32                nErrors;
+    OMX_U32                nPortChanges;
+    OMX_BUFFERHEADERTYPE  *emptied[MAX_BUFFERS];
+    OMX_U32                nEmptied;
+    OMX_BUFFERHEADERTYPE  *filled[MAX_BUFFERS];
+    OMX_U32                nFilled;
+} TEST_CLIENT;
+
+static TEST_CLIENT gClient;
+
+static OMX_ERRORTYPE OnEvent(OMX_HANDLETYPE, OMX_PTR, OMX_EVENTTYPE eEvent,
+                             OMX_U32 nData1, OMX_U32 nData2, OMX_PTR)
+{
+    pthread_mutex_lock(&gClient.lock);
+    if (eEvent == OMX_EventCmdComplete && nData1 == OMX_CommandStateSet)
+        gClient.state = (OMX_STATETYPE)nData2;
+    else if (eEvent == OMX_EventError)
+        gClient.nErrors++;
+    else if (eEvent == OMX_EventPortSettingsChanged)
+        gClient.nPortChanges++;
+    pthread_cond_broadcast(&gClient.cond);
+    pthread_mutex_unlock(&gClient.lock);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE OnEmptyBufferDone(OMX_HANDLETYPE, OMX_PTR, OMX_BUFFERHEADERTYPE *pBuffer)
+{
+    pthread_mutex_lock(&gClient.lock);
+    FP_CHECK(gClient.nEmptied < MAX_BUFFERS);
+    gClient.emptied[gClient.nEmptied++] = pBuffer;
+    pthread_cond_broadcast(&gClient.cond);
+    pthread_mutex_unlock(&gClient.lock);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE OnFillBufferDone(OMX_HANDLETYPE, OMX_PTR, OMX_BUFFERHEADERTYPE *pBuffer)
+{
+    pthread_mutex_lock(&gClient.lock);
+    FP_CHECK(gClient.nFilled < MAX_BUFFERS);
+    gClient.filled[gClient.nFilled++] = pBuffer;
+    pthread_cond_broadcast(&gClient.cond);
+    pthread_mutex_unlock(&gClient.lock);
+    return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE gCallbacks = { OnEvent, OnEmptyBufferDone, OnFillBufferDone };
+
+static void WaitState(OMX_STATETYPE state)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += 10;
+    pthread_mutex_lock(&gClient.lock);
+    while (gClient.state != state)
+        FP_CHECK(pthread_cond_timedwait(&gClient.cond, &gClient.lock, &ts) == 0);
+    pthread_mutex_unlock(&gClient.lock);
+}
+
+static int ThreadCount(void)
+{
+    DIR           *dir = opendir("/proc/self/task");
+    struct dirent *entry;
+    int            count = 0;
+
+    FP_CHECK(dir != NULL);
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.')
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+/* frame n as the mock decoder wrote it, seen through a buffer of nStride x nSlice */
+static void CheckFrame(const TEST_CASE *tc, const HOST_ANB *anb, OMX_U32 nStride, OMX_U32 nSlice, long n)
+{
+    const OMX_U8 *pData = (const OMX_U8 *)anb->pData;
+    const OMX_U8 *pChroma = pData + (size_t)nStride * nSlice;
+    OMX_U32       nDecSlice = (tc->nHeight + 15) & ~15;
+    OMX_U32       x, y;
+
+    for (y = 0; y < tc->nHeight; y += 3) {
+        for (x = 0; x < tc->nWidth; x += 5)
+            FP_CHECK(pData[y * nStride + x] == HOST_VPU_PIXEL(x, y, n));
+    }
+    for (y = 0; y < tc->nHeight / 2; y += 3) {
+        for (x = 0; x < tc->nWidth; x += 5)
+            FP_CHECK(pChroma[y * nStride + x] == HOST_VPU_PIXEL(x, nDecSlice + y, n));
+    }
+}
+
+static void SetEnableANB(OMX_COMPONENTTYPE *omx, OMX_BOOL enable)
+{
+    HOST_ENABLE_ANB_PARAMS anbParams;
+
+    INIT_SET_SIZE_VERSION(&anbParams, HOST_ENABLE_ANB_PARAMS);
+    anbParams.nPortIndex = OUTPUT_PORT_INDEX;
+    anbParams.enable = enable;
+    FP_CHECK(omx->SetParameter(omx, (OMX_INDEXTYPE)OMX_IndexParamEnableAndroidBuffers, &anbParams) == OMX_ErrorNone);
+}
+
+static void RunCase(const TEST_CASE *tc)
+{
+    OMX_COMPONENTTYPE             omx;
+    OMX_PARAM_PORTDEFINITIONTYPE  def;
+    FP_OMX_BASECOMPONENT         *pFpComponent;
+    FP_OMX_VIDEODEC_COMPONENT    *pVideoDec;
+    FP_OMX_BASEPORT              *pOutputPort;
+    OMX_BUFFERHEADERTYPE         *inputs[MAX_BUFFERS];
+    OMX_BUFFERHEADERTYPE         *outputs[MAX_BUFFERS];
+    HOST_ANB                      anbs[MAX_BUFFERS];
+    HOST_VPU_STATS                before, stats;
+    OMX_U32                       nInputs, nOutputs, nOutputSize, nAnbSize;
+    OMX_U32                       nShownStride, nShownSlice;
+    OMX_U32                       nWarmAllocs = 0;
+    int                           nThreads = ThreadCount();
+    long                          nFed = 0, nOut = 0;
+    OMX_BOOL                      bEos = OMX_FALSE;
+    OMX_U32                       i;
+
+    memset(&gClient.state, 0, sizeof(TEST_CLIENT) - offsetof(TEST_CLIENT, state));
+    gClient.state = OMX_StateLoaded;
+    host_vpu_get_stats(&before);
+
+    memset(&omx, 0, sizeof(omx));
+    INIT_SET_SIZE_VERSION(&omx, OMX_COMPONENTTYPE);
+    FP_CHECK(FP_OMX_ComponentConstructor(&omx, (OMX_STRING)FP_OMX_COMPONENT_H264_DEC) == OMX_ErrorNone);
+    FP_CHECK(omx.SetCallbacks(&omx, &gCallbacks, NULL) == OMX_ErrorNone);
+    pFpComponent = (FP_OMX_BASECOMPONENT *)omx.pComponentPrivate;
+    pVideoDec = (FP_OMX_VIDEODEC_COMPONENT *)pFpComponent->hComponentHandle;
+    pOutputPort = &pFpComponent->pFoilplanetPort[OUTPUT_PORT_INDEX];
+
+    INIT_SET_SIZE_VERSION(&def, OMX_PARAM_PORTDEFINITIONTYPE);
+    def.nPortIndex = INPUT_PORT_INDEX;
+    FP_CHECK(omx.GetParameter(&omx, OMX_IndexParamPortDefinition, &def) == OMX_ErrorNone);
+    def.format.video.nFrameWidth = tc->nWidth;
+    def.format.video.nFrameHeight = tc->nHeight;
+    FP_CHECK(omx.SetParameter(&omx, OMX_IndexParamPortDefinition, &def) == OMX_ErrorNone);
+
+    /*
+     * Enabling straight away decodes into the native buffers. Enabled after
+     * the copy mode below 176 wide it stays a copy, until the buffers come.
+     */
+    if (tc->bCopyFirst == OMX_TRUE) {
+        SetEnableANB(&omx, OMX_FALSE);
+        SetEnableANB(&omx, OMX_TRUE);
+        FP_CHECK(pOutputPort->bufferProcessType == BUFFER_COPY);
+    } else {
+        SetEnableANB(&omx, OMX_TRUE);
+        FP_CHECK(pOutputPort->bufferProcessType == BUFFER_SHARE);
+    }
+
+    def.nPortIndex = INPUT_PORT_INDEX;
+    FP_CHECK(omx.GetParameter(&omx, OMX_IndexParamPortDefinition, &def) == OMX_ErrorNone);
+    nInputs = def.nBufferCountActual;
+    FP_CHECK(nInputs <= MAX_BUFFERS);
+
+    def.nPortIndex = OUTPUT_PORT_INDEX;
+    FP_CHECK(omx.GetParameter(&omx, OMX_IndexParamPortDefinition, &def) == OMX_ErrorNone);
+    nOutputs = def.nBufferCountActual;
+    nOutputSize = def.nBufferSize;
+    FP_CHECK(nOutputs <= MAX_BUFFERS);
+    nAnbSize = tc->nAnbStride * ((tc->nHeight + 15) & ~15) * 2;
+
+    FP_CHECK(omx.SendCommand(&omx, OMX_CommandStateSet, OMX_StateIdle, NULL) == OMX_ErrorNone);
+    for (i = 0; i < nInputs; i++) {
+        FP_CHECK(omx.AllocateBuffer(&omx, &inputs[i], INPUT_PORT_INDEX, NULL, PACKET_SIZE * 4) == OMX_ErrorNone);
+    }
+    for (i = 0; i < nOutputs; i++) {
+        int fd = memfd_create("vdec_decode_test", 0);
+
+        FP_CHECK(fd >= 0);
+        FP_CHECK(ftruncate(fd, nAnbSize) == 0);
+        memset(&anbs[i], 0, sizeof(HOST_ANB));
+        anbs[i].priv.format = HAL_PIXEL_FORMAT_YCrCb_NV12;
+        anbs[i].priv.share_fd = fd;
+        anbs[i].priv.stride = tc->nAnbStride;
+        anbs[i].priv.size = nAnbSize;
+        anbs[i].pData = mmap(NULL, nAnbSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        FP_CHECK(anbs[i].pData != MAP_FAILED);
+        FP_CHECK(omx.UseBuffer(&omx, &outputs[i], OUTPUT_PORT_INDEX, &anbs[i], nOutputSize,
+                               (OMX_U8 *)&anbs[i]) == OMX_ErrorNone);
+    }
+    WaitState(OMX_StateIdle);
+    FP_CHECK(pOutputPort->bufferProcessType == tc->eExpected);
+
+    /* decoded into at the decoder layout, or copied packed at the frame width */
+    if (tc->eExpected == BUFFER_SHARE) {
+        nShownStride = tc->nAnbStride;
+        nShownSlice = (tc->nHeight + 15) & ~15;
+    } else {
+        nShownStride = tc->nWidth;
+        nShownSlice = tc->nHeight;
+    }
+
+    FP_CHECK(omx.SendCommand(&omx, OMX_CommandStateSet, OMX_StateExecuting, NULL) == OMX_ErrorNone);
+    WaitState(OMX_StateExecuting);
+
+    pthread_mutex_lock(&gClient.lock);
+    for (i = 0; i < nInputs; i++)
+        gClient.emptied[gClient.nEmptied++] = inputs[i];
+    pthread_mutex_unlock(&gClient.lock);
+    for (i = 0; i < nOutputs; i++)
+        FP_CHECK(omx.FillThisBuffer(&omx, outputs[i]) == OMX_ErrorNone);
+
+    while (bEos == OMX_FALSE) {
+        OMX_BUFFERHEADERTYPE *pInput = NULL;
+        OMX_BUFFERHEADERTYPE *pOutput = NULL;
+        struct timespec       ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 10;
+        pthread_mutex_lock(&gClient.lock);
+        while (gClient.nFilled == 0 && (gClient.nEmptied == 0 || nFed == FRAME_NUM))
+            FP_CHECK(pthread_cond_timedwait(&gClient.cond, &gClient.lock, &ts) == 0);
+        if (gClient.nFilled > 0) {
+            pOutput = gClient.filled[0];
+            memmove(&gClient.filled[0], &gClient.filled[1], --gClient.nFilled * sizeof(pOutput));
+        }
+        if (nFed < FRAME_NUM && gClient.nEmptied > 0)
+            pInput = gClient.emptied[--gClient.nEmptied];
+        FP_CHECK(gClient.nErrors == 0);
+        FP_CHECK(gClient.nPortChanges == 0);
+        pthread_mutex_unlock(&gClient.lock);
+
+        if (pInput != NULL) {
+            memset(pInput->pBuffer, 0xa5, PACKET_SIZE);
+            pInput->nOffset = 0;
+            pInput->nFilledLen = PACKET_SIZE;
+            pInput->nTimeStamp = nFed * 1000;
+            pInput->nFlags = (nFed == FRAME_NUM - 1) ? OMX_BUFFERFLAG_EOS : 0;
+            nFed++;
+            FP_CHECK(omx.EmptyThisBuffer(&omx, pInput) == OMX_ErrorNone);
+        }
+        if (pOutput != NULL) {
+            HOST_ANB *anb = (HOST_ANB *)pOutput->pAppPrivate;
+
+            FP_CHECK(pOutput->nFilledLen == tc->nWidth * tc->nHeight * 3 / 2);
+            FP_CHECK(pOutput->nTimeStamp == nOut * 1000);
+            CheckFrame(tc, anb, nShownStride, nShownSlice, nOut);
+            nOut++;
+            if (nOut == FRAME_WARMUP)
+                nWarmAllocs = FP_Dec_FrameAllocCount(pVideoDec);
+            if (pOutput->nFlags & OMX_BUFFERFLAG_EOS)
+                bEos = OMX_TRUE;
+            else
+                FP_CHECK(omx.FillThisBuffer(&omx, pOutput) == OMX_ErrorNone);
+        }
+    }
+    FP_CHECK(nOut == FRAME_NUM);
+
+    /* the prefilled pool covers every frame the decoder and the display hold */
+    FP_CHECK(nWarmAllocs != 0);
+    FP_CHECK(FP_Dec_FrameAllocCount(pVideoDec) == nWarmAllocs);
+
+    host_vpu_get_stats(&stats);
+    FP_CHECK(stats.nFrames - before.nFrames == FRAME_NUM);
+    if (tc->eExpected == BUFFER_SHARE) {
+        FP_CHECK(stats.nImported - before.nImported == FRAME_NUM);
+        FP_CHECK(stats.nCommitted - before.nCommitted == (long)nOutputs);
+    } else {
+        FP_CHECK(stats.nImported == before.nImported);
+        FP_CHECK(stats.nCommitted == before.nCommitted);
+    }
+
+    FP_CHECK(omx.SendCommand(&omx, OMX_CommandStateSet, OMX_StateIdle, NULL) == OMX_ErrorNone);
+    WaitState(OMX_StateIdle);
+    FP_CHECK(omx.SendCommand(&omx, OMX_CommandStateSet, OMX_StateLoaded, NULL) == OMX_ErrorNone);
+    for (i = 0; i < nInputs; i++)
+        FP_CHECK(omx.FreeBuffer(&omx, INPUT_PORT_INDEX, inputs[i]) == OMX_ErrorNone);
+    for (i = 0; i < nOutputs; i++)
+        FP_CHECK(omx.FreeBuffer(&omx, OUTPUT_PORT_INDEX, outputs[i]) == OMX_ErrorNone);
+    WaitState(OMX_StateLoaded);
+    FP_CHECK(omx.ComponentDeInit(&omx) == OMX_ErrorNone);
+
+    /* the codec loops returned before Loaded, their workers are joined with the last queue */
+    FP_CHECK(ThreadCount() == nThreads);
+
+    host_vpu_get_stats(&stats);
+    FP_CHECK(stats.nLiveBlocks == 0);
+    for (i = 0; i < nOutputs; i++) {
+        munmap(anbs[i].pData, nAnbSize);
+        close(anbs[i].priv.share_fd);
+    }
+
+    printf("vdec_decode_test %s: %ld frames, %u frame descriptors allocated\n", tc->name, nOut, nWarmAllocs);
+}
+
+static const TEST_CASE gCases[] = {
+    { "share",  320, 240, 320, OMX_FALSE, BUFFER_SHARE },
+    { "import", 160, 120, 160, OMX_TRUE,  BUFFER_SHARE },
+    { "copy",   160, 120, 224, OMX_TRUE,  BUFFER_COPY  },
+};
+
+int main(void)
+{
+    OMX_U32 i;
+
+    pthread_mutex_init(&gClient.lock, NULL);
+    pthread_cond_init(&gClient.cond, NULL);
+
+    /* what OMX_Init does before any component loads */
+    FP_CHECK(FP_OMX_ResourceManager_Init() == OMX_ErrorNone);
+    for (i = 0; i < sizeof(gCases) / sizeof(gCases[0]); i++)
+        RunCase(&gCases[i]);
+    FP_OMX_ResourceManager_Deinit();
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2019-2020 FoilPlanet Tech., Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include "fp_test.h"
+#include "vdec_sps.h"
+
+/* writes an SPS NAL bit by bit, with start code and emulation prevention */
+class SpsWriter {
+public:
+    void u(OMX_U32 v, int n)
+    {
+        while (n--)
+            bits.push_back((v >> n) & 1);
+    }
+    void ue(OMX_U32 v)
+    {
+        OMX_U64 x = (OMX_U64)v + 1;
+        int     n = 0;
+
+        while ((x >> n) > 1)
+            n++;
+        u(0, n);
+        u((OMX_U32)(x >> 32), n + 1 > 32 ? n + 1 - 32 : 0);
+        u((OMX_U32)x, n + 1 > 32 ? 32 : n + 1);
+    }
+    std::vector<OMX_U8> nal()
+    {
+        std::vector<OMX_U8> out;
+        size_t              i;
+        int                 zeros = 0;
+
+        out.push_back(0);
+        out.push_back(0);
+        out.push_back(0);
+        out.push_back(1);
+        u(1, 1);                    /* rbsp_stop_one_bit */
+        while (bits.size() % 8)
+            bits.push_back(0);
+        for (i = 0; i < bits.size(); i += 8) {
+            OMX_U8 byte = 0;
+            for (int b = 0; b < 8; b++)
+                byte = (byte << 1) | bits[i + b];
+            if (zeros >= 2 && byte <= 3) {
+                out.push_back(3);
+                zeros = 0;
+            }
+            zeros = byte ? 0 : zeros + 1;
+            out.push_back(byte);
+        }
+        return out;
+    }
+
+private:
+    std::vector<int> bits;
+};
+
+/* baseline profile, no VUI */
+static std::vector<OMX_U8> AvcSps(OMX_U32 level, OMX_U32 widthMbsMinus1, OMX_U32 heightMbsMinus1,
+                                  OMX_U32 frameMbsOnly, const OMX_U32 *crop)
+{
+    SpsWriter w;
+
+    w.u(0x67, 8);
+    w.u(66, 8);
+    w.u(0, 8);
+    w.u(level, 8);
+    w.ue(0);                        /* sps id */
+    w.ue(0);                        /* log2_max_frame_num_minus4 */
+    w.ue(2);                        /* poc type */
+    w.ue(4);                        /* max_num_ref_frames */
+    w.u(0, 1);
+    w.ue(widthMbsMinus1);
+    w.ue(heightMbsMinus1);
+    w.u(frameMbsOnly, 1);
+    if (!frameMbsOnly)
+        w.u(0, 1);
+    w.u(1, 1);
+    w.u(crop != NULL, 1);
+    if (crop) {
+        for (int i = 0; i < 4; i++)
+            w.ue(crop[i]);
+    }
+    w.u(0, 1);                      /* vui */
+    return w.nal();
+}
+
+/* main profile 4:2:0, one sub-layer */
+static std::vector<OMX_U8> HevcSps(OMX_U32 width, OMX_U32 height, const OMX_U32 *crop, OMX_U32 bitDepth)
+{
+    SpsWriter w;
+
+    w.u(0x4201, 16);
+    w.u(0, 4);
+    w.u(0, 3);
+    w.u(1, 1);
+    w.u(0, 32);
+    w.u(0, 32);
+    w.u(0, 32);
+    w.ue(0);                        /* sps id */
+    w.ue(1);                        /* chroma_format_idc */
+    w.ue(width);
+    w.ue(height);
+    w.u(crop != NULL, 1);
+    if (crop) {
+        for (int i = 0; i < 4; i++)
+            w.ue(crop[i]);
+    }
+    w.ue(bitDepth - 8);
+    w.ue(bitDepth - 8);
+    w.ue(4);
+    w.u(1, 1);
+    w.ue(5);                        /* max_dec_pic_buffering_minus1 */
+    w.ue(2);
+    w.ue(0);
+    return w.nal();
+}
+
+static OMX_BOOL Parse(OMX_VIDEO_CODINGTYPE codec, const std::vector<OMX_U8> &sps, VDEC_SPS_INFO *info)
+{
+    return FP_Dec_ParseSps(codec, &sps[0], sps.size(), info);
+}
+
+static void TestValid(void)
+{
+    static const OMX_U32 crop1080[4] = { 0, 0, 0, 4 };
+    static const OMX_U32 cropHevc[4] = { 0, 0, 0, 4 };
+    VDEC_SPS_INFO        info;
+
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(40, 119, 67, 1, crop1080), &info) == OMX_TRUE);
+    FP_CHECK(info.nWidth == 1920 && info.nHeight == 1080 && info.nBitDepth == 8);
+    /* level 4.0: 32768 / 8160 MBs, 4 frames */
+    FP_CHECK(info.nDpbFrames == 4);
+
+    /* interlaced 1080i codes field MB pairs */
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(40, 119, 33, 0, crop1080), &info) == OMX_TRUE);
+    FP_CHECK(info.nWidth == 1920 && info.nHeight == 1072);
+
+    /* largest picture the decoder takes */
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(52, 511, 255, 1, NULL), &info) == OMX_TRUE);
+    FP_CHECK(info.nWidth == 8192 && info.nHeight == 4096);
+
+    FP_CHECK(Parse(OMX_VIDEO_CodingHEVC, HevcSps(1920, 1088, cropHevc, 10), &info) == OMX_TRUE);
+    FP_CHECK(info.nWidth == 1920 && info.nHeight == 1080);
+    FP_CHECK(info.nBitDepth == 10 && info.nDpbFrames == 6);
+}
+
+/* none of these may divide by zero, wrap around or report a size */
+static void TestHostile(void)
+{
+    static const OMX_U32 cropAll[4] = { 0, 0, 540, 540 };
+    static const OMX_U32 cropHuge[4] = { 0x7fffffff, 0x7fffffff, 0, 0 };
+    static const OMX_U32 cropWrap[4] = { 0x80000000, 0x80000000, 0, 0 };
+    VDEC_SPS_INFO        info;
+
+    /* 65536 x 65536 MBs: the MB product wraps to 0 in 32 bits */
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(40, 65535, 65535, 1, NULL), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(40, 0xfffffffe, 0, 1, NULL), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(40, 512, 10, 1, NULL), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(40, 10, 128, 0, NULL), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(40, 119, 67, 1, cropAll), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(40, 119, 67, 1, cropHuge), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingAVC, AvcSps(40, 119, 67, 1, cropWrap), &info) == OMX_FALSE);
+
+    FP_CHECK(Parse(OMX_VIDEO_CodingHEVC, HevcSps(0, 1080, NULL, 8), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingHEVC, HevcSps(8200, 1080, NULL, 8), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingHEVC, HevcSps(1920, 4104, NULL, 8), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingHEVC, HevcSps(0xfffffffe, 1080, NULL, 8), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingHEVC, HevcSps(1920, 1080, cropAll, 8), &info) == OMX_FALSE);
+    FP_CHECK(Parse(OMX_VIDEO_CodingHEVC, HevcSps(1920, 1080, cropWrap, 8), &info) == OMX_FALSE);
+
+    /* truncated NALs fail the bit reader */
+    std::vector<OMX_U8> sps = AvcSps(40, 119, 67, 1, NULL);
+    for (size_t n = 4; n < 10; n++)
+        FP_CHECK(FP_Dec_ParseSps(OMX_VIDEO_CodingAVC, &sps[0], n, &info) == OMX_FALSE);
+}
+
+int main(void)
+{
+    TestValid();
+    TestHostile();
+    printf("vdec_sps_test passed\n");
+    return 0;
+}